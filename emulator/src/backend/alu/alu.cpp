@@ -1,9 +1,6 @@
 #include "alu.hpp"
 #include <iostream>
 
-ALU* ALU::instancePtr = nullptr;
-std::mutex ALU::mtx;
-
 ALU_Data ALU::GetALU_Data(uint16_t DataRA, uint16_t DataRB, uint8_t ALU_OpCode, bool enable)
 {
     ALU_Data ret = {};
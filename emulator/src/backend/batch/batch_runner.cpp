@@ -0,0 +1,337 @@
+#include "batch_runner.hpp"
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+
+#include "work_stealing_pool.hpp"
+#include "../machine.hpp"
+#include "../memory/program_image.hpp"
+#include "../lockstep/lockstep_engine.hpp"
+
+static const char* EngineName(ExecutionEngine engine)
+{
+    switch (engine) {
+        case ENGINE_RTL:        return "rtl";
+        case ENGINE_FUNCTIONAL: return "functional";
+        case ENGINE_JIT:        return "jit";
+        default:                return "?";
+    }
+}
+
+static bool ParseNumber(const std::string& text, uint64_t& out)
+{
+    char* end = nullptr;
+    out = std::strtoull(text.c_str(), &end, 0);
+    return !text.empty() && *end == '\0';
+}
+
+// Hashes are hex with or without 0x, as the results show them
+static bool ParseHash(const std::string& text, uint64_t& out)
+{
+    char* end = nullptr;
+    out = std::strtoull(text.c_str(), &end, 16);
+    return !text.empty() && *end == '\0';
+}
+
+// JSON keys of the results a job can expect (BatchCheck)
+static const char* const CHECK_NAMES[CHECK_COUNT] = {"cycles", "ram_hash", "fb_hash", "lcd_hash"};
+
+// --expect-<JSON key, '_' spelled '-'> -> BatchCheck, -1 for any other option
+static int FindCheck(const std::string& option)
+{
+    for (int check = 0; check < CHECK_COUNT; ++check) {
+        std::string name = CHECK_NAMES[check];
+        std::replace(name.begin(), name.end(), '_', '-');
+        if (option == "--expect-" + name)
+            return check;
+    }
+    return -1;
+}
+
+// Options of a manifest line (same spelling as organ16-run)
+static bool ParseJobOptions(const std::vector<std::string>& tokens, BatchJob& job, std::string& error)
+{
+    for (size_t i = 1; i < tokens.size(); ++i) {
+        const std::string& option = tokens[i];
+        if (i + 1 >= tokens.size()) {
+            error = "Missing value for " + option;
+            return false;
+        }
+        const std::string& text = tokens[++i];
+        uint64_t value = 0;
+        int check = FindCheck(option);
+
+        if (option == "--engine") {
+            if (text == "rtl")
+                job.engine = ENGINE_RTL;
+            else if (text == "functional")
+                job.engine = ENGINE_FUNCTIONAL;
+            else if (text == "jit")
+                job.engine = ENGINE_JIT;
+            else if (text == "lockstep")
+                job.lockstep = true;
+            else {
+                error = "Unknown engine : " + text;
+                return false;
+            }
+        }
+        else if (option == "--cycles" && ParseNumber(text, value)) {
+            job.maxCycles = value;
+        }
+        else if ((option == "--in0" || option == "--in1" || option == "--in2") && ParseNumber(text, value)) {
+            job.inputs[option[4] - '0'] = static_cast<uint16_t>(value);
+        }
+        else if (check >= 0 && (check == CHECK_CYCLES ? ParseNumber(text, value) : ParseHash(text, value))) {
+            job.checks |= 1 << check;
+            job.expected[check] = value;
+        }
+        else {
+            error = "Invalid option : " + option + " " + text;
+            return false;
+        }
+    }
+
+    if (job.lockstep && (job.checks & (1 << CHECK_LCD_HASH))) {
+        error = "The lockstep engine has no LCD to hash";
+        return false;
+    }
+    return true;
+}
+
+bool LoadBatchManifest(const std::string& path, std::vector<BatchJob>& jobs, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        error = "Could not open the manifest : " + path;
+        return false;
+    }
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::map<std::string, std::shared_ptr<const ProgramImage>> programs;
+
+    std::string text;
+    size_t line = 0;
+    while (std::getline(file, text)) {
+        ++line;
+        std::istringstream stream(text);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (stream >> token)
+            tokens.push_back(token);
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+
+        BatchJob job;
+        job.line = line;
+        job.programPath = tokens[0];
+        if (!ParseJobOptions(tokens, job, error)) {
+            error = path + ":" + std::to_string(line) + " : " + error;
+            return false;
+        }
+
+        std::filesystem::path programFile(job.programPath);
+        if (programFile.is_relative())
+            programFile = directory / programFile;
+        std::string key = programFile.lexically_normal().string();
+
+        std::shared_ptr<const ProgramImage>& program = programs[key];
+        if (!program) {
+            std::shared_ptr<ProgramImage> image = std::make_shared<ProgramImage>();
+            if (!image->Load(key, error)) {
+                error = path + ":" + std::to_string(line) + " : " + error;
+                return false;
+            }
+            program = image;
+        }
+        job.program = program;
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+// The murmur3 finalizer : every input bit reaches every output bit
+static uint64_t Mix64(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+uint64_t HashWords(const uint16_t* words, size_t count)
+{
+    // Groups of 4 words go through a full avalanche, so a difference in any word reaches all 64 bits
+    uint64_t hash = 14695981039346656037ull;
+    size_t groups = count / 4;
+    for (size_t g = 0; g < groups; ++g) {
+        const uint16_t* group = words + 4 * g;
+        uint64_t value = static_cast<uint64_t>(group[0]) | (static_cast<uint64_t>(group[1]) << 16) |
+                         (static_cast<uint64_t>(group[2]) << 32) | (static_cast<uint64_t>(group[3]) << 48);
+        hash = Mix64(hash ^ value);
+    }
+    for (size_t i = groups * 4; i < count; ++i)
+        hash = Mix64(hash ^ words[i]);
+    return hash;
+}
+
+// The panel as it shows, each 0xFFRRGGBB pixel as two words (low word first)
+static uint64_t HashPanel(const St7735s& lcd)
+{
+    std::vector<uint16_t> words(2 * LCD_WIDTH * LCD_HEIGHT);
+    uint32_t row[LCD_WIDTH];
+    for (int y = 0; y < LCD_HEIGHT; ++y) {
+        lcd.CopyRow(y, row);
+        for (int x = 0; x < LCD_WIDTH; ++x) {
+            words[2 * (y * LCD_WIDTH + x)] = static_cast<uint16_t>(row[x]);
+            words[2 * (y * LCD_WIDTH + x) + 1] = static_cast<uint16_t>(row[x] >> 16);
+        }
+    }
+    return HashWords(words.data(), words.size());
+}
+
+static std::string JsonString(const std::string& text)
+{
+    std::ostringstream out;
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+        else
+            out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+BatchSummary RunBatch(const std::vector<BatchJob>& jobs, unsigned workers, std::ostream& results)
+{
+    WorkStealingPool pool(workers);
+    BatchSummary summary;
+    summary.jobs = jobs.size();
+    summary.workers = pool.GetWorkerCount();
+
+    // Built by the worker itself, so its memory is first touched by the thread that uses it
+    std::vector<std::unique_ptr<Machine>> machines(pool.GetWorkerCount());
+    std::vector<std::unique_ptr<LockstepEngine>> lockstepEngines(pool.GetWorkerCount());
+    std::vector<uint64_t> cycles(pool.GetWorkerCount(), 0);
+    std::mutex resultsMutex;
+
+    auto start = std::chrono::steady_clock::now();
+    pool.Run(jobs.size(), [&](unsigned worker, size_t index) {
+        const BatchJob& job = jobs[index];
+        const uint16_t* memory = nullptr;
+        const char* halt = nullptr;
+        uint16_t ports[IO_PORT_COUNT] = {0, 0, 0};
+        uint64_t jobCycles = 0;
+        uint64_t lcdHash = 0;
+        auto jobStart = std::chrono::steady_clock::now();
+
+        if (job.lockstep) {
+            if (!lockstepEngines[worker])
+                lockstepEngines[worker] = std::make_unique<LockstepEngine>(1);
+            LockstepEngine& engine = *lockstepEngines[worker];
+
+            engine.LoadProgram(*job.program);
+            for (int p = 0; p < IO_PORT_COUNT; ++p)
+                engine.SetLaneInput(0, p, job.inputs[p]);
+            engine.Run(job.maxCycles * 2);
+            jobCycles = engine.GetLaneHalfTicks(0) / 2;
+
+            FunctionalStopReason reason = engine.GetLaneStopReason(0);
+            halt = reason == STOP_HALT ? "HLT" : (reason == STOP_UNSUPPORTED ? "unsupported" : "cycle limit");
+            for (int p = 0; p < IO_PORT_COUNT; ++p)
+                ports[p] = engine.GetLanePort(0, p);
+            memory = engine.GetLaneMemory(0);
+        }
+        else {
+            if (!machines[worker])
+                machines[worker] = std::make_unique<Machine>();
+            Machine& machine = *machines[worker];
+
+            machine.cpu.SetExecutionEngine(job.engine);
+            machine.LoadProgram(*job.program);
+            for (int p = 0; p < IO_PORT_COUNT; ++p)
+                machine.ioPorts.SetPortValue(p, job.inputs[p]);
+
+            jobCycles = machine.cpu.Run(job.maxCycles * 2) / 2;
+
+            halt = machine.cpu.IsHalted() ? "HLT" : "cycle limit";
+            for (int p = 0; p < IO_PORT_COUNT; ++p)
+                ports[p] = machine.ioPorts.GetIN(p);
+            memory = machine.ram.Data();
+            lcdHash = HashPanel(machine.lcd);
+        }
+        auto jobEnd = std::chrono::steady_clock::now();
+        cycles[worker] += jobCycles;
+
+        uint64_t actual[CHECK_COUNT] = {
+            jobCycles,
+            HashWords(memory, ADDRESS_SPACE),
+            HashWords(memory + FRAMEBUFFER_START, FRAMEBUFFER_END - FRAMEBUFFER_START),
+            lcdHash
+        };
+
+        // Expected results the job missed, and the same as a failure line for the summary
+        std::ostringstream mismatches;
+        std::ostringstream failure;
+        for (int check = 0; check < CHECK_COUNT; ++check) {
+            if (!((job.checks >> check) & 1) || actual[check] == job.expected[check])
+                continue;
+            mismatches << (mismatches.tellp() > 0 ? "," : "") << "\"" << CHECK_NAMES[check] << "\"";
+            failure << (failure.tellp() > 0 ? ", " : "") << CHECK_NAMES[check] << " ";
+            if (check == CHECK_CYCLES)
+                failure << actual[check] << " (expected " << job.expected[check] << ")";
+            else
+                failure << std::hex << std::setfill('0') << std::setw(16) << actual[check] << " (expected " << std::setw(16)
+                        << job.expected[check] << ")" << std::dec << std::setfill(' ');
+        }
+
+        std::ostringstream line;
+        line << "{\"line\":" << job.line
+             << ",\"program\":" << JsonString(job.programPath)
+             << ",\"engine\":\"" << (job.lockstep ? "lockstep" : EngineName(job.engine)) << "\""
+             << ",\"in\":[" << job.inputs[0] << "," << job.inputs[1] << "," << job.inputs[2] << "]"
+             << ",\"halt\":\"" << halt << "\""
+             << ",\"cycles\":" << jobCycles
+             << ",\"ports\":[" << ports[0] << "," << ports[1] << "," << ports[2] << "]"
+             << std::hex << std::setfill('0')
+             << ",\"ram_hash\":\"" << std::setw(16) << actual[CHECK_RAM_HASH] << "\""
+             << ",\"fb_hash\":\"" << std::setw(16) << actual[CHECK_FB_HASH] << "\"";
+        if (!job.lockstep)
+            line << ",\"lcd_hash\":\"" << std::setw(16) << actual[CHECK_LCD_HASH] << "\"";
+        line << std::dec << std::setfill(' ');
+        if (job.checks != 0) {
+            line << ",\"pass\":" << (failure.tellp() > 0 ? "false" : "true");
+            if (failure.tellp() > 0)
+                line << ",\"mismatch\":[" << mismatches.str() << "]";
+        }
+        line << std::fixed << std::setprecision(3)
+             << ",\"ms\":" << std::chrono::duration<double, std::milli>(jobEnd - jobStart).count()
+             << "}\n";
+
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        results << line.str() << std::flush;
+        if (failure.tellp() > 0) {
+            summary.failures.push_back("line " + std::to_string(job.line) + " : " + job.programPath + " (" +
+                                       (job.lockstep ? "lockstep" : EngineName(job.engine)) + ") : " + failure.str());
+        }
+    });
+    auto end = std::chrono::steady_clock::now();
+
+    for (uint64_t workerCycles : cycles)
+        summary.cycles += workerCycles;
+    summary.seconds = std::chrono::duration<double>(end - start).count();
+    return summary;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <ostream>
+#include <cstdint>
+
+#include "../cpu.hpp"
+#include "../memory/program_image.hpp"
+
+// Results a manifest line can expect (--expect-cycles, --expect-ram-hash...), named like their JSON keys
+enum BatchCheck{
+    CHECK_CYCLES,
+    CHECK_RAM_HASH,
+    CHECK_FB_HASH,
+    CHECK_LCD_HASH,   // What the ST7735S panel shows (no LCD on the lockstep engine)
+    CHECK_COUNT
+};
+
+// One program run of a batch : a manifest line
+struct BatchJob{
+    size_t line = 0;  // Manifest line (1 based), identifies the job in the results
+    std::string programPath;
+    ExecutionEngine engine = ENGINE_FUNCTIONAL;
+    bool lockstep = false;  // --engine lockstep : a one lane LockstepEngine runs the job instead (no devices)
+    uint64_t maxCycles = std::numeric_limits<uint64_t>::max() / 2;
+    uint16_t inputs[IO_PORT_COUNT] = {0, 0, 0};
+
+    // Bit i set : the job fails unless its result i (BatchCheck) equals expected[i]
+    uint8_t checks = 0;
+    uint64_t expected[CHECK_COUNT] = {0, 0, 0, 0};
+
+    // Read-only image, shared by every job running the same file
+    std::shared_ptr<const ProgramImage> program;
+};
+
+struct BatchSummary{
+    size_t jobs = 0;
+    unsigned workers = 0;
+    uint64_t cycles = 0;    // Simulated by all the jobs together
+    double seconds = 0.0;   // Wall clock
+
+    // One line per job that missed an expected result, in the order they finished
+    std::vector<std::string> failures;
+};
+
+// Reads a manifest : one job per line, written like an organ16-run command line without the dump options
+//   <program.bin|program.o16> [--engine functional|jit|rtl|lockstep] [--cycles N] [--in0 V] [--in1 V] [--in2 V]
+//   [--expect-cycles N] [--expect-ram-hash H] [--expect-fb-hash H] [--expect-lcd-hash H]
+// The hashes are written in hex as the results show them.
+// Blank lines and lines starting with '#' are skipped, relative program paths start from the manifest's directory.
+// Every distinct program file is loaded once. On failure returns false and describes the problem in error
+bool LoadBatchManifest(const std::string& path, std::vector<BatchJob>& jobs, std::string& error);
+
+// Runs every job on its own machine state (one Machine per worker, reset between jobs) using workers threads
+// (0 = one per hardware thread). Each result is written to results as a JSON line as soon as its job finishes,
+// the jobs that missed an expected result are listed in the summary
+BatchSummary RunBatch(const std::vector<BatchJob>& jobs, unsigned workers, std::ostream& results);
+
+// Groups of 4 words (first word in the low bits) chained through the murmur3 finalizer, the hash reported for RAM, the framebuffer and the panel
+uint64_t HashWords(const uint16_t* words, size_t count);
@@ -0,0 +1,62 @@
+#include "work_stealing_pool.hpp"
+
+#include <thread>
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    this->workerCount = workerCount;
+}
+
+bool WorkStealingPool::PopLocal(WorkerQueue& queue, size_t& job)
+{
+    std::lock_guard<std::mutex> lock(queue.mtx);
+    if (queue.jobs.empty())
+        return false;
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::Steal(std::vector<WorkerQueue>& queues, unsigned thief, size_t& job)
+{
+    // Victims are visited starting right after the thief so the workers don't all hit the same queue
+    for (unsigned offset = 1; offset < workerCount; ++offset) {
+        WorkerQueue& victim = queues[(thief + offset) % workerCount];
+        std::lock_guard<std::mutex> lock(victim.mtx);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::Run(size_t jobCount, const std::function<void(unsigned worker, size_t job)>& task)
+{
+    // Jobs are all known up front : once every queue is empty nothing new can show up
+    std::vector<WorkerQueue> queues(workerCount);
+    for (unsigned worker = 0; worker < workerCount; ++worker) {
+        size_t first = jobCount * worker / workerCount;
+        size_t last = jobCount * (worker + 1) / workerCount;
+        // Pushed in reverse so the local pops (from the back) go through the slice in order
+        for (size_t job = last; job > first; --job)
+            queues[worker].jobs.push_back(job - 1);
+    }
+
+    auto work = [&](unsigned worker) {
+        size_t job = 0;
+        while (PopLocal(queues[worker], job) || Steal(queues, worker, job))
+            task(worker, job);
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < workerCount; ++worker)
+        threads.emplace_back(work, worker);
+    work(0);
+    for (std::thread& thread : threads)
+        thread.join();
+}
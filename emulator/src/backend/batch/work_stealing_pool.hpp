@@ -0,0 +1,35 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+// Runs a fixed set of independent jobs on one thread per worker.
+// Every worker starts with its own contiguous slice of the jobs and takes them from the back of its queue;
+// once it is empty it steals from the front of the other queues, so long jobs don't leave cores idle
+class WorkStealingPool{
+    private:
+        struct WorkerQueue{
+            std::mutex mtx;
+            std::deque<size_t> jobs;
+        };
+
+        unsigned workerCount;
+
+        bool PopLocal(WorkerQueue& queue, size_t& job);
+        bool Steal(std::vector<WorkerQueue>& queues, unsigned thief, size_t& job);
+
+    public:
+        // 0 = one worker per hardware thread
+        explicit WorkStealingPool(unsigned workerCount = 0);
+
+        unsigned GetWorkerCount() const {
+            return workerCount;
+        }
+
+        // Calls task(worker, job) once for every job in [0, jobCount) and returns when they are all done.
+        // A worker runs its jobs one at a time, so per-worker state indexed by worker needs no locking
+        void Run(size_t jobCount, const std::function<void(unsigned worker, size_t job)>& task);
+};
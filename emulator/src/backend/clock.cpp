@@ -1,4 +0,0 @@
-#include "clock.hpp"
-
-Clock* Clock::instancePtr = nullptr;
-std::mutex Clock::mtx;
\ No newline at end of file
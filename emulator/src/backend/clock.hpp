@@ -1,59 +1,39 @@
 #pragma once
 
-#include <stdexcept>
-#include <mutex>
-
-void UpdateClockLabel(bool newValue);
+#include "cpu_state.hpp"
 
 class Clock{
     private:
-        Clock() {}
-        // Static pointer to the clock instance
-        static Clock* instancePtr;
-        // Mutex to ensure thread safety
-        static std::mutex mtx;
-
-        int value = false;        
+        // The clock signal lives in the Machine's CPUState
+        CPUState& state;
 
-        int frequency = 0; // [1Mhz - 100Mhz] 0 = Manual
+        double frequency = 0; // Hz, target of the ClockPacer. 0 = Manual
 
     public:
+        explicit Clock(CPUState& state) : state(state) {}
 
         Clock(const Clock&) = delete;
         Clock& operator=(const Clock&) = delete;
         Clock(Clock&&) = delete;
         Clock& operator=(Clock&&) = delete;
 
-        // Static method to get the clock instance
-        static Clock* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new Clock();
-                }
-            }
-            return instancePtr;
-        }
-
         void Increment(){
-            value = !value;
-            UpdateClockLabel(value);
+            state.clockSignal = !state.clockSignal;
         }
 
-        int GetClockSignal(bool halt){
-            return value && !halt;
+        int GetClockSignal(bool halt) const {
+            return state.clockSignal && !halt;
         }
 
-        int GetFrequency(){
+        double GetFrequency() const {
             return frequency;
         }
 
-        void SetFrequency(int newFrequency){
+        void SetFrequency(double newFrequency){
             frequency = newFrequency;
         }
 
         void Reset(){
-            value = false;
-            UpdateClockLabel(value);
+            state.clockSignal = false;
         }
-};
\ No newline at end of file
+};
@@ -0,0 +1,84 @@
+#include "clock_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "machine.hpp"
+
+void ClockPacer::Restart()
+{
+    started = false;
+    credit = 0;
+    windowHalfTicks = 0;
+    achievedFrequency = 0;
+}
+
+double ClockPacer::GetTargetFrequency() const
+{
+    return machine.clock.GetFrequency();
+}
+
+uint64_t ClockPacer::RunFrame(uint64_t maxHalfTicks)
+{
+    HostClock::time_point now = HostClock::now();
+    double frequency = GetTargetFrequency();
+    if (frequency <= 0)
+        return 0;
+
+    if (!started) {
+        started = true;
+        lastFrame = now;
+        windowStart = now;
+        return 0;
+    }
+
+    double frameSeconds = std::chrono::duration<double>(now - lastFrame).count();
+    lastFrame = now;
+    if (frameSeconds <= 0)
+        return 0;
+
+    // Two half-ticks per clock cycle
+    double targetRate = frequency * 2.0;
+    credit += frameSeconds * targetRate;
+
+    double maxCredit = targetRate * PACER_MAX_CATCH_UP_SECONDS;
+    if (credit > maxCredit) {
+        droppedHalfTicks += static_cast<uint64_t>(credit - maxCredit);
+        credit = maxCredit;
+    }
+
+    uint64_t owed = static_cast<uint64_t>(credit);
+
+    // Until the host speed is known, a first small slice measures it
+    uint64_t budget = hostRate > 0 ? static_cast<uint64_t>(hostRate * frameSeconds * PACER_FRAME_SHARE) : 1024;
+    uint64_t toRun = std::min(owed, std::max<uint64_t>(budget, 1));
+    if (toRun < owed)
+        lateFrames++;
+    toRun = std::min(toRun, maxHalfTicks);
+
+    HostClock::time_point runStart = HostClock::now();
+    uint64_t executed = toRun > 0 ? machine.cpu.Run(toRun) : 0;
+    double runSeconds = std::chrono::duration<double>(HostClock::now() - runStart).count();
+    emulationSeconds += runSeconds;
+
+    if (executed > 0 && runSeconds > 0) {
+        double measured = executed / runSeconds;
+        hostRate = hostRate > 0 ? hostRate * 0.75 + measured * 0.25 : measured;
+    }
+
+    // A halted CPU owes nothing, neither does one the debugger stopped
+    if (executed < toRun && (machine.cpu.IsHalted() || machine.debugger.HasStopped()))
+        credit = 0;
+    else
+        credit -= static_cast<double>(executed);
+
+    windowHalfTicks += executed;
+    double windowSeconds = std::chrono::duration<double>(now - windowStart).count();
+    if (windowSeconds >= PACER_MEASURE_SECONDS) {
+        achievedFrequency = windowHalfTicks / 2.0 / windowSeconds;
+        windowStart = now;
+        windowHalfTicks = 0;
+    }
+
+    return executed;
+}
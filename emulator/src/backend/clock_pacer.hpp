@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+class Machine;
+
+// Longest lateness made up for : past that, the owed cycles are dropped instead of run in a burst
+static const double PACER_MAX_CATCH_UP_SECONDS = 0.25;
+
+// Share of a host frame the emulation may take (the rest is left to the host : painting, events...)
+static const double PACER_FRAME_SHARE = 0.8;
+
+// Achieved frequency is measured over windows of this length
+static const double PACER_MEASURE_SECONDS = 0.5;
+
+// Runs a Machine at its clock's frequency (Clock::GetFrequency) against the host's monotonic clock.
+// Called once per host frame, it runs the half-ticks the elapsed time is worth. The fractional half-tick is carried to the next frame,
+// so the long run rate is exact whatever the frame length. A frame never spends more than PACER_FRAME_SHARE of its time emulating
+// (the budget follows the measured host speed), what is left over is caught up later, or dropped once it is too far behind
+class ClockPacer{
+    public:
+        typedef std::chrono::steady_clock HostClock;
+
+    private:
+        Machine& machine;
+
+        bool started = false;
+        HostClock::time_point lastFrame;
+
+        // Half-ticks owed to the target (fractional part included)
+        double credit = 0;
+
+        // Measured host speed (half-ticks per second of emulation), 0 until the first frame ran
+        double hostRate = 0;
+
+        uint64_t droppedHalfTicks = 0;
+        uint64_t lateFrames = 0;
+
+        // Host time spent inside Machine runs, since construction
+        double emulationSeconds = 0;
+
+        // Current measure window
+        HostClock::time_point windowStart;
+        uint64_t windowHalfTicks = 0;
+        double achievedFrequency = 0;
+
+    public:
+        explicit ClockPacer(Machine& machine) : machine(machine) {}
+
+        ClockPacer(const ClockPacer&) = delete;
+        ClockPacer& operator=(const ClockPacer&) = delete;
+        ClockPacer(ClockPacer&&) = delete;
+        ClockPacer& operator=(ClockPacer&&) = delete;
+
+        // Forgets the time reference and the owed cycles (clock restarted, frequency changed, machine reset)
+        void Restart();
+
+        // Runs what the time elapsed since the previous call is worth (at most maxHalfTicks). Returns the half-ticks executed
+        uint64_t RunFrame(uint64_t maxHalfTicks = std::numeric_limits<uint64_t>::max());
+
+        // Configured frequency, in Hz
+        double GetTargetFrequency() const;
+
+        // Frequency reached over the last measure window, in Hz
+        double GetAchievedFrequency() const {
+            return achievedFrequency;
+        }
+
+        // Half-ticks given up because the host could not keep up
+        uint64_t GetDroppedHalfTicks() const {
+            return droppedHalfTicks;
+        }
+
+        // Frames that could not run everything they owed
+        uint64_t GetLateFrames() const {
+            return lateFrames;
+        }
+
+        // Host seconds spent emulating (never reset : callers measure differences)
+        double GetEmulationSeconds() const {
+            return emulationSeconds;
+        }
+};
@@ -1,53 +1,204 @@
 #pragma once
 
-#include <mutex>
-
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
+// Every control signal packed into a single 32-bit word
 struct CU_Data {
-    uint8_t ALU_DATA = 0;
-    uint8_t regWrite = 0;
-    uint8_t srcRA = 0;
-    uint8_t srcRB = 0;
-    uint8_t dstR = 0;
-    uint8_t isNxtExt = 0;
-    uint8_t flagsWrite = 0;
-    uint8_t memWrite = 0;
-    uint8_t memToReg = 0;
-    uint8_t containsAddress = 0;
-    uint8_t loadPC = 0;
-    uint8_t spPop = 0;
-    uint8_t spChange = 0;
-    uint8_t jsr = 0;
-    uint8_t rts = 0;
-    uint8_t regIsAddress = 0;
-    uint8_t HLT = 0;
-    uint8_t useIn = 0;
-    uint8_t useOut = 0;
-    uint8_t ioPort = 0;
+    uint32_t ALU_DATA : 5;
+    uint32_t regWrite : 1;
+    uint32_t srcRA : 3;
+    uint32_t srcRB : 3;
+    uint32_t dstR : 3;
+    uint32_t isNxtExt : 1;
+    uint32_t flagsWrite : 1;
+    uint32_t memWrite : 1;
+    uint32_t memToReg : 1;
+    uint32_t containsAddress : 1;
+    uint32_t loadPC : 1;
+    uint32_t spPop : 1;
+    uint32_t spChange : 1;
+    uint32_t jsr : 1;
+    uint32_t rts : 1;
+    uint32_t regIsAddress : 1;
+    uint32_t HLT : 1;
+    uint32_t useIn : 1;
+    uint32_t useOut : 1;
+    uint32_t ioPort : 2;
 };
 
+static_assert(sizeof(CU_Data) == sizeof(uint32_t), "CU_Data must fit in a single word");
+
+// The decode only depends on the OpCode + SubOpCode (top 7 bits of IR0) and the 4 flags
+static const size_t CONTROL_ROM_SIZE = 1 << 11;
+
+constexpr uint16_t ControlRomAddress(uint16_t IR_0, uint8_t FlagsData){
+    return static_cast<uint16_t>(((IR_0 >> 9) << 4) | (FlagsData & 0x0F));
+}
+
+// Control signals for one ROM address (register fields left at 0, they come straight from IR0)
+constexpr CU_Data DecodeControlSignals(uint16_t romAddress){
+    CU_Data ret = {};  // Zero-initialize everything
+
+    const uint8_t OpCode = (romAddress >> 8) & 0b111;
+    const uint8_t subOpCode = (romAddress >> 4) & 0b1111;
+    const uint8_t FlagsData = romAddress & 0x0F;
+
+    // --- ALU DATA Logic ---
+    if(OpCode == 0 && subOpCode < 10){
+        ret.ALU_DATA = 16 + subOpCode;
+    }
+    else if(OpCode == 1 && (subOpCode == 10 || subOpCode == 11)){
+        ret.ALU_DATA = 26 + (subOpCode - 10);
+    }
+
+    // --- regWrite Logic ---
+    ret.regWrite = (OpCode == 5 && subOpCode == 1) ||
+                   (OpCode == 3 && (subOpCode == 0 || subOpCode == 3)) ||
+                   (OpCode == 2) ||
+                   (OpCode == 1 && subOpCode == 11) ||
+                   (OpCode == 0) ||
+                   (OpCode == 7 && (subOpCode == 1 || subOpCode == 2 || subOpCode == 3));
+
+    // --- isNxtExt Logic ---
+    ret.isNxtExt =
+        (OpCode == 0b010) ||
+        (OpCode == 0b100) ||
+        (OpCode == 0b011 && subOpCode < 2) ||
+        (OpCode == 0b101 && subOpCode == 1);
+
+    // --- flagsWrite ---
+    ret.flagsWrite = (OpCode == 0b001 && subOpCode == 10);
+
+    // --- memWrite ---
+    ret.memWrite = (OpCode == 0b011 && (subOpCode == 1 || subOpCode == 2));
+
+    // --- memToReg ---
+    ret.memToReg = (OpCode == 3 && (subOpCode == 0 || subOpCode == 3));
+
+    // --- Flags Mux Logic ---
+
+    uint8_t bit0 = (FlagsData >> 0) & 0x01;
+    uint8_t bit1 = (FlagsData >> 1) & 0x01;
+    uint8_t bit2 = (FlagsData >> 2) & 0x01;
+    uint8_t bit3 = (FlagsData >> 3) & 0x01;
+
+    bool flagsMux = false;
+    switch (subOpCode) {
+        case 0:   flagsMux = true; break;
+        case 1:   flagsMux = bit0; break;
+        case 2:   flagsMux = !bit0; break;
+        case 3:   flagsMux = bit2; break;
+        case 4:   flagsMux = bit0 | bit2; break;
+        case 5:   flagsMux = !(bit0 | bit2); break;
+        case 6:   flagsMux = !bit2; break;
+        case 7:   flagsMux = bit1 ^ bit3; break;
+        case 8:   flagsMux = bit0 | (bit1 ^ bit3); break;
+        case 9:   flagsMux = !(bit1 ^ bit3) & !bit0; break;
+        case 10:  flagsMux = (bit1 ^ bit3); break;
+        case 11:  flagsMux = true; break;
+        default:  flagsMux = false; break;
+    }
+
+    // --- containsAddress ---
+    if (OpCode == 3)
+        ret.containsAddress = 1;
+    else if(OpCode == 4)
+        ret.containsAddress = flagsMux;
+    else if(OpCode == 5 && subOpCode == 1)
+        ret.containsAddress = 1;
+
+    // --- loadPC ---
+    ret.loadPC = (OpCode == 0b100);
+
+    // --- spPop ---
+    ret.spPop = (OpCode == 0b100 && subOpCode == 12) ||
+                (OpCode == 0b101 && subOpCode == 1);
+
+    // --- spChange ---
+    ret.spChange = (OpCode == 0b100 && (subOpCode == 11 || subOpCode == 12)) ||
+                   (OpCode == 0b101);
+
+    // --- jsr ---
+    ret.jsr = (OpCode == 0b100 && subOpCode == 11);
+
+    // --- rts ---
+    ret.rts = (OpCode == 0b100 && subOpCode == 12);
+
+    // --- regIsAddress ---
+    ret.regIsAddress = (OpCode == 3 && (subOpCode == 2 || subOpCode == 3));
+
+    // --- HLT ---
+    ret.HLT = (OpCode == 7 && subOpCode == 0);
+
+    // --- Use In ---
+    ret.useIn = (OpCode == 7 && subOpCode > 0 && subOpCode < 4);
+
+    // --- Use Out ---
+    ret.useOut = (OpCode == 7 && subOpCode >= 4);
+
+    // --- IO Port --- (IN0/OUT0 -> A, IN1/OUT1 -> B, IN2/OUT2 -> C)
+    if(OpCode == 7 && subOpCode >= 1 && subOpCode <= 6){
+        ret.ioPort = (subOpCode - 1) % 3;
+    }
+
+    return ret;
+}
+
+// Hardware control ROM word : the control signals without the register fields.
+// bits 0-4 ALU_DATA, 5 regWrite, 6 isNxtExt, 7 flagsWrite, 8 memWrite, 9 memToReg, 10 containsAddress,
+// 11 loadPC, 12 spPop, 13 spChange, 14 jsr, 15 rts, 16 regIsAddress, 17 HLT, 18 useIn, 19 useOut, 20-21 ioPort
+static const int CONTROL_ROM_WORD_BITS = 22;
+
+constexpr uint32_t PackControlWord(const CU_Data& data){
+    return (static_cast<uint32_t>(data.ALU_DATA) << 0) |
+           (static_cast<uint32_t>(data.regWrite) << 5) |
+           (static_cast<uint32_t>(data.isNxtExt) << 6) |
+           (static_cast<uint32_t>(data.flagsWrite) << 7) |
+           (static_cast<uint32_t>(data.memWrite) << 8) |
+           (static_cast<uint32_t>(data.memToReg) << 9) |
+           (static_cast<uint32_t>(data.containsAddress) << 10) |
+           (static_cast<uint32_t>(data.loadPC) << 11) |
+           (static_cast<uint32_t>(data.spPop) << 12) |
+           (static_cast<uint32_t>(data.spChange) << 13) |
+           (static_cast<uint32_t>(data.jsr) << 14) |
+           (static_cast<uint32_t>(data.rts) << 15) |
+           (static_cast<uint32_t>(data.regIsAddress) << 16) |
+           (static_cast<uint32_t>(data.HLT) << 17) |
+           (static_cast<uint32_t>(data.useIn) << 18) |
+           (static_cast<uint32_t>(data.useOut) << 19) |
+           (static_cast<uint32_t>(data.ioPort) << 20);
+}
+
+constexpr std::array<CU_Data, CONTROL_ROM_SIZE> BuildControlRom(){
+    std::array<CU_Data, CONTROL_ROM_SIZE> rom = {};
+    for (size_t address = 0; address < CONTROL_ROM_SIZE; ++address) {
+        rom[address] = DecodeControlSignals(static_cast<uint16_t>(address));
+    }
+    return rom;
+}
+
 class ControlUnit{
     private:
-        ControlUnit() {}
-        static ControlUnit* instancePtr;
-        static std::mutex mtx;
-        
+        static const std::array<CU_Data, CONTROL_ROM_SIZE> controlRom;
+
     public:
+        ControlUnit() {}
+
         ControlUnit(const ControlUnit&) = delete;
         ControlUnit& operator=(const ControlUnit&) = delete;
         ControlUnit(ControlUnit&&) = delete;
         ControlUnit& operator=(ControlUnit&&) = delete;
 
-        // Static method to get the ControlUnit instance
-        static ControlUnit* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new ControlUnit();
-                }
-            }
-            return instancePtr;
+        CU_Data GetCU_Data(uint16_t IR_0, uint8_t FlagsData){
+            CU_Data ret = controlRom[ControlRomAddress(IR_0, FlagsData)];
+            ret.dstR  = (IR_0 >> 6) & 0b111;
+            ret.srcRA = (IR_0 >> 3) & 0b111;
+            ret.srcRB = IR_0 & 0b111;
+            return ret;
         }
 
-        CU_Data GetCU_Data(uint16_t IR_0, uint8_t FlagsData);
-};
\ No newline at end of file
+        // Packed control ROM words (see PackControlWord), indexed by ControlRomAddress
+        static std::array<uint32_t, CONTROL_ROM_SIZE> GetControlRomImage();
+};
@@ -1,70 +1,90 @@
 #include "cpu.hpp"
 
-CPU* CPU::instancePtr = nullptr;
-std::mutex CPU::mtx;
+#include <algorithm>
+
+#include "machine.hpp"
 
 void CPU::Tick(){
 
-    //Snapshot of previous state
-    TempOut previousTemp = TemporaryValues::GetInstance()->GetValues();
-    RegsOut previousRegs = RegisterFile::GetInstance()->GetRegsValues();
+    //Snapshot of previous state (a plain struct copy, the tick never allocates nor looks anything up)
+    CPUState& state = machine.state;
+    const CPUState previous = state;
+
+    // Each instruction is counted once, on the half-tick that starts it. The heatmap gets the RTL model's accesses from
+    // the instruction, they don't go through the bus taps (a device's transfers it starts do, as its accesses)
+    if(IsAtInstructionBoundary()){
+        machine.bus.SetAccessPC(state.PC);
+#if ORGAN16_PERF_COUNTERS
+        machine.perfCounters.CountInstruction(state.IR0, state.PC, machine.ram.Read(state.PC + 1), state.regs, state.FLAGS);
+#endif
+        if(machine.heatmap.IsEnabled())
+            machine.heatmap.CountInstruction(state.IR0, state.PC, machine.ram.Read(state.PC + 1), state.regs, state.SP);
+    }
+
+    TempOut previousTemp = machine.temporaryValues.GetValues();
     CU_Data previousControlUnitData = FetchControlUnitData();
     ALU_Data previousALUData = PerformALUOperations(previousControlUnitData);
-    uint16_t oldRBValue = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(previousControlUnitData.srcRB));
-    uint16_t oldRAValue = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(previousControlUnitData.srcRA));
-    uint16_t oldIR0Data = previousRegs.IR0;
-    uint16_t oldIR1Data = previousRegs.IR1;
+    uint16_t oldRBValue = previous.regs[previousControlUnitData.srcRB];
+    uint16_t oldRAValue = previous.regs[previousControlUnitData.srcRA];
 
     //Current state
-    Clock::GetInstance()->Increment();
-    bool currentClockSignal = Clock::GetInstance()->GetClockSignal(previousControlUnitData.HLT);
+    machine.clock.Increment();
+    bool currentClockSignal = machine.clock.GetClockSignal(previousControlUnitData.HLT);
     bool regWrite = previousControlUnitData.regWrite & (previousTemp.isCurrExt | ((previousControlUnitData.ALU_DATA & 0b10000) >> 4) | previousTemp.regIsCurrAddr | previousControlUnitData.useIn);
      
     //Clock Edge (Executed DURING edge (so we can only use old/previous values))
     TempOut newTempValues = UpdateTemporaryValuesOnClock(previousControlUnitData, previousTemp, currentClockSignal);
-    RegsOutOnChange newRegsValues = UpdateRegistersOnClock(previousControlUnitData, previousTemp, previousRegs, 
-                                                            previousALUData, oldRAMvalue, currentClockSignal, newTempValues, regWrite);
+    UpdateRegistersOnClock(previousControlUnitData, previousTemp, previous, 
+                            previousALUData, oldRAMvalue, currentClockSignal, newTempValues, regWrite);
     
-    UpdateRAMOnClock(previousControlUnitData, previousTemp, previousRegs,
+    UpdateRAMOnClock(previousControlUnitData, previousTemp, previous,
                         currentClockSignal, oldRBValue, oldRAValue, regWrite);
 
 
     CU_Data newControlUnitData = FetchControlUnitData();
-    RegsOut newRegsOut = RegisterFile::GetInstance()->GetRegsValues();
-    TempOut newTempOut = TemporaryValues::GetInstance()->GetValues();
-    uint16_t newRBValue = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(newControlUnitData.srcRB));
-    uint16_t newRAValue = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(newControlUnitData.srcRA));
-    MI_Data miData = MemoryInterface::GetInstance()->GetMI_Data(newControlUnitData, newRegsOut, newTempOut, currentClockSignal, 0, newRBValue, newRAValue, false);
-    uint16_t newRAMValue = RAM::GetInstance()->Read(miData.RAM_ADDRESS);
+    uint16_t newRBValue = state.regs[newControlUnitData.srcRB];
+    uint16_t newRAValue = state.regs[newControlUnitData.srcRA];
+    MI_Data miData = machine.memoryInterface.GetMI_Data(newControlUnitData, state, newTempValues, currentClockSignal, 0, newRBValue, newRAValue, false);
+    uint16_t newRAMValue = machine.bus.Read(miData.RAM_ADDRESS);
 
     //Clock Idle (Executed AFTER edge (so we can use new values))
-    RegsOutOnIdle regsOutOnClockIdle = UpdateRegistersOnIdle(newTempValues, newRAMValue, oldIR0Data, oldIR1Data, currentClockSignal);
+    UpdateRegistersOnIdle(newTempValues, newRAMValue, previous.IR0, previous.IR1, currentClockSignal);
 
     if(newControlUnitData.useOut)
-        SetOUT(newControlUnitData.ioPort, newRAValue);
+        machine.ioPorts.SetOUT(newControlUnitData.ioPort, newRAValue);
 
-    //Finalize (update graphics)
-    UpdateVisualRAMCurrentAddress(oldRAMAddress, miData.RAM_ADDRESS);
-    oldRAMAddress = miData.RAM_ADDRESS;
+    //Finalize
+    busAddress = miData.RAM_ADDRESS;
     oldRAMvalue = newRAMValue;
+    halfTicks++;
 }
 
 CU_Data CPU::FetchControlUnitData()
 {
-    uint16_t ir0Val = RegisterFile::GetInstance()->GetRegValue(IR0);
-    uint16_t flagsVal = RegisterFile::GetInstance()->GetRegValue(FLAGS);
-    return ControlUnit::GetInstance()->GetCU_Data(ir0Val, flagsVal);
+    uint16_t instruction = machine.state.IR0;
+
+#if ORGAN16_PERF_COUNTERS
+    // IN3 is decoded as IN2 reading the counter port instead (the control ROM has no such port)
+    if((instruction >> 9) == PERF_COUNTER_INSTRUCTION){
+        const uint16_t in2 = (0b111 << 4) | 3;
+        CU_Data data = machine.controlUnit.GetCU_Data(static_cast<uint16_t>((instruction & 0x1FF) | (in2 << 9)), machine.state.FLAGS);
+        data.ioPort = PERF_COUNTER_PORT;
+        return data;
+    }
+#endif
+
+    return machine.controlUnit.GetCU_Data(instruction, machine.state.FLAGS);
 }
 
 ALU_Data CPU::PerformALUOperations(const CU_Data& controlUnitData)
 {
-    uint16_t srcAVal = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(controlUnitData.srcRA));
-    uint16_t srcBVal = RegisterFile::GetInstance()->GetRegValue(static_cast<RegisterName>(controlUnitData.srcRB));
+    uint16_t srcAVal = machine.state.regs[controlUnitData.srcRA];
+    uint16_t srcBVal = machine.state.regs[controlUnitData.srcRB];
 
     uint8_t aluOpcode = controlUnitData.ALU_DATA & 0b01111;
     bool writeBackFlag = controlUnitData.ALU_DATA & 0b10000;
 
-    return ALU::GetInstance()->GetALU_Data(srcAVal, srcBVal, aluOpcode, writeBackFlag);
+    return machine.alu.GetALU_Data(srcAVal, srcBVal, aluOpcode, writeBackFlag);
 }
 
 TempOut CPU::UpdateTemporaryValuesOnClock(const CU_Data& oldControlUnitData, const TempOut& oldTemporaryValues, bool currentClockSignal)
@@ -79,43 +99,22 @@ TempOut CPU::UpdateTemporaryValuesOnClock(const CU_Data& oldControlUnitData, con
     tempIn.regIsAddr = oldControlUnitData.regIsAddress & !oldTemporaryValues.regIsCurrAddr;
     tempIn.isCurrExt = oldTemporaryValues.isCurrExt;
 
-    return TemporaryValues::GetInstance()->OnClockChange(tempIn);
+    return machine.temporaryValues.OnClockChange(tempIn);
 }
 
-RegsOutOnChange CPU::UpdateRegistersOnClock(CU_Data oldControlUnitData, const TempOut& oldTemporaryValues, const RegsOut& oldRegsOut, 
-                                           const ALU_Data& oldAluData, uint16_t oldRAM_OUT, bool currentClockSignal, const TempOut& newTempValues, bool regWrite)
+void CPU::UpdateRegistersOnClock(const CU_Data& oldControlUnitData, const TempOut& oldTemporaryValues, const CPUState& oldState, 
+                                 const ALU_Data& oldAluData, uint16_t oldRAM_OUT, bool currentClockSignal, const TempOut& newTempValues, bool regWrite)
 {
-    // Prepare regsOutOnChangeTemp for source registers (srcRA/srcRB)
-    RegsOutOnChange regsOutOnChangeTemp = {};
-    static const int NUM_REGISTERS = 8;
-    const uint16_t* regValues[NUM_REGISTERS] = {
-        &oldRegsOut.R0, &oldRegsOut.R1, &oldRegsOut.R2, &oldRegsOut.R3,
-        &oldRegsOut.R4, &oldRegsOut.R5, &oldRegsOut.R6, &oldRegsOut.R7
-    };
-
-    uint8_t srcRAIndex = static_cast<uint8_t>(oldControlUnitData.srcRA);
-    uint8_t srcRBIndex = static_cast<uint8_t>(oldControlUnitData.srcRB);
-
-    if (srcRAIndex < NUM_REGISTERS) {
-        regsOutOnChangeTemp.RA = *regValues[srcRAIndex];
-    }
-    if (srcRBIndex < NUM_REGISTERS) {
-        regsOutOnChangeTemp.RB = *regValues[srcRBIndex];
-    }
-    regsOutOnChangeTemp.SP = oldRegsOut.SP;
-    regsOutOnChangeTemp.PC = oldRegsOut.PC;
-    regsOutOnChangeTemp.FLAGS = oldRegsOut.FLAGS;
-    regsOutOnChangeTemp.RAM_ADDRESS = oldRegsOut.RAM_ADDRESS;
-
     RegsInOnChange regsInOnClockChange = {};
     regsInOnClockChange.carry = oldAluData.carry;
     regsInOnClockChange.flagsClock = currentClockSignal;
     regsInOnClockChange.flagsWrite = oldControlUnitData.flagsWrite;
     regsInOnClockChange.gpClock = oldTemporaryValues.isCurrAddr ? !currentClockSignal : currentClockSignal;
 
-    uint16_t ioDataIn = GetIN(oldControlUnitData.ioPort);
+    uint16_t ioDataIn = oldControlUnitData.ioPort == PERF_COUNTER_PORT ? machine.ReadPerfCounters().ReadPort(oldState.regs[oldControlUnitData.srcRA])
+                                                                      : machine.ioPorts.GetIN(oldControlUnitData.ioPort);
 
-    regsInOnClockChange.gpData = oldControlUnitData.useIn ? ioDataIn : (oldTemporaryValues.isCurrSpChange | oldTemporaryValues.regIsCurrAddr) ? oldRAM_OUT : (oldTemporaryValues.isCurrExt ? oldRegsOut.IR1 : oldAluData.result);    
+    regsInOnClockChange.gpData = oldControlUnitData.useIn ? ioDataIn : (oldTemporaryValues.isCurrSpChange | oldTemporaryValues.regIsCurrAddr) ? oldRAM_OUT : (oldTemporaryValues.isCurrExt ? oldState.IR1 : oldAluData.result);    
     regsInOnClockChange.gpRegToWrite = oldControlUnitData.dstR;
     regsInOnClockChange.gpRegWrite = regWrite;
     regsInOnClockChange.negative = oldAluData.negative;
@@ -141,7 +140,7 @@ RegsOutOnChange CPU::UpdateRegistersOnClock(CU_Data oldControlUnitData, const Te
 
     /// END OF DOOMED ZONE ///
 
-    regsInOnClockChange.pcData = (oldControlUnitData.rts) ? oldRAM_OUT : oldRegsOut.IR1;
+    regsInOnClockChange.pcData = (oldControlUnitData.rts) ? oldRAM_OUT : oldState.IR1;
     regsInOnClockChange.ramAddrClock = !currentClockSignal;
     regsInOnClockChange.raRead = oldControlUnitData.srcRA;
     regsInOnClockChange.rbRead = oldControlUnitData.srcRB;
@@ -150,19 +149,19 @@ RegsOutOnChange CPU::UpdateRegistersOnClock(CU_Data oldControlUnitData, const Te
     regsInOnClockChange.writeToPC = ((oldControlUnitData.loadPC & oldTemporaryValues.isCurrExt) & !oldTemporaryValues.isCurrJsr & oldTemporaryValues.isCurrAddr) | oldControlUnitData.rts;
     regsInOnClockChange.zero = oldAluData.zero;
 
-    return RegisterFile::GetInstance()->OnClockChange(regsInOnClockChange);
+    machine.registers.OnClockChange(regsInOnClockChange);
 }
 
-void CPU::UpdateRAMOnClock(const CU_Data& oldControlUnitData, const TempOut& oldTemporaryValues, const RegsOut& oldRegsOut, bool currentClockSignal, uint16_t oldRBValue, uint16_t oldRAValue, bool regWrite)
+void CPU::UpdateRAMOnClock(const CU_Data& oldControlUnitData, const TempOut& oldTemporaryValues, const CPUState& oldState, bool currentClockSignal, uint16_t oldRBValue, uint16_t oldRAValue, bool regWrite)
 {
     bool memWrite = (oldTemporaryValues.isCurrSpChange & !oldControlUnitData.spPop) | (oldControlUnitData.memWrite & (oldTemporaryValues.isCurrExt | oldTemporaryValues.regIsCurrAddr));
 
-    MI_Data miData = MemoryInterface::GetInstance()->GetMI_Data(oldControlUnitData, oldRegsOut, oldTemporaryValues, currentClockSignal, memWrite, oldRBValue, oldRAValue, regWrite);
+    MI_Data miData = machine.memoryInterface.GetMI_Data(oldControlUnitData, oldState, oldTemporaryValues, currentClockSignal, memWrite, oldRBValue, oldRAValue, regWrite);
 
-    MemoryInterface::GetInstance()->OnClockChange(miData);
+    machine.memoryInterface.OnClockChange(miData);
 }
 
-RegsOutOnIdle CPU::UpdateRegistersOnIdle(const TempOut& newtempValues, uint16_t newRamValue, uint16_t ir0Data, uint16_t ir1Data, bool currentClockSignal)
+void CPU::UpdateRegistersOnIdle(const TempOut& newtempValues, uint16_t newRamValue, uint16_t ir0Data, uint16_t ir1Data, bool currentClockSignal)
 {
     RegsInOnIdle regInOnClockIdle = {};
 
@@ -173,39 +172,219 @@ RegsOutOnIdle CPU::UpdateRegistersOnIdle(const TempOut& newtempValues, uint16_t
     regInOnClockIdle.ir0Data = newtempValues.isCurrExt ? ir0Data : newRamValue;
     regInOnClockIdle.ir1Data = newtempValues.isCurrExt ? newRamValue : ir1Data;
 
-    return RegisterFile::GetInstance()->OnClockIdle(regInOnClockIdle);
+    machine.registers.OnClockIdle(regInOnClockIdle);
 }
 
-void CPU::RunFrame(uint32_t nbHalfTicks)
+uint64_t CPU::Run(uint64_t maxHalfTicks)
 {
-    if(Clock::GetInstance()->GetFrequency() < 2 && nbHalfTicks >= 0){
-        for (int i = 0; i < nbHalfTicks; ++i) {
-            Tick();
+    uint64_t executed = 0;
+    SamplingProfiler& profiler = machine.profiler;
+    TraceRecorder& traceRecorder = machine.traceRecorder;
+    FlightRecorder& flightRecorder = machine.flightRecorder;
+    Debugger& debugger = machine.debugger;
+    bool stepped = flightRecorder.IsEnabled() || debugger.HasRegisterWatches();
+    debugger.BeginRun();
+    if(!profiler.IsRunning() && !traceRecorder.IsRecording() && !stepped){
+        executed = RunEngine(maxHalfTicks);
+    }
+    else{
+        // Cut at the sampling points and the keyframes : the PC sampled is where the engine stopped
+        while (executed < maxHalfTicks && !IsHalted() && !debugger.HasStopped()) {
+            uint64_t slice = maxHalfTicks - executed;
+            if(profiler.IsRunning())
+                slice = std::min(slice, profiler.GetHalfTicksToSample());
+            if(traceRecorder.IsRecording())
+                slice = std::min(slice, traceRecorder.GetHalfTicksToKeyframe(halfTicks));
+
+            slice = stepped ? RunStepped(slice) : RunEngine(slice);
+            executed += slice;
+            if(profiler.IsRunning())
+                profiler.Advance(slice, machine.registers.GetRegValue(PC));
+            if(traceRecorder.IsRecording())
+                traceRecorder.OnRun(halfTicks);
+        }
+
+        // The HLT is logged too
+        if(flightRecorder.IsEnabled() && IsHalted()){
+            RecordInstruction();
+            flightRecorder.OnHalt();
         }
+    }
+
+    // Once per run, the GUI only ever needs the latest state
+    machine.PublishSnapshot();
+    return executed;
+}
+
+uint64_t CPU::RunEngine(uint64_t maxHalfTicks)
+{
+    if(engine != ENGINE_RTL)
+        return RunFunctional(maxHalfTicks);
+
+    // The functional engine finds the breakpoints through the decoded blocks, the RTL model looks at every instruction
+    bool breakpoints = machine.debugger.HasBreakpoints();
+    bool watches = machine.debugger.HasWatches();
+    uint64_t executed = 0;
+    while (executed < maxHalfTicks && !IsHalted()) {
+        if(breakpoints && IsAtInstructionBoundary() && machine.debugger.HitBreakpoint(halfTicks))
+            break;
+        executed++;
+        if(TickWatched(watches))
+            break;
+    }
+    return executed;
+}
+
+bool CPU::TickWatched(bool watches)
+{
+    Debugger& debugger = machine.debugger;
+    if(watches && IsAtInstructionBoundary())
+        debugger.BeforeRTLInstruction(halfTicks);
+    Tick();
+    return debugger.HasPendingAccess() && IsAtInstructionBoundary() && debugger.CheckAccess(halfTicks);
+}
+
+void CPU::RecordInstruction()
+{
+    if(!IsAtInstructionBoundary())
         return;
+
+    const CPUState& state = machine.state;
+    FlightRecord record;
+    record.halfTicks = halfTicks;
+    record.PC = state.PC;
+    record.instruction = state.IR0;
+    record.ext = machine.ram.Data()[static_cast<uint16_t>(state.PC + 1)];
+    std::copy(state.regs, state.regs + 8, record.regs);
+    record.SP = state.SP;
+    record.FLAGS = state.FLAGS;
+    machine.flightRecorder.Record(record);
+}
+
+uint64_t CPU::RunStepped(uint64_t maxHalfTicks)
+{
+    const CPUState& state = machine.state;
+    Debugger& debugger = machine.debugger;
+    bool recording = machine.flightRecorder.IsEnabled();
+    bool watching = debugger.HasRegisterWatches();
+    uint64_t executed = 0;
+    while (executed < maxHalfTicks && !IsHalted() && !debugger.HasStopped()) {
+        if(recording)
+            RecordInstruction();
+
+        // The instruction's half-ticks : the engine stops right at the next boundary (the RTL model goes one at a time)
+        int cost = FunctionalEngine::GetHalfTicks(state.IR0);
+        bool boundary = cost > 0 && IsAtInstructionBoundary();
+        if(watching && boundary)
+            debugger.BeforeInstruction(halfTicks + cost);
+
+        executed += RunEngine(std::min<uint64_t>(maxHalfTicks - executed, boundary ? cost : 1));
+        if(watching && !debugger.HasStopped() && debugger.AfterInstruction(halfTicks))
+            break;
     }
+    return executed;
+}
 
-    const int ticks_per_frame = Clock::GetInstance()->GetFrequency() * 10;
-    if(ticks_per_frame > 0){
-        for (int i = 0; i < ticks_per_frame; ++i) {
-            Tick();
+uint64_t CPU::RunFunctional(uint64_t maxHalfTicks)
+{
+    machine.functionalEngine.SetJitEnabled(engine == ENGINE_JIT);
+
+    Debugger& debugger = machine.debugger;
+    bool watches = debugger.HasWatches();
+    uint64_t executed = 0;
+    while (executed < maxHalfTicks && !IsHalted()) {
+        // Mid-instruction (or the functional engine can't take the next one) : the RTL model moves on
+        if(!IsAtInstructionBoundary()){
+            executed++;
+            if(TickWatched(watches))
+                break;
+            continue;
+        }
+
+        ArchState state = CaptureArchState();
+        uint64_t consumed = machine.functionalEngine.Run(state, maxHalfTicks - executed);
+        if(consumed > 0){
+            halfTicks += consumed;
+            executed += consumed;
+            RestoreArchState(state);
+        }
+
+        // A watched access : the engine stopped right after its instruction
+        FunctionalStopReason reason = machine.functionalEngine.GetStopReason();
+        if(reason == STOP_REQUESTED){
+            if(debugger.CheckAccess(halfTicks))
+                break;
+            continue;
+        }
+
+        // On a breakpoint the RTL model takes the instruction, unless the debugger stops there
+        if(reason == STOP_BREAKPOINT && debugger.HitBreakpoint(halfTicks))
+            break;
+
+        if(reason != STOP_HALT && executed < maxHalfTicks){
+            executed++;
+            if(TickWatched(watches))
+                break;
         }
     }
-    else{
-        Tick();
-    }
+    return executed;
+}
+
+bool CPU::IsAtInstructionBoundary()
+{
+    const CPUState& state = machine.state;
+    return !state.clockSignal && !state.currentIsExt && !state.regIsCurrAddr && !state.currentChangesSP;
+}
+
+ArchState CPU::CaptureArchState()
+{
+    RegisterFile* regs = &machine.registers;
+    ArchState state;
+    for (int i = 0; i < 8; ++i)
+        state.regs[i] = regs->GetRegValue(static_cast<RegisterName>(i));
+    state.PC = regs->GetRegValue(PC);
+    state.SP = regs->GetRegValue(SP);
+    state.FLAGS = regs->GetRegValue(FLAGS);
+    state.IR1 = regs->GetRegValue(IR1);
+
+    state.addrLatched = machine.state.currentIsAddrJsr;
+    state.rtsLatched = machine.state.currentlyRts;
+    return state;
+}
+
+void CPU::RestoreArchState(const ArchState& state)
+{
+    RegisterFile* regs = &machine.registers;
+    for (int i = 0; i < 8; ++i)
+        regs->SetRegValue(static_cast<RegisterName>(i), state.regs[i]);
+    regs->SetRegValue(PC, state.PC);
+    regs->SetRegValue(SP, state.SP);
+    regs->SetRegValue(FLAGS, state.FLAGS);
+    regs->SetRegValue(IR1, state.IR1);
+    regs->SetRegValue(RAM_ADDRESS, state.IR1);
+
+    uint16_t nextInstruction = machine.bus.Read(state.PC);
+    regs->SetRegValue(IR0, nextInstruction);
+
+    TemporaryValues* temp = &machine.temporaryValues;
+    temp->Reset();
+    machine.state.currentIsAddrJsr = state.addrLatched;
+    machine.state.currentlyRts = state.rtsLatched;
+
+    machine.memoryInterface.SetWriteToRAMFlipFlop(false);
+
+    busAddress = state.PC;
+    oldRAMvalue = nextInstruction;
+}
+
+bool CPU::IsHalted()
+{
+    return FetchControlUnitData().HLT;
 }
 
 void CPU::Init(){
-    RAM::GetInstance();
-    RegisterFile::GetInstance();
-    MemoryInterface::GetInstance();
-    TemporaryValues::GetInstance();
-    ALU::GetInstance();
-    Clock::GetInstance();
-
-    uint16_t RAM0 = RAM::GetInstance()->Read(0);
-    RegisterFile::GetInstance()->SetRegValue(IR0, RAM0);
+    uint16_t RAM0 = machine.bus.Read(0);
+    machine.registers.SetRegValue(IR0, RAM0);
     oldRAMvalue = RAM0;
 
 
@@ -223,21 +402,29 @@ void CPU::Init(){
         } 
     }
 
-    ALU_Data ALU_OUT = ALU::GetInstance()->GetALU_Data(0, 0, ALU_exec_infos & 0b01111, ALU_exec_infos & 0b10000);
+    ALU_Data ALU_OUT = machine.alu.GetALU_Data(0, 0, ALU_exec_infos & 0b01111, ALU_exec_infos & 0b10000);
 
     
-    RegisterFile::GetInstance()->SetRegValue(SP, 0xFFFF);
+    machine.registers.SetRegValue(SP, 0xFFFF);
     
-    UpdateVisualRAMCurrentAddress(oldRAMAddress, 0);
-    ResetIOPortsVisual();
-    oldRAMAddress = 0;
+    machine.ioPorts.Reset();
+    machine.ResetPerfCounters();
+    busAddress = 0;
+    halfTicks = 0;
+
+    if(machine.traceRecorder.IsRecording())
+        machine.traceRecorder.OnRestart();
+
+    machine.PublishSnapshot();
 }
 
 void CPU::Reset(){
-    Clock::GetInstance()->Reset();
-    TemporaryValues::GetInstance()->Reset();
-    RegisterFile::GetInstance()->Reset();
-    MemoryInterface::GetInstance()->Reset();
-    TemporaryValues::GetInstance()->ProcessFlipflopsAndUpdateDebug(TemporaryValues::GetInstance()->flipflops);
+    machine.flightRecorder.OnReset();
+    machine.debugger.OnReset();
+    machine.heatmap.Clear();
+    machine.clock.Reset();
+    machine.temporaryValues.Reset();
+    machine.registers.Reset();
+    machine.memoryInterface.Reset();
     Init();
 }
\ No newline at end of file
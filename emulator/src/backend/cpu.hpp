@@ -6,24 +6,36 @@
 #include "control_unit/control_unit.hpp"
 #include "temp_values/temp_values.hpp"
 #include "memory/memory_interface.hpp"
+#include "io/io_ports.hpp"
+#include "functional/functional_engine.hpp"
+#include "observer.hpp"
 
-#include <iostream>
+class Machine;
 
-void UpdateVisualRAMCurrentAddress(uint16_t oldAddress, uint16_t newAddress);
-void ResetIOPortsVisual();
-uint16_t GetIN(int portIndex);
-void SetOUT(int portIndex, uint16_t data);
+// CPU latches kept outside CPUState : with it, the IO ports and the RAM they make up the whole machine state
+struct CPULatches{
+    uint64_t halfTicks = 0;
+    uint16_t busAddress = 0;
+    uint16_t oldRAMvalue = 0;
+};
+
+enum ExecutionEngine{
+    ENGINE_RTL,         // Half-tick model of the circuit (CPU::Tick)
+    ENGINE_FUNCTIONAL,  // One instruction per dispatch (FunctionalEngine), falls back to the RTL model between instructions
+    ENGINE_JIT          // Functional engine with hot blocks translated to native code (x86-64 Linux, else same as functional)
+};
 
 class CPU{
     private:
-        CPU() {}
-        static CPU* instancePtr;
-        static std::mutex mtx;
+        Machine& machine;
 
-        uint16_t oldRAMAddress = 0;
+        // Address the memory interface reads at after the last half-tick
+        uint16_t busAddress = 0;
         uint16_t oldRAMvalue = 0;
 
-        const int ticks_per_frame = Clock::GetInstance()->GetFrequency() * 10;
+        uint64_t halfTicks = 0;
+
+        ExecutionEngine engine = ENGINE_RTL;
 
         void Tick();
 
@@ -33,30 +45,78 @@ class CPU{
 
         TempOut UpdateTemporaryValuesOnClock(const CU_Data &oldControlUnitData, const TempOut &oldTemporaryValues, bool clockSignal);
 
-        RegsOutOnChange UpdateRegistersOnClock(CU_Data oldControlUnitData, const TempOut &oldTemporaryValues, const RegsOut &oldRegsOut, const ALU_Data &oldAluData, uint16_t oldRAM_OUT, bool currentClockSignal, const TempOut &newTempValues, bool regWrite);
+        void UpdateRegistersOnClock(const CU_Data &oldControlUnitData, const TempOut &oldTemporaryValues, const CPUState &oldState, const ALU_Data &oldAluData, uint16_t oldRAM_OUT, bool currentClockSignal, const TempOut &newTempValues, bool regWrite);
+
+        void UpdateRAMOnClock(const CU_Data &oldControlUnitData, const TempOut &oldTemporaryValues, const CPUState &oldState, bool currentClockSignal, uint16_t oldRBValue, uint16_t oldRAValue, bool regWrite);
+
+        void UpdateRegistersOnIdle(const TempOut &newtempValues, uint16_t newRamValue, uint16_t ir0Data, uint16_t ir1Data, bool currentClockSignal);
+
+        // Run() without the snapshot, the profiler and the recorders
+        uint64_t RunEngine(uint64_t maxHalfTicks);
+
+        // RunEngine() one instruction at a time, each one logged in the flight recorder and checked against the register watches
+        uint64_t RunStepped(uint64_t maxHalfTicks);
 
-        void UpdateRAMOnClock(const CU_Data &oldControlUnitData, const TempOut &oldTemporaryValues, const RegsOut &oldRegsOut, bool currentClockSignal, uint16_t oldRBValue, uint16_t oldRAValue, bool regWrite);
+        // Tick() with the RAM watches checked on the RTL model's instructions (watches : the Debugger has some).
+        // True when one stopped the CPU
+        bool TickWatched(bool watches);
 
-        RegsOutOnIdle UpdateRegistersOnIdle(const TempOut &newtempValues, uint16_t newRamValue, uint16_t ir0Data, uint16_t ir1Data, bool currentClockSignal);
+        // Logs the instruction in IR0 in the flight recorder (at an instruction boundary only)
+        void RecordInstruction();
+
+        uint64_t RunFunctional(uint64_t maxHalfTicks);
 
     public:
+        explicit CPU(Machine& machine) : machine(machine) {}
+
         CPU(const CPU&) = delete;
         CPU& operator=(const CPU&) = delete;
         CPU(CPU&&) = delete;
         CPU& operator=(CPU&&) = delete;
 
-        // Static method to get the CPU instance
-        static CPU* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new CPU();
-                }
-            }
-            return instancePtr;
+        // Runs up to maxHalfTicks half-ticks, stops early once the CPU halts or the debugger stops it (Debugger::HasStopped).
+        // Returns the number of half-ticks executed
+        uint64_t Run(uint64_t maxHalfTicks);
+
+        // True once IR0 holds a HLT instruction (the clock is gated from then on)
+        bool IsHalted();
+
+        uint64_t GetHalfTicks() const {
+            return halfTicks;
+        }
+
+        uint16_t GetBusAddress() const {
+            return busAddress;
+        }
+
+        CPULatches GetLatches() const {
+            return {halfTicks, busAddress, oldRAMvalue};
         }
 
-        void RunFrame(uint32_t nbHalfTicks);
+        // Along with the Machine's CPUState (trace keyframes)
+        void SetLatches(const CPULatches& latches){
+            halfTicks = latches.halfTicks;
+            busAddress = latches.busAddress;
+            oldRAMvalue = latches.oldRAMvalue;
+        }
+
+        // Switching is allowed at any time, the functional engine first lets the RTL model reach the next instruction boundary
+        void SetExecutionEngine(ExecutionEngine newEngine){
+            engine = newEngine;
+        }
+
+        ExecutionEngine GetExecutionEngine() const {
+            return engine;
+        }
+
+        // True when the RTL model sits between two instructions (clock low, IR0 holding the next instruction)
+        bool IsAtInstructionBoundary();
+
+        // Only valid at an instruction boundary
+        ArchState CaptureArchState();
+
+        // Rebuilds the RTL model's state at an instruction boundary
+        void RestoreArchState(const ArchState& state);
 
         void Init();
 
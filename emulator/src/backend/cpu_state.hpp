@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// Everything the RTL model latches between two half-ticks, in one flat struct.
+// The register file, the temporary values, the clock and the memory interface all work on the Machine's copy,
+// so a half-tick only reads and writes plain fields (no allocation, no lookup) and a snapshot is a struct copy
+struct CPUState{
+    uint16_t regs[8] = {0};     // R0 - R7
+    uint16_t SP = 0;
+    uint16_t PC = 0;
+    uint16_t RAM_ADDRESS = 0;
+    uint16_t IR0 = 0;
+    uint16_t IR1 = 0;
+
+    uint8_t FLAGS : 4;              // bit0 = Z, bit1 = N, bit2 = C, bit3 = O
+
+    // Temporary values
+    uint8_t currentIsExt : 1;       // CURRENT_IS_EXT
+    uint8_t currentIsAddrBase : 1;  // CURRENT_IS_ADDR_BASE
+    uint8_t currentIsAddrJsr : 1;   // CURRENT_IS_ADDR_JSR
+    uint8_t currentChangesSP : 1;   // CURRENT_CHANGES_SP
+    uint8_t currentlyJsr : 1;       // CURRENTLY_JSR
+    uint8_t currentlyRts : 1;       // CURRENTLY_RTS
+    uint8_t regIsCurrAddr : 1;      // REG_IS_CURR_ADDR
+
+    uint8_t clockSignal : 1;
+    uint8_t writeToRAM : 1;         // Memory interface flip-flop
+
+    CPUState() : FLAGS(0), currentIsExt(0), currentIsAddrBase(0), currentIsAddrJsr(0), currentChangesSP(0),
+                 currentlyJsr(0), currentlyRts(0), regIsCurrAddr(0), clockSignal(0), writeToRAM(0) {}
+};
@@ -0,0 +1,283 @@
+#include "condition.hpp"
+
+#include <cctype>
+#include <cstdlib>
+
+static const char* const OPERAND_NAMES[OPERAND_COUNT] = {
+    "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "SP", "PC", "FLAGS", "value"
+};
+
+// Binary operators, longest first so "<<" is not read as "<"
+struct BinaryOperator{
+    const char* text;
+    int precedence;     // Higher binds tighter
+    ConditionOp op;
+};
+
+static const BinaryOperator BINARY_OPERATORS[] = {
+    {"||", 1, COND_LOGICAL_OR},
+    {"&&", 2, COND_LOGICAL_AND},
+    {"==", 6, COND_EQUAL},
+    {"!=", 6, COND_NOT_EQUAL},
+    {"<=", 7, COND_LESS_EQUAL},
+    {">=", 7, COND_GREATER_EQUAL},
+    {"<<", 8, COND_SHL},
+    {">>", 8, COND_SHR},
+    {"|", 3, COND_OR},
+    {"^", 4, COND_XOR},
+    {"&", 5, COND_AND},
+    {"<", 7, COND_LESS},
+    {">", 7, COND_GREATER},
+    {"+", 9, COND_ADD},
+    {"-", 9, COND_SUB},
+    {"*", 10, COND_MUL},
+    {"/", 10, COND_DIV},
+    {"%", 10, COND_MOD},
+};
+
+// Recursive descent over the text, emits the bytecode in postfix order
+class ConditionParser{
+    private:
+        const std::string& text;
+        size_t position = 0;
+        std::vector<ConditionInstruction>& code;
+        int depth = 0;
+        int maxDepth = 0;
+        std::string error;
+
+        void SkipSpaces(){
+            while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+                position++;
+        }
+
+        bool Accept(char c){
+            SkipSpaces();
+            if (position < text.size() && text[position] == c) {
+                position++;
+                return true;
+            }
+            return false;
+        }
+
+        void Emit(ConditionOp op, int64_t operand, int stackChange){
+            code.push_back({op, operand});
+            depth += stackChange;
+            if (depth > maxDepth)
+                maxDepth = depth;
+        }
+
+        bool Fail(const std::string& message){
+            if (error.empty())
+                error = message + " at column " + std::to_string(position + 1) + " : " + text;
+            return false;
+        }
+
+        const BinaryOperator* PeekOperator(){
+            SkipSpaces();
+            for (const BinaryOperator& candidate : BINARY_OPERATORS) {
+                if (text.compare(position, std::char_traits<char>::length(candidate.text), candidate.text) == 0)
+                    return &candidate;
+            }
+            return nullptr;
+        }
+
+        bool ParsePrimary(){
+            SkipSpaces();
+            if (position >= text.size())
+                return Fail("Operand expected");
+
+            char c = text[position];
+            if (c == '(' || c == '[') {
+                position++;
+                if (!ParseExpression(0))
+                    return false;
+                if (!Accept(c == '(' ? ')' : ']'))
+                    return Fail(c == '(' ? "')' expected" : "']' expected");
+                if (c == '[')
+                    Emit(COND_LOAD, 0, 0);
+                return true;
+            }
+
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                // strtoull does not know the 0b prefix
+                const char* start = text.c_str() + position;
+                char* end = nullptr;
+                bool binary = c == '0' && position + 1 < text.size() && (text[position + 1] == 'b' || text[position + 1] == 'B');
+                uint64_t number = binary ? std::strtoull(start + 2, &end, 2) : std::strtoull(start, &end, 0);
+                if (end == start || (binary && end == start + 2) || std::isalnum(static_cast<unsigned char>(*end)))
+                    return Fail("Invalid number");
+                position += end - start;
+                Emit(COND_CONSTANT, static_cast<int64_t>(number), 1);
+                return true;
+            }
+
+            if (std::isalpha(static_cast<unsigned char>(c))) {
+                size_t start = position;
+                while (position < text.size() && (std::isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_'))
+                    position++;
+                std::string name = text.substr(start, position - start);
+
+                int operand = Condition::FindOperand(name);
+                if (operand >= 0) {
+                    Emit(COND_OPERAND, operand, 1);
+                    return true;
+                }
+
+                // Single flags : (FLAGS >> bit) & 1
+                static const char FLAG_NAMES[] = "ZNCO";
+                if (name.size() == 1) {
+                    for (int bit = 0; bit < 4; ++bit) {
+                        if (std::toupper(static_cast<unsigned char>(name[0])) == FLAG_NAMES[bit]) {
+                            Emit(COND_OPERAND, OPERAND_FLAGS, 1);
+                            Emit(COND_CONSTANT, bit, 1);
+                            Emit(COND_SHR, 0, -1);
+                            Emit(COND_CONSTANT, 1, 1);
+                            Emit(COND_AND, 0, -1);
+                            return true;
+                        }
+                    }
+                }
+                position = start;
+                return Fail("Unknown name '" + name + "'");
+            }
+
+            return Fail("Operand expected");
+        }
+
+        bool ParseUnary(){
+            SkipSpaces();
+            if (position < text.size() && (text[position] == '-' || text[position] == '!' || text[position] == '~')) {
+                char c = text[position++];
+                if (!ParseUnary())
+                    return false;
+                Emit(c == '-' ? COND_NEGATE : c == '!' ? COND_NOT : COND_INVERT, 0, 0);
+                return true;
+            }
+            return ParsePrimary();
+        }
+
+    public:
+        ConditionParser(const std::string& text, std::vector<ConditionInstruction>& code) : text(text), code(code) {}
+
+        // Operators binding tighter than minPrecedence (precedence climbing)
+        bool ParseExpression(int minPrecedence){
+            if (!ParseUnary())
+                return false;
+
+            for (;;) {
+                const BinaryOperator* binary = PeekOperator();
+                if (binary == nullptr || binary->precedence <= minPrecedence)
+                    return true;
+
+                position += std::char_traits<char>::length(binary->text);
+                if (!ParseExpression(binary->precedence))
+                    return false;
+                Emit(binary->op, 0, -1);
+            }
+        }
+
+        bool ParseAll(){
+            if (!ParseExpression(0))
+                return false;
+            SkipSpaces();
+            if (position < text.size())
+                return Fail(text[position] == '=' ? "'=' is not an operator (==)" : "Unexpected character");
+            if (maxDepth > CONDITION_MAX_DEPTH)
+                return Fail("Expression too deep");
+            return true;
+        }
+
+        const std::string& GetError() const {
+            return error;
+        }
+};
+
+bool Condition::Compile(const std::string& source, std::string& error)
+{
+    std::vector<ConditionInstruction> compiled;
+    if (source.find_first_not_of(" \t") != std::string::npos) {
+        ConditionParser parser(source, compiled);
+        if (!parser.ParseAll()) {
+            error = parser.GetError();
+            return false;
+        }
+    }
+
+    code = std::move(compiled);
+    text = source;
+    return true;
+}
+
+bool Condition::Test(const ConditionContext& context) const
+{
+    if (code.empty())
+        return true;
+
+    int64_t stack[CONDITION_MAX_DEPTH];
+    int top = -1;
+    for (const ConditionInstruction& instruction : code) {
+        int64_t b = top >= 0 ? stack[top] : 0;
+        int64_t& a = stack[top > 0 ? top - 1 : 0];
+        switch (instruction.op) {
+            case COND_CONSTANT: stack[++top] = instruction.operand; continue;
+            case COND_OPERAND: stack[++top] = ReadOperand(*context.state, static_cast<int>(instruction.operand), context.value); continue;
+            case COND_LOAD: stack[top] = context.memory[static_cast<uint16_t>(b)]; continue;
+            case COND_NEGATE: stack[top] = -b; continue;
+            case COND_NOT: stack[top] = !b; continue;
+            case COND_INVERT: stack[top] = ~b; continue;
+            case COND_MUL: a = a * b; break;
+            case COND_DIV: a = b != 0 ? a / b : 0; break;
+            case COND_MOD: a = b != 0 ? a % b : 0; break;
+            case COND_ADD: a = a + b; break;
+            case COND_SUB: a = a - b; break;
+            case COND_SHL: a = (b >= 0 && b < 64) ? static_cast<int64_t>(static_cast<uint64_t>(a) << b) : 0; break;
+            case COND_SHR: a = (b >= 0 && b < 64) ? a >> b : 0; break;
+            case COND_LESS: a = a < b; break;
+            case COND_LESS_EQUAL: a = a <= b; break;
+            case COND_GREATER: a = a > b; break;
+            case COND_GREATER_EQUAL: a = a >= b; break;
+            case COND_EQUAL: a = a == b; break;
+            case COND_NOT_EQUAL: a = a != b; break;
+            case COND_AND: a = a & b; break;
+            case COND_XOR: a = a ^ b; break;
+            case COND_OR: a = a | b; break;
+            case COND_LOGICAL_AND: a = a && b; break;
+            case COND_LOGICAL_OR: a = a || b; break;
+        }
+        // Binary operators only
+        top--;
+    }
+    return stack[0] != 0;
+}
+
+int Condition::FindOperand(const std::string& name)
+{
+    for (int operand = 0; operand < OPERAND_COUNT; ++operand) {
+        const char* candidate = OPERAND_NAMES[operand];
+        if (name.size() != std::char_traits<char>::length(candidate))
+            continue;
+
+        size_t i = 0;
+        while (i < name.size() && std::toupper(static_cast<unsigned char>(name[i])) == std::toupper(static_cast<unsigned char>(candidate[i])))
+            i++;
+        if (i == name.size())
+            return operand;
+    }
+    return -1;
+}
+
+const char* Condition::GetOperandName(int operand)
+{
+    return operand >= 0 && operand < OPERAND_COUNT ? OPERAND_NAMES[operand] : "?";
+}
+
+uint16_t Condition::ReadOperand(const CPUState& state, int operand, uint16_t value)
+{
+    switch (operand) {
+        case OPERAND_SP: return state.SP;
+        case OPERAND_PC: return state.PC;
+        case OPERAND_FLAGS: return state.FLAGS;
+        case OPERAND_VALUE: return value;
+        default: return state.regs[operand & 0b111];
+    }
+}
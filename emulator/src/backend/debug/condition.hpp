@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../cpu_state.hpp"
+
+// Named operands of a condition (R0 - R7 keep their register number)
+enum ConditionOperand{
+    OPERAND_SP = 8,
+    OPERAND_PC,
+    OPERAND_FLAGS,
+    OPERAND_VALUE,      // Word a watch caught (read, written, new register value)
+    OPERAND_COUNT
+};
+
+enum ConditionOp : uint8_t{
+    COND_CONSTANT,      // Pushes the operand
+    COND_OPERAND,       // Pushes a ConditionOperand
+    COND_LOAD,          // RAM word at the address on top
+    COND_NEGATE,
+    COND_NOT,
+    COND_INVERT,
+    COND_MUL,
+    COND_DIV,
+    COND_MOD,
+    COND_ADD,
+    COND_SUB,
+    COND_SHL,
+    COND_SHR,
+    COND_LESS,
+    COND_LESS_EQUAL,
+    COND_GREATER,
+    COND_GREATER_EQUAL,
+    COND_EQUAL,
+    COND_NOT_EQUAL,
+    COND_AND,
+    COND_XOR,
+    COND_OR,
+    COND_LOGICAL_AND,
+    COND_LOGICAL_OR
+};
+
+struct ConditionInstruction{
+    ConditionOp op;
+    int64_t operand;
+};
+
+// Deepest stack a condition may need
+static const int CONDITION_MAX_DEPTH = 32;
+
+// What a condition is tested against : the CPU between two instructions, the RAM and the word a watch caught
+struct ConditionContext{
+    const CPUState* state;
+    const uint16_t* memory;
+    uint16_t value;
+};
+
+// Condition of a breakpoint or a watch, such as "R3 == 0x7F && [0xC000] > 100".
+// Operands : numbers (decimal, 0x hex, 0b binary), R0-R7, SP, PC, FLAGS, the flags Z N C O, value and [address] (RAM word).
+// Operators, with the C precedences : unary - ! ~, * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||.
+// Compiled once into a small stack bytecode, testing it never allocates
+class Condition{
+    private:
+        std::vector<ConditionInstruction> code;
+        std::string text;
+
+    public:
+        // An empty text always holds. On failure returns false and describes the problem in error
+        bool Compile(const std::string& source, std::string& error);
+
+        bool IsEmpty() const {
+            return code.empty();
+        }
+
+        const std::string& GetText() const {
+            return text;
+        }
+
+        // True when the expression is not 0 (or when empty)
+        bool Test(const ConditionContext& context) const;
+
+        // ConditionOperand (or register number) named name (any case), -1 if none
+        static int FindOperand(const std::string& name);
+
+        static const char* GetOperandName(int operand);
+
+        static uint16_t ReadOperand(const CPUState& state, int operand, uint16_t value);
+};
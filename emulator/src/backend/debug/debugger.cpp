@@ -0,0 +1,429 @@
+#include "debugger.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include "../machine.hpp"
+
+static std::string Hex(uint16_t value)
+{
+    std::ostringstream out;
+    out << "0x" << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << value;
+    return out.str();
+}
+
+static bool ParseAddress(const std::string& text, uint16_t& address)
+{
+    char* end = nullptr;
+    unsigned long value = std::strtoul(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || value > 0xFFFF)
+        return false;
+    address = static_cast<uint16_t>(value);
+    return true;
+}
+
+static const char* GetKindName(int kinds)
+{
+    switch (kinds) {
+        case WATCH_READ: return "read";
+        case WATCH_ACCESS: return "access";
+        case WATCH_CHANGE: return "change";
+        default: return "write";
+    }
+}
+
+int Debugger::AddBreakpoint(uint16_t pc, const std::string& condition, std::string& error)
+{
+    Breakpoint breakpoint{nextId, pc, Condition()};
+    if (!breakpoint.condition.Compile(condition, error))
+        return -1;
+
+    breakpoints.push_back(std::move(breakpoint));
+    machine.blockCache.SetBreakpoint(pc, true);
+    return nextId++;
+}
+
+int Debugger::AddWatch(uint16_t first, uint16_t last, int kinds, const std::string& condition, std::string& error)
+{
+    if (last < first) {
+        error = "Empty watch range : " + Hex(first) + "-" + Hex(last);
+        return -1;
+    }
+
+    Watch watch{nextId, first, last, kinds, Condition()};
+    if (!watch.condition.Compile(condition, error))
+        return -1;
+
+    SetPageWatches(watch, 1);
+    watches.push_back(std::move(watch));
+    return nextId++;
+}
+
+int Debugger::AddRegisterWatch(int operand, const std::string& condition, std::string& error)
+{
+    if (operand < 0 || operand > OPERAND_FLAGS || operand == OPERAND_PC) {
+        error = "Only R0-R7, SP and FLAGS can be watched";
+        return -1;
+    }
+
+    RegisterWatch watch{nextId, operand, Condition()};
+    if (!watch.condition.Compile(condition, error))
+        return -1;
+
+    registerWatches.push_back(std::move(watch));
+    return nextId++;
+}
+
+int Debugger::Add(const std::string& command, std::string& error)
+{
+    // Words up to "if", the condition is the rest of the line (up to a # comment)
+    std::string condition;
+    std::vector<std::string> words;
+    std::istringstream in(command.substr(0, command.find('#')));
+    std::string word;
+    while (in >> word) {
+        if (word == "if") {
+            std::getline(in >> std::ws, condition);
+            condition.erase(condition.find_last_not_of(" \t\r") + 1);
+            break;
+        }
+        words.push_back(word);
+    }
+
+    if (words.size() == 2 && words[0] == "break") {
+        uint16_t pc = 0;
+        if (!ParseAddress(words[1], pc)) {
+            error = "Invalid breakpoint address : " + words[1];
+            return -1;
+        }
+        return AddBreakpoint(pc, condition, error);
+    }
+
+    if (words.size() >= 2 && words.size() <= 3 && words[0] == "watch") {
+        int kinds = WATCH_WRITE;
+        if (words.size() == 3) {
+            static const int KINDS[] = {WATCH_READ, WATCH_WRITE, WATCH_ACCESS, WATCH_CHANGE};
+            kinds = 0;
+            for (int kind : KINDS) {
+                if (words[1] == GetKindName(kind))
+                    kinds = kind;
+            }
+            if (kinds == 0) {
+                error = "Unknown watch kind '" + words[1] + "' (read, write, access or change)";
+                return -1;
+            }
+        }
+
+        const std::string& target = words.back();
+        int operand = Condition::FindOperand(target);
+        if (operand >= 0) {
+            if (words.size() == 3) {
+                error = "Register watches stop on changes only : watch " + target;
+                return -1;
+            }
+            return AddRegisterWatch(operand, condition, error);
+        }
+
+        size_t dash = target.find('-');
+        uint16_t first = 0, last = 0;
+        if (!ParseAddress(target.substr(0, dash), first)
+            || !ParseAddress(dash == std::string::npos ? target.substr(0, dash) : target.substr(dash + 1), last)) {
+            error = "Invalid watch address or range : " + target;
+            return -1;
+        }
+        return AddWatch(first, last, kinds, condition, error);
+    }
+
+    error = "Expected \"break ADDRESS [if CONDITION]\" or \"watch [read|write|access|change] FIRST[-LAST] | REGISTER [if CONDITION]\" : " + command;
+    return -1;
+}
+
+bool Debugger::Remove(int id)
+{
+    for (size_t i = 0; i < breakpoints.size(); ++i) {
+        if (breakpoints[i].id != id)
+            continue;
+        uint16_t pc = breakpoints[i].PC;
+        breakpoints.erase(breakpoints.begin() + i);
+
+        // Another breakpoint may share its address
+        bool shared = std::any_of(breakpoints.begin(), breakpoints.end(), [pc](const Breakpoint& other) { return other.PC == pc; });
+        if (!shared)
+            machine.blockCache.SetBreakpoint(pc, false);
+        return true;
+    }
+
+    for (size_t i = 0; i < watches.size(); ++i) {
+        if (watches[i].id == id) {
+            SetPageWatches(watches[i], -1);
+            watches.erase(watches.begin() + i);
+            if (watches.empty())
+                machine.bus.RemoveTap(this);
+            return true;
+        }
+    }
+
+    for (size_t i = 0; i < registerWatches.size(); ++i) {
+        if (registerWatches[i].id == id) {
+            registerWatches.erase(registerWatches.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Debugger::Clear()
+{
+    for (const Breakpoint& breakpoint : breakpoints)
+        machine.blockCache.SetBreakpoint(breakpoint.PC, false);
+    for (const Watch& watch : watches)
+        SetPageWatches(watch, -1);
+    breakpoints.clear();
+    watches.clear();
+    registerWatches.clear();
+    machine.bus.RemoveTap(this);
+    pending = false;
+    ClearAccess();
+}
+
+void Debugger::List(std::ostream& out) const
+{
+    for (const Breakpoint& breakpoint : breakpoints) {
+        out << "break " << Hex(breakpoint.PC);
+        if (!breakpoint.condition.IsEmpty())
+            out << " if " << breakpoint.condition.GetText();
+        out << "  # " << breakpoint.id << ", " << breakpoint.hits << " hits\n";
+    }
+
+    for (const Watch& watch : watches) {
+        out << "watch " << GetKindName(watch.kinds) << " " << Hex(watch.first);
+        if (watch.last != watch.first)
+            out << "-" << Hex(watch.last);
+        if (!watch.condition.IsEmpty())
+            out << " if " << watch.condition.GetText();
+        out << "  # " << watch.id << ", " << watch.hits << " hits\n";
+    }
+
+    for (const RegisterWatch& watch : registerWatches) {
+        out << "watch " << Condition::GetOperandName(watch.operand);
+        if (!watch.condition.IsEmpty())
+            out << " if " << watch.condition.GetText();
+        out << "  # " << watch.id << ", " << watch.hits << " hits\n";
+    }
+}
+
+std::string Debugger::DescribeStop() const
+{
+    std::string by = " by the instruction at " + Hex(stop.PC);
+    switch (stop.kind) {
+        case DEBUG_STOP_BREAKPOINT:
+            return "breakpoint #" + std::to_string(stop.id) + " at " + Hex(stop.PC);
+        case DEBUG_STOP_WATCH:
+            if (stop.access == WATCH_READ)
+                return "watchpoint #" + std::to_string(stop.id) + ", read of [" + Hex(stop.address) + "] = " + Hex(stop.value) + by;
+            return "watchpoint #" + std::to_string(stop.id) + ", write of [" + Hex(stop.address) + "] : "
+                 + Hex(stop.oldValue) + " -> " + Hex(stop.value) + by;
+        case DEBUG_STOP_REGISTER:
+            return "register watch #" + std::to_string(stop.id) + ", " + Condition::GetOperandName(stop.address) + " : "
+                 + Hex(stop.oldValue) + " -> " + Hex(stop.value) + by;
+        default:
+            return "not stopped";
+    }
+}
+
+void Debugger::Stop(const DebugStop& newStop)
+{
+    stop = newStop;
+    stopped = true;
+}
+
+void Debugger::SetPageWatches(const Watch& watch, int change)
+{
+    for (int page = watch.first >> DEBUG_PAGE_SHIFT; page <= (watch.last >> DEBUG_PAGE_SHIFT); ++page)
+        pageWatches[page] = static_cast<uint16_t>(pageWatches[page] + change);
+
+    // Retapping drops the decoded code, the next blocks are built with the new data tables
+    int access = ((watch.kinds & WATCH_READ) ? BUS_READ : 0) | ((watch.kinds & (WATCH_WRITE | WATCH_CHANGE)) ? BUS_WRITE : 0);
+    if (change > 0)
+        machine.bus.AddTap(this);
+    machine.bus.TapPages(watch.first >> BUS_PAGE_SHIFT, watch.last >> BUS_PAGE_SHIFT, access, change);
+}
+
+bool Debugger::IsWatched(uint16_t address, int kinds) const
+{
+    return std::any_of(watches.begin(), watches.end(), [address, kinds](const Watch& watch) {
+        return (watch.kinds & kinds) != 0 && address >= watch.first && address <= watch.last;
+    });
+}
+
+void Debugger::ClearAccess()
+{
+    accessPending = false;
+    machine.bus.ClearStopRequest();
+}
+
+bool Debugger::HitBreakpoint(uint64_t halfTicks)
+{
+    const CPUState& state = machine.state;
+    if (!machine.blockCache.IsBreakpoint(state.PC) || (passing && halfTicks == passHalfTicks))
+        return false;
+
+    ConditionContext context{&state, machine.ram.Data(), 0};
+    for (Breakpoint& breakpoint : breakpoints) {
+        if (breakpoint.PC == state.PC && breakpoint.condition.Test(context)) {
+            breakpoint.hits++;
+            DebugStop hit;
+            hit.kind = DEBUG_STOP_BREAKPOINT;
+            hit.id = breakpoint.id;
+            hit.halfTicks = halfTicks;
+            hit.PC = state.PC;
+            Stop(hit);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Debugger::BeforeInstruction(uint64_t endHalfTicks)
+{
+    const CPUState& state = machine.state;
+    pending = true;
+    pendingEnd = endHalfTicks;
+    pendingPC = state.PC;
+    for (int operand = 0; operand <= OPERAND_FLAGS; ++operand)
+        registersBefore[operand] = Condition::ReadOperand(state, operand, 0);
+}
+
+bool Debugger::AfterInstruction(uint64_t halfTicks)
+{
+    if (!pending || halfTicks != pendingEnd)
+        return false;
+    pending = false;
+
+    const CPUState& state = machine.state;
+    ConditionContext context{&state, machine.ram.Data(), 0};
+    for (RegisterWatch& watch : registerWatches) {
+        uint16_t value = Condition::ReadOperand(state, watch.operand, 0);
+        uint16_t before = registersBefore[watch.operand];
+        context.value = value;
+        if (value == before || !watch.condition.Test(context))
+            continue;
+
+        watch.hits++;
+        DebugStop hit;
+        hit.kind = DEBUG_STOP_REGISTER;
+        hit.id = watch.id;
+        hit.halfTicks = halfTicks;
+        hit.PC = pendingPC;
+        hit.address = static_cast<uint16_t>(watch.operand);
+        hit.oldValue = before;
+        hit.value = value;
+        Stop(hit);
+        return true;
+    }
+    return false;
+}
+
+void Debugger::BeforeRTLInstruction(uint64_t halfTicks)
+{
+    // The data word the instruction reads or writes (the fetches are not watched)
+    const CPUState& state = machine.state;
+    const uint16_t* memory = machine.ram.Data();
+    uint16_t ext = memory[static_cast<uint16_t>(state.PC + 1)];
+    uint16_t address = 0;
+    int access = FunctionalEngine::GetDataAccess(state.IR0, ext, state.regs, state.SP, address);
+    int kind = access == BUS_READ ? WATCH_READ : access == BUS_WRITE ? WATCH_WRITE : 0;
+
+    // Whether a write changes the word is only known once it is done
+    if (kind == 0 || pageWatches[address >> DEBUG_PAGE_SHIFT] == 0
+        || !IsWatched(address, kind == WATCH_WRITE ? WATCH_WRITE | WATCH_CHANGE : kind))
+        return;
+
+    accessPending = true;
+    accessFromRTL = true;
+    accessEnd = halfTicks + FunctionalEngine::GetHalfTicks(state.IR0);
+    accessPC = state.PC;
+    accessKind = kind;
+    accessAddress = address;
+    accessOld = memory[address];
+}
+
+bool Debugger::CheckAccess(uint64_t halfTicks)
+{
+    ClearAccess();
+    if (accessFromRTL) {
+        // Left over by a run that ended inside the instruction, the state was replaced since
+        if (halfTicks != accessEnd)
+            return false;
+        accessValue = accessKind == WATCH_READ ? machine.bus.Read(accessAddress) : machine.ram.Data()[accessAddress];
+    }
+
+    int kinds = accessKind;
+    if (accessKind == WATCH_WRITE && accessValue != accessOld)
+        kinds |= WATCH_CHANGE;
+
+    ConditionContext context{&machine.state, machine.ram.Data(), accessValue};
+    for (Watch& watch : watches) {
+        if ((watch.kinds & kinds) == 0 || accessAddress < watch.first || accessAddress > watch.last
+            || !watch.condition.Test(context))
+            continue;
+
+        watch.hits++;
+        DebugStop hit;
+        hit.kind = DEBUG_STOP_WATCH;
+        hit.id = watch.id;
+        hit.halfTicks = halfTicks;
+        hit.PC = accessPC;
+        hit.access = accessKind;
+        hit.address = accessAddress;
+        hit.oldValue = accessOld;
+        hit.value = accessValue;
+        Stop(hit);
+        return true;
+    }
+    return false;
+}
+
+void Debugger::OnRead(uint16_t pc, uint16_t address, uint16_t value)
+{
+    // The heatmap taps every page : most of what comes here is not watched. A device's transfer (heard during the
+    // RTL model's instruction, after its own access was foreseen) comes first, as it does for the engines
+    if ((accessPending && !accessFromRTL) || pageWatches[address >> DEBUG_PAGE_SHIFT] == 0 || !IsWatched(address, WATCH_READ))
+        return;
+
+    accessPending = true;
+    accessFromRTL = false;
+    accessPC = pc;
+    accessKind = WATCH_READ;
+    accessAddress = address;
+    accessOld = value;
+    accessValue = value;
+    machine.bus.RequestStop();
+}
+
+void Debugger::OnWrite(uint16_t pc, uint16_t address, uint16_t previous, uint16_t value)
+{
+    int kinds = previous != value ? WATCH_WRITE | WATCH_CHANGE : WATCH_WRITE;
+    if ((accessPending && !accessFromRTL) || pageWatches[address >> DEBUG_PAGE_SHIFT] == 0 || !IsWatched(address, kinds))
+        return;
+
+    accessPending = true;
+    accessFromRTL = false;
+    accessPC = pc;
+    accessKind = WATCH_WRITE;
+    accessAddress = address;
+    accessOld = previous;
+    accessValue = value;
+    machine.bus.RequestStop();
+}
+
+void Debugger::OnReset()
+{
+    stopped = false;
+    passing = false;
+    passNext = false;
+    pending = false;
+    ClearAccess();
+}
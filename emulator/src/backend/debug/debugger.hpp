@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "condition.hpp"
+#include "../memory/memory_bus.hpp"
+
+class Machine;
+
+// Accesses a watch stops on (or'ed together)
+enum WatchKind{
+    WATCH_READ = 1,
+    WATCH_WRITE = 2,
+    WATCH_CHANGE = 4,   // A write that changes the word
+    WATCH_ACCESS = WATCH_READ | WATCH_WRITE
+};
+
+enum DebugStopKind{
+    DEBUG_STOP_NONE,
+    DEBUG_STOP_BREAKPOINT,  // Before the instruction at PC
+    DEBUG_STOP_WATCH,       // After the instruction that made the access
+    DEBUG_STOP_REGISTER     // After the instruction that changed the register
+};
+
+struct DebugStop{
+    DebugStopKind kind = DEBUG_STOP_NONE;
+    int id = 0;
+    uint64_t halfTicks = 0;     // Where the CPU stopped
+    uint16_t PC = 0;            // Instruction stopped at (breakpoint), or that made the access / changed the register
+    int access = 0;             // WATCH_READ or WATCH_WRITE
+    uint16_t address = 0;       // RAM word (watch), ConditionOperand (register)
+    uint16_t oldValue = 0;
+    uint16_t value = 0;
+};
+
+static const int DEBUG_PAGE_SHIFT = 8;
+static const size_t DEBUG_PAGE_COUNT = 65536 >> DEBUG_PAGE_SHIFT;
+
+// Breakpoints, watchpoints and register watches of a Machine, each with an optional Condition.
+// PC breakpoints cost nothing while the code runs : decoded blocks end right before them (BlockCache), so the engines
+// only come back here when they reach one. Watches tap the bus pages they cover : the engines keep running decoded
+// blocks and translated code, an access heard on a watched word stops them after its instruction and the conditions
+// are tested there. The RTL model's instructions are looked at one by one (BeforeRTLInstruction). Register watches
+// make CPU::Run go one instruction at a time. With nothing set Run goes at full speed.
+// Edited between runs only (not while the Machine runs on another thread)
+class Debugger : public BusTap{
+    private:
+        struct Breakpoint{
+            int id;
+            uint16_t PC;
+            Condition condition;
+            uint64_t hits = 0;
+        };
+
+        struct Watch{
+            int id;
+            uint16_t first;
+            uint16_t last;
+            int kinds;
+            Condition condition;
+            uint64_t hits = 0;
+        };
+
+        struct RegisterWatch{
+            int id;
+            int operand;        // R0 - R7, OPERAND_SP or OPERAND_FLAGS
+            Condition condition;
+            uint64_t hits = 0;
+        };
+
+        Machine& machine;
+
+        std::vector<Breakpoint> breakpoints;
+        std::vector<Watch> watches;
+        std::vector<RegisterWatch> registerWatches;
+        int nextId = 1;
+
+        // Watches overlapping each page : an access anywhere else is not looked any further
+        std::array<uint16_t, DEBUG_PAGE_COUNT> pageWatches{};
+
+        // First access of an instruction that matched a watch (conditions aside), tested once the instruction is done.
+        // Heard from the bus, or foreseen for the RTL model (accessFromRTL : the value is read at accessEnd)
+        bool accessPending = false;
+        bool accessFromRTL = false;
+        uint64_t accessEnd = 0;
+        uint16_t accessPC = 0;
+        int accessKind = 0;
+        uint16_t accessAddress = 0;
+        uint16_t accessOld = 0;
+        uint16_t accessValue = 0;
+
+        // The instruction being stepped (BeforeInstruction), its register watches checked once it completes at pendingEnd
+        bool pending = false;
+        uint64_t pendingEnd = 0;
+        uint16_t pendingPC = 0;
+        uint16_t registersBefore[OPERAND_FLAGS + 1] = {0};
+
+        DebugStop stop;
+        bool stopped = false;
+
+        // Breakpoints on passHalfTicks are gone through by the current run (it starts where the last one stopped),
+        // passNext carries that over to the next run
+        bool passing = false;
+        bool passNext = false;
+        uint64_t passHalfTicks = 0;
+
+        void Stop(const DebugStop& newStop);
+
+        // Also taps the pages on the bus for the watch's kinds
+        void SetPageWatches(const Watch& watch, int change);
+
+        // True when a watch of one of the WatchKind bits of kinds covers address
+        bool IsWatched(uint16_t address, int kinds) const;
+
+        void ClearAccess();
+
+    public:
+        explicit Debugger(Machine& machine) : machine(machine) {}
+
+        Debugger(const Debugger&) = delete;
+        Debugger& operator=(const Debugger&) = delete;
+        Debugger(Debugger&&) = delete;
+        Debugger& operator=(Debugger&&) = delete;
+
+        // Each returns the new id, or -1 and describes the problem in error
+        int AddBreakpoint(uint16_t pc, const std::string& condition, std::string& error);
+
+        int AddWatch(uint16_t first, uint16_t last, int kinds, const std::string& condition, std::string& error);
+
+        // operand : R0 - R7, OPERAND_SP or OPERAND_FLAGS
+        int AddRegisterWatch(int operand, const std::string& condition, std::string& error);
+
+        // "break ADDRESS [if CONDITION]"
+        // "watch [read|write|access|change] FIRST[-LAST] [if CONDITION]" (write by default)
+        // "watch REGISTER [if CONDITION]"
+        // Anything after a # is a comment
+        int Add(const std::string& command, std::string& error);
+
+        // False when there is no such id
+        bool Remove(int id);
+
+        void Clear();
+
+        // One Add() command per line, its id and hit count in a comment
+        void List(std::ostream& out) const;
+
+        bool HasBreakpoints() const {
+            return !breakpoints.empty();
+        }
+
+        // RAM watches : the RTL model's instructions go through BeforeRTLInstruction
+        bool HasWatches() const {
+            return !watches.empty();
+        }
+
+        // CPU::Run steps one instruction at a time
+        bool HasRegisterWatches() const {
+            return !registerWatches.empty();
+        }
+
+        bool HasStopped() const {
+            return stopped;
+        }
+
+        // Only valid once HasStopped()
+        const DebugStop& GetStop() const {
+            return stop;
+        }
+
+        std::string DescribeStop() const;
+
+        // Called by CPU::Run as it starts : a stop is only reported during the run that reached it
+        void BeginRun(){
+            if (stopped)
+                PassBreakpoint(stop.halfTicks);
+            passing = passNext;
+            passNext = false;
+            stopped = false;
+        }
+
+        // The next run goes through a breakpoint on halfTicks (a client stepping or continuing from where it stands)
+        void PassBreakpoint(uint64_t halfTicks){
+            passNext = true;
+            passHalfTicks = halfTicks;
+        }
+
+        // The CPU sits at an instruction boundary on halfTicks : true (and stopped) if a breakpoint there holds
+        bool HitBreakpoint(uint64_t halfTicks);
+
+        // The instruction in IR0 is about to run (instruction boundary), it completes at endHalfTicks
+        void BeforeInstruction(uint64_t endHalfTicks);
+
+        // True (and stopped) when the instruction that just completed on halfTicks set a register watch off
+        bool AfterInstruction(uint64_t halfTicks);
+
+        // The RTL model is about to run the instruction in IR0 (instruction boundary) : its data access is foreseen,
+        // the taps don't hear the RTL model
+        void BeforeRTLInstruction(uint64_t halfTicks);
+
+        // An access matched a watch : CheckAccess() once its instruction is done
+        bool HasPendingAccess() const {
+            return accessPending;
+        }
+
+        // The CPU is at the instruction boundary halfTicks, after the instruction of the pending access.
+        // True (and stopped) when a watch's condition holds. Clears the access and the bus' stop request either way
+        bool CheckAccess(uint64_t halfTicks);
+
+        // Accesses on the watched pages, the ones matching a watch request a stop
+        void OnRead(uint16_t pc, uint16_t address, uint16_t value) override;
+
+        void OnWrite(uint16_t pc, uint16_t address, uint16_t previous, uint16_t value) override;
+
+        // The CPU restarted, nothing to resume from
+        void OnReset();
+};
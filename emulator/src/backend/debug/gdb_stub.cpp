@@ -0,0 +1,747 @@
+#include "gdb_stub.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "../machine.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define ORGAN16_GDB_SOCKETS 1
+#else
+#define ORGAN16_GDB_SOCKETS 0
+#endif
+
+// A client gone mid-send must not kill the process (SIGPIPE)
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Bytes the client addresses : two per word
+static const uint32_t GDB_MEMORY_BYTES = 65536 * 2;
+
+static const char TARGET_XML[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+    "<target version=\"1.0\">\n"
+    "  <feature name=\"org.organ16.cpu\">\n"
+    "    <flags id=\"organ16_flags\" size=\"2\">\n"
+    "      <field name=\"Z\" start=\"0\" end=\"0\"/>\n"
+    "      <field name=\"N\" start=\"1\" end=\"1\"/>\n"
+    "      <field name=\"C\" start=\"2\" end=\"2\"/>\n"
+    "      <field name=\"O\" start=\"3\" end=\"3\"/>\n"
+    "    </flags>\n"
+    "    <reg name=\"r0\" bitsize=\"16\" type=\"uint16\" regnum=\"0\"/>\n"
+    "    <reg name=\"r1\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r2\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r3\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r4\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r5\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r6\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"r7\" bitsize=\"16\" type=\"uint16\"/>\n"
+    "    <reg name=\"sp\" bitsize=\"16\" type=\"data_ptr\"/>\n"
+    "    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>\n"
+    "    <reg name=\"flags\" bitsize=\"16\" type=\"organ16_flags\"/>\n"
+    "  </feature>\n"
+    "</target>\n";
+
+static const char MONITOR_HELP[] =
+    "break ADDRESS [if CONDITION]                               breakpoint on a word address\n"
+    "watch [read|write|access|change] FIRST[-LAST] [if CONDITION]  watchpoint on word addresses\n"
+    "watch REGISTER [if CONDITION]                              stop when R0-R7, SP or FLAGS changes\n"
+    "delete ID                                                  remove a breakpoint or a watch\n"
+    "list                                                       breakpoints and watches, with their hits\n"
+    "reset                                                      reset the CPU (the RAM is kept)\n";
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static void PutHexByte(std::string& out, uint8_t value)
+{
+    out += HEX_DIGITS[value >> 4];
+    out += HEX_DIGITS[value & 0xF];
+}
+
+// Target byte order : low byte first
+static void PutHexWord(std::string& out, uint16_t value)
+{
+    PutHexByte(out, static_cast<uint8_t>(value));
+    PutHexByte(out, static_cast<uint8_t>(value >> 8));
+}
+
+// Binary data (x replies) : the framing characters go escaped
+static void PutEscapedByte(std::string& out, uint8_t value)
+{
+    if (value == '#' || value == '$' || value == '}' || value == '*') {
+        out += '}';
+        value ^= 0x20;
+    }
+    out += static_cast<char>(value);
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool ParseHex(const std::string& text, uint32_t& value)
+{
+    if (text.empty() || text.size() > 8)
+        return false;
+    value = 0;
+    for (char c : text) {
+        int digit = HexValue(c);
+        if (digit < 0)
+            return false;
+        value = (value << 4) | static_cast<uint32_t>(digit);
+    }
+    return true;
+}
+
+static bool DecodeHexBytes(const std::string& text, std::vector<uint8_t>& bytes)
+{
+    if (text.size() % 2 != 0)
+        return false;
+    bytes.resize(text.size() / 2);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        int high = HexValue(text[2 * i]), low = HexValue(text[2 * i + 1]);
+        if (high < 0 || low < 0)
+            return false;
+        bytes[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return true;
+}
+
+static std::string EncodeHexText(const std::string& text)
+{
+    std::string out;
+    out.reserve(text.size() * 2);
+    for (char c : text)
+        PutHexByte(out, static_cast<uint8_t>(c));
+    return out;
+}
+
+// "ADDRESS,LENGTH" (hex)
+static bool ParseRange(const std::string& text, uint32_t& start, uint32_t& length)
+{
+    size_t comma = text.find(',');
+    return comma != std::string::npos && ParseHex(text.substr(0, comma), start) && ParseHex(text.substr(comma + 1), length);
+}
+
+GdbStub::~GdbStub()
+{
+    CloseClient();
+#if ORGAN16_GDB_SOCKETS
+    if (listener >= 0)
+        close(listener);
+    if (!unixPath.empty())
+        unlink(unixPath.c_str());
+#endif
+}
+
+bool GdbStub::Listen(const std::string& where, std::string& error)
+{
+#if ORGAN16_GDB_SOCKETS
+    if (where.compare(0, 5, "unix:") == 0) {
+        std::string path = where.substr(5);
+        sockaddr_un socketAddress{};
+        if (path.empty() || path.size() >= sizeof(socketAddress.sun_path)) {
+            error = "Invalid unix socket path : " + path;
+            return false;
+        }
+        socketAddress.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), socketAddress.sun_path);
+
+        // A socket file left by an earlier session
+        unlink(path.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0
+            || listen(listener, 1) != 0) {
+            error = "Could not listen on the unix socket " + path;
+            return false;
+        }
+        unixPath = path;
+        address = path;
+        return true;
+    }
+
+    char* end = nullptr;
+    unsigned long port = std::strtoul(where.c_str(), &end, 10);
+    if (where.empty() || *end != '\0' || port > 65535) {
+        error = "Invalid gdb address (PORT or unix:PATH) : " + where;
+        return false;
+    }
+
+    sockaddr_in socketAddress{};
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socketAddress.sin_port = htons(static_cast<uint16_t>(port));
+
+    int one = 1;
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0
+        || bind(listener, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0
+        || listen(listener, 1) != 0) {
+        error = "Could not listen on port " + where;
+        return false;
+    }
+
+    socklen_t length = sizeof(socketAddress);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&socketAddress), &length);
+    address = "localhost:" + std::to_string(ntohs(socketAddress.sin_port));
+    return true;
+#else
+    (void)where;
+    error = "The gdb stub needs POSIX sockets";
+    return false;
+#endif
+}
+
+bool GdbStub::Serve(std::string& error)
+{
+#if ORGAN16_GDB_SOCKETS
+    client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+        error = "Could not accept the gdb connection";
+        return false;
+    }
+    if (unixPath.empty()) {
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    noAck = false;
+    killed = false;
+    input.clear();
+    lastPacket.clear();
+
+    // Registers are only meaningful between two instructions
+    FinishInstruction();
+
+    std::string packet;
+    bool done = false;
+    while (!done && ReadPacket(packet)) {
+        std::string reply = Handle(packet, done);
+        if (packet != "k" && !SendPacket(reply))
+            break;
+    }
+
+    // The client's breakpoints go with it
+    for (const Point& point : points)
+        machine.debugger.Remove(point.id);
+    points.clear();
+    CloseClient();
+    return true;
+#else
+    error = "The gdb stub needs POSIX sockets";
+    return false;
+#endif
+}
+
+void GdbStub::CloseClient()
+{
+#if ORGAN16_GDB_SOCKETS
+    if (client >= 0)
+        close(client);
+#endif
+    client = -1;
+}
+
+bool GdbStub::Receive()
+{
+#if ORGAN16_GDB_SOCKETS
+    char buffer[65536];
+    ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+    if (received <= 0)
+        return false;
+    input.append(buffer, static_cast<size_t>(received));
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool GdbStub::SendRaw(const std::string& bytes)
+{
+#if ORGAN16_GDB_SOCKETS
+    size_t sent = 0;
+    while (sent < bytes.size()) {
+        ssize_t count = send(client, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0)
+            return false;
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+#else
+    (void)bytes;
+    return false;
+#endif
+}
+
+bool GdbStub::SendPacket(const std::string& payload)
+{
+    uint8_t checksum = 0;
+    for (char c : payload)
+        checksum = static_cast<uint8_t>(checksum + static_cast<uint8_t>(c));
+
+    // One send for the whole packet, however large
+    lastPacket.clear();
+    lastPacket.reserve(payload.size() + 4);
+    lastPacket += '$';
+    lastPacket += payload;
+    lastPacket += '#';
+    PutHexByte(lastPacket, checksum);
+    return SendRaw(lastPacket);
+}
+
+bool GdbStub::ReadPacket(std::string& payload)
+{
+    for (;;) {
+        // Acks (and stray Ctrl-C) before the packet : a '-' asks for the last one again
+        size_t start = input.find('$');
+        size_t skipped = start == std::string::npos ? input.size() : start;
+        if (!noAck && input.find('-') < skipped && !lastPacket.empty() && !SendRaw(lastPacket))
+            return false;
+        input.erase(0, skipped);
+
+        size_t end = input.find('#');
+        if (!input.empty() && end != std::string::npos && end + 2 < input.size()) {
+            payload = input.substr(1, end - 1);
+            int expected = (HexValue(input[end + 1]) << 4) | HexValue(input[end + 2]);
+            input.erase(0, end + 3);
+            if (noAck)
+                return true;
+
+            uint8_t checksum = 0;
+            for (char c : payload)
+                checksum = static_cast<uint8_t>(checksum + static_cast<uint8_t>(c));
+            if (checksum == expected)
+                return SendRaw("+");
+            if (!SendRaw("-"))
+                return false;
+            continue;
+        }
+
+        if (!Receive())
+            return false;
+    }
+}
+
+bool GdbStub::Interrupted()
+{
+#if ORGAN16_GDB_SOCKETS
+    pollfd descriptor{client, POLLIN, 0};
+    if (poll(&descriptor, 1, 0) <= 0)
+        return false;
+    if (!Receive())
+        return true;
+
+    size_t at = input.find('\x03');
+    if (at == std::string::npos)
+        return false;
+    input.erase(at, 1);
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string GdbStub::Handle(const std::string& packet, bool& done)
+{
+    if (packet.empty())
+        return "";
+
+    std::string arguments = packet.substr(1);
+    switch (packet[0]) {
+        case '?':
+            return lastStop;
+
+        case 'g':
+            return ReadRegisters();
+
+        case 'G': {
+            std::vector<uint8_t> bytes;
+            if (!DecodeHexBytes(arguments, bytes) || bytes.size() < GDB_REG_COUNT * 2)
+                return "E01";
+            for (int number = 0; number < GDB_REG_COUNT; ++number) {
+                if (!WriteRegister(number, static_cast<uint16_t>(bytes[2 * number] | (bytes[2 * number + 1] << 8))))
+                    return "E02";
+            }
+            return "OK";
+        }
+
+        case 'p': {
+            uint32_t number = 0;
+            if (!ParseHex(arguments, number) || number >= GDB_REG_COUNT)
+                return "E01";
+            return ReadRegisters().substr(number * 4, 4);
+        }
+
+        case 'P': {
+            size_t equals = arguments.find('=');
+            uint32_t number = 0;
+            std::vector<uint8_t> bytes;
+            if (equals == std::string::npos || !ParseHex(arguments.substr(0, equals), number) || number >= GDB_REG_COUNT
+                || !DecodeHexBytes(arguments.substr(equals + 1), bytes) || bytes.size() != 2)
+                return "E01";
+            return WriteRegister(static_cast<int>(number), static_cast<uint16_t>(bytes[0] | (bytes[1] << 8))) ? "OK" : "E02";
+        }
+
+        case 'm':
+        case 'x': {
+            uint32_t start = 0, length = 0;
+            if (!ParseRange(arguments, start, length))
+                return "E01";
+            return ReadMemory(start, length, packet[0] == 'x');
+        }
+
+        case 'M':
+        case 'X': {
+            size_t colon = arguments.find(':');
+            uint32_t start = 0, length = 0;
+            if (colon == std::string::npos || !ParseRange(arguments.substr(0, colon), start, length))
+                return "E01";
+
+            std::vector<uint8_t> bytes;
+            if (packet[0] == 'M') {
+                if (!DecodeHexBytes(arguments.substr(colon + 1), bytes))
+                    return "E01";
+            }
+            else {
+                for (size_t i = colon + 1; i < arguments.size(); ++i) {
+                    uint8_t value = static_cast<uint8_t>(arguments[i]);
+                    if (value == '}' && i + 1 < arguments.size())
+                        value = static_cast<uint8_t>(arguments[++i]) ^ 0x20;
+                    bytes.push_back(value);
+                }
+            }
+            if (bytes.size() != length)
+                return "E01";
+            return WriteMemory(start, bytes) ? "OK" : "E02";
+        }
+
+        // Resuming at another address or with a signal is not supported : both are ignored
+        case 'c':
+        case 'C':
+            return Resume(false);
+
+        case 's':
+        case 'S':
+            return Resume(true);
+
+        case 'Z':
+        case 'z':
+            return SetPoint(packet[0] == 'Z', arguments);
+
+        case 'D':
+            done = true;
+            return "OK";
+
+        case 'k':
+            done = true;
+            killed = true;
+            return "";
+
+        // Single thread
+        case 'H':
+        case 'T':
+            return "OK";
+
+        default:
+            break;
+    }
+
+    if (packet == "vCont?")
+        return "vCont;c;C;s;S";
+    if (packet.compare(0, 6, "vCont;") == 0 && packet.size() > 6) {
+        // Every action is for the only thread, the first one decides
+        char action = packet[6];
+        if (action == 'c' || action == 'C')
+            return Resume(false);
+        if (action == 's' || action == 'S')
+            return Resume(true);
+        return "E01";
+    }
+    if (packet.compare(0, 5, "vKill") == 0) {
+        done = true;
+        killed = true;
+        return "OK";
+    }
+
+    if (packet.compare(0, 10, "qSupported") == 0) {
+        std::ostringstream features;
+        features << "PacketSize=" << std::hex << GDB_PACKET_SIZE
+                 << ";qXfer:features:read+;QStartNoAckMode+;swbreak+;hwbreak+;vContSupported+";
+        return features.str();
+    }
+    if (packet.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+        uint32_t offset = 0, length = 0;
+        if (!ParseRange(packet.substr(31), offset, length))
+            return "E01";
+        std::string xml = TARGET_XML;
+        if (offset >= xml.size())
+            return "l";
+        std::string chunk = xml.substr(offset, length);
+        return (offset + chunk.size() < xml.size() ? "m" : "l") + chunk;
+    }
+    if (packet == "QStartNoAckMode") {
+        // This packet was still acknowledged, nothing is from now on
+        noAck = true;
+        return "OK";
+    }
+    if (packet.compare(0, 6, "qRcmd,") == 0) {
+        std::vector<uint8_t> bytes;
+        if (!DecodeHexBytes(packet.substr(6), bytes))
+            return "E01";
+        return Monitor(std::string(bytes.begin(), bytes.end()));
+    }
+    if (packet == "qAttached")
+        return "1";
+    if (packet == "qC")
+        return "QC1";
+    if (packet == "qfThreadInfo")
+        return "m1";
+    if (packet == "qsThreadInfo")
+        return "l";
+    if (packet == "qOffsets")
+        return "Text=0;Data=0;Bss=0";
+    if (packet.compare(0, 7, "qSymbol") == 0)
+        return "OK";
+
+    // Anything else is not supported
+    return "";
+}
+
+std::string GdbStub::ReadRegisters()
+{
+    const CPUState& state = machine.state;
+    std::string out;
+    out.reserve(GDB_REG_COUNT * 4);
+    for (int i = 0; i < 8; ++i)
+        PutHexWord(out, state.regs[i]);
+    PutHexWord(out, state.SP);
+    PutHexWord(out, state.PC);
+    PutHexWord(out, state.FLAGS);
+    return out;
+}
+
+bool GdbStub::WriteRegister(int number, uint16_t value)
+{
+    CPU& cpu = machine.cpu;
+    if (!cpu.IsAtInstructionBoundary())
+        return false;
+
+    ArchState state = cpu.CaptureArchState();
+    if (number < 8)
+        state.regs[number] = value;
+    else if (number == GDB_REG_SP)
+        state.SP = value;
+    else if (number == GDB_REG_PC)
+        state.PC = value;
+    else
+        state.FLAGS = static_cast<uint8_t>(value & 0xF);
+
+    // IR0 is fetched again from the new PC
+    cpu.RestoreArchState(state);
+    return true;
+}
+
+std::string GdbStub::ReadMemory(uint32_t start, uint32_t length, bool binary)
+{
+    if (start >= GDB_MEMORY_BYTES && length > 0)
+        return "E01";
+
+    // Past the end of the address space the reply is cut short
+    uint32_t end = std::min(start + std::min(length, GDB_MEMORY_BYTES), GDB_MEMORY_BYTES);
+    const uint16_t* memory = machine.ram.Data();
+    std::string out;
+    out.reserve(binary ? 1 + (end - start) * 2 : (end - start) * 2);
+    if (binary)
+        out += 'b';
+    for (uint32_t byte = start; byte < end; ++byte) {
+        uint8_t value = static_cast<uint8_t>(memory[byte >> 1] >> ((byte & 1) * 8));
+        if (binary)
+            PutEscapedByte(out, value);
+        else
+            PutHexByte(out, value);
+    }
+    return out;
+}
+
+bool GdbStub::WriteMemory(uint32_t start, const std::vector<uint8_t>& bytes)
+{
+    if (start + bytes.size() > GDB_MEMORY_BYTES)
+        return false;
+
+    // Bytes are merged into their word first, each word touched is written once (a device sees one write per word)
+    const uint16_t* memory = machine.ram.Data();
+    uint32_t end = start + static_cast<uint32_t>(bytes.size());
+    for (uint32_t word = start >> 1; word < (end + 1) >> 1; ++word) {
+        uint16_t value = memory[word];
+        for (int half = 0; half < 2; ++half) {
+            uint32_t byte = (word << 1) + half;
+            if (byte >= start && byte < end) {
+                int shift = half * 8;
+                value = static_cast<uint16_t>((value & ~(0xFF << shift)) | (bytes[byte - start] << shift));
+            }
+        }
+        machine.bus.Write(static_cast<uint16_t>(word), value);
+    }
+
+    // The instruction at PC may have been rewritten
+    CPU& cpu = machine.cpu;
+    if (cpu.IsAtInstructionBoundary())
+        cpu.RestoreArchState(cpu.CaptureArchState());
+    return true;
+}
+
+std::string GdbStub::SetPoint(bool insert, const std::string& arguments)
+{
+    // "TYPE,ADDRESS,KIND" (conditions and commands after a ';' are not supported)
+    size_t comma = arguments.find(',');
+    uint32_t address = 0, length = 0;
+    if (comma != 1 || !ParseRange(arguments.substr(2, arguments.find(';') - 2), address, length) || address >= GDB_MEMORY_BYTES)
+        return "E01";
+
+    char type = arguments[0];
+    int kinds = 0;
+    switch (type) {
+        case '0':
+        case '1': break;
+        case '2': kinds = WATCH_WRITE; break;
+        case '3': kinds = WATCH_READ; break;
+        case '4': kinds = WATCH_ACCESS; break;
+        default: return "";
+    }
+
+    auto existing = std::find_if(points.begin(), points.end(), [&](const Point& point) {
+        return point.type == type && point.address == address && (kinds == 0 || point.length == length);
+    });
+
+    if (!insert) {
+        if (existing == points.end())
+            return "E01";
+        machine.debugger.Remove(existing->id);
+        points.erase(existing);
+        return "OK";
+    }
+    if (existing != points.end())
+        return "OK";
+
+    std::string error;
+    uint16_t first = static_cast<uint16_t>(address >> 1);
+    uint32_t last = std::min<uint32_t>((address + std::max<uint32_t>(length, 1) - 1) >> 1, 0xFFFF);
+    int id = kinds == 0 ? machine.debugger.AddBreakpoint(first, "", error)
+                        : machine.debugger.AddWatch(first, static_cast<uint16_t>(last), kinds, "", error);
+    if (id < 0)
+        return "E02";
+    points.push_back({type, address, length, id});
+    return "OK";
+}
+
+std::string GdbStub::Monitor(const std::string& command)
+{
+    Debugger& debugger = machine.debugger;
+    std::istringstream words(command);
+    std::string verb;
+    words >> verb;
+
+    std::ostringstream out;
+    std::string error;
+    if (verb == "break" || verb == "watch") {
+        int id = debugger.Add(command, error);
+        if (id < 0)
+            out << error << "\n";
+        else
+            out << "#" << id << "\n";
+    }
+    else if (verb == "delete") {
+        int id = 0;
+        if (words >> id && debugger.Remove(id)) {
+            points.erase(std::remove_if(points.begin(), points.end(), [id](const Point& point) { return point.id == id; }), points.end());
+            out << "Deleted #" << id << "\n";
+        }
+        else
+            out << "No such breakpoint or watch\n";
+    }
+    else if (verb == "list") {
+        debugger.List(out);
+    }
+    else if (verb == "reset") {
+        machine.cpu.Reset();
+        lastStop = "S05";
+        out << "CPU reset\n";
+    }
+    else {
+        out << MONITOR_HELP;
+    }
+    return EncodeHexText(out.str());
+}
+
+void GdbStub::FinishInstruction()
+{
+    CPU& cpu = machine.cpu;
+    while (!cpu.IsAtInstructionBoundary() && !cpu.IsHalted() && !machine.debugger.HasStopped())
+        cpu.Run(1);
+}
+
+std::string GdbStub::Resume(bool step)
+{
+    CPU& cpu = machine.cpu;
+    Debugger& debugger = machine.debugger;
+
+    // Going on from a breakpoint the client stands on
+    debugger.PassBreakpoint(cpu.GetHalfTicks());
+
+    bool interrupted = false;
+    if (step) {
+        int cost = FunctionalEngine::GetHalfTicks(machine.state.IR0);
+        cpu.Run(cost > 0 ? cost : 1);
+        FinishInstruction();
+    }
+    else {
+        // The last stop is only cleared by the next run
+        do {
+            cpu.Run(GDB_RUN_SLICE);
+            if (!cpu.IsHalted() && !debugger.HasStopped() && Interrupted()) {
+                FinishInstruction();
+                interrupted = true;
+                break;
+            }
+        } while (!cpu.IsHalted() && !debugger.HasStopped());
+    }
+
+    // SIGTRAP for the breakpoints, watches, steps and HLT, SIGINT for Ctrl-C
+    std::string reply = interrupted && !debugger.HasStopped() ? "T02" : "T05";
+    if (debugger.HasStopped()) {
+        const DebugStop& stop = debugger.GetStop();
+        for (const Point& point : points) {
+            if (point.id != stop.id)
+                continue;
+
+            if (stop.kind == DEBUG_STOP_BREAKPOINT) {
+                reply += point.type == '1' ? "hwbreak:;" : "swbreak:;";
+            }
+            else if (stop.kind == DEBUG_STOP_WATCH) {
+                std::ostringstream watch;
+                watch << (point.type == '2' ? "watch:" : point.type == '3' ? "rwatch:" : "awatch:")
+                      << std::hex << static_cast<uint32_t>(stop.address) * 2 << ";";
+                reply += watch.str();
+            }
+        }
+    }
+    lastStop = reply;
+    return reply;
+}
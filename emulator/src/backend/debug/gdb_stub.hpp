@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Machine;
+
+// Half-ticks run between two looks at the connection while the client has the target continue (Ctrl-C)
+static const uint64_t GDB_RUN_SLICE = uint64_t(1) << 20;
+
+// Largest packet announced to the client : the whole 16K word framebuffer fits in a single m / M / X / x packet
+static const size_t GDB_PACKET_SIZE = 0x20000;
+
+// Register numbers of the client : R0-R7, then these
+enum GdbRegister{
+    GDB_REG_SP = 8,
+    GDB_REG_PC,
+    GDB_REG_FLAGS,
+    GDB_REG_COUNT
+};
+
+// GDB remote serial protocol server for one Machine, over TCP (localhost) or a unix socket (POSIX only).
+// Memory is byte addressed on the client's side : bytes 2n and 2n + 1 are the low and high halves of word n.
+// Registers are 16 bit (target.xml, sent through qXfer:features:read). Breakpoints (Z0 / Z1) and watchpoints (Z2 - Z4)
+// go to the Machine's Debugger, "monitor" commands take the Debugger's own (with conditions).
+// The client is served on the calling thread, which runs the Machine whenever the client has it continue or step
+class GdbStub{
+    private:
+        // A Z packet and the Debugger entry made for it
+        struct Point{
+            char type;
+            uint32_t address;
+            uint32_t length;
+            int id;
+        };
+
+        Machine& machine;
+
+        int listener = -1;
+        int client = -1;
+        std::string address;
+        std::string unixPath;   // Unlinked on close
+
+        bool noAck = false;
+        bool killed = false;
+
+        // Received from the client, not parsed yet
+        std::string input;
+
+        // Sent last, again if the client asks for it ('-')
+        std::string lastPacket;
+
+        std::vector<Point> points;
+
+        // Answer to '?'
+        std::string lastStop = "S05";
+
+        bool Receive();
+
+        // Next packet's payload, false once the client is gone
+        bool ReadPacket(std::string& payload);
+
+        bool SendRaw(const std::string& bytes);
+
+        bool SendPacket(const std::string& payload);
+
+        // Reply to one packet (nothing is sent back for an empty optional reply to k)
+        std::string Handle(const std::string& packet, bool& done);
+
+        std::string ReadRegisters();
+
+        bool WriteRegister(int number, uint16_t value);
+
+        std::string ReadMemory(uint32_t start, uint32_t length, bool binary);
+
+        bool WriteMemory(uint32_t start, const std::vector<uint8_t>& bytes);
+
+        std::string SetPoint(bool insert, const std::string& arguments);
+
+        std::string Monitor(const std::string& command);
+
+        // Steps one instruction or continues until a stop, a HLT or a Ctrl-C from the client, returns the stop reply
+        std::string Resume(bool step);
+
+        // Runs the RTL model up to the next instruction boundary
+        void FinishInstruction();
+
+        // A Ctrl-C (0x03) arrived, or the client left
+        bool Interrupted();
+
+        void CloseClient();
+
+    public:
+        explicit GdbStub(Machine& machine) : machine(machine) {}
+
+        ~GdbStub();
+
+        GdbStub(const GdbStub&) = delete;
+        GdbStub& operator=(const GdbStub&) = delete;
+        GdbStub(GdbStub&&) = delete;
+        GdbStub& operator=(GdbStub&&) = delete;
+
+        // "PORT" (TCP on 127.0.0.1, 0 picks a free one) or "unix:PATH".
+        // On failure returns false and describes the problem in error
+        bool Listen(const std::string& where, std::string& error);
+
+        // Where clients connect ("localhost:PORT" or the socket path)
+        const std::string& GetAddress() const {
+            return address;
+        }
+
+        // Waits for a client and serves it until it detaches, kills the target or disconnects
+        bool Serve(std::string& error);
+
+        // The client ended the session with k (the Machine is left as it is)
+        bool WasKilled() const {
+            return killed;
+        }
+};
@@ -0,0 +1,182 @@
+#include "block_cache.hpp"
+
+#include "functional_engine.hpp"
+
+DecodedBlock* BlockCache::Build(uint16_t pc, const uint16_t* memory)
+{
+    if (IsBreakpoint(pc) || IsDeviceAddress(pc))
+        return nullptr;
+
+    std::unique_ptr<DecodedBlock> block = std::make_unique<DecodedBlock>();
+    block->startPC = pc;
+
+    uint32_t address = pc;
+    while (block->instructions.size() < MAX_BLOCK_INSTRUCTIONS) {
+        uint16_t instruction = memory[address];
+        int halfTicks = FunctionalEngine::GetHalfTicks(instruction);
+        int length = FunctionalEngine::GetLength(instruction);
+
+        // HLT / undocumented encodings / breakpoints / device pages are left to the caller, blocks never wrap around the address space
+        if (halfTicks == 0 || address + length > BLOCK_CACHE_SIZE || IsBreakpoint(static_cast<uint16_t>(address))
+            || IsDeviceAddress(static_cast<uint16_t>(address)) || IsDeviceAddress(static_cast<uint16_t>(address + length - 1)))
+            break;
+
+        DecodedInstruction decoded;
+        decoded.index = instruction >> 9;
+        decoded.handler = decoded.index;
+        decoded.halfTicks = static_cast<uint8_t>(halfTicks);
+        decoded.dst = (instruction >> 6) & 0b111;
+        decoded.srcA = (instruction >> 3) & 0b111;
+        decoded.srcB = instruction & 0b111;
+        decoded.ext = length == 2 ? memory[address + 1] : 0;
+        block->instructions.push_back(decoded);
+        block->halfTicks += halfTicks;
+
+        address += length;
+        if (FunctionalEngine::EndsBlock(instruction))
+            break;
+    }
+
+    if (block->instructions.empty())
+        return nullptr;
+
+    // Fused pairs never overlap : the second instruction of a pair keeps its plain handler
+    for (size_t i = 0; i + 1 < block->instructions.size(); ++i) {
+        int fusion = FunctionalEngine::FindFusion(block->instructions[i].index, block->instructions[i + 1].index);
+        if (fusion >= 0) {
+            block->instructions[i].handler = static_cast<uint8_t>(FUSED_HANDLER_BASE + fusion);
+            ++i;
+        }
+    }
+
+    block->endAddress = address;
+    for (uint32_t word = pc; word < address; ++word)
+        coverCount[word]++;
+    for (uint32_t page = pc >> BLOCK_PAGE_SHIFT; page <= ((address - 1) >> BLOCK_PAGE_SHIFT); ++page)
+        pageBlocks[page].push_back(pc);
+
+    blocks[pc] = std::move(block);
+    return blocks[pc].get();
+}
+
+void BlockCache::Remove(uint16_t startPC)
+{
+    std::unique_ptr<DecodedBlock> block = std::move(blocks[startPC]);
+    if (!block)
+        return;
+
+    for (uint32_t word = block->startPC; word < block->endAddress; ++word)
+        coverCount[word]--;
+
+    for (uint32_t page = block->startPC >> BLOCK_PAGE_SHIFT; page <= ((block->endAddress - 1) >> BLOCK_PAGE_SHIFT); ++page) {
+        std::vector<uint16_t>& starts = pageBlocks[page];
+        for (size_t i = 0; i < starts.size(); ++i) {
+            if (starts[i] == startPC) {
+                starts[i] = starts.back();
+                starts.pop_back();
+                break;
+            }
+        }
+    }
+
+    removed.push_back(std::move(block));
+}
+
+void BlockCache::InvalidateAddress(uint16_t address)
+{
+    // Collect first : Remove() edits the page list we would be walking
+    std::vector<uint16_t> stale;
+    for (uint16_t startPC : pageBlocks[address >> BLOCK_PAGE_SHIFT]) {
+        const DecodedBlock* block = blocks[startPC].get();
+        if (address >= block->startPC && address < block->endAddress)
+            stale.push_back(startPC);
+    }
+
+    for (uint16_t startPC : stale)
+        Remove(startPC);
+    generation++;
+}
+
+void BlockCache::SetBreakpoint(uint16_t address, bool set)
+{
+    uint64_t bit = uint64_t(1) << (address & 63);
+    if (set) {
+        breakpoints[address >> 6] |= bit;
+        InvalidateAddress(address);
+    }
+    else {
+        breakpoints[address >> 6] &= ~bit;
+        if (address > 0)
+            InvalidateAddress(static_cast<uint16_t>(address - 1));
+    }
+}
+
+void BlockCache::InvalidateAll()
+{
+    // Nothing can run the translations anymore, the arena can start over
+    jitCompiler.Reset();
+
+    // The page lists hold every live block : a program load or reset does not walk the whole table
+    FlushPerfCounts();
+    for (std::vector<uint16_t>& starts : pageBlocks) {
+        for (uint16_t startPC : starts)
+            blocks[startPC].reset();
+        starts.clear();
+    }
+    coverCount.fill(0);
+    generation++;
+}
+
+void BlockCache::ForgetJitCode()
+{
+    for (const std::vector<uint16_t>& starts : pageBlocks) {
+        for (uint16_t startPC : starts)
+            blocks[startPC]->jitCode = nullptr;
+    }
+}
+
+void BlockCache::FoldPasses(DecodedBlock* block)
+{
+    if (block->perfPasses != 0) {
+        CountBlock(*block, 0, block->instructions.size(), block->perfPasses);
+        perfCounters.CountTakenBranches(block->perfTaken);
+        block->perfPasses = 0;
+        block->perfTaken = 0;
+    }
+}
+
+void BlockCache::TakeRunBack(DecodedBlock* block, size_t first, size_t last)
+{
+    uint64_t passes = block->perfPasses;
+    size_t size = block->instructions.size();
+    perfCounters.CountBlock(*block, 0, size, passes);
+    perfCounters.CountBlock(*block, first, last, ~static_cast<uint64_t>(0));
+    perfCounters.CountTakenBranches(block->perfTaken);
+    heatmap.CountBlock(*block, 0, first, passes);
+    heatmap.CountBlock(*block, first, last, passes - 1);
+    heatmap.CountBlock(*block, last, size, passes);
+    block->perfPasses = 0;
+    block->perfTaken = 0;
+}
+
+void BlockCache::ReleaseRemovedBlocks()
+{
+    for (std::unique_ptr<DecodedBlock>& block : removed)
+        FoldPasses(block.get());
+    removed.clear();
+}
+
+void BlockCache::FoldPending()
+{
+    for (uint16_t startPC : perfPending) {
+        if (blocks[startPC])
+            FoldPasses(blocks[startPC].get());
+    }
+    perfPending.clear();
+}
+
+void BlockCache::FlushPerfCounts()
+{
+    FoldPending();
+    ReleaseRemovedBlocks();
+}
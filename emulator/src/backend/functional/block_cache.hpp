@@ -0,0 +1,198 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "../jit/jit_compiler.hpp"
+#include "../perf/perf_counters.hpp"
+#include "../perf/access_heatmap.hpp"
+
+static const size_t BLOCK_CACHE_SIZE = 65536;
+static const int BLOCK_PAGE_SHIFT = 8;
+static const size_t BLOCK_PAGE_COUNT = BLOCK_CACHE_SIZE >> BLOCK_PAGE_SHIFT;
+
+// Longest run of instructions decoded into a single block
+static const int MAX_BLOCK_INSTRUCTIONS = 64;
+
+// One instruction with its operands already extracted from IR0 (and its extension word)
+struct DecodedInstruction{
+    uint8_t index;      // OpCode + SubOpCode (top 7 bits of IR0)
+    uint8_t handler;    // Interpreter handler : index, or a fused pair (FUSED_HANDLER_BASE + FusionKind)
+    uint8_t halfTicks;  // Cost on the RTL model
+    uint8_t dst;
+    uint8_t srcA;
+    uint8_t srcB;
+    uint16_t ext;       // Extension word (only for the 2 word instructions)
+};
+
+// Straight line code starting at startPC, ends after JMP/Jcc/JSR/RTS or before HLT / an undocumented encoding / a breakpoint
+struct DecodedBlock{
+    uint16_t startPC = 0;
+    uint32_t endAddress = 0;  // One past the last word covered (extension words included)
+    uint32_t halfTicks = 0;   // Whole block, every instruction costs the same taken or not
+    std::vector<DecodedInstruction> instructions;
+
+    // Native translation (ENGINE_JIT), made once the block got hot
+    uint32_t executions = 0;
+    JitBlockFunction jitCode = nullptr;
+    bool jitRejected = false;
+
+    // Runs of the whole block and of its last instruction's jump (Jcc) not added to the performance counters yet
+    // (see BlockCache::CountPasses)
+    uint64_t perfPasses = 0;
+    uint64_t perfTaken = 0;
+};
+
+// Cache of decoded blocks keyed by start PC.
+// Every write to a word covered by a block (RAM::Write or the functional engine's stores) throws the block away.
+// A block thrown away is kept until ReleaseRemovedBlocks() : the engine running it may still be reading it.
+class BlockCache{
+    private:
+        // Translations of the owning Machine, dropped along with the blocks
+        JitCompiler& jitCompiler;
+
+        // Counters and heatmap of the owning Machine, the blocks' passes are added to them
+        PerfCounters& perfCounters;
+        AccessHeatmap& heatmap;
+
+        std::vector<std::unique_ptr<DecodedBlock>> blocks = std::vector<std::unique_ptr<DecodedBlock>>(BLOCK_CACHE_SIZE);
+
+        // Number of blocks covering each word, keeps the write check to a single load
+        std::array<uint16_t, BLOCK_CACHE_SIZE> coverCount{};
+
+        // Start PCs of the blocks overlapping each 256 word page
+        std::array<std::vector<uint16_t>, BLOCK_PAGE_COUNT> pageBlocks;
+
+        // PC breakpoints (Debugger) : a block ends right before one and none starts there, so the engines stop on them
+        // without looking at every instruction
+        std::array<uint64_t, BLOCK_CACHE_SIZE / 64> breakpoints{};
+
+        // Pages a device reads (MemoryBus) : no block reaches into them, the RTL model runs that code through the bus
+        std::array<uint64_t, BLOCK_PAGE_COUNT / 64> devicePages{};
+
+        // Bumped on every invalidation so a running block can tell it may be gone
+        uint64_t generation = 0;
+
+        // Blocks thrown away since the last ReleaseRemovedBlocks()
+        std::vector<std::unique_ptr<DecodedBlock>> removed;
+
+        // Start PCs of the blocks holding passes (may list a block twice, or one that was removed since)
+        std::vector<uint16_t> perfPending;
+
+        void FoldPasses(DecodedBlock* block);
+
+        // FoldPasses() with one run less for the instructions [first, last) : the heatmap's counts saturate, a run
+        // can't be taken back once they did
+        void TakeRunBack(DecodedBlock* block, size_t first, size_t last);
+
+        // Folds the passes of the live blocks listed in perfPending
+        void FoldPending();
+
+        DecodedBlock* Build(uint16_t pc, const uint16_t* memory);
+
+        void Remove(uint16_t startPC);
+
+    public:
+        BlockCache(JitCompiler& jitCompiler, PerfCounters& perfCounters, AccessHeatmap& heatmap)
+            : jitCompiler(jitCompiler), perfCounters(perfCounters), heatmap(heatmap) {}
+
+        BlockCache(const BlockCache&) = delete;
+        BlockCache& operator=(const BlockCache&) = delete;
+        BlockCache(BlockCache&&) = delete;
+        BlockCache& operator=(BlockCache&&) = delete;
+
+        // Decoded block starting at pc (decoded now if needed). nullptr when the instruction at pc can't start a block
+        DecodedBlock* GetBlock(uint16_t pc, const uint16_t* memory){
+            DecodedBlock* block = blocks[pc].get();
+            return block ? block : Build(pc, memory);
+        }
+
+        // Must be called for every write to memory
+        void OnWrite(uint16_t address){
+            if (coverCount[address] != 0)
+                InvalidateAddress(address);
+        }
+
+        void InvalidateAddress(uint16_t address);
+
+        // The whole memory changed (reset, program load)
+        void InvalidateAll();
+
+        // The blocks running through address are thrown away, the ones that stopped before it are rebuilt longer once it is cleared
+        void SetBreakpoint(uint16_t address, bool set);
+
+        bool IsBreakpoint(uint16_t address) const {
+            return (breakpoints[address >> 6] >> (address & 63)) & 1;
+        }
+
+        // Set by the MemoryBus before it drops every block
+        void SetDevicePage(int page, bool set){
+            uint64_t bit = uint64_t(1) << (page & 63);
+            devicePages[page >> 6] = set ? devicePages[page >> 6] | bit : devicePages[page >> 6] & ~bit;
+        }
+
+        bool IsDeviceAddress(uint16_t address) const {
+            int page = address >> BLOCK_PAGE_SHIFT;
+            return (devicePages[page >> 6] >> (page & 63)) & 1;
+        }
+
+        // Drops the native code of every block (the JIT arena is being recycled)
+        void ForgetJitCode();
+
+        bool HasRemovedBlocks() const {
+            return !removed.empty();
+        }
+
+        // Frees the blocks thrown away (no engine may be running them), their passes go to the counters first
+        void ReleaseRemovedBlocks();
+
+        // The whole block is about to run `passes` times. Only a counter bump here, the block's instructions are
+        // added to the performance counters and the heatmap's fetches by FlushPerfCounts() (a pass that stops early
+        // takes its tail back, CountBlock)
+        void CountPasses(DecodedBlock* block, uint64_t passes){
+#if !ORGAN16_PERF_COUNTERS
+            // Only the heatmap wants them
+            if (!heatmap.IsEnabled())
+                return;
+#endif
+            if (block->perfPasses == 0) {
+                // Code rewriting itself keeps listing new blocks, the list never outgrows the cache
+                if (perfPending.size() >= BLOCK_CACHE_SIZE)
+                    FoldPending();
+                perfPending.push_back(block->startPC);
+            }
+            block->perfPasses += passes;
+        }
+
+        // The instructions [first, last) of block ran `times` more times (uint64_t(-1) takes one run back)
+        void CountBlock(DecodedBlock& block, size_t first, size_t last, uint64_t times){
+            if (heatmap.IsEnabled() && times == ~static_cast<uint64_t>(0) && block.perfPasses != 0) {
+                TakeRunBack(&block, first, last);
+                return;
+            }
+            perfCounters.CountBlock(block, first, last, times);
+            if (heatmap.IsEnabled())
+                heatmap.CountBlock(block, first, last, times);
+        }
+
+        // The Jcc ending block was taken `taken` times (during passes counted by CountPasses)
+        void CountTaken(DecodedBlock* block, uint64_t taken){
+#if ORGAN16_PERF_COUNTERS
+            block->perfTaken += taken;
+#endif
+        }
+
+        // Adds every pending pass to the performance counters (before they are read)
+        void FlushPerfCounts();
+
+        uint64_t GetGeneration() const {
+            return generation;
+        }
+
+        // Read by the translated code to keep its inline stores away from decoded code
+        const uint16_t* GetCoverCounts() const {
+            return coverCount.data();
+        }
+};
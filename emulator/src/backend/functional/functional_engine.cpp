@@ -0,0 +1,638 @@
+#include "functional_engine.hpp"
+
+#include <algorithm>
+
+#include "../machine.hpp"
+
+// 7 bit index made of the OpCode and SubOpCode (the top 7 bits of IR0)
+#define OPCODE(op, sub) (((op) << 4) | (sub))
+
+// Every instruction handled by the engine : (handler label, OpCode, SubOpCode, half-ticks on the RTL model, length in words)
+#define FUNCTIONAL_OPCODES(X)         \
+    X(op_add,    0b000, 0,  2, 1)     \
+    X(op_sub,    0b000, 1,  2, 1)     \
+    X(op_mul,    0b000, 2,  2, 1)     \
+    X(op_div,    0b000, 3,  2, 1)     \
+    X(op_mod,    0b000, 4,  2, 1)     \
+    X(op_and,    0b000, 5,  2, 1)     \
+    X(op_or,     0b000, 6,  2, 1)     \
+    X(op_nand,   0b000, 7,  2, 1)     \
+    X(op_nor,    0b000, 8,  2, 1)     \
+    X(op_xor,    0b000, 9,  2, 1)     \
+    X(op_cmp,    0b001, 10, 2, 1)     \
+    X(op_not,    0b001, 11, 2, 1)     \
+    X(op_mov,    0b010, 0,  4, 2)     \
+    X(op_load,   0b011, 0,  4, 2)     \
+    X(op_store,  0b011, 1,  4, 2)     \
+    X(op_storer, 0b011, 2,  4, 1)     \
+    X(op_loadr,  0b011, 3,  4, 1)     \
+    X(op_jmp,    0b100, 0,  4, 2)     \
+    X(op_jcc,    0b100, 1,  4, 2)     \
+    X(op_jcc,    0b100, 2,  4, 2)     \
+    X(op_jcc,    0b100, 3,  4, 2)     \
+    X(op_jcc,    0b100, 4,  4, 2)     \
+    X(op_jcc,    0b100, 5,  4, 2)     \
+    X(op_jcc,    0b100, 6,  4, 2)     \
+    X(op_jcc,    0b100, 7,  4, 2)     \
+    X(op_jcc,    0b100, 8,  4, 2)     \
+    X(op_jcc,    0b100, 9,  4, 2)     \
+    X(op_jcc,    0b100, 10, 4, 2)     \
+    X(op_jsr,    0b100, 11, 6, 2)     \
+    X(op_rts,    0b100, 12, 4, 1)     \
+    X(op_push,   0b101, 0,  4, 1)     \
+    X(op_pop,    0b101, 1,  4, 1)     \
+    X(op_in,     0b111, 1,  2, 1)     \
+    X(op_in,     0b111, 2,  2, 1)     \
+    X(op_in,     0b111, 3,  2, 1)     \
+    X(op_out,    0b111, 4,  2, 1)     \
+    X(op_out,    0b111, 5,  2, 1)     \
+    X(op_out,    0b111, 6,  2, 1)     \
+    FUNCTIONAL_COUNTER_OPCODES(X)
+
+// IN3 reads the performance counters, it stays an undocumented encoding when they are compiled out
+#if ORGAN16_PERF_COUNTERS
+#define FUNCTIONAL_COUNTER_OPCODES(X) X(op_in_counters, 0b111, 7, 2, 1)
+#else
+#define FUNCTIONAL_COUNTER_OPCODES(X)
+#endif
+
+// Fused pairs : (handler label, FusionKind, first OpCode/SubOpCode range, second OpCode/SubOpCode range)
+#define FUNCTIONAL_FUSIONS(X)                                                       \
+    X(fused_cmp_jcc,     FUSION_CMP_JCC,    OPCODE(0b001, 10), OPCODE(0b001, 10), OPCODE(0b100, 1),  OPCODE(0b100, 10))  \
+    X(fused_mov_add,     FUSION_MOV_ADD,    OPCODE(0b010, 0),  OPCODE(0b010, 0),  OPCODE(0b000, 0),  OPCODE(0b000, 0))   \
+    X(fused_add_storer,  FUSION_ADD_STORER, OPCODE(0b000, 0),  OPCODE(0b000, 0),  OPCODE(0b011, 2),  OPCODE(0b011, 2))   \
+    X(fused_storer_add,  FUSION_STORER_ADD, OPCODE(0b011, 2),  OPCODE(0b011, 2),  OPCODE(0b000, 0),  OPCODE(0b000, 0))
+
+struct InstructionTable{
+    uint8_t halfTicks[128] = {0};
+    uint8_t length[128] = {0};
+
+    InstructionTable(){
+        #define FILL_TABLE(name, op, sub, ticks, words) halfTicks[OPCODE(op, sub)] = ticks; length[OPCODE(op, sub)] = words;
+        FUNCTIONAL_OPCODES(FILL_TABLE)
+        #undef FILL_TABLE
+    }
+};
+
+static const InstructionTable instructionTable;
+
+int FunctionalEngine::GetHalfTicks(uint16_t instruction)
+{
+    return instructionTable.halfTicks[instruction >> 9];
+}
+
+int FunctionalEngine::GetLength(uint16_t instruction)
+{
+    return instructionTable.length[instruction >> 9];
+}
+
+int FunctionalEngine::FindFusion(uint8_t firstIndex, uint8_t secondIndex)
+{
+    #define MATCH_FUSION(name, kind, firstMin, firstMax, secondMin, secondMax)        \
+        if (firstIndex >= (firstMin) && firstIndex <= (firstMax) &&                   \
+            secondIndex >= (secondMin) && secondIndex <= (secondMax))                 \
+            return kind;
+    FUNCTIONAL_FUSIONS(MATCH_FUSION)
+    #undef MATCH_FUSION
+    return -1;
+}
+
+const char* FunctionalEngine::GetFusionName(FusionKind kind)
+{
+    switch (kind) {
+        case FUSION_CMP_JCC:    return "CMP + Jcc";
+        case FUSION_MOV_ADD:    return "MOV + ADD";
+        case FUSION_ADD_STORER: return "ADD + STORER";
+        case FUSION_STORER_ADD: return "STORER + ADD";
+        default:                return "?";
+    }
+}
+
+int FunctionalEngine::GetDataAccess(uint16_t instruction, uint16_t ext, const uint16_t regs[8], uint16_t SP, uint16_t& address)
+{
+    uint16_t srcB = regs[instruction & 0b111];
+    switch (instruction >> 9) {
+        case OPCODE(0b011, 0): address = ext; return BUS_READ;                                  // LOAD
+        case OPCODE(0b011, 1): address = ext; return BUS_WRITE;                                 // STORE
+        case OPCODE(0b011, 2): address = srcB; return BUS_WRITE;                                // STORER
+        case OPCODE(0b011, 3): address = srcB; return BUS_READ;                                 // LOADR
+        case OPCODE(0b100, 11):                                                                 // JSR
+        case OPCODE(0b101, 0): address = SP; return BUS_WRITE;                                  // PUSH
+        case OPCODE(0b100, 12):                                                                 // RTS
+        case OPCODE(0b101, 1): address = static_cast<uint16_t>(SP + 1); return BUS_READ;        // POP
+        default: return 0;
+    }
+}
+
+bool FunctionalEngine::EndsBlock(uint16_t instruction)
+{
+    // JMP, Jcc, JSR and RTS all load PC
+    return (instruction >> 13) == 0b100;
+}
+
+// Same condition mux as the control unit (bit0 = Z, bit1 = N, bit2 = C, bit3 = O)
+static inline bool JumpCondition(uint8_t subOpCode, uint8_t flags)
+{
+    bool zero = flags & 0b0001;
+    bool negative = flags & 0b0010;
+    bool carry = flags & 0b0100;
+    bool overflow = flags & 0b1000;
+
+    switch (subOpCode) {
+        case 1:  return zero;
+        case 2:  return !zero;
+        case 3:  return carry;
+        case 4:  return zero | carry;
+        case 5:  return !(zero | carry);
+        case 6:  return !carry;
+        case 7:  return negative ^ overflow;
+        case 8:  return zero | (negative ^ overflow);
+        case 9:  return !(negative ^ overflow) & !zero;
+        case 10: return negative ^ overflow;
+        default: return false;
+    }
+}
+
+bool FunctionalEngine::IsJumpTaken(uint8_t subOpCode, uint8_t flags)
+{
+    return JumpCondition(subOpCode, flags);
+}
+
+uint64_t FunctionalEngine::Run(ArchState& state, uint64_t maxHalfTicks)
+{
+    MemoryBus* bus = &machine.bus;
+    uint16_t* memory = machine.ram.Data();
+    BusDevice* const* writers = bus->GetDataWriters();
+    bool dataReads = bus->HasDataReaders();
+    IOPorts* ioPorts = &machine.ioPorts;
+    BlockCache* blockCache = &machine.blockCache;
+    PerfCounters* perf = &machine.perfCounters;
+
+    uint16_t regs[8];
+    for (int i = 0; i < 8; ++i)
+        regs[i] = state.regs[i];
+    uint16_t pc = state.PC;
+    uint16_t sp = state.SP;
+    uint8_t flags = state.FLAGS;
+    uint16_t ir1 = state.IR1;
+    bool addrLatched = state.addrLatched;
+    bool rtsLatched = state.rtsLatched;
+
+    uint64_t consumed = 0;
+    uint64_t retired = 0;
+
+    // Block being executed, its instruction being executed, the next one and the end of the block
+    DecodedBlock* block = nullptr;
+    const DecodedInstruction* current = nullptr;
+    const DecodedInstruction* next = nullptr;
+    const DecodedInstruction* blockEnd = nullptr;
+    uint64_t generation = 0;
+
+    // Operands of the current instruction
+    #define DST (current->dst)
+    #define SRC_A (current->srcA)
+    #define SRC_B (current->srcB)
+    #define EXT (current->ext)
+    #define SUB_OPCODE (current->index & 0b1111)
+
+    // The block's pass was counted when it was entered (BlockCache::CountPasses) : leaving early takes back what did not run
+    #define UNCOUNT_REST() \
+        blockCache->CountBlock(*block, next - block->instructions.data(), block->instructions.size(), ~static_cast<uint64_t>(0))
+
+    // Stores go through the bus only for the pages a device writes (the framebuffer marks its rows dirty) or a tap hears.
+    // A store over decoded code drops the rest of the current block, the next fetch decodes it again. So does a tap
+    // asking for a stop (the engine returns before the next block)
+    #define STORE_WORD(address, value)                                                  \
+        do {                                                                            \
+            uint16_t storeAddress = (address);                                          \
+            if (writers[storeAddress >> BUS_PAGE_SHIFT] != nullptr)                     \
+                bus->WriteData(storeAddress, (value), pc);                              \
+            else {                                                                      \
+                memory[storeAddress] = (value);                                         \
+                blockCache->OnWrite(storeAddress);                                      \
+            }                                                                           \
+            if (blockCache->GetGeneration() != generation || bus->IsStopRequested()) {  \
+                UNCOUNT_REST();                                                         \
+                next = blockEnd;                                                        \
+            }                                                                           \
+        } while (0)
+
+    // Data reads only look the page up once a device reads or a tap listens somewhere. PEEK_WORD is a read the RTL
+    // model makes along with a write : the device answers, the taps don't hear it
+    #define LOAD_WORD(target, address)                                                  \
+        do {                                                                            \
+            if (dataReads) {                                                            \
+                target = bus->ReadData((address), pc);                                  \
+                if (bus->IsStopRequested()) {                                           \
+                    UNCOUNT_REST();                                                     \
+                    next = blockEnd;                                                    \
+                }                                                                       \
+            }                                                                           \
+            else                                                                        \
+                target = memory[address];                                               \
+        } while (0)
+    #define PEEK_WORD(address) (dataReads ? bus->Read(address) : memory[address])
+
+    // Fetch + budget check shared by every handler, a new block is looked up once the current one is done
+    #define FETCH()                                                                     \
+        if (next == blockEnd)                                                           \
+            goto next_block;                                                            \
+        if (consumed + next->halfTicks > maxHalfTicks)                                  \
+            goto out_of_budget;                                                         \
+        consumed += next->halfTicks;                                                    \
+        retired++;                                                                      \
+        current = next++;
+
+#if defined(__GNUC__)
+    // Threaded dispatch : every handler ends with its own fetch and indirect jump
+    void* handlers[FUSED_HANDLER_BASE + FUSION_COUNT];
+    for (int i = 0; i < FUSED_HANDLER_BASE + FUSION_COUNT; ++i)
+        handlers[i] = &&done;
+    #define REGISTER_HANDLER(name, op, sub, halfTicks, words) handlers[OPCODE(op, sub)] = &&name;
+    FUNCTIONAL_OPCODES(REGISTER_HANDLER)
+    #undef REGISTER_HANDLER
+    #define REGISTER_FUSED_HANDLER(name, kind, firstMin, firstMax, secondMin, secondMax) handlers[FUSED_HANDLER_BASE + kind] = &&name;
+    FUNCTIONAL_FUSIONS(REGISTER_FUSED_HANDLER)
+    #undef REGISTER_FUSED_HANDLER
+
+    #define HANDLER(name) name:
+    #define DISPATCH() do { FETCH() goto *handlers[current->handler]; } while (0)
+
+    goto next_block;
+#else
+    #define HANDLER(name) name:
+    #define DISPATCH() goto dispatch
+
+dispatch:
+    FETCH()
+    switch (current->handler) {
+        #define CASE_HANDLER(name, op, sub, halfTicks, words) case OPCODE(op, sub): goto name;
+        FUNCTIONAL_OPCODES(CASE_HANDLER)
+        #undef CASE_HANDLER
+        #define CASE_FUSED_HANDLER(name, kind, firstMin, firstMax, secondMin, secondMax) case FUSED_HANDLER_BASE + kind: goto name;
+        FUNCTIONAL_FUSIONS(CASE_FUSED_HANDLER)
+        #undef CASE_FUSED_HANDLER
+        default: goto done;
+    }
+#endif
+
+next_block:
+    for (;;) {
+        // A tap heard the last instruction's access
+        if (bus->IsStopRequested()) {
+            stopReason = STOP_REQUESTED;
+            goto done;
+        }
+
+        // Nothing runs the blocks thrown away anymore
+        if (blockCache->HasRemovedBlocks())
+            blockCache->ReleaseRemovedBlocks();
+
+        block = blockCache->GetBlock(pc, memory);
+        if (block == nullptr) {
+            stopReason = blockCache->IsBreakpoint(pc) ? STOP_BREAKPOINT
+                       : blockCache->IsDeviceAddress(pc) ? STOP_UNSUPPORTED
+                       : ((memory[pc] >> 9) == OPCODE(0b111, 0)) ? STOP_HALT : STOP_UNSUPPORTED;
+            goto done;
+        }
+
+        if (jitEnabled && !block->jitRejected) {
+            if (block->jitCode == nullptr && ++block->executions >= JIT_HOT_THRESHOLD)
+                machine.jitCompiler.Compile(block);
+
+            // Translated blocks run whole, the interpreter takes the ones that don't fit in the budget
+            if (block->jitCode != nullptr && consumed + block->halfTicks <= maxHalfTicks) {
+                JitContext context;
+                for (int i = 0; i < 8; ++i)
+                    context.regs[i] = regs[i];
+                context.PC = pc;
+                context.SP = sp;
+                context.IR1 = ir1;
+                context.FLAGS = flags;
+                context.addrLatched = addrLatched;
+                context.rtsLatched = rtsLatched;
+                context.mustLeave = 0;
+                context.budget = static_cast<uint32_t>(std::min<uint64_t>(maxHalfTicks - consumed, JIT_MAX_BUDGET));
+                context.halfTicks = 0;
+                context.instructions = 0;
+                context.machine = &machine;
+
+                block->jitCode(&context);
+
+                for (int i = 0; i < 8; ++i)
+                    regs[i] = context.regs[i];
+                pc = context.PC;
+                sp = context.SP;
+                ir1 = context.IR1;
+                flags = context.FLAGS;
+                addrLatched = context.addrLatched;
+                rtsLatched = context.rtsLatched;
+                consumed += context.halfTicks;
+                retired += context.instructions;
+                // Counted as whole passes (mostly a single one), the last one may have stopped early.
+                // Its stores can throw the block away, it stays readable until the next ReleaseRemovedBlocks()
+                size_t length = block->instructions.size();
+                uint64_t passes = 1;
+                size_t partial = 0;
+                if (context.instructions != length) {
+                    passes = context.instructions / length;
+                    partial = context.instructions % length;
+                }
+                blockCache->CountPasses(block, passes + (partial != 0));
+                if (partial != 0)
+                    blockCache->CountBlock(*block, partial, length, ~static_cast<uint64_t>(0));
+                // Only the last instruction can be a Jcc : every complete pass but the last one looped back
+                if (passes != 0 && PerfCounters::IsConditionalJump(block->instructions.back().index))
+                    blockCache->CountTaken(block, passes - 1 + (partial != 0 || addrLatched));
+                continue;
+            }
+        }
+
+        generation = blockCache->GetGeneration();
+        next = block->instructions.data();
+        blockEnd = next + block->instructions.size();
+        blockCache->CountPasses(block, 1);
+        break;
+    }
+    DISPATCH();
+
+    // ALU operations : with CURRENT_IS_ADDR_JSR left set, the destination is written on both edges
+    #define ALU_BODY(expression)                                                        \
+        do {                                                                            \
+            uint8_t dst = DST, srcA = SRC_A, srcB = SRC_B;                              \
+            uint16_t a = regs[srcA], b = regs[srcB];                                    \
+            regs[dst] = static_cast<uint16_t>(expression);                              \
+            if (addrLatched) {                                                          \
+                a = regs[srcA];                                                         \
+                b = regs[srcB];                                                         \
+                regs[dst] = static_cast<uint16_t>(expression);                          \
+            }                                                                           \
+            addrLatched = false;                                                        \
+            rtsLatched = false;                                                         \
+            pc++;                                                                       \
+        } while (0)
+
+    #define ALU_HANDLER(name, expression)                                               \
+    HANDLER(name) {                                                                     \
+        ALU_BODY(expression);                                                           \
+        DISPATCH();                                                                     \
+    }
+
+    ALU_HANDLER(op_add, a + b)
+    ALU_HANDLER(op_sub, a - b)
+    ALU_HANDLER(op_mul, static_cast<uint32_t>(a) * b)
+    ALU_HANDLER(op_div, b != 0 ? a / b : 0)
+    ALU_HANDLER(op_mod, b != 0 ? a % b : 0)
+    ALU_HANDLER(op_and, a & b)
+    ALU_HANDLER(op_or, a | b)
+    ALU_HANDLER(op_nand, !(a & b))
+    ALU_HANDLER(op_nor, !(a | b))
+    ALU_HANDLER(op_xor, a ^ b)
+
+    // NOT only has SRC_A
+    HANDLER(op_not) {
+        uint8_t dst = DST, srcA = SRC_A;
+        regs[dst] = static_cast<uint16_t>(~regs[srcA]);
+        if (addrLatched)
+            regs[dst] = static_cast<uint16_t>(~regs[srcA]);
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+    // Bodies shared by the plain and the fused handlers
+    #define CMP_BODY()                                                                  \
+        do {                                                                            \
+            uint16_t a = regs[SRC_A], b = regs[SRC_B];                                  \
+            uint16_t result = a - b;                                                    \
+            /* The ALU's overflow flag is never set (its MSB checks are truncated to 8 bits) */ \
+            flags = (result == 0) | (((result >> 15) & 1) << 1) | ((a < b) << 2);       \
+            addrLatched = false;                                                        \
+            rtsLatched = false;                                                         \
+            pc++;                                                                       \
+        } while (0)
+
+    #define MOV_BODY()                                                                  \
+        do {                                                                            \
+            ir1 = EXT;                                                                  \
+            regs[DST] = ir1;                                                            \
+            addrLatched = false;                                                        \
+            rtsLatched = false;                                                         \
+            pc += 2;                                                                    \
+        } while (0)
+
+    #define STORER_BODY()                                                               \
+        do {                                                                            \
+            perf->CountWrite(regs[SRC_B]);                                              \
+            STORE_WORD(regs[SRC_B], regs[SRC_A]);                                       \
+            addrLatched = false;                                                        \
+            rtsLatched = false;                                                         \
+            pc++;                                                                       \
+        } while (0)
+
+    #define JCC_BODY()                                                                  \
+        do {                                                                            \
+            ir1 = EXT;                                                                  \
+            addrLatched = JumpCondition(SUB_OPCODE, flags);                             \
+            blockCache->CountTaken(block, addrLatched);                                 \
+            pc = addrLatched ? ir1 : static_cast<uint16_t>(pc + 2);                     \
+            rtsLatched = false;                                                         \
+        } while (0)
+
+    #define ADD_BODY() ALU_BODY(a + b)
+
+    HANDLER(op_cmp) {
+        CMP_BODY();
+        DISPATCH();
+    }
+
+    HANDLER(op_mov) {
+        MOV_BODY();
+        DISPATCH();
+    }
+
+    HANDLER(op_load) {
+        LOAD_WORD(ir1, EXT);
+        regs[DST] = ir1;
+        addrLatched = true;
+        rtsLatched = false;
+        pc += 2;
+        DISPATCH();
+    }
+
+    HANDLER(op_store) {
+        uint16_t address = EXT;
+        // IR1 ends up holding the word that was overwritten
+        ir1 = PEEK_WORD(address);
+        STORE_WORD(address, regs[SRC_A]);
+        addrLatched = true;
+        rtsLatched = false;
+        pc += 2;
+        DISPATCH();
+    }
+
+    HANDLER(op_storer) {
+        STORER_BODY();
+        DISPATCH();
+    }
+
+    HANDLER(op_loadr) {
+        perf->CountRead(regs[SRC_B]);
+        LOAD_WORD(regs[DST], regs[SRC_B]);
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+    HANDLER(op_jmp) {
+        ir1 = EXT;
+        pc = ir1;
+        addrLatched = true;
+        rtsLatched = false;
+        DISPATCH();
+    }
+
+    HANDLER(op_jcc) {
+        JCC_BODY();
+        DISPATCH();
+    }
+
+    // The target is read after the push : pushed over its own extension word, JSR jumps to the word written
+    // (plain RAM, decoded code never reaches into a reading device's page)
+    HANDLER(op_jsr) {
+        ir1 = EXT;
+        STORE_WORD(sp, static_cast<uint16_t>(pc + 2));
+        if (sp == static_cast<uint16_t>(pc + 1))
+            ir1 = memory[sp];
+        sp--;
+        pc = ir1;
+        addrLatched = true;
+        rtsLatched = false;
+        DISPATCH();
+    }
+
+    HANDLER(op_rts) {
+        sp++;
+        LOAD_WORD(ir1, sp);
+        pc = ir1;
+        addrLatched = false;
+        rtsLatched = true;
+        DISPATCH();
+    }
+
+    HANDLER(op_push) {
+        STORE_WORD(sp, regs[SRC_A]);
+        sp--;
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+    HANDLER(op_pop) {
+        sp++;
+        LOAD_WORD(ir1, sp);
+        regs[DST] = ir1;
+        addrLatched = true;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+    HANDLER(op_in) {
+        regs[DST] = ioPorts->GetIN(SUB_OPCODE - 1);
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+#if ORGAN16_PERF_COUNTERS
+    // SRC_A selects the counter word. Like the ALU results, the value is written on both edges while CURRENT_IS_ADDR_JSR is set.
+    // The instructions after this one were counted with the block's pass, they are left out while the guest reads.
+    // Reading flushes the block's passes : the pass is counted again for the rest of the block
+    HANDLER(op_in_counters) {
+        size_t rest = next - block->instructions.data();
+        UNCOUNT_REST();
+        const PerfCounters& counters = machine.ReadPerfCounters();
+        regs[DST] = counters.ReadPort(regs[SRC_A]);
+        if (addrLatched)
+            regs[DST] = counters.ReadPort(regs[SRC_A]);
+        blockCache->CountPasses(block, 1);
+        blockCache->CountBlock(*block, 0, rest, ~static_cast<uint64_t>(0));
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+#endif
+
+    HANDLER(op_out) {
+        ioPorts->SetOUT(SUB_OPCODE - 4, regs[SRC_A]);
+        addrLatched = false;
+        rtsLatched = false;
+        pc++;
+        DISPATCH();
+    }
+
+    // Fused pairs : one dispatch for both instructions. The second one only runs here when it still fits
+    // in the budget and the first one left the block alone, otherwise the regular fetch takes over exactly
+    // where the unfused code would have stopped
+    #define FUSED_HANDLER(name, kind, FIRST, SECOND)                                    \
+    HANDLER(name) {                                                                     \
+        FIRST();                                                                        \
+        if (next != blockEnd && consumed + next->halfTicks <= maxHalfTicks) {           \
+            consumed += next->halfTicks;                                                \
+            retired++;                                                                  \
+            current = next++;                                                           \
+            SECOND();                                                                   \
+            fusionCounts[kind]++;                                                       \
+        }                                                                               \
+        DISPATCH();                                                                     \
+    }
+
+    FUSED_HANDLER(fused_cmp_jcc, FUSION_CMP_JCC, CMP_BODY, JCC_BODY)
+    FUSED_HANDLER(fused_mov_add, FUSION_MOV_ADD, MOV_BODY, ADD_BODY)
+    FUSED_HANDLER(fused_add_storer, FUSION_ADD_STORER, ADD_BODY, STORER_BODY)
+    FUSED_HANDLER(fused_storer_add, FUSION_STORER_ADD, STORER_BODY, ADD_BODY)
+
+out_of_budget:
+    UNCOUNT_REST();
+    stopReason = STOP_BUDGET;
+
+done:
+    #undef FUSED_HANDLER
+    #undef CMP_BODY
+    #undef MOV_BODY
+    #undef ADD_BODY
+    #undef STORER_BODY
+    #undef JCC_BODY
+    #undef ALU_HANDLER
+    #undef ALU_BODY
+    #undef HANDLER
+    #undef DISPATCH
+    #undef FETCH
+    #undef STORE_WORD
+    #undef LOAD_WORD
+    #undef PEEK_WORD
+    #undef UNCOUNT_REST
+    #undef SUB_OPCODE
+    #undef EXT
+    #undef SRC_B
+    #undef SRC_A
+    #undef DST
+
+    for (int i = 0; i < 8; ++i)
+        state.regs[i] = regs[i];
+    state.PC = pc;
+    state.SP = sp;
+    state.FLAGS = flags;
+    state.IR1 = ir1;
+    state.addrLatched = addrLatched;
+    state.rtsLatched = rtsLatched;
+
+    instructionCount += retired;
+    return consumed;
+}
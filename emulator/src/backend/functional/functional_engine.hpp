@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "../memory/ram.hpp"
+#include "../memory/memory_bus.hpp"
+#include "../io/io_ports.hpp"
+#include "block_cache.hpp"
+
+class Machine;
+
+// Architectural state of the CPU between two instructions.
+// This is everything the RTL model keeps alive across an instruction boundary.
+struct ArchState{
+    uint16_t regs[8] = {0};
+    uint16_t PC = 0;
+    uint16_t SP = 0xFFFF;
+    uint8_t FLAGS = 0;
+
+    // Last extension word latched by IR1 (RAM_ADDRESS always mirrors it at a boundary)
+    uint16_t IR1 = 0;
+
+    // CURRENT_IS_ADDR_JSR is still set after LOAD, STORE, POP, JMP, taken Jcc and JSR.
+    // While set, the next ALU instruction writes its destination on both clock edges (so it is applied twice)
+    bool addrLatched = false;
+
+    // CURRENTLY_RTS is still set after RTS (no effect, only shown in the debug panel)
+    bool rtsLatched = false;
+};
+
+enum FunctionalStopReason{
+    STOP_BUDGET,      // The next instruction does not fit in the remaining half-ticks
+    STOP_HALT,        // PC points to a HLT
+    STOP_UNSUPPORTED, // PC points to an undocumented encoding, the RTL model has to execute it
+    STOP_BREAKPOINT,  // PC points to a breakpoint (BlockCache::SetBreakpoint), the Debugger decides whether to go on
+    STOP_REQUESTED    // A bus tap heard the last instruction's access (MemoryBus::RequestStop), the Debugger checks its watches
+};
+
+// Instruction pairs executed by a single dispatch
+enum FusionKind{
+    FUSION_CMP_JCC,     // CMP then any conditional jump
+    FUSION_MOV_ADD,     // MOV immediate then ADD (a base address plus an index)
+    FUSION_ADD_STORER,  // Pixel address computed then stored to
+    FUSION_STORER_ADD,  // Store then move the pointer on (fill loops)
+    FUSION_COUNT
+};
+
+// DecodedInstruction::handler of a fused pair's first instruction (plain instructions use their 7 bit index)
+static const int FUSED_HANDLER_BASE = 128;
+
+// Instruction level engine : executes one Organ16 instruction per dispatch from pre-decoded blocks (BlockCache),
+// reproducing the RTL model's results and half-tick counts.
+class FunctionalEngine{
+    private:
+        Machine& machine;
+
+        FunctionalStopReason stopReason = STOP_BUDGET;
+
+        // Hot blocks are translated to native code (JitCompiler)
+        bool jitEnabled = false;
+
+        // Times each fused pair ran as one dispatch
+        std::array<uint64_t, FUSION_COUNT> fusionCounts{};
+
+        // Instructions executed here (interpreted or translated), the ones left to the RTL model are not counted
+        uint64_t instructionCount = 0;
+
+    public:
+        explicit FunctionalEngine(Machine& machine) : machine(machine) {}
+
+        FunctionalEngine(const FunctionalEngine&) = delete;
+        FunctionalEngine& operator=(const FunctionalEngine&) = delete;
+        FunctionalEngine(FunctionalEngine&&) = delete;
+        FunctionalEngine& operator=(FunctionalEngine&&) = delete;
+
+        // Executes whole instructions on state while they fit in maxHalfTicks.
+        // Returns the number of half-ticks consumed, GetStopReason() tells why it returned
+        uint64_t Run(ArchState& state, uint64_t maxHalfTicks);
+
+        void SetJitEnabled(bool enabled){
+            jitEnabled = enabled && JitCompiler::IsSupported();
+        }
+
+        bool IsJitEnabled() const {
+            return jitEnabled;
+        }
+
+        FunctionalStopReason GetStopReason() const {
+            return stopReason;
+        }
+
+        // Half-ticks the RTL model spends on the instruction word (0 if it is not handled here)
+        static int GetHalfTicks(uint16_t instruction);
+
+        // Words taken by the instruction (2 when it has an extension word)
+        static int GetLength(uint16_t instruction);
+
+        // BUS_READ / BUS_WRITE of the data word the instruction accesses (in address), from its extension word and the
+        // registers before it runs. 0 without a data access (fetches aside). Watches and the heatmap see the RTL model's
+        // instructions through it
+        static int GetDataAccess(uint16_t instruction, uint16_t ext, const uint16_t regs[8], uint16_t SP, uint16_t& address);
+
+        // True for the instructions that load PC (a decoded block stops after them)
+        static bool EndsBlock(uint16_t instruction);
+
+        // True when the Jcc with this SubOpCode is taken with these FLAGS
+        static bool IsJumpTaken(uint8_t subOpCode, uint8_t flags);
+
+        // FusionKind of the pair made of two 7 bit instruction indexes, -1 if they don't fuse
+        static int FindFusion(uint8_t firstIndex, uint8_t secondIndex);
+
+        static const char* GetFusionName(FusionKind kind);
+
+        uint64_t GetFusionCount(FusionKind kind) const {
+            return fusionCounts[kind];
+        }
+
+        void ResetFusionCounts(){
+            fusionCounts.fill(0);
+        }
+
+        uint64_t GetInstructionCount() const {
+            return instructionCount;
+        }
+
+        void ResetInstructionCount(){
+            instructionCount = 0;
+        }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+static const int IO_PORT_COUNT = 3;
+
+// Hardware wired to an output port (bit banged peripherals)
+class IOPortListener{
+    public:
+        virtual ~IOPortListener() = default;
+
+        // The CPU drove a new value on the port (OUT instructions), previous is the one it replaces
+        virtual void OnOUT(int portIndex, uint16_t previous, uint16_t data) = 0;
+};
+
+// The three 16-bit IO ports (A, B, C) read by IN0-2 and driven by OUT0-2
+class IOPorts{
+    private:
+        std::array<uint16_t, IO_PORT_COUNT> ports{};
+
+        // nullptr : nothing wired
+        std::array<IOPortListener*, IO_PORT_COUNT> listeners{};
+
+    public:
+        IOPorts() = default;
+
+        IOPorts(const IOPorts&) = delete;
+        IOPorts& operator=(const IOPorts&) = delete;
+        IOPorts(IOPorts&&) = delete;
+        IOPorts& operator=(IOPorts&&) = delete;
+
+        uint16_t GetIN(int portIndex) const {
+            return ports[portIndex];
+        }
+
+        // Driven by the CPU (OUT instructions). The RTL model drives it on every half-tick of the OUT, the listener
+        // only hears about changes
+        void SetOUT(int portIndex, uint16_t data){
+            uint16_t previous = ports[portIndex];
+            ports[portIndex] = data;
+            if (listeners[portIndex] != nullptr && previous != data)
+                listeners[portIndex]->OnOUT(portIndex, previous, data);
+        }
+
+        void SetListener(int portIndex, IOPortListener* listener){
+            listeners[portIndex] = listener;
+        }
+
+        // Driven from outside the CPU (GUI buttons, CLI stimulus)
+        void SetPortValue(int portIndex, uint16_t data){
+            ports[portIndex] = data;
+        }
+
+        void Reset(){
+            ports.fill(0);
+        }
+};
@@ -0,0 +1,366 @@
+#include "st7735s.hpp"
+
+#include <algorithm>
+
+static const uint32_t LCD_BLACK = 0xFF000000;
+
+// Saved state : the controller's words, then the panel image as runs of up to 256 equal pixels
+// ((length - 1) << 8 | red, green << 8 | blue)
+static const size_t LCD_STATE_WORDS = 33;
+static const int LCD_STATE_MAX_RUN = 256;
+
+// 6-bit channel -> 8-bit
+static inline uint32_t Widen(uint8_t channel)
+{
+    return static_cast<uint32_t>((channel << 2) | (channel >> 4));
+}
+
+St7735s::St7735s(RAM& ram, MemoryBus& bus, IOPorts& ioPorts)
+    : ram(ram), bus(bus), ioPorts(ioPorts), frame(LCD_WIDTH * LCD_HEIGHT, LCD_BLACK)
+{
+    ResetController();
+}
+
+bool St7735s::Attach(std::string& error)
+{
+    return bus.Map(this, LCD_START, LCD_END - 1, BUS_WRITE, error);
+}
+
+void St7735s::Write(uint16_t address, uint16_t data)
+{
+    ram.Write(address, data);
+    if (address == LCD_COMMAND)
+        WriteCommand(static_cast<uint8_t>(data));
+    else if (address == LCD_DATA)
+        WriteData(static_cast<uint8_t>(data));
+    else if (address >= LCD_PIXELS)
+        WritePixel(data);
+}
+
+void St7735s::Reset()
+{
+    std::fill(frame.begin(), frame.end(), LCD_BLACK);
+    ResetController();
+    shift = 0;
+    shiftBits = 0;
+    bytes = 0;
+    pixels = 0;
+    frames = 0;
+}
+
+void St7735s::SaveState(std::vector<uint16_t>& words) const
+{
+    words.push_back(command);
+    words.push_back(static_cast<uint16_t>(parameterCount));
+    words.insert(words.end(), parameters, parameters + 4);
+    words.push_back(columnStart);
+    words.push_back(columnEnd);
+    words.push_back(rowStart);
+    words.push_back(rowEnd);
+    words.push_back(column);
+    words.push_back(row);
+    words.push_back(madctl);
+    words.push_back(colmod);
+    words.push_back(static_cast<uint16_t>(sleeping | displayOn << 1 | inverted << 2));
+    words.insert(words.end(), pixelBytes, pixelBytes + 3);
+    words.push_back(static_cast<uint16_t>(pixelByteCount));
+    words.push_back(shift);
+    words.push_back(static_cast<uint16_t>(shiftBits));
+    PutStateCounter(words, bytes);
+    PutStateCounter(words, pixels);
+    PutStateCounter(words, frames);
+
+    for (size_t i = 0; i < frame.size();) {
+        size_t run = 1;
+        while (run < LCD_STATE_MAX_RUN && i + run < frame.size() && frame[i + run] == frame[i])
+            run++;
+        uint32_t pixel = frame[i];
+        words.push_back(static_cast<uint16_t>((run - 1) << 8 | ((pixel >> 16) & 0xFF)));
+        words.push_back(static_cast<uint16_t>(pixel));
+        i += run;
+    }
+}
+
+void St7735s::RestoreState(const std::vector<uint16_t>& words)
+{
+    // Counts a real controller can't be left with are taken for damage
+    if (words.size() < LCD_STATE_WORDS || (words.size() - LCD_STATE_WORDS) % 2 != 0 || words[1] > 5 || words[18] > 2
+        || words[20] > 7) {
+        Reset();
+        return;
+    }
+
+    std::vector<uint32_t> image;
+    image.reserve(frame.size());
+    for (size_t i = LCD_STATE_WORDS; i < words.size(); i += 2) {
+        size_t run = (words[i] >> 8) + 1;
+        if (image.size() + run > frame.size())
+            break;
+        image.insert(image.end(), run, LCD_BLACK | static_cast<uint32_t>(words[i] & 0xFF) << 16 | words[i + 1]);
+    }
+    if (image.size() != frame.size()) {
+        Reset();
+        return;
+    }
+    frame.swap(image);
+
+    command = static_cast<uint8_t>(words[0]);
+    parameterCount = words[1];
+    for (int i = 0; i < 4; ++i)
+        parameters[i] = static_cast<uint8_t>(words[2 + i]);
+    columnStart = words[6];
+    columnEnd = words[7];
+    rowStart = words[8];
+    rowEnd = words[9];
+    column = words[10];
+    row = words[11];
+    madctl = static_cast<uint8_t>(words[12]);
+    colmod = static_cast<uint8_t>(words[13]);
+    sleeping = words[14] & 1;
+    displayOn = (words[14] >> 1) & 1;
+    inverted = (words[14] >> 2) & 1;
+    for (int i = 0; i < 3; ++i)
+        pixelBytes[i] = static_cast<uint8_t>(words[15 + i]);
+    pixelByteCount = words[18];
+    shift = static_cast<uint8_t>(words[19]);
+    shiftBits = words[20];
+    bytes = GetStateCounter(&words[21]);
+    pixels = GetStateCounter(&words[25]);
+    frames = GetStateCounter(&words[29]);
+    MarkPanelDirty();
+}
+
+void St7735s::ResetController()
+{
+    command = LCD_NOP;
+    parameterCount = 0;
+    columnStart = 0;
+    columnEnd = LCD_WIDTH - 1;
+    rowStart = 0;
+    rowEnd = LCD_HEIGHT - 1;
+    column = 0;
+    row = 0;
+    madctl = 0;
+    colmod = LCD_COLMOD_18BIT;
+    sleeping = true;
+    displayOn = false;
+    inverted = false;
+    pixelByteCount = 0;
+    MarkPanelDirty();
+}
+
+void St7735s::SetSpiPort(int port)
+{
+    if (spiPort >= 0)
+        ioPorts.SetListener(spiPort, nullptr);
+    spiPort = port;
+    shift = 0;
+    shiftBits = 0;
+    if (spiPort >= 0)
+        ioPorts.SetListener(spiPort, this);
+}
+
+void St7735s::OnOUT(int, uint16_t previous, uint16_t data)
+{
+    // Held in reset
+    if (!(data & LCD_PIN_RESX)) {
+        if (previous & LCD_PIN_RESX)
+            ResetController();
+        shiftBits = 0;
+        return;
+    }
+
+    // Deselected : a byte in progress is dropped
+    if (data & LCD_PIN_CSX) {
+        shiftBits = 0;
+        return;
+    }
+
+    // SDA is sampled on SCL's rising edge, D/CX with the byte's last bit
+    if (!(previous & LCD_PIN_SCL) && (data & LCD_PIN_SCL)) {
+        shift = static_cast<uint8_t>((shift << 1) | (data & LCD_PIN_SDA));
+        if (++shiftBits == 8) {
+            shiftBits = 0;
+            if (data & LCD_PIN_DCX)
+                WriteData(shift);
+            else
+                WriteCommand(shift);
+        }
+    }
+}
+
+void St7735s::WriteCommand(uint8_t value)
+{
+    bytes++;
+    command = value;
+    parameterCount = 0;
+    pixelByteCount = 0;
+
+    switch (value) {
+        case LCD_SWRESET:
+            ResetController();
+            break;
+        case LCD_SLPIN:
+        case LCD_SLPOUT:
+            sleeping = value == LCD_SLPIN;
+            MarkPanelDirty();
+            break;
+        case LCD_INVOFF:
+        case LCD_INVON:
+            inverted = value == LCD_INVON;
+            MarkPanelDirty();
+            break;
+        case LCD_DISPOFF:
+        case LCD_DISPON:
+            displayOn = value == LCD_DISPON;
+            MarkPanelDirty();
+            break;
+        case LCD_RAMWR:
+            column = columnStart;
+            row = rowStart;
+            break;
+        default:
+            break;
+    }
+}
+
+void St7735s::WriteData(uint8_t value)
+{
+    bytes++;
+
+    switch (command) {
+        case LCD_CASET:
+        case LCD_RASET:
+            if (parameterCount < 4)
+                parameters[parameterCount++] = value;
+            if (parameterCount == 4) {
+                uint16_t start = static_cast<uint16_t>((parameters[0] << 8) | parameters[1]);
+                uint16_t end = static_cast<uint16_t>((parameters[2] << 8) | parameters[3]);
+                if (command == LCD_CASET) {
+                    columnStart = start;
+                    columnEnd = end;
+                }
+                else {
+                    rowStart = start;
+                    rowEnd = end;
+                }
+                parameterCount++;
+            }
+            break;
+
+        case LCD_MADCTL:
+            madctl = value;
+            break;
+
+        case LCD_COLMOD:
+            colmod = value & 0x07;
+            pixelByteCount = 0;
+            break;
+
+        case LCD_RAMWR:
+            pixelBytes[pixelByteCount++] = value;
+            if (colmod == LCD_COLMOD_16BIT) {
+                if (pixelByteCount == 2) {
+                    pixelByteCount = 0;
+                    StorePixel(pixelBytes[0] >> 3, ((pixelBytes[0] & 0x07) << 3) | (pixelBytes[1] >> 5), pixelBytes[1] & 0x1F);
+                }
+            }
+            else if (colmod == LCD_COLMOD_12BIT) {
+                // R1G1 B1R2 G2B2, 4-bit channels
+                if (pixelByteCount == 3) {
+                    pixelByteCount = 0;
+                    StorePixel((pixelBytes[0] >> 4) << 2, (pixelBytes[0] & 0x0F) << 2, (pixelBytes[1] >> 4) << 2);
+                    StorePixel((pixelBytes[1] & 0x0F) << 2, (pixelBytes[2] >> 4) << 2, (pixelBytes[2] & 0x0F) << 2);
+                }
+            }
+            else if (pixelByteCount == 3) {
+                // 18-bit (any other value too) : the 6 high bits of each byte
+                pixelByteCount = 0;
+                StorePixel(pixelBytes[0] >> 2, pixelBytes[1] >> 2, pixelBytes[2] >> 2);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void St7735s::WritePixel(uint16_t rgb565)
+{
+    if (command != LCD_RAMWR || colmod != LCD_COLMOD_16BIT || pixelByteCount != 0) {
+        WriteData(static_cast<uint8_t>(rgb565 >> 8));
+        WriteData(static_cast<uint8_t>(rgb565));
+        return;
+    }
+
+    bytes += 2;
+    StorePixel(rgb565 >> 11, (rgb565 >> 5) & 0x3F, rgb565 & 0x1F);
+}
+
+void St7735s::StorePixel(uint8_t red, uint8_t green, uint8_t blue)
+{
+    // Pixel formats narrower than 6 bits : RGB565's red and blue come in as 5 bits
+    if (colmod == LCD_COLMOD_16BIT) {
+        red = static_cast<uint8_t>((red << 1) | (red >> 4));
+        blue = static_cast<uint8_t>((blue << 1) | (blue >> 4));
+    }
+    else if (colmod == LCD_COLMOD_12BIT) {
+        red |= red >> 4;
+        green |= green >> 4;
+        blue |= blue >> 4;
+    }
+    if (madctl & LCD_MADCTL_BGR)
+        std::swap(red, blue);
+
+    // MV exchanges the counters, MX / MY mirror them on the panel
+    int x = (madctl & LCD_MADCTL_MV) ? row : column;
+    int y = (madctl & LCD_MADCTL_MV) ? column : row;
+    if (madctl & LCD_MADCTL_MX)
+        x = LCD_WIDTH - 1 - x;
+    if (madctl & LCD_MADCTL_MY)
+        y = LCD_HEIGHT - 1 - y;
+
+    // The controller's memory is a bit larger than the panel (132x162) : what falls outside is not shown
+    if (x >= 0 && x < LCD_WIDTH && y >= 0 && y < LCD_HEIGHT) {
+        frame[y * LCD_WIDTH + x] = LCD_BLACK | (Widen(red) << 16) | (Widen(green) << 8) | Widen(blue);
+        MarkRowDirty(y);
+    }
+    pixels++;
+
+    if (column < columnEnd) {
+        column++;
+        return;
+    }
+    column = columnStart;
+    if (row < rowEnd) {
+        row++;
+        return;
+    }
+    row = rowStart;
+    frames++;
+}
+
+void St7735s::MarkPanelDirty()
+{
+    for (std::atomic<uint64_t>& rows : dirtyRows)
+        rows.store(~uint64_t(0), std::memory_order_release);
+}
+
+void St7735s::CopyRow(int panelRow, uint32_t* out) const
+{
+    if (sleeping || !displayOn) {
+        std::fill(out, out + LCD_WIDTH, LCD_BLACK);
+        return;
+    }
+
+    const uint32_t* pixelRow = frame.data() + panelRow * LCD_WIDTH;
+    uint32_t mask = inverted ? 0x00FFFFFF : 0;
+    for (int x = 0; x < LCD_WIDTH; ++x)
+        out[x] = pixelRow[x] ^ mask;
+}
+
+void St7735s::TakeDirtyRows(uint64_t rows[LCD_DIRTY_WORDS])
+{
+    for (int i = 0; i < LCD_DIRTY_WORDS; ++i)
+        rows[i] = dirtyRows[i].exchange(0, std::memory_order_acquire);
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "io_ports.hpp"
+#include "../memory/memory_bus.hpp"
+
+// ER-TFT018A3-2 panel : an ST7735S driving 128x160 pixels
+static const int LCD_WIDTH = 128;
+static const int LCD_HEIGHT = 160;
+
+// Dirty panel rows, one bit per row
+static const int LCD_DIRTY_WORDS = (LCD_HEIGHT + 63) / 64;
+
+// Transaction level interface : one memory mapped page, the device only takes the writes
+static const uint16_t LCD_START = 0xEE00;
+static const uint16_t LCD_END = 0xEF00;
+static const uint16_t LCD_COMMAND = 0xEE00;    // Low byte : command (D/CX low)
+static const uint16_t LCD_DATA = 0xEE01;       // Low byte : parameter or pixel byte (D/CX high)
+static const uint16_t LCD_PIXELS = 0xEE80;     // Up to LCD_END : each word is one RGB565 pixel, a blitter row streams into it
+
+// Bit level interface : the controller's pins on an OUT port (SPI mode 0, MSB first)
+static const uint16_t LCD_PIN_SDA = 0x0001;
+static const uint16_t LCD_PIN_SCL = 0x0002;
+static const uint16_t LCD_PIN_DCX = 0x0004;
+static const uint16_t LCD_PIN_CSX = 0x0008;    // Active low
+static const uint16_t LCD_PIN_RESX = 0x0010;   // Active low
+
+// The commands the model acts on, the others are taken with their parameters and ignored
+enum LcdCommand : uint8_t{
+    LCD_NOP = 0x00,
+    LCD_SWRESET = 0x01,
+    LCD_SLPIN = 0x10,
+    LCD_SLPOUT = 0x11,
+    LCD_INVOFF = 0x20,
+    LCD_INVON = 0x21,
+    LCD_DISPOFF = 0x28,
+    LCD_DISPON = 0x29,
+    LCD_CASET = 0x2A,
+    LCD_RASET = 0x2B,
+    LCD_RAMWR = 0x2C,
+    LCD_MADCTL = 0x36,
+    LCD_COLMOD = 0x3A
+};
+
+// MADCTL bits
+static const uint8_t LCD_MADCTL_MY = 0x80;
+static const uint8_t LCD_MADCTL_MX = 0x40;
+static const uint8_t LCD_MADCTL_MV = 0x20;
+static const uint8_t LCD_MADCTL_BGR = 0x08;
+
+// COLMOD interface pixel formats
+static const uint8_t LCD_COLMOD_12BIT = 0x03;     // RGB444, 3 bytes for 2 pixels
+static const uint8_t LCD_COLMOD_16BIT = 0x05;     // RGB565, 2 bytes per pixel
+static const uint8_t LCD_COLMOD_18BIT = 0x06;     // RGB666, 3 bytes per pixel (reset value)
+
+// Display controller model : frame memory, CASET / RASET window, RAMWR cursor, MADCTL orientation, COLMOD formats,
+// sleep / display on / inversion. The program drives it either through the memory mapped registers (a byte or a whole
+// pixel per store) or bit by bit on an OUT port, where the time it takes is the one the real wiring would take
+class St7735s : public BusDevice, public IOPortListener{
+    private:
+        RAM& ram;
+        MemoryBus& bus;
+        IOPorts& ioPorts;
+
+        // Frame memory as the panel shows it, 0xFFRRGGBB (the 6-bit channels widened to 8)
+        std::vector<uint32_t> frame;
+
+        uint8_t command = LCD_NOP;
+        int parameterCount = 0;
+        uint8_t parameters[4] = {};
+
+        // Window and RAMWR cursor, in MADCTL's (column, row) order
+        uint16_t columnStart = 0;
+        uint16_t columnEnd = 0;
+        uint16_t rowStart = 0;
+        uint16_t rowEnd = 0;
+        uint16_t column = 0;
+        uint16_t row = 0;
+
+        uint8_t madctl = 0;
+        uint8_t colmod = LCD_COLMOD_18BIT;
+        bool sleeping = true;
+        bool displayOn = false;
+        bool inverted = false;
+
+        // Bytes of the pixel (or pixel pair in 12-bit mode) being received
+        uint8_t pixelBytes[3] = {};
+        int pixelByteCount = 0;
+
+        // Bit level interface, -1 while it is off
+        int spiPort = -1;
+        uint8_t shift = 0;
+        int shiftBits = 0;
+
+        uint64_t bytes = 0;
+        uint64_t pixels = 0;
+        uint64_t frames = 0;
+
+        // Panel rows changed since the display last took them (bit y of word y / 64).
+        // Set by the thread running the Machine, cleared by the one presenting the panel
+        std::atomic<uint64_t> dirtyRows[LCD_DIRTY_WORDS]{};
+
+        void MarkRowDirty(int panelRow){
+            std::atomic<uint64_t>& rows = dirtyRows[panelRow >> 6];
+            uint64_t bit = uint64_t(1) << (panelRow & 63);
+            if (!(rows.load(std::memory_order_relaxed) & bit))
+                rows.fetch_or(bit, std::memory_order_release);
+        }
+
+        void MarkPanelDirty();
+
+        // Power-on / RESX / SWRESET values (the frame memory is kept)
+        void ResetController();
+
+        void WriteCommand(uint8_t value);
+        void WriteData(uint8_t value);
+
+        // RAMWR with a whole RGB565 pixel at once : straight into the frame memory when nothing is half received
+        void WritePixel(uint16_t rgb565);
+
+        // Channels are 6-bit, stores at the cursor then moves it along the window
+        void StorePixel(uint8_t red, uint8_t green, uint8_t blue);
+
+    public:
+        St7735s(RAM& ram, MemoryBus& bus, IOPorts& ioPorts);
+
+        St7735s(const St7735s&) = delete;
+        St7735s& operator=(const St7735s&) = delete;
+        St7735s(St7735s&&) = delete;
+        St7735s& operator=(St7735s&&) = delete;
+
+        // Maps the register page (writes only)
+        bool Attach(std::string& error);
+
+        uint16_t Read(uint16_t address) override {
+            return ram.Data()[address];
+        }
+
+        void Write(uint16_t address, uint16_t data) override;
+
+        // The CPU's reset is wired to RESX, the frame memory goes black
+        void Reset() override;
+
+        // Controller registers, window and cursor, the byte half shifted in on the SPI port, the counters and the panel
+        // image (runs of equal pixels). The SPI port wiring is not part of it
+        void SaveState(std::vector<uint16_t>& words) const override;
+
+        void RestoreState(const std::vector<uint16_t>& words) override;
+
+        // Pins changed on the SPI port
+        void OnOUT(int portIndex, uint16_t previous, uint16_t data) override;
+
+        // Drives the controller from the pins on port (see LCD_PIN_*) on top of the memory mapped registers.
+        // -1 detaches it from the ports
+        void SetSpiPort(int port);
+
+        int GetSpiPort() const {
+            return spiPort;
+        }
+
+        // A panel row as it shows (blank while asleep or off, inverted colors), LCD_WIDTH pixels 0xFFRRGGBB
+        void CopyRow(int panelRow, uint32_t* out) const;
+
+        // Rows changed since the last call (bit y of rows[y / 64]), clears them
+        void TakeDirtyRows(uint64_t rows[LCD_DIRTY_WORDS]);
+
+        // Bytes received (commands, parameters, pixels) since the last reset, 8 SCL cycles each on the real link
+        uint64_t GetBytes() const {
+            return bytes;
+        }
+
+        uint64_t GetPixels() const {
+            return pixels;
+        }
+
+        // RAMWR windows filled up to their last pixel
+        uint64_t GetFrames() const {
+            return frames;
+        }
+};
@@ -0,0 +1,790 @@
+#include "jit_compiler.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "x86_emitter.hpp"
+#include "../functional/functional_engine.hpp"
+#include "../control_unit/control_unit.hpp"
+#include "../machine.hpp"
+
+#if ORGAN16_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if ORGAN16_JIT_SUPPORTED
+
+#define OPCODE(op, sub) (((op) << 4) | (sub))
+#define CONTEXT_FIELD(field) static_cast<int32_t>(offsetof(JitContext, field))
+
+// Stores the generated code can't do inline (devices, taps, decoded code) : same path as the interpreter's stores.
+// pc : the storing instruction
+static void JitStore(JitContext* context, uint32_t address, uint32_t value, uint32_t pc)
+{
+    BlockCache& blockCache = context->machine->blockCache;
+    MemoryBus& bus = context->machine->bus;
+    uint64_t generation = blockCache.GetGeneration();
+    uint16_t storeAddress = static_cast<uint16_t>(address);
+
+    if (bus.GetDataWriter(storeAddress) != nullptr)
+        bus.WriteData(storeAddress, static_cast<uint16_t>(value), static_cast<uint16_t>(pc));
+    else {
+        context->machine->ram.Data()[storeAddress] = static_cast<uint16_t>(value);
+        blockCache.OnWrite(storeAddress);
+    }
+
+    if (blockCache.GetGeneration() != generation || bus.IsStopRequested())
+        context->mustLeave = 1;
+}
+
+// Reads from a device's or a tapped page
+static uint32_t JitLoad(JitContext* context, uint32_t address, uint32_t pc)
+{
+    MemoryBus& bus = context->machine->bus;
+    uint16_t value = bus.ReadData(static_cast<uint16_t>(address), static_cast<uint16_t>(pc));
+    if (bus.IsStopRequested())
+        context->mustLeave = 1;
+    return value;
+}
+
+// STORE's read of the word it overwrites : the device answers, the taps don't hear it
+static uint32_t JitPeek(JitContext* context, uint32_t address, uint32_t)
+{
+    return context->machine->bus.Read(static_cast<uint16_t>(address));
+}
+
+// Guest register -> host register
+static inline int HostRegister(int guestRegister)
+{
+    return R8 + guestRegister;
+}
+
+// Where the block leaves and what the interpreter has to see at that point
+struct JitExit{
+    bool pcInRax = false;   // RTS : the return address was just popped in AX
+    uint16_t PC = 0;
+    bool addrLatched = false;
+    bool rtsLatched = false;
+    uint32_t halfTicks = 0;
+    uint32_t instructions = 0;
+    bool flagsPending = false;
+};
+
+// Host registers the block touches : only those are loaded, stored back and preserved
+struct JitFrame{
+    uint8_t usedRegisters = 0;      // Guest registers read or written (loaded on entry)
+    uint8_t writtenRegisters = 0;   // Guest registers written (stored back on every exit)
+    bool usesSP = false;
+    bool usesFlags = false;         // A CMP keeps its operands in ESI / ECX
+    std::vector<int> calleeSaved;   // Pushed by the prologue
+    std::vector<int> callerSaved;   // Kept across the helper calls
+};
+
+// Keeps RSP 16-byte aligned at the helper calls : on entry it is 8 past a boundary (return address)
+static uint8_t FramePadding(const JitFrame& frame)
+{
+    return frame.calleeSaved.size() % 2 == 0 ? 8 : 0;
+}
+
+// FLAGS from the last CMP's operands : Z, N and C of the same subtraction (the ALU never sets O)
+static void EmitMaterializeFlags(X86Emitter& e)
+{
+    e.Alu16(0x39, RSI, RCX);
+    e.Setcc(CC_B, RAX);
+    e.Movzx8(RAX, RAX);
+    e.ShlImm32(RAX, 2);
+    e.Alu16(0x39, RSI, RCX);
+    e.Setcc(CC_S, RDX);
+    e.Movzx8(RDX, RDX);
+    e.Alu32(0x01, RDX, RDX);
+    e.Alu32(0x09, RAX, RDX);
+    e.Alu16(0x39, RSI, RCX);
+    e.Setcc(CC_E, RDX);
+    e.Movzx8(RDX, RDX);
+    e.Alu32(0x09, RAX, RDX);
+    e.StoreByte(RDI, -1, CONTEXT_FIELD(FLAGS), RAX);
+}
+
+static void EmitExit(X86Emitter& e, const JitFrame& frame, const JitExit& exit)
+{
+    if (exit.pcInRax)
+        e.StoreWord(RDI, -1, CONTEXT_FIELD(PC), RAX);
+    else
+        e.StoreWordImm(RDI, -1, CONTEXT_FIELD(PC), exit.PC);
+
+    for (int i = 0; i < 8; ++i) {
+        if ((frame.writtenRegisters >> i) & 1)
+            e.StoreWord(RDI, -1, CONTEXT_FIELD(regs) + 2 * i, HostRegister(i));
+    }
+    if (frame.usesSP)
+        e.StoreWord(RDI, -1, CONTEXT_FIELD(SP), RBX);
+
+    if (exit.flagsPending)
+        EmitMaterializeFlags(e);
+
+    e.StoreByteImm(RDI, -1, CONTEXT_FIELD(addrLatched), exit.addrLatched);
+    e.StoreByteImm(RDI, -1, CONTEXT_FIELD(rtsLatched), exit.rtsLatched);
+
+    // On top of the iterations already looped through
+    e.AddDwordImm(RDI, -1, CONTEXT_FIELD(halfTicks), exit.halfTicks);
+    e.AddDwordImm(RDI, -1, CONTEXT_FIELD(instructions), exit.instructions);
+
+    if (FramePadding(frame) != 0)
+        e.AddRsp(FramePadding(frame));
+    for (size_t i = frame.calleeSaved.size(); i-- > 0;)
+        e.Pop(frame.calleeSaved[i]);
+    e.Ret();
+}
+
+// What every branch of the block needs to know to loop back to its start
+struct JitLoop{
+    uint16_t startPC = 0;
+    size_t head = 0;            // Code position right after the prologue
+    uint32_t halfTicks = 0;     // One iteration
+    bool flagsAtHead = false;   // FLAGS must be rebuilt before looping (a store may leave before the block's CMP)
+};
+
+// Taken branch : back to the block's start when it fits in the budget, else out
+static void EmitTakenBranch(X86Emitter& e, const JitFrame& frame, const JitLoop& loop, const JitExit& taken)
+{
+    if (taken.pcInRax || taken.PC != loop.startPC) {
+        EmitExit(e, frame, taken);
+        return;
+    }
+
+    e.AddDwordImm(RDI, -1, CONTEXT_FIELD(halfTicks), taken.halfTicks);
+    e.AddDwordImm(RDI, -1, CONTEXT_FIELD(instructions), taken.instructions);
+    e.LoadDword(RAX, RDI, -1, CONTEXT_FIELD(halfTicks));
+    e.AluImm32(0, RAX, loop.halfTicks);
+    e.CmpDword(RAX, RDI, -1, CONTEXT_FIELD(budget));
+    size_t outOfBudget = e.Jcc(CC_A);
+    if (loop.flagsAtHead && taken.flagsPending)
+        EmitMaterializeFlags(e);
+    e.StoreByteImm(RDI, -1, CONTEXT_FIELD(addrLatched), taken.addrLatched);
+    e.JmpTo(loop.head);
+
+    e.Bind(outOfBudget);
+    JitExit exit = taken;
+    exit.halfTicks = 0;
+    exit.instructions = 0;
+    EmitExit(e, frame, exit);
+}
+
+// Pushes the caller-saved registers the block keeps live around a helper call
+static void EmitSaveForCall(X86Emitter& e, const JitFrame& frame)
+{
+    for (int reg : frame.callerSaved)
+        e.Push(reg);
+    if (frame.callerSaved.size() % 2 != 0)
+        e.SubRsp(8);
+}
+
+static void EmitRestoreAfterCall(X86Emitter& e, const JitFrame& frame)
+{
+    if (frame.callerSaved.size() % 2 != 0)
+        e.AddRsp(8);
+    for (size_t i = frame.callerSaved.size(); i-- > 0;)
+        e.Pop(frame.callerSaved[i]);
+}
+
+// Calls JitStore(context, EAX, value, pc)
+static void EmitStoreHelperCall(X86Emitter& e, const JitFrame& frame, int valueRegister, uint16_t valueImmediate, uint16_t pc)
+{
+    EmitSaveForCall(e, frame);
+    e.Mov32(RSI, RAX);
+    if (valueRegister >= 0)
+        e.Mov32(RDX, valueRegister);
+    else
+        e.MovImm32(RDX, valueImmediate);
+    e.MovImm32(RCX, pc);
+    e.MovImm64(RAX, reinterpret_cast<uint64_t>(&JitStore));
+    e.Call(RAX);
+    EmitRestoreAfterCall(e, frame);
+}
+
+// EAX = helper(context, EAX, pc) (JitLoad or JitPeek)
+static void EmitLoadHelperCall(X86Emitter& e, const JitFrame& frame, uint32_t (*helper)(JitContext*, uint32_t, uint32_t), uint16_t pc)
+{
+    EmitSaveForCall(e, frame);
+    e.Mov32(RSI, RAX);
+    e.MovImm32(RDX, pc);
+    e.MovImm64(RAX, reinterpret_cast<uint64_t>(helper));
+    e.Call(RAX);
+    EmitRestoreAfterCall(e, frame);
+}
+
+// Displacement of a Machine member from RAM's base (RBP), the Machine holds both
+static int32_t MachineOffset(const uint16_t* memory, const void* member)
+{
+    return static_cast<int32_t>(reinterpret_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(memory));
+}
+
+// Compares the page table entry of the address in addressRegister with nullptr
+static void EmitCheckDevicePage(X86Emitter& e, const uint16_t* memory, BusDevice* const* table, int addressRegister)
+{
+    // Page * 4, which the operand's scale of 2 turns into the offset of a pointer
+    e.Mov32(RDX, addressRegister);
+    e.ShrImm32(RDX, BUS_PAGE_SHIFT - 2);
+    e.AluImm32(4, RDX, (BUS_PAGE_COUNT - 1) << 2);
+    e.CmpQwordImm8(RBP, RDX, MachineOffset(memory, table), 0);
+}
+
+// dst = word at EAX, through JitLoad when the page has a reading device or a tap (looked up only once the bus has some)
+static void EmitLoad(X86Emitter& e, const JitFrame& frame, const uint16_t* memory, const MemoryBus& bus, int dst, uint16_t pc)
+{
+    if (!bus.HasDataReaders()) {
+        e.LoadWord(dst, RBP, RAX, 0);
+        return;
+    }
+
+    EmitCheckDevicePage(e, memory, bus.GetDataReaders(), RAX);
+    size_t device = e.Jcc(CC_NE);
+    e.LoadWord(dst, RBP, RAX, 0);
+    size_t done = e.Jmp();
+    e.Bind(device);
+    EmitLoadHelperCall(e, frame, &JitLoad, pc);
+    e.Mov32(dst, RAX);
+    e.Bind(done);
+}
+
+// Constant address load, the data table is looked up at translation time. peek : STORE's read of the word it
+// overwrites (the device table only, JitPeek)
+static void EmitLoadConstant(X86Emitter& e, const JitFrame& frame, const MemoryBus& bus, uint16_t address, int dst, uint16_t pc, bool peek = false)
+{
+    if ((peek ? bus.GetReader(address) : bus.GetDataReader(address)) != nullptr) {
+        e.MovImm32(RAX, address);
+        EmitLoadHelperCall(e, frame, peek ? &JitPeek : &JitLoad, pc);
+        e.Mov32(dst, RAX);
+    }
+    else
+        e.LoadWord(dst, RBP, -1, address * 2);
+}
+
+// Word store : inline when the target is plain memory, through JitStore for devices, taps and decoded code.
+// With constantAddress the target is address, otherwise it is in EAX
+static void EmitStore(X86Emitter& e, const JitFrame& frame, const uint16_t* memory, const MemoryBus& bus, const uint16_t* coverCount, bool constantAddress,
+                      uint16_t address, int valueRegister, uint16_t valueImmediate, uint16_t pc)
+{
+    auto storeInline = [&](int index, int32_t disp) {
+        if (valueRegister >= 0)
+            e.StoreWord(RBP, index, disp, valueRegister);
+        else
+            e.StoreWordImm(RBP, index, disp, valueImmediate);
+    };
+
+    if (constantAddress) {
+        if (bus.GetDataWriter(address) != nullptr) {
+            e.MovImm32(RAX, address);
+            EmitStoreHelperCall(e, frame, valueRegister, valueImmediate, pc);
+            return;
+        }
+        e.MovImm64(RDX, reinterpret_cast<uint64_t>(&coverCount[address]));
+        e.CmpWordImm8(RDX, -1, 0, 0);
+        size_t slow = e.Jcc(CC_NE);
+        storeInline(-1, address * 2);
+        size_t done = e.Jmp();
+        e.Bind(slow);
+        e.MovImm32(RAX, address);
+        EmitStoreHelperCall(e, frame, valueRegister, valueImmediate, pc);
+        e.Bind(done);
+        return;
+    }
+
+    EmitCheckDevicePage(e, memory, bus.GetDataWriters(), RAX);
+    size_t device = e.Jcc(CC_NE);
+    e.MovImm64(RDX, reinterpret_cast<uint64_t>(coverCount));
+    e.CmpWordImm8(RDX, RAX, 0, 0);
+    size_t code = e.Jcc(CC_NE);
+    storeInline(RAX, 0);
+    size_t done = e.Jmp();
+    e.Bind(device);
+    e.Bind(code);
+    EmitStoreHelperCall(e, frame, valueRegister, valueImmediate, pc);
+    e.Bind(done);
+}
+
+// pageCounters[address >> PERF_PAGE_SHIFT]++ for an access through a register (the rest is counted with the block's passes)
+static void EmitCountAccess(X86Emitter& e, const uint16_t* memory, const uint64_t* pageCounters, int addressRegister)
+{
+#if ORGAN16_PERF_COUNTERS
+    // Page * 4, which the operand's scale of 2 turns into the offset of a 64-bit counter
+    e.Mov32(RDX, addressRegister);
+    e.ShrImm32(RDX, PERF_PAGE_SHIFT - 2);
+    e.AluImm32(4, RDX, (PERF_PAGE_COUNT - 1) << 2);
+    e.AddQwordImm8(RBP, RDX, MachineOffset(memory, pageCounters), 1);
+#endif
+}
+
+// dst = a <op> b for the ALU instructions (OpCode 0 and NOT), always through AX
+static void EmitAlu(X86Emitter& e, uint8_t index, int dst, int a, int b)
+{
+    e.Mov32(RAX, a);
+    switch (index) {
+        case OPCODE(0b000, 0): e.Alu16(0x01, RAX, b); break;
+        case OPCODE(0b000, 1): e.Alu16(0x29, RAX, b); break;
+        case OPCODE(0b000, 2): e.Imul16(RAX, b); break;
+        case OPCODE(0b000, 3):
+        case OPCODE(0b000, 4): {
+            // Division by 0 gives 0
+            e.Alu32(0x31, RDX, RDX);
+            e.Alu16(0x85, b, b);
+            size_t zero = e.Jcc(CC_E);
+            e.Div16(b);
+            if (index == OPCODE(0b000, 4))
+                e.Mov32(RAX, RDX);
+            size_t done = e.Jmp();
+            e.Bind(zero);
+            e.Alu32(0x31, RAX, RAX);
+            e.Bind(done);
+            break;
+        }
+        case OPCODE(0b000, 5): e.Alu16(0x21, RAX, b); break;
+        case OPCODE(0b000, 6): e.Alu16(0x09, RAX, b); break;
+        case OPCODE(0b000, 7):
+        case OPCODE(0b000, 8):
+            // NAND / NOR are logical (0 or 1)
+            e.Alu16(index == OPCODE(0b000, 7) ? 0x21 : 0x09, RAX, b);
+            e.Setcc(CC_E, RAX);
+            e.Movzx8(dst, RAX);
+            return;
+        case OPCODE(0b000, 9): e.Alu16(0x31, RAX, b); break;
+        case OPCODE(0b001, 11): e.Not16(RAX); break;
+    }
+    e.Movzx16(dst, RAX);
+}
+
+static bool IsAluInstruction(uint8_t index)
+{
+    return index < OPCODE(0b000, 10) || index == OPCODE(0b001, 11);
+}
+
+// Jcc taken when bit FLAGS of the mask is set, straight from the control unit's decode table
+static uint16_t JumpMask(uint8_t subOpCode)
+{
+    uint16_t mask = 0;
+    for (uint16_t flags = 0; flags < 16; ++flags) {
+        if (DecodeControlSignals(static_cast<uint16_t>((0b100 << 8) | (subOpCode << 4) | flags)).containsAddress)
+            mask |= static_cast<uint16_t>(1 << flags);
+    }
+    return mask;
+}
+
+static void EmitJcc(X86Emitter& e, const JitFrame& frame, const JitLoop& loop, uint8_t subOpCode, bool flagsPending, const JitExit& notTaken, const JitExit& taken)
+{
+    std::vector<size_t> toTaken;
+    std::vector<size_t> toNotTaken;
+
+    if (flagsPending) {
+        // Host flags of the same subtraction : ZF = Z, SF = N, CF = C (O is always 0 after CMP)
+        e.Alu16(0x39, RSI, RCX);
+        switch (subOpCode) {
+            case 1:  toTaken.push_back(e.Jcc(CC_E)); break;
+            case 2:  toTaken.push_back(e.Jcc(CC_NE)); break;
+            case 3:  toTaken.push_back(e.Jcc(CC_B)); break;
+            case 4:  toTaken.push_back(e.Jcc(CC_BE)); break;
+            case 5:  toTaken.push_back(e.Jcc(CC_A)); break;
+            case 6:  toTaken.push_back(e.Jcc(CC_AE)); break;
+            case 7:
+            case 10: toTaken.push_back(e.Jcc(CC_S)); break;
+            case 8:
+                toTaken.push_back(e.Jcc(CC_E));
+                toTaken.push_back(e.Jcc(CC_S));
+                break;
+            case 9:
+                toNotTaken.push_back(e.Jcc(CC_E));
+                toNotTaken.push_back(e.Jcc(CC_S));
+                toTaken.push_back(e.Jmp());
+                break;
+        }
+    }
+    else {
+        e.LoadByte(RAX, RDI, -1, CONTEXT_FIELD(FLAGS));
+        e.AluImm32(4, RAX, 0x0F);
+        e.MovImm32(RDX, JumpMask(subOpCode));
+        e.Bt32(RDX, RAX);
+        toTaken.push_back(e.Jcc(CC_B));
+    }
+
+    for (size_t position : toNotTaken)
+        e.Bind(position);
+    EmitExit(e, frame, notTaken);
+
+    for (size_t position : toTaken)
+        e.Bind(position);
+    EmitTakenBranch(e, frame, loop, taken);
+}
+
+static JitFrame AnalyzeFrame(const DecodedBlock* block)
+{
+    JitFrame frame;
+    for (const DecodedInstruction& instruction : block->instructions) {
+        uint8_t index = instruction.index;
+        uint8_t dst = static_cast<uint8_t>(1 << instruction.dst);
+        uint8_t srcA = static_cast<uint8_t>(1 << instruction.srcA);
+        uint8_t srcB = static_cast<uint8_t>(1 << instruction.srcB);
+        uint8_t read = 0;
+        uint8_t written = 0;
+
+        if (IsAluInstruction(index)) {
+            read = index == OPCODE(0b001, 11) ? srcA : srcA | srcB;
+            written = dst;
+        }
+        else {
+            switch (index) {
+                case OPCODE(0b001, 10): read = srcA | srcB; frame.usesFlags = true; break;
+                case OPCODE(0b010, 0):
+                case OPCODE(0b011, 0):  written = dst; break;
+                case OPCODE(0b011, 1):  read = srcA; break;
+                case OPCODE(0b011, 2):  read = srcA | srcB; break;
+                case OPCODE(0b011, 3):  read = srcB; written = dst; break;
+                case OPCODE(0b100, 11):
+                case OPCODE(0b100, 12): frame.usesSP = true; break;
+                case OPCODE(0b101, 0):  read = srcA; frame.usesSP = true; break;
+                case OPCODE(0b101, 1):  written = dst; frame.usesSP = true; break;
+            }
+        }
+        frame.usedRegisters |= read | written;
+        frame.writtenRegisters |= written;
+    }
+
+    // RBP holds RAM's base, R12-R15 guest R4-R7
+    if (frame.usesSP)
+        frame.calleeSaved.push_back(RBX);
+    frame.calleeSaved.push_back(RBP);
+    for (int i = 4; i < 8; ++i) {
+        if ((frame.usedRegisters >> i) & 1)
+            frame.calleeSaved.push_back(HostRegister(i));
+    }
+
+    // R8-R11 hold guest R0-R3
+    frame.callerSaved.push_back(RDI);
+    if (frame.usesFlags) {
+        frame.callerSaved.push_back(RSI);
+        frame.callerSaved.push_back(RCX);
+    }
+    for (int i = 0; i < 4; ++i) {
+        if ((frame.usedRegisters >> i) & 1)
+            frame.callerSaved.push_back(HostRegister(i));
+    }
+    return frame;
+}
+
+static void Translate(X86Emitter& e, const DecodedBlock* block, uint16_t* memory, const MemoryBus& bus, const uint16_t* coverCount,
+                      PerfCounters& perf)
+{
+    JitFrame frame = AnalyzeFrame(block);
+
+    // Prologue : RDI = context
+    for (int reg : frame.calleeSaved)
+        e.Push(reg);
+    if (FramePadding(frame) != 0)
+        e.SubRsp(FramePadding(frame));
+    e.MovImm64(RBP, reinterpret_cast<uint64_t>(memory));
+    for (int i = 0; i < 8; ++i) {
+        if ((frame.usedRegisters >> i) & 1)
+            e.LoadWord(HostRegister(i), RDI, -1, CONTEXT_FIELD(regs) + 2 * i);
+    }
+    if (frame.usesSP)
+        e.LoadWord(RBX, RDI, -1, CONTEXT_FIELD(SP));
+
+    JitLoop loop;
+    loop.startPC = block->startPC;
+    loop.head = e.GetPosition();
+    loop.halfTicks = block->halfTicks;
+
+    // Looping with a store before the CMP : that store's exit must see the previous iteration's FLAGS
+    bool storeSeen = false;
+    for (const DecodedInstruction& instruction : block->instructions) {
+        if (instruction.index == OPCODE(0b001, 10)) {
+            loop.flagsAtHead = storeSeen;
+            break;
+        }
+        storeSeen |= instruction.index == OPCODE(0b011, 1) || instruction.index == OPCODE(0b011, 2) || instruction.index == OPCODE(0b101, 0);
+    }
+
+    uint32_t pc = block->startPC;
+    uint32_t halfTicks = 0;
+    bool flagsPending = false;
+    bool addrLatched = false;  // CURRENT_IS_ADDR_JSR after the previous instruction (unknown for the first one)
+
+    for (size_t i = 0; i < block->instructions.size(); ++i) {
+        const DecodedInstruction& instruction = block->instructions[i];
+        uint8_t index = instruction.index;
+        int dst = HostRegister(instruction.dst);
+        int srcA = HostRegister(instruction.srcA);
+        int srcB = HostRegister(instruction.srcB);
+        uint16_t ext = instruction.ext;
+        uint16_t instructionPC = static_cast<uint16_t>(pc);
+
+        uint32_t nextPC = pc + FunctionalEngine::GetLength(static_cast<uint16_t>(index << 9));
+        halfTicks += instruction.halfTicks;
+
+        // State once the instruction is done (for the exits)
+        JitExit after;
+        after.PC = static_cast<uint16_t>(nextPC);
+        after.halfTicks = halfTicks;
+        after.instructions = static_cast<uint32_t>(i + 1);
+
+        // A helper may ask the block to leave once the instruction is done (mustLeave)
+        bool mayLeave = false;
+
+        if (IsAluInstruction(index)) {
+            EmitAlu(e, index, dst, srcA, srcB);
+            // CURRENT_IS_ADDR_JSR still set : the destination is written twice.
+            // Only the first instruction of a block can't know it at translation time
+            if (i == 0) {
+                e.CmpByteImm8(RDI, -1, CONTEXT_FIELD(addrLatched), 0);
+                size_t notLatched = e.Jcc(CC_E);
+                EmitAlu(e, index, dst, srcA, srcB);
+                e.Bind(notLatched);
+            }
+            else if (addrLatched) {
+                EmitAlu(e, index, dst, srcA, srcB);
+            }
+        }
+        else {
+            switch (index) {
+                case OPCODE(0b001, 10):
+                    e.Mov32(RSI, srcA);
+                    e.Mov32(RCX, srcB);
+                    flagsPending = true;
+                    break;
+
+                case OPCODE(0b010, 0):
+                    e.MovImm32(dst, ext);
+                    e.StoreWordImm(RDI, -1, CONTEXT_FIELD(IR1), ext);
+                    break;
+
+                case OPCODE(0b011, 0):
+                    EmitLoadConstant(e, frame, bus, ext, RAX, instructionPC);
+                    e.StoreWord(RDI, -1, CONTEXT_FIELD(IR1), RAX);
+                    e.Mov32(dst, RAX);
+                    after.addrLatched = true;
+                    mayLeave = bus.GetDataReader(ext) != nullptr;
+                    break;
+
+                case OPCODE(0b011, 1):
+                    // IR1 ends up holding the word that was overwritten
+                    EmitLoadConstant(e, frame, bus, ext, RAX, instructionPC, true);
+                    e.StoreWord(RDI, -1, CONTEXT_FIELD(IR1), RAX);
+                    EmitStore(e, frame, memory, bus, coverCount, true, ext, srcA, 0, instructionPC);
+                    after.addrLatched = true;
+                    mayLeave = true;
+                    break;
+
+                case OPCODE(0b011, 2):
+                    e.Mov32(RAX, srcB);
+                    EmitCountAccess(e, memory, perf.GetPageWrites(), RAX);
+                    EmitStore(e, frame, memory, bus, coverCount, false, 0, srcA, 0, instructionPC);
+                    mayLeave = true;
+                    break;
+
+                case OPCODE(0b011, 3):
+                    e.Mov32(RAX, srcB);
+                    EmitCountAccess(e, memory, perf.GetPageReads(), RAX);
+                    EmitLoad(e, frame, memory, bus, dst, instructionPC);
+                    mayLeave = bus.HasDataReaders();
+                    break;
+
+                case OPCODE(0b100, 0): {
+                    e.StoreWordImm(RDI, -1, CONTEXT_FIELD(IR1), ext);
+                    JitExit exit = after;
+                    exit.PC = ext;
+                    exit.addrLatched = true;
+                    exit.flagsPending = flagsPending;
+                    EmitTakenBranch(e, frame, loop, exit);
+                    return;
+                }
+
+                case OPCODE(0b100, 11): {
+                    e.StoreWordImm(RDI, -1, CONTEXT_FIELD(IR1), ext);
+                    e.Mov32(RAX, RBX);
+                    EmitStore(e, frame, memory, bus, coverCount, false, 0, -1, static_cast<uint16_t>(pc + 2), instructionPC);
+
+                    // The target is read after the push : pushed over its own extension word, it jumps to the word written
+                    // (plain RAM, the block never reaches into a reading device's page)
+                    e.AluImm32(7, RBX, static_cast<uint16_t>(pc + 1));
+                    size_t notOverExt = e.Jcc(CC_NE);
+                    e.Mov32(RAX, RBX);
+                    e.LoadWord(RAX, RBP, RAX, 0);
+                    e.StoreWord(RDI, -1, CONTEXT_FIELD(IR1), RAX);
+                    e.Dec16(RBX);
+                    JitExit overExt = after;
+                    overExt.pcInRax = true;
+                    overExt.addrLatched = true;
+                    overExt.flagsPending = flagsPending;
+                    EmitExit(e, frame, overExt);
+                    e.Bind(notOverExt);
+
+                    e.Dec16(RBX);
+                    JitExit exit = after;
+                    exit.PC = ext;
+                    exit.addrLatched = true;
+                    exit.flagsPending = flagsPending;
+                    // Calling its own start : the push may have asked to leave instead of looping
+                    if (ext == loop.startPC) {
+                        e.CmpByteImm8(RDI, -1, CONTEXT_FIELD(mustLeave), 0);
+                        size_t stay = e.Jcc(CC_E);
+                        EmitExit(e, frame, exit);
+                        e.Bind(stay);
+                    }
+                    EmitTakenBranch(e, frame, loop, exit);
+                    return;
+                }
+
+                case OPCODE(0b100, 12): {
+                    e.Inc16(RBX);
+                    e.Mov32(RAX, RBX);
+                    EmitLoad(e, frame, memory, bus, RAX, instructionPC);
+                    e.StoreWord(RDI, -1, CONTEXT_FIELD(IR1), RAX);
+                    JitExit exit = after;
+                    exit.pcInRax = true;
+                    exit.rtsLatched = true;
+                    exit.flagsPending = flagsPending;
+                    EmitExit(e, frame, exit);
+                    return;
+                }
+
+                case OPCODE(0b101, 0):
+                    e.Mov32(RAX, RBX);
+                    EmitStore(e, frame, memory, bus, coverCount, false, 0, srcA, 0, instructionPC);
+                    e.Dec16(RBX);
+                    mayLeave = true;
+                    break;
+
+                case OPCODE(0b101, 1):
+                    e.Inc16(RBX);
+                    e.Mov32(RAX, RBX);
+                    EmitLoad(e, frame, memory, bus, RAX, instructionPC);
+                    e.StoreWord(RDI, -1, CONTEXT_FIELD(IR1), RAX);
+                    e.Mov32(dst, RAX);
+                    after.addrLatched = true;
+                    mayLeave = bus.HasDataReaders();
+                    break;
+
+                default:
+                    // Jcc
+                    if (index > OPCODE(0b100, 0) && index < OPCODE(0b100, 11)) {
+                        e.StoreWordImm(RDI, -1, CONTEXT_FIELD(IR1), ext);
+                        JitExit notTaken = after;
+                        notTaken.flagsPending = flagsPending;
+                        JitExit taken = notTaken;
+                        taken.PC = ext;
+                        taken.addrLatched = true;
+                        EmitJcc(e, frame, loop, index & 0b1111, flagsPending, notTaken, taken);
+                        return;
+                    }
+                    break;
+            }
+        }
+
+        // A store threw away decoded code (the interpreter decodes the new code) or a tap asked for a stop : leave
+        if (mayLeave) {
+            e.CmpByteImm8(RDI, -1, CONTEXT_FIELD(mustLeave), 0);
+            size_t unchanged = e.Jcc(CC_E);
+            JitExit exit = after;
+            exit.flagsPending = flagsPending;
+            EmitExit(e, frame, exit);
+            e.Bind(unchanged);
+        }
+
+        addrLatched = after.addrLatched;
+        pc = nextPC;
+    }
+
+    // The block ended before a HLT / an undocumented encoding, or was too long
+    JitExit exit;
+    exit.PC = static_cast<uint16_t>(pc);
+    exit.halfTicks = halfTicks;
+    exit.instructions = static_cast<uint32_t>(block->instructions.size());
+    exit.addrLatched = addrLatched;
+    exit.flagsPending = flagsPending;
+    EmitExit(e, frame, exit);
+}
+
+JitCompiler::~JitCompiler()
+{
+    if (arena != nullptr)
+        munmap(arena, JIT_ARENA_SIZE);
+}
+
+bool JitCompiler::ReserveArena(size_t size)
+{
+    if (arena == nullptr) {
+        void* memory = mmap(nullptr, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return false;
+        arena = static_cast<uint8_t*>(memory);
+    }
+    return arenaUsed + size <= JIT_ARENA_SIZE;
+}
+
+void JitCompiler::Compile(DecodedBlock* block)
+{
+    // IN/OUT stay in the interpreter
+    for (const DecodedInstruction& instruction : block->instructions) {
+        if (instruction.index >> 4 == 0b111) {
+            block->jitRejected = true;
+            return;
+        }
+    }
+
+    // So do the short blocks that don't branch back to their own start (JMP, Jcc or JSR, not RTS)
+    const DecodedInstruction& last = block->instructions.back();
+    bool loops = (last.index >> 4) == 0b100 && last.index != OPCODE(0b100, 12) && last.ext == block->startPC;
+    if (!loops && block->instructions.size() < JIT_MIN_INSTRUCTIONS) {
+        block->jitRejected = true;
+        return;
+    }
+
+    X86Emitter e;
+    Translate(e, block, machine.ram.Data(), machine.bus, machine.blockCache.GetCoverCounts(), machine.perfCounters);
+    const std::vector<uint8_t>& code = e.GetCode();
+    size_t size = (code.size() + 15) & ~static_cast<size_t>(15);
+
+    if (!ReserveArena(size)) {
+        // Arena full : start over (no translated code is running while we compile)
+        Reset();
+        if (!ReserveArena(size)) {
+            block->jitRejected = true;
+            return;
+        }
+    }
+
+    // Only the pages the code lands on are flipped (the whole arena takes longer than most translations)
+    uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t pagesStart = reinterpret_cast<uintptr_t>(arena + arenaUsed) & ~(pageSize - 1);
+    uintptr_t pagesEnd = (reinterpret_cast<uintptr_t>(arena + arenaUsed + code.size()) + pageSize - 1) & ~(pageSize - 1);
+    mprotect(reinterpret_cast<void*>(pagesStart), pagesEnd - pagesStart, PROT_READ | PROT_WRITE);
+    std::memcpy(arena + arenaUsed, code.data(), code.size());
+    mprotect(reinterpret_cast<void*>(pagesStart), pagesEnd - pagesStart, PROT_READ | PROT_EXEC);
+
+    block->jitCode = reinterpret_cast<JitBlockFunction>(arena + arenaUsed);
+    arenaUsed += size;
+    compiledBlocks++;
+}
+
+#else
+
+JitCompiler::~JitCompiler()
+{
+}
+
+void JitCompiler::Compile(DecodedBlock* block)
+{
+    block->jitRejected = true;
+}
+
+bool JitCompiler::ReserveArena(size_t size)
+{
+    return false;
+}
+
+#endif
+
+void JitCompiler::Reset()
+{
+    machine.blockCache.ForgetJitCode();
+    arenaUsed = 0;
+}
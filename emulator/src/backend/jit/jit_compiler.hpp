@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct DecodedBlock;
+class Machine;
+
+// The only JIT backend is x86-64 System V (Linux)
+#if defined(__x86_64__) && defined(__linux__)
+#define ORGAN16_JIT_SUPPORTED 1
+#else
+#define ORGAN16_JIT_SUPPORTED 0
+#endif
+
+// State handed to a translated block (same content as ArchState, laid out for the generated code)
+struct JitContext{
+    uint16_t regs[8];
+    uint16_t PC;
+    uint16_t SP;
+    uint16_t IR1;
+    uint8_t FLAGS;
+    uint8_t addrLatched;
+    uint8_t rtsLatched;
+
+    // Set by the helpers when a write threw away decoded code or a bus tap asked for a stop (the block leaves right
+    // after that instruction)
+    uint8_t mustLeave;
+
+    // Half-ticks the block may spend (it loops on itself while the next iteration fits)
+    uint32_t budget;
+
+    // Half-ticks spent by the instructions it executed (0 on entry)
+    uint32_t halfTicks;
+
+    // Instructions it executed (0 on entry)
+    uint32_t instructions;
+
+    // Owner of the memory the block runs on (read by the helpers)
+    Machine* machine;
+};
+
+typedef void (*JitBlockFunction)(JitContext* context);
+
+// Blocks run this many times in the interpreter before being translated
+static const uint32_t JIT_HOT_THRESHOLD = 16;
+
+// Shorter blocks are left to the interpreter unless they loop on themselves : entering and leaving the native code
+// costs about as much as interpreting them
+static const size_t JIT_MIN_INSTRUCTIONS = 8;
+
+static const size_t JIT_ARENA_SIZE = 16 * 1024 * 1024;
+
+// Keeps the generated 32-bit half-tick arithmetic away from overflows
+static const uint32_t JIT_MAX_BUDGET = 0x7FFFFFFF;
+
+// Translates decoded blocks into native code kept in an mmap'd arena (one per Machine, the code has its RAM baked in).
+// Guest R0-R7 live in R8-R15, SP in RBX, RAM's base in RBP. CMP only keeps its operands (ESI, ECX),
+// the FLAGS word is built from them when the block leaves. A branch back to the block's own start stays in native code.
+// Blocks with IN/OUT and short blocks are left to the interpreter, stores to decoded code, device and tapped accesses go
+// through helpers. A block only loads, stores back and preserves the registers it uses.
+// LOADR / STORER bump the Machine's performance counters, the rest is counted by the interpreter after the block ran.
+class JitCompiler{
+    private:
+        Machine& machine;
+
+        uint8_t* arena = nullptr;
+        size_t arenaUsed = 0;
+        uint64_t compiledBlocks = 0;
+
+        bool ReserveArena(size_t size);
+
+    public:
+        explicit JitCompiler(Machine& machine) : machine(machine) {}
+
+        // Releases the arena
+        ~JitCompiler();
+
+        JitCompiler(const JitCompiler&) = delete;
+        JitCompiler& operator=(const JitCompiler&) = delete;
+        JitCompiler(JitCompiler&&) = delete;
+        JitCompiler& operator=(JitCompiler&&) = delete;
+
+        static bool IsSupported() {
+            return ORGAN16_JIT_SUPPORTED;
+        }
+
+        // Translates block (sets block->jitCode, or block->jitRejected when it has to stay interpreted)
+        void Compile(DecodedBlock* block);
+
+        // Drops every translation (only when no translated code is running)
+        void Reset();
+
+        uint64_t GetCompiledBlockCount() const {
+            return compiledBlocks;
+        }
+};
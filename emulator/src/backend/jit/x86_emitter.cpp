@@ -0,0 +1,331 @@
+#include "x86_emitter.hpp"
+
+void X86Emitter::Byte(uint8_t value)
+{
+    code.push_back(value);
+}
+
+void X86Emitter::Word(uint16_t value)
+{
+    Byte(value & 0xFF);
+    Byte(value >> 8);
+}
+
+void X86Emitter::Dword(uint32_t value)
+{
+    Word(value & 0xFFFF);
+    Word(value >> 16);
+}
+
+void X86Emitter::Qword(uint64_t value)
+{
+    Dword(value & 0xFFFFFFFF);
+    Dword(value >> 32);
+}
+
+void X86Emitter::Rex(bool wide, int reg, int index, int base, bool byteRegs)
+{
+    uint8_t rex = 0x40;
+    if (wide)
+        rex |= 0x08;
+    if (reg >= 8)
+        rex |= 0x04;
+    if (index >= 8)
+        rex |= 0x02;
+    if (base >= 8)
+        rex |= 0x01;
+
+    // Without a REX prefix, byte registers 4-7 would be AH/CH/DH/BH instead of SPL/BPL/SIL/DIL
+    bool needsByteRex = byteRegs && ((reg >= 4 && reg < 8) || (base >= 4 && base < 8));
+    if (rex != 0x40 || needsByteRex)
+        Byte(rex);
+}
+
+void X86Emitter::ModRM(int mod, int reg, int rm)
+{
+    Byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+}
+
+void X86Emitter::Memory(int reg, int base, int index, int32_t disp)
+{
+    // Always mod = 10 (disp32) : valid for every base, RBP/R13 included
+    if (index >= 0) {
+        ModRM(0b10, reg, 0b100);
+        Byte(static_cast<uint8_t>((0b01 << 6) | ((index & 7) << 3) | (base & 7)));
+    }
+    else if ((base & 7) == RSP) {
+        ModRM(0b10, reg, 0b100);
+        Byte(0x24);
+    }
+    else {
+        ModRM(0b10, reg, base);
+    }
+    Dword(static_cast<uint32_t>(disp));
+}
+
+void X86Emitter::RegReg(bool op16, const std::vector<uint8_t>& opcode, int reg, int rm, bool byteRegs)
+{
+    if (op16)
+        Byte(0x66);
+    Rex(false, reg, -1, rm, byteRegs);
+    for (uint8_t byte : opcode)
+        Byte(byte);
+    ModRM(0b11, reg, rm);
+}
+
+void X86Emitter::RegMem(bool op16, const std::vector<uint8_t>& opcode, int reg, int base, int index, int32_t disp, bool byteRegs)
+{
+    if (op16)
+        Byte(0x66);
+    Rex(false, reg, index, base, byteRegs);
+    for (uint8_t byte : opcode)
+        Byte(byte);
+    Memory(reg, base, index, disp);
+}
+
+void X86Emitter::Mov32(int dst, int src)
+{
+    RegReg(false, {0x89}, src, dst);
+}
+
+void X86Emitter::Alu16(uint8_t opcode, int dst, int src)
+{
+    RegReg(true, {opcode}, src, dst);
+}
+
+void X86Emitter::Alu32(uint8_t opcode, int dst, int src)
+{
+    RegReg(false, {opcode}, src, dst);
+}
+
+void X86Emitter::Imul16(int dst, int src)
+{
+    RegReg(true, {0x0F, 0xAF}, dst, src);
+}
+
+void X86Emitter::Movzx16(int dst, int src)
+{
+    RegReg(false, {0x0F, 0xB7}, dst, src);
+}
+
+void X86Emitter::Movzx8(int dst, int src)
+{
+    RegReg(false, {0x0F, 0xB6}, dst, src, true);
+}
+
+void X86Emitter::Not16(int reg)
+{
+    RegReg(true, {0xF7}, 2, reg);
+}
+
+void X86Emitter::Div16(int src)
+{
+    RegReg(true, {0xF7}, 6, src);
+}
+
+void X86Emitter::Inc16(int reg)
+{
+    RegReg(true, {0xFF}, 0, reg);
+}
+
+void X86Emitter::Dec16(int reg)
+{
+    RegReg(true, {0xFF}, 1, reg);
+}
+
+void X86Emitter::Setcc(X86Condition condition, int reg)
+{
+    RegReg(false, {0x0F, static_cast<uint8_t>(0x90 | condition)}, 0, reg, true);
+}
+
+void X86Emitter::Bt32(int bitBase, int bitIndex)
+{
+    RegReg(false, {0x0F, 0xA3}, bitIndex, bitBase);
+}
+
+void X86Emitter::AluImm32(int extension, int reg, uint32_t imm)
+{
+    RegReg(false, {0x81}, extension, reg);
+    Dword(imm);
+}
+
+void X86Emitter::ShlImm32(int reg, uint8_t count)
+{
+    RegReg(false, {0xC1}, 4, reg);
+    Byte(count);
+}
+
+void X86Emitter::ShrImm32(int reg, uint8_t count)
+{
+    RegReg(false, {0xC1}, 5, reg);
+    Byte(count);
+}
+
+void X86Emitter::MovImm32(int dst, uint32_t imm)
+{
+    Rex(false, 0, -1, dst);
+    Byte(static_cast<uint8_t>(0xB8 | (dst & 7)));
+    Dword(imm);
+}
+
+void X86Emitter::MovImm64(int dst, uint64_t imm)
+{
+    Rex(true, 0, -1, dst);
+    Byte(static_cast<uint8_t>(0xB8 | (dst & 7)));
+    Qword(imm);
+}
+
+void X86Emitter::LoadWord(int dst, int base, int index, int32_t disp)
+{
+    RegMem(false, {0x0F, 0xB7}, dst, base, index, disp);
+}
+
+void X86Emitter::LoadByte(int dst, int base, int index, int32_t disp)
+{
+    RegMem(false, {0x0F, 0xB6}, dst, base, index, disp);
+}
+
+void X86Emitter::LoadDword(int dst, int base, int index, int32_t disp)
+{
+    RegMem(false, {0x8B}, dst, base, index, disp);
+}
+
+void X86Emitter::StoreWord(int base, int index, int32_t disp, int src)
+{
+    RegMem(true, {0x89}, src, base, index, disp);
+}
+
+void X86Emitter::StoreByte(int base, int index, int32_t disp, int src)
+{
+    RegMem(false, {0x88}, src, base, index, disp, true);
+}
+
+void X86Emitter::StoreDword(int base, int index, int32_t disp, int src)
+{
+    RegMem(false, {0x89}, src, base, index, disp);
+}
+
+void X86Emitter::StoreWordImm(int base, int index, int32_t disp, uint16_t imm)
+{
+    RegMem(true, {0xC7}, 0, base, index, disp);
+    Word(imm);
+}
+
+void X86Emitter::StoreByteImm(int base, int index, int32_t disp, uint8_t imm)
+{
+    RegMem(false, {0xC6}, 0, base, index, disp);
+    Byte(imm);
+}
+
+void X86Emitter::StoreDwordImm(int base, int index, int32_t disp, uint32_t imm)
+{
+    RegMem(false, {0xC7}, 0, base, index, disp);
+    Dword(imm);
+}
+
+void X86Emitter::CmpWordImm8(int base, int index, int32_t disp, uint8_t imm)
+{
+    RegMem(true, {0x83}, 7, base, index, disp);
+    Byte(imm);
+}
+
+void X86Emitter::CmpByteImm8(int base, int index, int32_t disp, uint8_t imm)
+{
+    RegMem(false, {0x80}, 7, base, index, disp);
+    Byte(imm);
+}
+
+void X86Emitter::AddDwordImm(int base, int index, int32_t disp, uint32_t imm)
+{
+    RegMem(false, {0x81}, 0, base, index, disp);
+    Dword(imm);
+}
+
+void X86Emitter::AddQwordImm8(int base, int index, int32_t disp, uint8_t imm)
+{
+    Rex(true, 0, index, base);
+    Byte(0x83);
+    Memory(0, base, index, disp);
+    Byte(imm);
+}
+
+void X86Emitter::CmpQwordImm8(int base, int index, int32_t disp, uint8_t imm)
+{
+    Rex(true, 0, index, base);
+    Byte(0x83);
+    Memory(7, base, index, disp);
+    Byte(imm);
+}
+
+void X86Emitter::CmpDword(int reg, int base, int index, int32_t disp)
+{
+    RegMem(false, {0x3B}, reg, base, index, disp);
+}
+
+void X86Emitter::Push(int reg)
+{
+    Rex(false, 0, -1, reg);
+    Byte(static_cast<uint8_t>(0x50 | (reg & 7)));
+}
+
+void X86Emitter::Pop(int reg)
+{
+    Rex(false, 0, -1, reg);
+    Byte(static_cast<uint8_t>(0x58 | (reg & 7)));
+}
+
+void X86Emitter::AddRsp(uint8_t imm)
+{
+    Byte(0x48);
+    Byte(0x83);
+    ModRM(0b11, 0, RSP);
+    Byte(imm);
+}
+
+void X86Emitter::SubRsp(uint8_t imm)
+{
+    Byte(0x48);
+    Byte(0x83);
+    ModRM(0b11, 5, RSP);
+    Byte(imm);
+}
+
+void X86Emitter::Call(int reg)
+{
+    RegReg(false, {0xFF}, 2, reg);
+}
+
+void X86Emitter::Ret()
+{
+    Byte(0xC3);
+}
+
+size_t X86Emitter::Jcc(X86Condition condition)
+{
+    Byte(0x0F);
+    Byte(static_cast<uint8_t>(0x80 | condition));
+    size_t position = GetPosition();
+    Dword(0);
+    return position;
+}
+
+size_t X86Emitter::Jmp()
+{
+    Byte(0xE9);
+    size_t position = GetPosition();
+    Dword(0);
+    return position;
+}
+
+void X86Emitter::JmpTo(size_t target)
+{
+    Byte(0xE9);
+    Dword(static_cast<uint32_t>(target - (GetPosition() + 4)));
+}
+
+void X86Emitter::Bind(size_t position)
+{
+    uint32_t displacement = static_cast<uint32_t>(GetPosition() - (position + 4));
+    for (int i = 0; i < 4; ++i)
+        code[position + i] = static_cast<uint8_t>(displacement >> (8 * i));
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum X86Register{
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// Condition codes (low nibble of Jcc / SETcc)
+enum X86Condition{
+    CC_B = 0x2,   // Below (carry)
+    CC_AE = 0x3,  // Above or equal (no carry)
+    CC_E = 0x4,   // Equal (zero)
+    CC_NE = 0x5,  // Not equal
+    CC_BE = 0x6,  // Below or equal
+    CC_A = 0x7,   // Above
+    CC_S = 0x8,   // Sign
+    CC_NS = 0x9   // No sign
+};
+
+// Minimal x86-64 encoder, only the forms the JIT needs.
+// "16" methods work on the low word of the registers, "32" ones zero the upper half as usual on x86-64.
+// Memory operands are always [base + index * 2 + disp32] (index = -1 for none)
+class X86Emitter{
+    private:
+        std::vector<uint8_t> code;
+
+        void Rex(bool wide, int reg, int index, int base, bool byteRegs = false);
+        void ModRM(int mod, int reg, int rm);
+        void Memory(int reg, int base, int index, int32_t disp);
+
+        // Generic encoders : opcode with a register / memory operand
+        void RegReg(bool op16, const std::vector<uint8_t>& opcode, int reg, int rm, bool byteRegs = false);
+        void RegMem(bool op16, const std::vector<uint8_t>& opcode, int reg, int base, int index, int32_t disp, bool byteRegs = false);
+
+    public:
+        void Byte(uint8_t value);
+        void Word(uint16_t value);
+        void Dword(uint32_t value);
+        void Qword(uint64_t value);
+
+        const std::vector<uint8_t>& GetCode() const {
+            return code;
+        }
+
+        size_t GetPosition() const {
+            return code.size();
+        }
+
+        // Register to register
+        void Mov32(int dst, int src);
+        void Alu16(uint8_t opcode, int dst, int src);      // add 01, or 09, and 21, sub 29, xor 31, cmp 39 (dst op= src)
+        void Alu32(uint8_t opcode, int dst, int src);
+        void Imul16(int dst, int src);
+        void Movzx16(int dst, int src);
+        void Movzx8(int dst, int src);
+        void Not16(int reg);
+        void Div16(int src);                                // dx:ax / src -> ax, dx
+        void Inc16(int reg);
+        void Dec16(int reg);
+        void Setcc(X86Condition condition, int reg);
+        void Bt32(int bitBase, int bitIndex);
+        void AluImm32(int extension, int reg, uint32_t imm); // add /0, and /4, sub /5, cmp /7
+        void ShlImm32(int reg, uint8_t count);
+        void ShrImm32(int reg, uint8_t count);
+
+        void MovImm32(int dst, uint32_t imm);
+        void MovImm64(int dst, uint64_t imm);
+
+        // Memory
+        void LoadWord(int dst, int base, int index, int32_t disp);     // movzx r32, word
+        void LoadByte(int dst, int base, int index, int32_t disp);     // movzx r32, byte
+        void LoadDword(int dst, int base, int index, int32_t disp);
+        void StoreWord(int base, int index, int32_t disp, int src);
+        void StoreByte(int base, int index, int32_t disp, int src);
+        void StoreDword(int base, int index, int32_t disp, int src);
+        void StoreWordImm(int base, int index, int32_t disp, uint16_t imm);
+        void StoreByteImm(int base, int index, int32_t disp, uint8_t imm);
+        void StoreDwordImm(int base, int index, int32_t disp, uint32_t imm);
+        void CmpWordImm8(int base, int index, int32_t disp, uint8_t imm);
+        void CmpByteImm8(int base, int index, int32_t disp, uint8_t imm);
+        void AddDwordImm(int base, int index, int32_t disp, uint32_t imm);
+        void AddQwordImm8(int base, int index, int32_t disp, uint8_t imm);
+        void CmpQwordImm8(int base, int index, int32_t disp, uint8_t imm);
+        void CmpDword(int reg, int base, int index, int32_t disp);      // cmp r32, dword
+
+        // Stack and control flow
+        void Push(int reg);
+        void Pop(int reg);
+        void AddRsp(uint8_t imm);
+        void SubRsp(uint8_t imm);
+        void Call(int reg);
+        void Ret();
+
+        // Branches with a 32-bit displacement, returns the position to hand to Bind()
+        size_t Jcc(X86Condition condition);
+        size_t Jmp();
+
+        // Jump back to an already emitted position
+        void JmpTo(size_t target);
+
+        // Points the branch emitted at position to the current position
+        void Bind(size_t position);
+};
@@ -0,0 +1,11 @@
+// Built with -mavx2 (see CMakeLists.txt), only called once the CPU said it has AVX2
+#include "lockstep_kernel.hpp"
+
+uint64_t RunLockstepAvx2(const LockstepChunk& chunk, int count)
+{
+#if defined(__AVX2__)
+    return RunLockstepLanes<Avx2Lanes>(chunk, count);
+#else
+    return RunLockstepLanes<ScalarLanes>(chunk, count);
+#endif
+}
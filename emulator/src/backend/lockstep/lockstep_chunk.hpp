@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+
+// Where a lane is at (LockstepEngine keeps one per machine)
+enum LockstepLaneStatus : uint32_t{
+    LANE_RUNNING = 0,
+    LANE_BUDGET,        // The next instruction did not fit in the budget
+    LANE_HALT,          // Stopped on HLT
+    LANE_UNSUPPORTED    // Undocumented encoding, IN3, a 2 word instruction at 0xFFFF or a store into a device page
+};
+
+// One bit per kind of instruction, each step only runs the kinds at least one lane fetched
+enum LockstepKind : uint32_t{
+    KIND_NONE   = 0,          // HLT, IN3 and the undocumented encodings
+    KIND_ADD    = 1u << 0,    // The ALU operations keep their SubOpCode order (ADD to XOR), then NOT
+    KIND_DIV    = 1u << 3,
+    KIND_MOD    = 1u << 4,
+    KIND_NOT    = 1u << 10,
+    KIND_CMP    = 1u << 11,
+    KIND_MOV    = 1u << 12,
+    KIND_LOAD   = 1u << 13,
+    KIND_STORE  = 1u << 14,
+    KIND_STORER = 1u << 15,
+    KIND_LOADR  = 1u << 16,
+    KIND_JMP    = 1u << 17,
+    KIND_JCC    = 1u << 18,
+    KIND_JSR    = 1u << 19,
+    KIND_RTS    = 1u << 20,
+    KIND_PUSH   = 1u << 21,
+    KIND_POP    = 1u << 22,
+    KIND_IN     = 1u << 23,
+    KIND_OUT    = 1u << 24,
+
+    KIND_ALU    = (1u << 11) - 1,
+    KIND_WRITES = KIND_STORE | KIND_STORER | KIND_JSR | KIND_PUSH,
+    KIND_ALL    = (1u << 25) - 1
+};
+
+// Decode table entries : LockstepKind, then the half-ticks (3 bits) and the length in words (2 bits).
+// The whole entry is 0 for HLT, IN3 and the undocumented encodings
+static const int LOCKSTEP_HALF_TICKS_SHIFT = 25;
+static const int LOCKSTEP_LENGTH_SHIFT = 28;
+
+// A word of the program decoded as the first word of an instruction (LockstepEngine::LoadProgram decodes every address)
+struct LockstepInstruction{
+    uint32_t decoded;   // Decode table entry
+    uint16_t ext;       // The word after it
+    uint8_t index;      // OpCode + SubOpCode
+    uint8_t dst, srcA, srcB;
+};
+
+// Structure of arrays view of the lanes a kernel call runs (every pointer is at the chunk's first lane).
+// Registers, flags and latches are kept zero extended to 32 bits so a whole vector lane holds one machine
+struct LockstepChunk{
+    uint32_t* regs[8];
+    uint32_t* pc;
+    uint32_t* sp;
+    uint32_t* flags;
+    uint32_t* ir1;
+    uint32_t* addrLatched;  // 0 or 1
+    uint32_t* rtsLatched;   // 0 or 1
+    uint32_t* ports[3];     // Read by IN, written by OUT
+    uint32_t* consumed;     // Half-ticks spent in this call
+    uint32_t* budget;       // Half-ticks each lane may spend in this call (at most LOCKSTEP_MAX_BUDGET)
+    uint32_t* status;       // LockstepLaneStatus
+
+    // RAM of the chunk's first lane, the next ones follow every memoryStride words
+    uint16_t* memory;
+    uint32_t memoryStride;
+
+    // Indexed by OpCode + SubOpCode (top 7 bits of IR0)
+    const uint32_t* decode;
+
+    // Bit n set when the Jcc with this SubOpCode jumps with FLAGS = n
+    const uint32_t* jumpMasks;
+
+    // 1 for the bus pages whose writes a device handles (indexed by address >> BUS_PAGE_SHIFT)
+    const uint32_t* devicePages;
+
+    // Every address of the program as loaded, shared by the lanes
+    const LockstepInstruction* program;
+
+    // 1 once a lane stored to the word (in any lane's RAM) : its instructions are fetched from each lane's RAM from then on
+    uint8_t* written;
+};
+
+// Keeps the 32-bit half-tick compares of the kernels away from the sign bit
+static const uint32_t LOCKSTEP_MAX_BUDGET = 0x7FFFFFF0;
+
+// Widest vector the kernels use, the lane count is padded to a multiple of it
+static const int LOCKSTEP_MAX_WIDTH = 8;
+
+// Kernels for every instruction set, each runs count lanes (a multiple of its width) until they all stop.
+// Return the number of instructions executed
+uint64_t RunLockstepScalar(const LockstepChunk& chunk, int count);
+uint64_t RunLockstepSse2(const LockstepChunk& chunk, int count);
+uint64_t RunLockstepAvx2(const LockstepChunk& chunk, int count);
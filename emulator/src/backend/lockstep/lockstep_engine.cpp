@@ -0,0 +1,275 @@
+#include "lockstep_engine.hpp"
+
+#include <algorithm>
+
+#include "../control_unit/control_unit.hpp"
+#include "../memory/blitter.hpp"
+#include "../io/st7735s.hpp"
+
+// LockstepKind of a 7 bit instruction index (OpCode + SubOpCode)
+static uint32_t GetKind(uint32_t index)
+{
+    uint32_t subOpCode = index & 15;
+    switch (index >> 4) {
+        case 0b000: return subOpCode <= 9 ? 1u << subOpCode : 0;
+        case 0b001: return subOpCode == 10 ? KIND_CMP : (subOpCode == 11 ? KIND_NOT : KIND_NONE);
+        case 0b010: return subOpCode == 0 ? KIND_MOV : KIND_NONE;
+        case 0b011: {
+            static const LockstepKind memoryKinds[] = {KIND_LOAD, KIND_STORE, KIND_STORER, KIND_LOADR};
+            return subOpCode < 4 ? memoryKinds[subOpCode] : KIND_NONE;
+        }
+        case 0b100:
+            if (subOpCode == 0)
+                return KIND_JMP;
+            if (subOpCode <= 10)
+                return KIND_JCC;
+            return subOpCode == 11 ? KIND_JSR : (subOpCode == 12 ? KIND_RTS : KIND_NONE);
+        case 0b101: return subOpCode == 0 ? KIND_PUSH : (subOpCode == 1 ? KIND_POP : KIND_NONE);
+        case 0b111:
+            if (subOpCode >= 1 && subOpCode <= 3)
+                return KIND_IN;
+            return subOpCode >= 4 && subOpCode <= 6 ? KIND_OUT : KIND_NONE;
+        default:
+            return 0;
+    }
+}
+
+LockstepEngine::LockstepEngine(size_t laneCount) :
+    laneCount(laneCount),
+    paddedCount((laneCount + LOCKSTEP_MAX_WIDTH - 1) / LOCKSTEP_MAX_WIDTH * LOCKSTEP_MAX_WIDTH),
+    isa(GetBestIsa())
+{
+    memory.assign(paddedCount * MEMORY_STRIDE, 0);
+    for (std::vector<uint32_t>& reg : regs)
+        reg.assign(paddedCount, 0);
+    for (std::vector<uint32_t>& port : ports)
+        port.assign(paddedCount, 0);
+    pc.assign(paddedCount, 0);
+    sp.assign(paddedCount, 0xFFFF);
+    flags.assign(paddedCount, 0);
+    ir1.assign(paddedCount, 0);
+    addrLatched.assign(paddedCount, 0);
+    rtsLatched.assign(paddedCount, 0);
+    consumed.assign(paddedCount, 0);
+    budget.assign(paddedCount, 0);
+    status.assign(paddedCount, LANE_HALT);
+    halfTicks.assign(paddedCount, 0);
+    program.assign(ADDRESS_SPACE, LockstepInstruction{});
+    written.assign(MEMORY_STRIDE, 0);
+
+    for (uint32_t index = 0; index < 128; ++index) {
+        uint16_t instruction = static_cast<uint16_t>(index << 9);
+        uint32_t halfTicks = static_cast<uint32_t>(FunctionalEngine::GetHalfTicks(instruction));
+        uint32_t length = static_cast<uint32_t>(FunctionalEngine::GetLength(instruction));
+        // IN3 reads the Machine's performance counters, the lanes have none : it stops them like an undocumented encoding
+        if (halfTicks != 0 && GetKind(index) != KIND_NONE)
+            decodeTable[index] = GetKind(index) | (halfTicks << LOCKSTEP_HALF_TICKS_SHIFT) | (length << LOCKSTEP_LENGTH_SHIFT);
+    }
+
+    // Same condition mux as the control unit
+    for (uint16_t subOpCode = 0; subOpCode < 16; ++subOpCode) {
+        for (uint16_t value = 0; value < 16; ++value) {
+            if (DecodeControlSignals(static_cast<uint16_t>((0b100 << 8) | (subOpCode << 4) | value)).containsAddress)
+                jumpMasks[subOpCode] |= 1u << value;
+        }
+    }
+
+    // The devices of a Machine whose writes do more than store the word (the framebuffer's pixels are plain RAM here)
+    for (int page = BLITTER_START >> BUS_PAGE_SHIFT; page < BLITTER_END >> BUS_PAGE_SHIFT; ++page)
+        devicePages[page] = 1;
+    for (int page = LCD_START >> BUS_PAGE_SHIFT; page < LCD_END >> BUS_PAGE_SHIFT; ++page)
+        devicePages[page] = 1;
+}
+
+void LockstepEngine::LoadProgram(const ProgramImage& image)
+{
+    std::vector<uint16_t> words(MEMORY_STRIDE, 0);
+    for (const ProgramSegment& segment : image.GetSegments())
+        std::copy_n(segment.words, segment.length, words.begin() + segment.start);
+
+    std::fill(memory.begin(), memory.end(), 0);
+    for (size_t lane = 0; lane < laneCount; ++lane)
+        std::copy(words.begin(), words.end(), memory.begin() + lane * MEMORY_STRIDE);
+
+    // Every word as the first word of an instruction, the lanes only use the ones they reach
+    for (uint32_t address = 0; address < ADDRESS_SPACE; ++address) {
+        uint16_t instruction = words[address];
+        LockstepInstruction& decoded = program[address];
+        decoded.index = static_cast<uint8_t>(instruction >> 9);
+        decoded.decoded = decodeTable[decoded.index];
+        decoded.ext = words[address + 1];
+        decoded.dst = (instruction >> 6) & 0b111;
+        decoded.srcA = (instruction >> 3) & 0b111;
+        decoded.srcB = instruction & 0b111;
+    }
+    std::fill(written.begin(), written.end(), 0);
+
+    for (std::vector<uint32_t>& reg : regs)
+        std::fill(reg.begin(), reg.end(), 0);
+    for (std::vector<uint32_t>& port : ports)
+        std::fill(port.begin(), port.end(), 0);
+    std::fill(pc.begin(), pc.end(), image.GetEntry());
+    std::fill(sp.begin(), sp.end(), 0xFFFF);
+    std::fill(flags.begin(), flags.end(), 0);
+    std::fill(ir1.begin(), ir1.end(), 0);
+    std::fill(addrLatched.begin(), addrLatched.end(), 0);
+    std::fill(rtsLatched.begin(), rtsLatched.end(), 0);
+    std::fill(halfTicks.begin(), halfTicks.end(), 0);
+
+    // The padding lanes stay stopped
+    std::fill(status.begin(), status.end(), LANE_HALT);
+    std::fill(status.begin(), status.begin() + laneCount, LANE_BUDGET);
+
+    instructionCount = 0;
+}
+
+void LockstepEngine::SetLaneInput(size_t lane, int port, uint16_t value)
+{
+    ports[port][lane] = value;
+}
+
+LockstepChunk LockstepEngine::MakeChunk()
+{
+    LockstepChunk chunk;
+    for (int r = 0; r < 8; ++r)
+        chunk.regs[r] = regs[r].data();
+    chunk.pc = pc.data();
+    chunk.sp = sp.data();
+    chunk.flags = flags.data();
+    chunk.ir1 = ir1.data();
+    chunk.addrLatched = addrLatched.data();
+    chunk.rtsLatched = rtsLatched.data();
+    for (int p = 0; p < 3; ++p)
+        chunk.ports[p] = ports[p].data();
+    chunk.consumed = consumed.data();
+    chunk.budget = budget.data();
+    chunk.status = status.data();
+    chunk.memory = memory.data();
+    chunk.memoryStride = static_cast<uint32_t>(MEMORY_STRIDE);
+    chunk.decode = decodeTable;
+    chunk.jumpMasks = jumpMasks;
+    chunk.devicePages = devicePages;
+    chunk.program = program.data();
+    chunk.written = written.data();
+    return chunk;
+}
+
+uint64_t LockstepEngine::Run(uint64_t maxHalfTicks)
+{
+    LockstepChunk chunk = MakeChunk();
+    int count = static_cast<int>(paddedCount);
+
+    // Budgets over 31 bits are split in slices, a lane stopped by its slice goes on with the next one
+    // from where it was (nothing is lost at the boundary)
+    std::vector<uint64_t> remaining(paddedCount, maxHalfTicks);
+    uint64_t retired = 0;
+    for (;;) {
+        bool any = false;
+        bool sliced = false;
+        for (size_t lane = 0; lane < paddedCount; ++lane) {
+            consumed[lane] = 0;
+            if (status[lane] == LANE_BUDGET && remaining[lane] > 0) {
+                status[lane] = LANE_RUNNING;
+                budget[lane] = static_cast<uint32_t>(std::min<uint64_t>(remaining[lane], LOCKSTEP_MAX_BUDGET));
+                any = true;
+                sliced |= budget[lane] < remaining[lane];
+            }
+        }
+        if (!any)
+            break;
+
+        switch (isa) {
+            case LOCKSTEP_AVX2: retired += RunLockstepAvx2(chunk, count); break;
+            case LOCKSTEP_SSE2: retired += RunLockstepSse2(chunk, count); break;
+            default:            retired += RunLockstepScalar(chunk, count); break;
+        }
+
+        for (size_t lane = 0; lane < paddedCount; ++lane) {
+            halfTicks[lane] += consumed[lane];
+            remaining[lane] -= consumed[lane];
+        }
+        if (!sliced)
+            break;
+    }
+
+    instructionCount += retired;
+    return retired;
+}
+
+ArchState LockstepEngine::GetLaneState(size_t lane) const
+{
+    ArchState state;
+    for (int r = 0; r < 8; ++r)
+        state.regs[r] = static_cast<uint16_t>(regs[r][lane]);
+    state.PC = static_cast<uint16_t>(pc[lane]);
+    state.SP = static_cast<uint16_t>(sp[lane]);
+    state.FLAGS = static_cast<uint8_t>(flags[lane]);
+    state.IR1 = static_cast<uint16_t>(ir1[lane]);
+    state.addrLatched = addrLatched[lane] != 0;
+    state.rtsLatched = rtsLatched[lane] != 0;
+    return state;
+}
+
+FunctionalStopReason LockstepEngine::GetLaneStopReason(size_t lane) const
+{
+    switch (status[lane]) {
+        case LANE_HALT:        return STOP_HALT;
+        case LANE_UNSUPPORTED: return STOP_UNSUPPORTED;
+        default:               return STOP_BUDGET;
+    }
+}
+
+bool LockstepEngine::IsIsaSupported(LockstepIsa isa)
+{
+    switch (isa) {
+        case LOCKSTEP_SCALAR:
+            return true;
+        case LOCKSTEP_SSE2:
+#if defined(__SSE2__)
+            return true;
+#else
+            return false;
+#endif
+        case LOCKSTEP_AVX2:
+#if defined(ORGAN16_LOCKSTEP_AVX2) && defined(__GNUC__)
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+LockstepIsa LockstepEngine::GetBestIsa()
+{
+    if (IsIsaSupported(LOCKSTEP_AVX2))
+        return LOCKSTEP_AVX2;
+    if (IsIsaSupported(LOCKSTEP_SSE2))
+        return LOCKSTEP_SSE2;
+    return LOCKSTEP_SCALAR;
+}
+
+const char* LockstepEngine::GetIsaName(LockstepIsa isa)
+{
+    switch (isa) {
+        case LOCKSTEP_SCALAR: return "scalar";
+        case LOCKSTEP_SSE2:   return "sse2";
+        case LOCKSTEP_AVX2:   return "avx2";
+        default:              return "?";
+    }
+}
+
+int LockstepEngine::GetIsaWidth(LockstepIsa isa)
+{
+    switch (isa) {
+        case LOCKSTEP_SSE2: return 4;
+        case LOCKSTEP_AVX2: return 8;
+        default:            return 1;
+    }
+}
+
+void LockstepEngine::SetIsa(LockstepIsa isa)
+{
+    this->isa = IsIsaSupported(isa) ? isa : GetBestIsa();
+}
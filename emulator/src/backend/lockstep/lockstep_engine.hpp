@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "lockstep_chunk.hpp"
+#include "../functional/functional_engine.hpp"
+#include "../memory/program_image.hpp"
+#include "../memory/memory_bus.hpp"
+
+enum LockstepIsa{
+    LOCKSTEP_SCALAR,
+    LOCKSTEP_SSE2,
+    LOCKSTEP_AVX2
+};
+
+// Runs many independent Organ16 machines on the same program, one per vector lane (structure of arrays).
+// The lanes execute in lockstep with per-lane masks from the program decoded once when it is loaded, so they
+// can take different branches and see different IN ports. Same instruction semantics and half-tick costs as FunctionalEngine, with the same limits :
+// a lane stops on HLT, an undocumented encoding or the end of its budget (no RTL fallback, no observer,
+// no framebuffer). There are no devices either : a lane stops before a store into the blitter or ST7735S pages,
+// or an IN3 (performance counters).
+class LockstepEngine{
+    private:
+        size_t laneCount;
+        size_t paddedCount;     // Multiple of LOCKSTEP_MAX_WIDTH, the padding lanes never run
+
+        LockstepIsa isa;
+
+        // One 64K word RAM per lane, plus a word so the fetch of PC 0xFFFF stays inside
+        static const size_t MEMORY_STRIDE = 65536 + 16;
+        std::vector<uint16_t> memory;
+
+        std::vector<uint32_t> regs[8];
+        std::vector<uint32_t> pc;
+        std::vector<uint32_t> sp;
+        std::vector<uint32_t> flags;
+        std::vector<uint32_t> ir1;
+        std::vector<uint32_t> addrLatched;
+        std::vector<uint32_t> rtsLatched;
+        std::vector<uint32_t> ports[3];
+        std::vector<uint32_t> consumed;
+        std::vector<uint32_t> budget;
+        std::vector<uint32_t> status;
+
+        // Half-ticks spent by each lane since the program was loaded
+        std::vector<uint64_t> halfTicks;
+
+        uint64_t instructionCount = 0;
+
+        // Every address of the program decoded, and the words a lane stored to since (LockstepChunk::written)
+        std::vector<LockstepInstruction> program;
+        std::vector<uint8_t> written;
+
+        uint32_t decodeTable[128] = {0};
+        uint32_t jumpMasks[16] = {0};
+        uint32_t devicePages[BUS_PAGE_COUNT] = {0};
+
+        LockstepChunk MakeChunk();
+
+    public:
+        explicit LockstepEngine(size_t laneCount);
+
+        LockstepEngine(const LockstepEngine&) = delete;
+        LockstepEngine& operator=(const LockstepEngine&) = delete;
+        LockstepEngine(LockstepEngine&&) = delete;
+        LockstepEngine& operator=(LockstepEngine&&) = delete;
+
+        // Copies image in every lane's RAM and resets them all (PC = the program's entry point, SP = 0xFFFF, ports cleared)
+        void LoadProgram(const ProgramImage& image);
+
+        void SetLaneInput(size_t lane, int port, uint16_t value);
+
+        // Runs every lane until it stops or spent maxHalfTicks more half-ticks.
+        // Lanes stopped by their budget carry on, the others stay stopped. Returns the instructions executed
+        uint64_t Run(uint64_t maxHalfTicks);
+
+        size_t GetLaneCount() const {
+            return laneCount;
+        }
+
+        ArchState GetLaneState(size_t lane) const;
+
+        const uint16_t* GetLaneMemory(size_t lane) const {
+            return memory.data() + lane * MEMORY_STRIDE;
+        }
+
+        // Last value set by SetLaneInput or OUT
+        uint16_t GetLanePort(size_t lane, int port) const {
+            return static_cast<uint16_t>(ports[port][lane]);
+        }
+
+        uint64_t GetLaneHalfTicks(size_t lane) const {
+            return halfTicks[lane];
+        }
+
+        // STOP_HALT, STOP_UNSUPPORTED or STOP_BUDGET (also for the lanes that never ran)
+        FunctionalStopReason GetLaneStopReason(size_t lane) const;
+
+        // Instructions executed by all the lanes together since the program was loaded
+        uint64_t GetInstructionCount() const {
+            return instructionCount;
+        }
+
+        // Widest instruction set this build and this CPU can use
+        static LockstepIsa GetBestIsa();
+
+        static bool IsIsaSupported(LockstepIsa isa);
+
+        static const char* GetIsaName(LockstepIsa isa);
+
+        static int GetIsaWidth(LockstepIsa isa);
+
+        LockstepIsa GetIsa() const {
+            return isa;
+        }
+
+        // Falls back to the best supported one when isa is not
+        void SetIsa(LockstepIsa isa);
+};
@@ -0,0 +1,615 @@
+#pragma once
+
+#include "lockstep_chunk.hpp"
+#include "lockstep_vectors.hpp"
+#include "../memory/memory_bus.hpp"
+
+// Lockstep interpreter, included once per instruction set (see lockstep_vectors.hpp for why it is file local).
+// Every step runs the instruction at the lowest PC of the running lanes, on the lanes at that PC : lanes that fell
+// behind on a branch run alone until they catch up with the others. The instruction comes decoded from the program
+// as loaded, so its operands index the register file directly. A word any lane stored to is not trusted anymore :
+// a step at such a PC fetches from each lane's RAM and runs each kind of instruction the lanes fetched over the
+// whole vector, masked to the lanes that fetched it. Lanes that stopped stay masked out until all of them did.
+namespace {
+
+    // The ALU operations (OpCode 0 and NOT) but DIV and MOD, on operands a and b
+    #define LOCKSTEP_ALU_OPERATIONS(X)                          \
+        X(KIND_ADD << 0, (a + b) & word)                        \
+        X(KIND_ADD << 1, (a - b) & word)                        \
+        X(KIND_ADD << 2, V::MulLo16(a, b))                      \
+        X(KIND_ADD << 5, a & b)                                 \
+        X(KIND_ADD << 6, a | b)                                 \
+        X(KIND_ADD << 7, V::CmpEq(a & b, zero) & one)           \
+        X(KIND_ADD << 8, V::CmpEq(a | b, zero) & one)           \
+        X(KIND_ADD << 9, a ^ b)                                 \
+        X(KIND_NOT, a ^ word)
+
+    inline int CountLanes(int bits)
+    {
+        int count = 0;
+        for (; bits != 0; bits &= bits - 1)
+            count++;
+        return count;
+    }
+
+    template<class V>
+    class LockstepKernel{
+        private:
+            static const int W = V::WIDTH;
+
+            const LockstepChunk& chunk;
+            const LockstepInstruction* program;
+            uint8_t* written;
+            int first = 0;          // First lane of the group
+            uint16_t* memory = nullptr;
+            V laneOffset;           // Lane i's RAM starts at memory + i * stride
+
+            // Every running lane is at groupPC
+            bool converged = false;
+            uint32_t groupPC = 0;
+
+            V regs[8];
+            V pc, sp, flags, ir1;
+            V addrLatched, rtsLatched;  // As masks
+            V ports[3];
+            V consumed, budget, status;
+
+            static V Splat(uint32_t value){
+                return V::Set1(value);
+            }
+
+            static bool Any(V mask){
+                return V::MoveMask(mask) != 0;
+            }
+
+            V ReadRegister(V number) const {
+                V value = regs[0];
+                for (uint32_t r = 1; r < 8; ++r)
+                    value = V::Select(V::CmpEq(number, Splat(r)), regs[r], value);
+                return value;
+            }
+
+            void WriteRegister(V mask, V number, V value){
+                for (uint32_t r = 0; r < 8; ++r)
+                    regs[r] = V::Select(mask & V::CmpEq(number, Splat(r)), value, regs[r]);
+            }
+
+            V ReadMemory(V address) const {
+                return V::GatherPair(memory, laneOffset + address) & Splat(0xFFFF);
+            }
+
+            void WriteMemory(V mask, V address, V value){
+                alignas(32) uint32_t addresses[W], values[W];
+                address.ToArray(addresses);
+                value.ToArray(values);
+                int bits = V::MoveMask(mask);
+                for (int lane = 0; lane < W; ++lane) {
+                    if (bits & (1 << lane)) {
+                        memory[static_cast<size_t>(lane) * chunk.memoryStride + addresses[lane]] = static_cast<uint16_t>(values[lane]);
+                        written[addresses[lane]] = 1;
+                    }
+                }
+            }
+
+            // The lanes have no devices : a lane storing into a device page is left out, the lanes left out are returned
+            V WriteMemoryOutsideDevices(V mask, V address, V value){
+                alignas(32) uint32_t addresses[W], values[W], device[W];
+                address.ToArray(addresses);
+                value.ToArray(values);
+                int bits = V::MoveMask(mask);
+                for (int lane = 0; lane < W; ++lane) {
+                    device[lane] = 0;
+                    if (bits & (1 << lane)) {
+                        if (chunk.devicePages[addresses[lane] >> BUS_PAGE_SHIFT] != 0) {
+                            device[lane] = 0xFFFFFFFF;
+                            continue;
+                        }
+                        memory[static_cast<size_t>(lane) * chunk.memoryStride + addresses[lane]] = static_cast<uint16_t>(values[lane]);
+                        written[addresses[lane]] = 1;
+                    }
+                }
+                return V::Load(device);
+            }
+
+            // No integer division in SSE / AVX
+            static V DivideLanes(V lanes, bool modulo, V a, V b, V result){
+                alignas(32) uint32_t as[W], bs[W], laneMasks[W], results[W];
+                a.ToArray(as);
+                b.ToArray(bs);
+                lanes.ToArray(laneMasks);
+                result.ToArray(results);
+                for (int lane = 0; lane < W; ++lane) {
+                    if (laneMasks[lane] != 0)
+                        results[lane] = bs[lane] == 0 ? 0 : modulo ? as[lane] % bs[lane] : as[lane] / bs[lane];
+                }
+                return V::Load(results);
+            }
+
+            // The ALU operation kind on every lane
+            static V Alu(uint32_t kind, V a, V b){
+                const V word = Splat(0xFFFF);
+                const V one = Splat(1);
+                const V zero = Splat(0);
+
+                #define ALU_CASE(bit, expression) case bit: return expression;
+                switch (kind) {
+                    LOCKSTEP_ALU_OPERATIONS(ALU_CASE)
+                    case KIND_DIV: return DivideLanes(V::CmpEq(zero, zero), false, a, b, zero);
+                    case KIND_MOD: return DivideLanes(V::CmpEq(zero, zero), true, a, b, zero);
+                    default:       return zero;
+                }
+                #undef ALU_CASE
+            }
+
+            // The ALU operations (OpCode 0 and NOT), kinds is 0 for the lanes left alone
+            static V Alu(V kinds, uint32_t present, V a, V b){
+                const V word = Splat(0xFFFF);
+                const V one = Splat(1);
+                const V zero = Splat(0);
+                V result = zero;
+
+                #define ALU_KIND(bit, expression)                                           \
+                    if (present & (bit))                                                    \
+                        result = V::Select(V::CmpEq(kinds, Splat(bit)), expression, result);
+                LOCKSTEP_ALU_OPERATIONS(ALU_KIND)
+                #undef ALU_KIND
+
+                if (present & KIND_DIV)
+                    result = DivideLanes(V::CmpEq(kinds, Splat(KIND_DIV)), false, a, b, result);
+                if (present & KIND_MOD)
+                    result = DivideLanes(V::CmpEq(kinds, Splat(KIND_MOD)), true, a, b, result);
+                return result;
+            }
+
+        public:
+            explicit LockstepKernel(const LockstepChunk& chunk) : chunk(chunk), program(chunk.program), written(chunk.written) {}
+
+            // Takes the W lanes starting at lane first
+            void Load(int first){
+                const V one = Splat(1);
+
+                this->first = first;
+                converged = false;
+                memory = chunk.memory + static_cast<size_t>(first) * chunk.memoryStride;
+                alignas(32) uint32_t offsets[W];
+                for (int lane = 0; lane < W; ++lane)
+                    offsets[lane] = static_cast<uint32_t>(lane) * chunk.memoryStride;
+                laneOffset = V::Load(offsets);
+
+                for (int r = 0; r < 8; ++r)
+                    regs[r] = V::Load(chunk.regs[r] + first);
+                pc = V::Load(chunk.pc + first);
+                sp = V::Load(chunk.sp + first);
+                flags = V::Load(chunk.flags + first);
+                ir1 = V::Load(chunk.ir1 + first);
+                addrLatched = V::CmpEq(V::Load(chunk.addrLatched + first), one);
+                rtsLatched = V::CmpEq(V::Load(chunk.rtsLatched + first), one);
+                for (int p = 0; p < 3; ++p)
+                    ports[p] = V::Load(chunk.ports[p] + first);
+                consumed = V::Load(chunk.consumed + first);
+                budget = V::Load(chunk.budget + first);
+                status = V::Load(chunk.status + first);
+            }
+
+            // One instruction on every running lane, fetched from its own RAM. False once none is running
+            bool StepFetched(uint64_t& retired){
+                const V word = Splat(0xFFFF);
+                const V one = Splat(1);
+                const V zero = Splat(0);
+
+                V active = V::CmpEq(status, Splat(LANE_RUNNING));
+                if (!Any(active))
+                    return false;
+
+
+                V fetched = V::GatherPair(memory, laneOffset + pc);
+                V instruction = fetched & word;
+                V ext = V::template Srl<16>(fetched);
+                V index = V::template Srl<9>(instruction);
+                // Lanes mostly fetch the same instruction : a single table read then
+                uint32_t firstIndex = V::FirstLane(index);
+                V decoded = V::MoveMask(V::AndNot(V::CmpEq(index, Splat(firstIndex)), active)) == 0
+                          ? Splat(chunk.decode[firstIndex])
+                          : V::Gather(chunk.decode, index);
+                V cost = V::template Srl<LOCKSTEP_HALF_TICKS_SHIFT>(decoded) & Splat(7);
+                V length = V::template Srl<LOCKSTEP_LENGTH_SHIFT>(decoded);
+
+                // HLT (index 0x70), undocumented encodings and extension words past the end of RAM stop the lane
+                V blocked = active & (V::CmpEq(cost, zero) | (V::CmpEq(length, Splat(2)) & V::CmpEq(pc, word)));
+                status = V::Select(blocked, V::Select(V::CmpEq(index, Splat(0x70)), Splat(LANE_HALT), Splat(LANE_UNSUPPORTED)), status);
+                active = V::AndNot(blocked, active);
+
+                V over = active & V::CmpGt(consumed + cost, budget);
+                status = V::Select(over, Splat(LANE_BUDGET), status);
+                active = V::AndNot(over, active);
+
+                int activeBits = V::MoveMask(active);
+                if (activeBits == 0)
+                    return true;
+
+                // Kind of every running lane (0 for the others), and every kind present
+                V kinds = decoded & Splat(KIND_ALL) & active;
+                uint32_t present = V::OrLanes(kinds);
+
+                V dst = V::template Srl<6>(instruction) & Splat(7);
+                V a = ReadRegister(V::template Srl<3>(instruction) & Splat(7));
+                V b = ReadRegister(instruction & Splat(7));
+
+                #define KIND_MASK(kind) V::CmpEq(kinds, Splat(kind))
+
+                // The lanes have no devices : a store into a device page stops the lane before the instruction
+                if (present & KIND_WRITES) {
+                    V target = V::Select(KIND_MASK(KIND_STORE), ext, V::Select(KIND_MASK(KIND_STORER), b, sp));
+                    V writes = V::CmpGt(kinds & Splat(KIND_WRITES), zero);
+                    V device = writes & V::CmpEq(V::Gather(chunk.devicePages, V::template Srl<BUS_PAGE_SHIFT>(target)), one);
+                    if (Any(device)) {
+                        status = V::Select(device, Splat(LANE_UNSUPPORTED), status);
+                        active = V::AndNot(device, active);
+                        kinds = kinds & active;
+                        activeBits = V::MoveMask(active);
+                        if (activeBits == 0)
+                            return true;
+                    }
+                }
+
+                retired += CountLanes(activeBits);
+                consumed = consumed + (cost & active);
+
+                // State after the instruction, for the lanes that don't say otherwise
+                V nextPC = (pc + length) & word;
+                V nextLatched = zero;
+                V nextRts = zero;
+
+                // ALU : with CURRENT_IS_ADDR_JSR left set, the destination is written on both edges
+                if (present & KIND_ALU) {
+                    V m = V::CmpGt(kinds & Splat(KIND_ALU), zero);
+                    WriteRegister(m, dst, Alu(kinds, present, a, b));
+                    V again = m & addrLatched;
+                    if (Any(again)) {
+                        V srcA = ReadRegister(V::template Srl<3>(instruction) & Splat(7));
+                        V srcB = ReadRegister(instruction & Splat(7));
+                        WriteRegister(again, dst, Alu(kinds & again, present, srcA, srcB));
+                    }
+                }
+
+                // CMP : Z, N and C of a - b (the ALU never sets O)
+                if (present & KIND_CMP) {
+                    V result = (a - b) & word;
+                    V value = (V::CmpEq(result, zero) & one) |
+                              V::template Sll<1>(V::template Srl<15>(result)) |
+                              (V::CmpGt(b, a) & Splat(4));
+                    flags = V::Select(KIND_MASK(KIND_CMP), value, flags);
+                }
+
+                if (present & KIND_MOV) {
+                    V m = KIND_MASK(KIND_MOV);
+                    ir1 = V::Select(m, ext, ir1);
+                    WriteRegister(m, dst, ext);
+                }
+
+                if (present & KIND_LOAD) {
+                    V m = KIND_MASK(KIND_LOAD);
+                    V value = ReadMemory(ext);
+                    ir1 = V::Select(m, value, ir1);
+                    WriteRegister(m, dst, value);
+                    nextLatched = nextLatched | m;
+                }
+
+                // IR1 ends up holding the word that was overwritten
+                if (present & KIND_STORE) {
+                    V m = KIND_MASK(KIND_STORE);
+                    ir1 = V::Select(m, ReadMemory(ext), ir1);
+                    WriteMemory(m, ext, a);
+                    nextLatched = nextLatched | m;
+                }
+
+                if (present & KIND_STORER)
+                    WriteMemory(KIND_MASK(KIND_STORER), b, a);
+
+                if (present & KIND_LOADR)
+                    WriteRegister(KIND_MASK(KIND_LOADR), dst, ReadMemory(b));
+
+                if (present & KIND_JMP) {
+                    V m = KIND_MASK(KIND_JMP);
+                    ir1 = V::Select(m, ext, ir1);
+                    nextPC = V::Select(m, ext, nextPC);
+                    nextLatched = nextLatched | m;
+                }
+
+                // Jcc : the lanes diverge here, each keeps its own PC
+                if (present & KIND_JCC) {
+                    V m = KIND_MASK(KIND_JCC);
+                    ir1 = V::Select(m, ext, ir1);
+                    V conditions = V::Lookup16(chunk.jumpMasks, index & Splat(15));
+                    V taken = m & V::CmpEq(V::SrlVar(conditions, flags) & one, one);
+                    nextPC = V::Select(taken, ext, nextPC);
+                    nextLatched = nextLatched | taken;
+                }
+
+                // The target is read after the push : pushed over its own extension word, JSR jumps to the word written
+                if (present & KIND_JSR) {
+                    V m = KIND_MASK(KIND_JSR);
+                    V returnPC = (pc + Splat(2)) & word;
+                    V target = V::Select(V::CmpEq(sp, (pc + one) & word), returnPC, ext);
+                    ir1 = V::Select(m, target, ir1);
+                    WriteMemory(m, sp, returnPC);
+                    sp = V::Select(m, (sp - one) & word, sp);
+                    nextPC = V::Select(m, target, nextPC);
+                    nextLatched = nextLatched | m;
+                }
+
+                if (present & KIND_RTS) {
+                    V m = KIND_MASK(KIND_RTS);
+                    V top = (sp + one) & word;
+                    V value = ReadMemory(top);
+                    sp = V::Select(m, top, sp);
+                    ir1 = V::Select(m, value, ir1);
+                    nextPC = V::Select(m, value, nextPC);
+                    nextRts = nextRts | m;
+                }
+
+                if (present & KIND_PUSH) {
+                    V m = KIND_MASK(KIND_PUSH);
+                    WriteMemory(m, sp, a);
+                    sp = V::Select(m, (sp - one) & word, sp);
+                }
+
+                if (present & KIND_POP) {
+                    V m = KIND_MASK(KIND_POP);
+                    V top = (sp + one) & word;
+                    V value = ReadMemory(top);
+                    sp = V::Select(m, top, sp);
+                    ir1 = V::Select(m, value, ir1);
+                    WriteRegister(m, dst, value);
+                    nextLatched = nextLatched | m;
+                }
+
+                // IN 1-3 and OUT 4-6 share the three port latches
+                if (present & (KIND_IN | KIND_OUT)) {
+                    V sub = index & Splat(15);
+                    V in = KIND_MASK(KIND_IN);
+                    V out = KIND_MASK(KIND_OUT);
+                    for (uint32_t p = 0; p < 3; ++p) {
+                        V reads = in & V::CmpEq(sub, Splat(1 + p));
+                        if (Any(reads))
+                            WriteRegister(reads, dst, ports[p]);
+                        ports[p] = V::Select(out & V::CmpEq(sub, Splat(4 + p)), a, ports[p]);
+                    }
+                }
+
+                #undef KIND_MASK
+
+                pc = V::Select(active, nextPC, pc);
+                addrLatched = V::Select(active, nextLatched, addrLatched);
+                rtsLatched = V::Select(active, nextRts, rtsLatched);
+                return true;
+            }
+
+            // One instruction on the running lanes at the lowest PC, false once none is running
+            bool Step(uint64_t& retired){
+                const V word = Splat(0xFFFF);
+                const V one = Splat(1);
+                const V zero = Splat(0);
+
+                V active = V::CmpEq(status, Splat(LANE_RUNNING));
+                int activeBits = V::MoveMask(active);
+                if (activeBits == 0)
+                    return false;
+
+                uint32_t address = converged ? groupPC : V::MinLanes(V::Select(active, pc, Splat(0xFFFFFFFF)));
+                V lanes = converged ? active : active & V::CmpEq(pc, Splat(address));
+                converged = false;
+
+                const LockstepInstruction& instruction = program[address];
+                uint32_t kind = instruction.decoded & KIND_ALL;
+                uint32_t cost = (instruction.decoded >> LOCKSTEP_HALF_TICKS_SHIFT) & 7;
+                uint32_t length = instruction.decoded >> LOCKSTEP_LENGTH_SHIFT;
+                if (written[address] != 0 || (length == 2 && written[address + 1] != 0))
+                    return StepFetched(retired);
+
+                // HLT (index 0x70), undocumented encodings and extension words past the end of RAM stop the lanes
+                if (cost == 0 || (length == 2 && address == 0xFFFF)) {
+                    status = V::Select(lanes, Splat(instruction.index == 0x70 ? LANE_HALT : LANE_UNSUPPORTED), status);
+                    return true;
+                }
+
+                V over = lanes & V::CmpGt(consumed + Splat(cost), budget);
+                if (Any(over)) {
+                    status = V::Select(over, Splat(LANE_BUDGET), status);
+                    lanes = V::AndNot(over, lanes);
+                    if (!Any(lanes))
+                        return true;
+                }
+
+                V& dst = regs[instruction.dst];
+                V a = regs[instruction.srcA];
+                V b = regs[instruction.srcB];
+                V ext = Splat(instruction.ext);
+                uint32_t nextPC = (address + length) & 0xFFFF;
+                V laneNextPC;           // Where the lanes go when they don't all go to nextPC
+                bool diverged = false;
+                V latched = zero;       // The lanes leaving CURRENT_IS_ADDR_JSR set
+                V stopped = zero;       // The lanes that stored into a device page (before the instruction)
+
+                switch (kind) {
+                    // ALU : with CURRENT_IS_ADDR_JSR left set, the destination is written on both edges
+                    case KIND_ADD << 0: case KIND_ADD << 1: case KIND_ADD << 2: case KIND_DIV: case KIND_MOD:
+                    case KIND_ADD << 5: case KIND_ADD << 6: case KIND_ADD << 7: case KIND_ADD << 8: case KIND_ADD << 9:
+                    case KIND_NOT: {
+                        dst = V::Select(lanes, Alu(kind, a, b), dst);
+                        V again = lanes & addrLatched;
+                        if (Any(again))
+                            dst = V::Select(again, Alu(kind, regs[instruction.srcA], regs[instruction.srcB]), dst);
+                        break;
+                    }
+
+                    // CMP : Z, N and C of a - b (the ALU never sets O)
+                    case KIND_CMP: {
+                        V result = (a - b) & word;
+                        V value = (V::CmpEq(result, zero) & one) |
+                                  V::template Sll<1>(V::template Srl<15>(result)) |
+                                  (V::CmpGt(b, a) & Splat(4));
+                        flags = V::Select(lanes, value, flags);
+                        break;
+                    }
+
+                    case KIND_MOV:
+                        ir1 = V::Select(lanes, ext, ir1);
+                        dst = V::Select(lanes, ext, dst);
+                        break;
+
+                    case KIND_LOAD: {
+                        V value = ReadMemory(ext);
+                        ir1 = V::Select(lanes, value, ir1);
+                        dst = V::Select(lanes, value, dst);
+                        latched = lanes;
+                        break;
+                    }
+
+                    // IR1 ends up holding the word that was overwritten
+                    case KIND_STORE:
+                        if (chunk.devicePages[instruction.ext >> BUS_PAGE_SHIFT] != 0) {
+                            stopped = lanes;
+                            break;
+                        }
+                        ir1 = V::Select(lanes, ReadMemory(ext), ir1);
+                        WriteMemory(lanes, ext, a);
+                        latched = lanes;
+                        break;
+
+                    case KIND_STORER:
+                        stopped = WriteMemoryOutsideDevices(lanes, b, a);
+                        break;
+
+                    case KIND_LOADR:
+                        dst = V::Select(lanes, ReadMemory(b), dst);
+                        break;
+
+                    case KIND_JMP:
+                        ir1 = V::Select(lanes, ext, ir1);
+                        nextPC = instruction.ext;
+                        latched = lanes;
+                        break;
+
+                    // Jcc : the lanes diverge here when only some of them jump
+                    case KIND_JCC: {
+                        ir1 = V::Select(lanes, ext, ir1);
+                        V condition = Splat(chunk.jumpMasks[instruction.index & 15]);
+                        latched = lanes & V::CmpEq(V::SrlVar(condition, flags) & one, one);
+                        int taken = V::MoveMask(latched);
+                        if (taken != 0 && taken == V::MoveMask(lanes))
+                            nextPC = instruction.ext;
+                        else if (taken != 0) {
+                            laneNextPC = V::Select(latched, ext, Splat(nextPC));
+                            diverged = true;
+                        }
+                        break;
+                    }
+
+                    // The target is read after the push : pushed over its own extension word, JSR jumps to the word written
+                    case KIND_JSR: {
+                        V returnPC = Splat(nextPC);
+                        V target = V::Select(V::CmpEq(sp, Splat((address + 1) & 0xFFFF)), returnPC, ext);
+                        stopped = WriteMemoryOutsideDevices(lanes, sp, returnPC);
+                        V pushed = V::AndNot(stopped, lanes);
+                        ir1 = V::Select(pushed, target, ir1);
+                        sp = V::Select(pushed, (sp - one) & word, sp);
+                        laneNextPC = target;
+                        diverged = true;
+                        latched = pushed;
+                        break;
+                    }
+
+                    case KIND_RTS: {
+                        V top = (sp + one) & word;
+                        V value = ReadMemory(top);
+                        sp = V::Select(lanes, top, sp);
+                        ir1 = V::Select(lanes, value, ir1);
+                        laneNextPC = value;
+                        diverged = true;
+                        break;
+                    }
+
+                    case KIND_PUSH:
+                        stopped = WriteMemoryOutsideDevices(lanes, sp, a);
+                        sp = V::Select(V::AndNot(stopped, lanes), (sp - one) & word, sp);
+                        break;
+
+                    case KIND_POP: {
+                        V top = (sp + one) & word;
+                        V value = ReadMemory(top);
+                        sp = V::Select(lanes, top, sp);
+                        ir1 = V::Select(lanes, value, ir1);
+                        dst = V::Select(lanes, value, dst);
+                        latched = lanes;
+                        break;
+                    }
+
+                    // IN 1-3 and OUT 4-6 share the three port latches
+                    case KIND_IN:
+                        dst = V::Select(lanes, ports[(instruction.index & 15) - 1], dst);
+                        break;
+
+                    case KIND_OUT: {
+                        V& port = ports[(instruction.index & 15) - 4];
+                        port = V::Select(lanes, a, port);
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+
+                if (Any(stopped)) {
+                    status = V::Select(stopped, Splat(LANE_UNSUPPORTED), status);
+                    lanes = V::AndNot(stopped, lanes);
+                }
+
+                int laneBits = V::MoveMask(lanes);
+                retired += CountLanes(laneBits);
+                consumed = consumed + (Splat(cost) & lanes);
+                pc = V::Select(lanes, diverged ? laneNextPC : Splat(nextPC), pc);
+                addrLatched = V::AndNot(lanes, addrLatched) | latched;
+                rtsLatched = kind == KIND_RTS ? rtsLatched | lanes : V::AndNot(lanes, rtsLatched);
+
+                // Every lane that was running ran this one and went to the same place
+                converged = laneBits == activeBits && !diverged;
+                groupPC = nextPC;
+                return true;
+            }
+
+            // Writes the group back
+            void Store(){
+                const V one = Splat(1);
+
+                for (int r = 0; r < 8; ++r)
+                    regs[r].Store(chunk.regs[r] + first);
+                pc.Store(chunk.pc + first);
+                sp.Store(chunk.sp + first);
+                flags.Store(chunk.flags + first);
+                ir1.Store(chunk.ir1 + first);
+                (addrLatched & one).Store(chunk.addrLatched + first);
+                (rtsLatched & one).Store(chunk.rtsLatched + first);
+                for (int p = 0; p < 3; ++p)
+                    ports[p].Store(chunk.ports[p] + first);
+                consumed.Store(chunk.consumed + first);
+                status.Store(chunk.status + first);
+            }
+    };
+
+    template<class V>
+    uint64_t RunLockstepLanes(const LockstepChunk& chunk, int count)
+    {
+        uint64_t retired = 0;
+        LockstepKernel<V> kernel(chunk);
+        for (int lane = 0; lane < count; lane += V::WIDTH) {
+            kernel.Load(lane);
+            while (kernel.Step(retired)) {}
+            kernel.Store();
+        }
+        return retired;
+    }
+
+    #undef LOCKSTEP_ALU_OPERATIONS
+
+}
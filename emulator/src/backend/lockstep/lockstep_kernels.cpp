@@ -0,0 +1,15 @@
+#include "lockstep_kernel.hpp"
+
+uint64_t RunLockstepScalar(const LockstepChunk& chunk, int count)
+{
+    return RunLockstepLanes<ScalarLanes>(chunk, count);
+}
+
+uint64_t RunLockstepSse2(const LockstepChunk& chunk, int count)
+{
+#if defined(__SSE2__)
+    return RunLockstepLanes<Sse2Lanes>(chunk, count);
+#else
+    return RunLockstepLanes<ScalarLanes>(chunk, count);
+#endif
+}
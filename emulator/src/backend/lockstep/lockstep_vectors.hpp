@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Vectors of 32-bit lanes for the lockstep kernels, one machine per lane.
+// Masks are vectors too (every bit of a lane set or clear). Memory reads are gathers of 2 consecutive words
+// (an instruction and its extension word in one go), writes are always done lane by lane.
+// Everything stays in an anonymous namespace : each instruction set is built in its own translation unit
+// with its own compiler flags, the linker must never merge their copies.
+namespace {
+
+    // One lane, the reference the vector backends must match
+    struct ScalarLanes{
+        static const int WIDTH = 1;
+        uint32_t v;
+
+        static ScalarLanes Set1(uint32_t value){ return {value}; }
+        static ScalarLanes Load(const uint32_t* source){ return {source[0]}; }
+        void Store(uint32_t* destination) const { destination[0] = v; }
+        void ToArray(uint32_t* destination) const { destination[0] = v; }
+
+        friend ScalarLanes operator+(ScalarLanes a, ScalarLanes b){ return {a.v + b.v}; }
+        friend ScalarLanes operator-(ScalarLanes a, ScalarLanes b){ return {a.v - b.v}; }
+        friend ScalarLanes operator&(ScalarLanes a, ScalarLanes b){ return {a.v & b.v}; }
+        friend ScalarLanes operator|(ScalarLanes a, ScalarLanes b){ return {a.v | b.v}; }
+        friend ScalarLanes operator^(ScalarLanes a, ScalarLanes b){ return {a.v ^ b.v}; }
+
+        // ~mask & value
+        static ScalarLanes AndNot(ScalarLanes mask, ScalarLanes value){ return {~mask.v & value.v}; }
+        static ScalarLanes CmpEq(ScalarLanes a, ScalarLanes b){ return {a.v == b.v ? 0xFFFFFFFFu : 0u}; }
+        // Signed compare a > b
+        static ScalarLanes CmpGt(ScalarLanes a, ScalarLanes b){ return {static_cast<int32_t>(a.v) > static_cast<int32_t>(b.v) ? 0xFFFFFFFFu : 0u}; }
+        // mask ? a : b
+        static ScalarLanes Select(ScalarLanes mask, ScalarLanes a, ScalarLanes b){ return {(mask.v & a.v) | (~mask.v & b.v)}; }
+        // Low 16 bits of a * b (both below 2^16)
+        static ScalarLanes MulLo16(ScalarLanes a, ScalarLanes b){ return {(a.v * b.v) & 0xFFFF}; }
+        template<int N> static ScalarLanes Srl(ScalarLanes a){ return {a.v >> N}; }
+        template<int N> static ScalarLanes Sll(ScalarLanes a){ return {a.v << N}; }
+        static ScalarLanes SrlVar(ScalarLanes a, ScalarLanes count){ return {a.v >> count.v}; }
+        // One bit per lane
+        static int MoveMask(ScalarLanes mask){ return static_cast<int>(mask.v & 1); }
+        // Every lane ORed together
+        static uint32_t OrLanes(ScalarLanes a){ return a.v; }
+        static uint32_t FirstLane(ScalarLanes a){ return a.v; }
+        // Smallest lane, unsigned
+        static uint32_t MinLanes(ScalarLanes a){ return a.v; }
+        // table[index] for index < 16
+        static ScalarLanes Lookup16(const uint32_t* table, ScalarLanes index){ return {table[index.v]}; }
+        static ScalarLanes Gather(const uint32_t* table, ScalarLanes index){ return {table[index.v]}; }
+        // memory[index] | memory[index + 1] << 16
+        static ScalarLanes GatherPair(const uint16_t* memory, ScalarLanes index){
+            return {static_cast<uint32_t>(memory[index.v]) | (static_cast<uint32_t>(memory[index.v + 1]) << 16)};
+        }
+    };
+
+#if defined(__SSE2__)
+    // 4 lanes, SSE2 has no gathers nor variable shifts : those go through the lanes one by one
+    struct Sse2Lanes{
+        static const int WIDTH = 4;
+        __m128i v;
+
+        static Sse2Lanes Set1(uint32_t value){ return {_mm_set1_epi32(static_cast<int>(value))}; }
+        static Sse2Lanes Load(const uint32_t* source){ return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(source))}; }
+        void Store(uint32_t* destination) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), v); }
+        void ToArray(uint32_t* destination) const { Store(destination); }
+
+        friend Sse2Lanes operator+(Sse2Lanes a, Sse2Lanes b){ return {_mm_add_epi32(a.v, b.v)}; }
+        friend Sse2Lanes operator-(Sse2Lanes a, Sse2Lanes b){ return {_mm_sub_epi32(a.v, b.v)}; }
+        friend Sse2Lanes operator&(Sse2Lanes a, Sse2Lanes b){ return {_mm_and_si128(a.v, b.v)}; }
+        friend Sse2Lanes operator|(Sse2Lanes a, Sse2Lanes b){ return {_mm_or_si128(a.v, b.v)}; }
+        friend Sse2Lanes operator^(Sse2Lanes a, Sse2Lanes b){ return {_mm_xor_si128(a.v, b.v)}; }
+
+        static Sse2Lanes AndNot(Sse2Lanes mask, Sse2Lanes value){ return {_mm_andnot_si128(mask.v, value.v)}; }
+        static Sse2Lanes CmpEq(Sse2Lanes a, Sse2Lanes b){ return {_mm_cmpeq_epi32(a.v, b.v)}; }
+        static Sse2Lanes CmpGt(Sse2Lanes a, Sse2Lanes b){ return {_mm_cmpgt_epi32(a.v, b.v)}; }
+        static Sse2Lanes Select(Sse2Lanes mask, Sse2Lanes a, Sse2Lanes b){
+            return {_mm_or_si128(_mm_and_si128(mask.v, a.v), _mm_andnot_si128(mask.v, b.v))};
+        }
+        // The upper halves of both operands are 0, so are the upper halves of the 16-bit products
+        static Sse2Lanes MulLo16(Sse2Lanes a, Sse2Lanes b){ return {_mm_mullo_epi16(a.v, b.v)}; }
+        template<int N> static Sse2Lanes Srl(Sse2Lanes a){ return {_mm_srli_epi32(a.v, N)}; }
+        template<int N> static Sse2Lanes Sll(Sse2Lanes a){ return {_mm_slli_epi32(a.v, N)}; }
+        static Sse2Lanes SrlVar(Sse2Lanes a, Sse2Lanes count){
+            alignas(16) uint32_t values[WIDTH], counts[WIDTH];
+            a.ToArray(values);
+            count.ToArray(counts);
+            for (int i = 0; i < WIDTH; ++i)
+                values[i] >>= counts[i];
+            return Load(values);
+        }
+        static int MoveMask(Sse2Lanes mask){ return _mm_movemask_ps(_mm_castsi128_ps(mask.v)); }
+        static uint32_t OrLanes(Sse2Lanes a){
+            __m128i half = _mm_or_si128(a.v, _mm_shuffle_epi32(a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_or_si128(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)))));
+        }
+        static uint32_t FirstLane(Sse2Lanes a){ return static_cast<uint32_t>(_mm_cvtsi128_si32(a.v)); }
+        // No unsigned min before SSE4.1
+        static uint32_t MinLanes(Sse2Lanes a){
+            alignas(16) uint32_t values[WIDTH];
+            a.ToArray(values);
+            uint32_t smallest = values[0];
+            for (int i = 1; i < WIDTH; ++i)
+                smallest = values[i] < smallest ? values[i] : smallest;
+            return smallest;
+        }
+        static Sse2Lanes Lookup16(const uint32_t* table, Sse2Lanes index){ return Gather(table, index); }
+        static Sse2Lanes Gather(const uint32_t* table, Sse2Lanes index){
+            alignas(16) uint32_t indexes[WIDTH];
+            index.ToArray(indexes);
+            return {_mm_setr_epi32(static_cast<int>(table[indexes[0]]), static_cast<int>(table[indexes[1]]),
+                                   static_cast<int>(table[indexes[2]]), static_cast<int>(table[indexes[3]]))};
+        }
+        static Sse2Lanes GatherPair(const uint16_t* memory, Sse2Lanes index){
+            alignas(16) uint32_t indexes[WIDTH], values[WIDTH];
+            index.ToArray(indexes);
+            for (int i = 0; i < WIDTH; ++i)
+                values[i] = static_cast<uint32_t>(memory[indexes[i]]) | (static_cast<uint32_t>(memory[indexes[i] + 1]) << 16);
+            return Load(values);
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    // 8 lanes with hardware gathers (there is no scatter before AVX-512)
+    struct Avx2Lanes{
+        static const int WIDTH = 8;
+        __m256i v;
+
+        static Avx2Lanes Set1(uint32_t value){ return {_mm256_set1_epi32(static_cast<int>(value))}; }
+        static Avx2Lanes Load(const uint32_t* source){ return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source))}; }
+        void Store(uint32_t* destination) const { _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), v); }
+        void ToArray(uint32_t* destination) const { Store(destination); }
+
+        friend Avx2Lanes operator+(Avx2Lanes a, Avx2Lanes b){ return {_mm256_add_epi32(a.v, b.v)}; }
+        friend Avx2Lanes operator-(Avx2Lanes a, Avx2Lanes b){ return {_mm256_sub_epi32(a.v, b.v)}; }
+        friend Avx2Lanes operator&(Avx2Lanes a, Avx2Lanes b){ return {_mm256_and_si256(a.v, b.v)}; }
+        friend Avx2Lanes operator|(Avx2Lanes a, Avx2Lanes b){ return {_mm256_or_si256(a.v, b.v)}; }
+        friend Avx2Lanes operator^(Avx2Lanes a, Avx2Lanes b){ return {_mm256_xor_si256(a.v, b.v)}; }
+
+        static Avx2Lanes AndNot(Avx2Lanes mask, Avx2Lanes value){ return {_mm256_andnot_si256(mask.v, value.v)}; }
+        static Avx2Lanes CmpEq(Avx2Lanes a, Avx2Lanes b){ return {_mm256_cmpeq_epi32(a.v, b.v)}; }
+        static Avx2Lanes CmpGt(Avx2Lanes a, Avx2Lanes b){ return {_mm256_cmpgt_epi32(a.v, b.v)}; }
+        static Avx2Lanes Select(Avx2Lanes mask, Avx2Lanes a, Avx2Lanes b){ return {_mm256_blendv_epi8(b.v, a.v, mask.v)}; }
+        static Avx2Lanes MulLo16(Avx2Lanes a, Avx2Lanes b){ return {_mm256_mullo_epi16(a.v, b.v)}; }
+        template<int N> static Avx2Lanes Srl(Avx2Lanes a){ return {_mm256_srli_epi32(a.v, N)}; }
+        template<int N> static Avx2Lanes Sll(Avx2Lanes a){ return {_mm256_slli_epi32(a.v, N)}; }
+        static Avx2Lanes SrlVar(Avx2Lanes a, Avx2Lanes count){ return {_mm256_srlv_epi32(a.v, count.v)}; }
+        static int MoveMask(Avx2Lanes mask){ return _mm256_movemask_ps(_mm256_castsi256_ps(mask.v)); }
+        static uint32_t OrLanes(Avx2Lanes a){
+            __m128i half = _mm_or_si128(_mm256_castsi256_si128(a.v), _mm256_extracti128_si256(a.v, 1));
+            half = _mm_or_si128(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_or_si128(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)))));
+        }
+        static uint32_t FirstLane(Avx2Lanes a){ return static_cast<uint32_t>(_mm256_cvtsi256_si32(a.v)); }
+        static uint32_t MinLanes(Avx2Lanes a){
+            __m128i half = _mm_min_epu32(_mm256_castsi256_si128(a.v), _mm256_extracti128_si256(a.v, 1));
+            half = _mm_min_epu32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_min_epu32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)))));
+        }
+        // Two in-register permutes instead of a gather (far longer latency on most cores)
+        static Avx2Lanes Lookup16(const uint32_t* table, Avx2Lanes index){
+            __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(table)), index.v);
+            __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(table + 8)), index.v);
+            return Select(CmpGt(index, Set1(7)), {high}, {low});
+        }
+        static Avx2Lanes Gather(const uint32_t* table, Avx2Lanes index){
+            return {_mm256_i32gather_epi32(reinterpret_cast<const int*>(table), index.v, 4)};
+        }
+        // Word indexes with a scale of 2 : each 32-bit load covers the word and the next one
+        static Avx2Lanes GatherPair(const uint16_t* memory, Avx2Lanes index){
+            return {_mm256_i32gather_epi32(reinterpret_cast<const int*>(memory), index.v, 2)};
+        }
+    };
+#endif
+
+}
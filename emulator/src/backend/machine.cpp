@@ -0,0 +1,107 @@
+#include "machine.hpp"
+
+Machine::Machine()
+    : clock(state),
+      registers(state),
+      temporaryValues(state),
+      jitCompiler(*this),
+      blockCache(jitCompiler, perfCounters, heatmap),
+      ram(blockCache, observer),
+      bus(ram, blockCache),
+      framebuffer(ram),
+      blitter(ram, bus),
+      lcd(ram, bus, ioPorts),
+      memoryInterface(bus, state),
+      functionalEngine(*this),
+      cpu(*this),
+      traceRecorder(*this),
+      heatmap(bus),
+      debugger(*this)
+{
+    // Nothing else is mapped yet
+    std::string error;
+    framebuffer.Attach(bus, error);
+    blitter.Attach(error);
+    lcd.Attach(error);
+}
+
+void Machine::LoadProgram(const ProgramImage& program)
+{
+    cpu.Reset();
+    bus.Load(program);
+    cpu.Init();
+    if (program.HasEntry()) {
+        ArchState start = cpu.CaptureArchState();
+        start.PC = program.GetEntry();
+        cpu.RestoreArchState(start);
+    }
+}
+
+void Machine::SetInput(int port, uint16_t value)
+{
+    ioPorts.SetPortValue(port, value);
+    if (traceRecorder.IsRecording())
+        traceRecorder.RecordInput(port, value);
+}
+
+MachineState Machine::CaptureState()
+{
+    MachineState captured;
+    captured.cpu = state;
+    CPULatches latches = cpu.GetLatches();
+    captured.halfTicks = latches.halfTicks;
+    captured.busAddress = latches.busAddress;
+    captured.oldRAMvalue = latches.oldRAMvalue;
+    for (int p = 0; p < IO_PORT_COUNT; ++p)
+        captured.ports[p] = ioPorts.GetIN(p);
+    captured.devices = bus.SaveDevices();
+    return captured;
+}
+
+void Machine::RestoreState(const MachineState& restored, const uint16_t* memory)
+{
+    bus.Load(memory);
+    bus.RestoreDevices(restored.devices);
+    state = restored.cpu;
+    cpu.SetLatches({restored.halfTicks, restored.busAddress, restored.oldRAMvalue});
+    for (int p = 0; p < IO_PORT_COUNT; ++p)
+        ioPorts.SetPortValue(p, restored.ports[p]);
+
+    if (traceRecorder.IsRecording())
+        traceRecorder.OnRestart();
+    PublishSnapshot();
+}
+
+void Machine::PublishSnapshot()
+{
+    MachineSnapshot& snapshot = snapshots.Back();
+    snapshot.cpu = state;
+    for (int p = 0; p < IO_PORT_COUNT; ++p)
+        snapshot.ports[p] = ioPorts.GetIN(p);
+    snapshot.busAddress = cpu.GetBusAddress();
+    snapshot.halfTicks = cpu.GetHalfTicks();
+    snapshot.halted = cpu.IsHalted();
+    snapshot.perf = ReadPerfCounters();
+
+    // The rows the RAM viewer shows, so it never reads the RAM while the Machine writes it
+    snapshots.GetRAMWindow(snapshot.ramFirstRow, snapshot.ramRows);
+    std::copy_n(ram.Data() + snapshot.ramFirstRow * SNAPSHOT_RAM_ROW_WORDS, snapshot.ramRows * SNAPSHOT_RAM_ROW_WORDS, snapshot.ram);
+    // Every plane, the heatmap window draws the whole address space
+    if (heatmap.IsEnabled())
+        snapshot.heat.assign(heatmap.GetCounts(HEAT_READ), heatmap.GetCounts(HEAT_READ) + HEAT_KIND_COUNT * HEATMAP_WORDS);
+    else
+        snapshot.heat.clear();
+    snapshots.Publish();
+}
+
+const PerfCounters& Machine::ReadPerfCounters()
+{
+    blockCache.FlushPerfCounts();
+    return perfCounters;
+}
+
+void Machine::ResetPerfCounters()
+{
+    blockCache.FlushPerfCounts();
+    perfCounters.Reset();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "cpu.hpp"
+#include "machine_state.hpp"
+#include "snapshot/snapshot_buffer.hpp"
+#include "perf/perf_counters.hpp"
+#include "perf/access_heatmap.hpp"
+#include "profiler/sampling_profiler.hpp"
+#include "trace/trace_recorder.hpp"
+#include "trace/flight_recorder.hpp"
+#include "debug/debugger.hpp"
+#include "memory/program_image.hpp"
+#include "memory/framebuffer.hpp"
+#include "memory/blitter.hpp"
+#include "io/st7735s.hpp"
+
+// One whole Organ16 computer : every piece of state (registers, RAM, decoded blocks, translated code...) lives in the object.
+// Machines are independent, several of them can run at the same time, one per thread.
+// The components keep references to their siblings, so a Machine stays where it was built (no copy, no move)
+class Machine{
+    private:
+        // Notified of the visible state changes, components hold a reference to this slot (nullptr = nobody is watching)
+        EmulatorObserver* observer = nullptr;
+
+    public:
+        // Latched state of the RTL model, shared by the clock, the registers, the temporary values and the memory interface
+        CPUState state;
+
+        Clock clock;
+        ALU alu;
+        ControlUnit controlUnit;
+        RegisterFile registers;
+        TemporaryValues temporaryValues;
+        IOPorts ioPorts;
+
+        // Event counts of every engine (read them through ReadPerfCounters(), the decoded blocks hold some back)
+        PerfCounters perfCounters;
+
+        JitCompiler jitCompiler;
+        BlockCache blockCache;
+        RAM ram;
+
+        // Page table of the address space : plain RAM or memory mapped devices
+        MemoryBus bus;
+        Framebuffer framebuffer;
+        Blitter blitter;
+
+        // ST7735S display controller, memory mapped (and on an OUT port once SetSpiPort() wires it)
+        St7735s lcd;
+
+        MemoryInterface memoryInterface;
+        FunctionalEngine functionalEngine;
+        CPU cpu;
+
+        // Latest state for the GUI, published by the thread running the Machine
+        SnapshotBuffer snapshots;
+
+        // Guest PC histogram, CPU::Run samples it while it runs
+        SamplingProfiler profiler;
+
+        // Inputs and keyframes of the run, CPU::Run stops at the keyframes while it records
+        TraceRecorder traceRecorder;
+
+        // Last instructions executed, CPU::Run fills it while it is enabled
+        FlightRecorder flightRecorder;
+
+        // Reads, writes and fetches per address, counted on the bus and the decoded blocks while it is enabled
+        AccessHeatmap heatmap;
+
+        // Breakpoints and watches, CPU::Run stops on them
+        Debugger debugger;
+
+        Machine();
+
+        Machine(const Machine&) = delete;
+        Machine& operator=(const Machine&) = delete;
+        Machine(Machine&&) = delete;
+        Machine& operator=(Machine&&) = delete;
+
+        // nullptr detaches the observer, the components then skip every notification
+        void SetObserver(EmulatorObserver* newObserver){
+            observer = newObserver;
+        }
+
+        EmulatorObserver* GetObserver() const {
+            return observer;
+        }
+
+        // Everything but the RAM, in one call
+        MachineState CaptureState();
+
+        // Puts back a state with its RAM (ADDRESS_SPACE words), the devices' state included
+        void RestoreState(const MachineState& state, const uint16_t* memory);
+
+        // Resets the CPU, loads the program in the RAM and starts it at its entry point
+        void LoadProgram(const ProgramImage& program);
+
+        // IN port value set from outside the CPU (GUI, CLI), recorded in the trace
+        void SetInput(int port, uint16_t value);
+
+        // Copies the registers, flip-flops, IO ports and performance counters into the snapshot buffer
+        void PublishSnapshot();
+
+        // Up to date performance counters
+        const PerfCounters& ReadPerfCounters();
+
+        void ResetPerfCounters();
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_state.hpp"
+#include "io/io_ports.hpp"
+
+// Whole machine state but the RAM : the RTL model's latches (registers, flags, temporary values, memory interface
+// and clock flip-flops), the CPU's own latches, the IO ports and the memory mapped devices' own state.
+// Taken and put back by Machine::CaptureState / RestoreState
+struct MachineState{
+    CPUState cpu;
+    uint64_t halfTicks = 0;
+    uint16_t busAddress = 0;
+    uint16_t oldRAMvalue = 0;
+    std::array<uint16_t, IO_PORT_COUNT> ports{};
+
+    // MemoryBus::SaveDevices()
+    std::vector<std::vector<uint16_t>> devices;
+};
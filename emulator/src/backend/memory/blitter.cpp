@@ -0,0 +1,68 @@
+#include "blitter.hpp"
+
+bool Blitter::Attach(std::string& error)
+{
+    return bus.Map(this, BLITTER_START, BLITTER_END - 1, BUS_WRITE, error);
+}
+
+void Blitter::SaveState(std::vector<uint16_t>& words) const
+{
+    PutStateCounter(words, transfers);
+    PutStateCounter(words, cycles);
+}
+
+void Blitter::RestoreState(const std::vector<uint16_t>& words)
+{
+    if (words.size() != 8) {
+        Reset();
+        return;
+    }
+    transfers = GetStateCounter(words.data());
+    cycles = GetStateCounter(words.data() + 4);
+}
+
+void Blitter::Write(uint16_t address, uint16_t data)
+{
+    ram.Write(address, data);
+    if (address == BLITTER_START + BLIT_CONTROL && data >= BLIT_FILL && data <= BLIT_COPY_TRANSPARENT)
+        Run(data);
+}
+
+void Blitter::Run(uint16_t mode)
+{
+    const uint16_t* registers = ram.Data() + BLITTER_START;
+    uint16_t width = registers[BLIT_WIDTH];
+    uint16_t height = registers[BLIT_HEIGHT];
+    uint16_t color = registers[BLIT_COLOR];
+    uint16_t srcStride = registers[BLIT_SRC_STRIDE];
+    uint16_t dstStride = registers[BLIT_DST_STRIDE];
+    uint16_t srcRow = registers[BLIT_SRC];
+    uint16_t dstRow = registers[BLIT_DST];
+
+    ram.Write(BLITTER_START + BLIT_STATUS, 0);
+
+    // Addresses wrap around like the CPU's. Every word goes through the bus (framebuffer rows, decoded code, watches
+    // and the heatmap), except the ones landing on the registers themselves : a transfer can't start another one
+    for (uint16_t y = 0; y < height; ++y) {
+        for (uint16_t x = 0; x < width; ++x) {
+            uint16_t value = mode == BLIT_FILL ? color : bus.TransferRead(static_cast<uint16_t>(srcRow + x));
+            if (mode == BLIT_COPY_TRANSPARENT && value == color)
+                continue;
+
+            uint16_t dst = static_cast<uint16_t>(dstRow + x);
+            if (bus.GetWriter(dst) == this)
+                ram.Write(dst, value);
+            else
+                bus.TransferWrite(dst, value);
+        }
+        srcRow = static_cast<uint16_t>(srcRow + srcStride);
+        dstRow = static_cast<uint16_t>(dstRow + dstStride);
+    }
+
+    // Fills only write, copies read then write every word
+    uint64_t words = static_cast<uint64_t>(width) * height;
+    transfers++;
+    cycles += BLIT_SETUP_CYCLES + (mode == BLIT_FILL ? words : 2 * words);
+
+    ram.Write(BLITTER_START + BLIT_STATUS, BLIT_STATUS_DONE);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+#include "memory_bus.hpp"
+
+// The blitter's registers take the last page before the stack
+static const uint16_t BLITTER_START = 0xEF00;
+static const uint16_t BLITTER_END = 0xF000;
+
+// Register words, from BLITTER_START
+enum BlitterRegister{
+    BLIT_SRC,           // First source word (copies)
+    BLIT_DST,           // First destination word
+    BLIT_WIDTH,         // Words per row
+    BLIT_HEIGHT,        // Rows
+    BLIT_SRC_STRIDE,    // Words from a source row to the next
+    BLIT_DST_STRIDE,    // Words from a destination row to the next (128 for the screen)
+    BLIT_COLOR,         // Fill color, or the source color a transparent copy skips
+    BLIT_CONTROL,       // Writing a BlitterMode runs the transfer
+    BLIT_STATUS,        // BLIT_STATUS_DONE once the transfer is done
+    BLIT_REGISTER_COUNT
+};
+
+enum BlitterMode{
+    BLIT_FILL = 1,
+    BLIT_COPY = 2,
+    BLIT_COPY_TRANSPARENT = 3
+};
+
+static const uint16_t BLIT_STATUS_DONE = 0x0001;
+
+// Modeled cost of a transfer : the blitter owns the RAM bus and does one access per cycle
+static const uint64_t BLIT_SETUP_CYCLES = 4;
+
+// Rectangle fills and copies on the host, programmed through memory mapped registers. The registers are RAM words (the
+// program reads them back, STATUS included, as plain memory), the device only takes the writes to start the transfers.
+// A transfer is done by the time the store to CONTROL completes, its cycles are counted rather than stalling the CPU
+class Blitter : public BusDevice{
+    private:
+        RAM& ram;
+        MemoryBus& bus;
+
+        uint64_t transfers = 0;
+        uint64_t cycles = 0;
+
+        void Run(uint16_t mode);
+
+    public:
+        Blitter(RAM& ram, MemoryBus& bus) : ram(ram), bus(bus) {}
+
+        Blitter(const Blitter&) = delete;
+        Blitter& operator=(const Blitter&) = delete;
+        Blitter(Blitter&&) = delete;
+        Blitter& operator=(Blitter&&) = delete;
+
+        // Maps the register page (writes only)
+        bool Attach(std::string& error);
+
+        uint16_t Read(uint16_t address) override {
+            return ram.Data()[address];
+        }
+
+        void Write(uint16_t address, uint16_t data) override;
+
+        void Reset() override {
+            transfers = 0;
+            cycles = 0;
+        }
+
+        // The counters (the registers are RAM words)
+        void SaveState(std::vector<uint16_t>& words) const override;
+
+        void RestoreState(const std::vector<uint16_t>& words) override;
+
+        // Transfers run since the last reset
+        uint64_t GetTransfers() const {
+            return transfers;
+        }
+
+        // Cycles they would have taken in hardware
+        uint64_t GetCycles() const {
+            return cycles;
+        }
+};
@@ -0,0 +1,21 @@
+#include "framebuffer.hpp"
+
+bool Framebuffer::Attach(MemoryBus& bus, std::string& error)
+{
+    if (!bus.Map(this, FRAMEBUFFER_START, FRAMEBUFFER_END - 1, BUS_WRITE, error))
+        return false;
+    MarkScreenDirty();
+    return true;
+}
+
+void Framebuffer::MarkScreenDirty()
+{
+    for (std::atomic<uint64_t>& rows : dirtyRows)
+        rows.store(~uint64_t(0), std::memory_order_release);
+}
+
+void Framebuffer::TakeDirtyRows(uint64_t rows[SCREEN_DIRTY_WORDS])
+{
+    for (int i = 0; i < SCREEN_DIRTY_WORDS; ++i)
+        rows[i] = dirtyRows[i].exchange(0, std::memory_order_acquire);
+}
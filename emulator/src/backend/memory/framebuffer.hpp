@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "memory_bus.hpp"
+
+// Memory mapped 128x128 RGB565 screen
+static const uint16_t FRAMEBUFFER_START = 0x8000;
+static const uint16_t FRAMEBUFFER_END = 0xC000;
+static const int SCREEN_WIDTH = 128;
+static const int SCREEN_HEIGHT = 128;
+
+// Dirty screen rows, one bit per row
+static const int SCREEN_DIRTY_WORDS = SCREEN_HEIGHT / 64;
+
+// The screen's pixels are the RAM words FRAMEBUFFER_START to FRAMEBUFFER_END - 1. The device only takes the writes
+// (reads are plain memory) to keep track of the rows the display has to present again
+class Framebuffer : public BusDevice{
+    private:
+        RAM& ram;
+
+        // Screen rows written since the display last took them (bit y of word y / 64).
+        // Set by the thread running the Machine, cleared by the one presenting the screen
+        std::atomic<uint64_t> dirtyRows[SCREEN_DIRTY_WORDS]{};
+
+        void MarkRowDirty(int row){
+            std::atomic<uint64_t>& rows = dirtyRows[row >> 6];
+            uint64_t bit = uint64_t(1) << (row & 63);
+
+            // Most stores land on a row already marked, they only pay for the load
+            if (!(rows.load(std::memory_order_relaxed) & bit))
+                rows.fetch_or(bit, std::memory_order_release);
+        }
+
+    public:
+        explicit Framebuffer(RAM& ram) : ram(ram) {}
+
+        Framebuffer(const Framebuffer&) = delete;
+        Framebuffer& operator=(const Framebuffer&) = delete;
+        Framebuffer(Framebuffer&&) = delete;
+        Framebuffer& operator=(Framebuffer&&) = delete;
+
+        // Maps the device's pages (writes only)
+        bool Attach(MemoryBus& bus, std::string& error);
+
+        uint16_t Read(uint16_t address) override {
+            return ram.Data()[address];
+        }
+
+        void Write(uint16_t address, uint16_t data) override {
+            ram.Write(address, data);
+            MarkRowDirty((address - FRAMEBUFFER_START) / SCREEN_WIDTH);
+        }
+
+        void Reset() override {
+            MarkScreenDirty();
+        }
+
+        void OnRAMLoaded() override {
+            MarkScreenDirty();
+        }
+
+        // Pixels, SCREEN_WIDTH words per row
+        const uint16_t* GetPixels() const {
+            return ram.Data() + FRAMEBUFFER_START;
+        }
+
+        // Every row needs presenting again
+        void MarkScreenDirty();
+
+        // Dirty rows since the last call (bit y of rows[y / 64]), clears them
+        void TakeDirtyRows(uint64_t rows[SCREEN_DIRTY_WORDS]);
+};
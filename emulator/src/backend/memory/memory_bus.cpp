@@ -0,0 +1,131 @@
+#include "memory_bus.hpp"
+
+#include <algorithm>
+
+#include "../functional/block_cache.hpp"
+
+static std::string HexAddress(uint32_t address)
+{
+    static const char DIGITS[] = "0123456789ABCDEF";
+    std::string text = "0x0000";
+    for (int i = 0; i < 4; ++i)
+        text[5 - i] = DIGITS[(address >> (4 * i)) & 0xF];
+    return text;
+}
+
+bool MemoryBus::Map(BusDevice* device, uint16_t first, uint16_t last, int access, std::string& error)
+{
+    if (first % BUS_PAGE_SIZE != 0 || (last + 1) % BUS_PAGE_SIZE != 0 || last < first) {
+        error = "Device range " + HexAddress(first) + "-" + HexAddress(last) + " does not cover whole pages of "
+              + std::to_string(BUS_PAGE_SIZE) + " words";
+        return false;
+    }
+
+    int firstPage = first >> BUS_PAGE_SHIFT;
+    int lastPage = last >> BUS_PAGE_SHIFT;
+    for (int page = firstPage; page <= lastPage; ++page) {
+        BusDevice* reader = readers[page];
+        BusDevice* writer = writers[page];
+        if (((access & BUS_READ) && reader != nullptr && reader != device) || ((access & BUS_WRITE) && writer != nullptr && writer != device)) {
+            error = "Device range " + HexAddress(first) + "-" + HexAddress(last) + " overlaps another device at "
+                  + HexAddress(static_cast<uint32_t>(page) << BUS_PAGE_SHIFT);
+            return false;
+        }
+    }
+
+    for (int page = firstPage; page <= lastPage; ++page) {
+        if (access & BUS_READ)
+            readers[page] = device;
+        if (access & BUS_WRITE)
+            writers[page] = device;
+    }
+    if (std::find(devices.begin(), devices.end(), device) == devices.end())
+        devices.push_back(device);
+
+    OnTableChanged();
+    return true;
+}
+
+void MemoryBus::Unmap(BusDevice* device)
+{
+    for (int page = 0; page < BUS_PAGE_COUNT; ++page) {
+        if (readers[page] == device)
+            readers[page] = nullptr;
+        if (writers[page] == device)
+            writers[page] = nullptr;
+    }
+    devices.erase(std::remove(devices.begin(), devices.end(), device), devices.end());
+    OnTableChanged();
+}
+
+void MemoryBus::AddTap(BusTap* tap)
+{
+    if (std::find(taps.begin(), taps.end(), tap) == taps.end())
+        taps.push_back(tap);
+}
+
+void MemoryBus::RemoveTap(BusTap* tap)
+{
+    taps.erase(std::remove(taps.begin(), taps.end(), tap), taps.end());
+}
+
+void MemoryBus::TapPages(int firstPage, int lastPage, int access, int change)
+{
+    for (int page = firstPage; page <= lastPage; ++page) {
+        if (access & BUS_READ)
+            readTaps[page] = static_cast<uint16_t>(readTaps[page] + change);
+        if (access & BUS_WRITE)
+            writeTaps[page] = static_cast<uint16_t>(writeTaps[page] + change);
+    }
+    OnTableChanged();
+}
+
+void MemoryBus::OnTableChanged()
+{
+    dataReads = false;
+    for (int page = 0; page < BUS_PAGE_COUNT; ++page) {
+        blockCache.SetDevicePage(page, readers[page] != nullptr);
+        dataReaders[page] = readers[page] ? readers[page] : readTaps[page] != 0 ? &ramPort : nullptr;
+        dataWriters[page] = writers[page] ? writers[page] : writeTaps[page] != 0 ? &ramPort : nullptr;
+        dataReads |= dataReaders[page] != nullptr;
+    }
+
+    // Translated code has the data tables' decisions baked in
+    blockCache.InvalidateAll();
+}
+
+void MemoryBus::Reset()
+{
+    ram.Reset();
+    for (BusDevice* device : devices)
+        device->Reset();
+}
+
+void MemoryBus::Load(const uint16_t* words)
+{
+    ram.Load(words);
+    for (BusDevice* device : devices)
+        device->OnRAMLoaded();
+}
+
+std::vector<std::vector<uint16_t>> MemoryBus::SaveDevices() const
+{
+    std::vector<std::vector<uint16_t>> states(devices.size());
+    for (size_t i = 0; i < devices.size(); ++i)
+        devices[i]->SaveState(states[i]);
+    return states;
+}
+
+void MemoryBus::RestoreDevices(const std::vector<std::vector<uint16_t>>& states)
+{
+    static const std::vector<uint16_t> none;
+    for (size_t i = 0; i < devices.size(); ++i)
+        devices[i]->RestoreState(i < states.size() ? states[i] : none);
+}
+
+void MemoryBus::Load(const ProgramImage& program)
+{
+    ram.Load(program);
+    for (BusDevice* device : devices)
+        device->OnRAMLoaded();
+}
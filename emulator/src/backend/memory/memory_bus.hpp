@@ -0,0 +1,274 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ram.hpp"
+
+class BlockCache;
+class ProgramImage;
+
+// The address space is split in BUS_PAGE_COUNT pages of BUS_PAGE_SIZE words, devices take whole pages
+static const int BUS_PAGE_SHIFT = 8;
+static const int BUS_PAGE_SIZE = 1 << BUS_PAGE_SHIFT;
+static const int BUS_PAGE_COUNT = static_cast<int>(ADDRESS_SPACE >> BUS_PAGE_SHIFT);
+
+// What a device takes over in the pages it maps
+enum BusAccess{
+    BUS_READ = 1,
+    BUS_WRITE = 2
+};
+
+// Memory mapped hardware. The words under a device stay in the RAM (viewers, save states and the debugger see them there),
+// the device decides what a data read returns and what a write does
+class BusDevice{
+    public:
+        virtual ~BusDevice() = default;
+
+        // The RTL model reads the bus on every half-tick : reads must not have side effects
+        virtual uint16_t Read(uint16_t address) = 0;
+
+        virtual void Write(uint16_t address, uint16_t data) = 0;
+
+        // The CPU was reset (the RAM is all zeros again)
+        virtual void Reset() {}
+
+        // Every RAM word was replaced (program or state loaded)
+        virtual void OnRAMLoaded() {}
+
+        // What the device keeps outside the RAM (save states, trace keyframes, rewinding), appended to words
+        virtual void SaveState(std::vector<uint16_t>& words) const {}
+
+        // Puts back what SaveState() wrote, after the RAM. Anything else (another version, a damaged file) resets the device
+        virtual void RestoreState(const std::vector<uint16_t>& words) {}
+};
+
+// 64-bit counters in a device's state words, low word first
+static inline void PutStateCounter(std::vector<uint16_t>& words, uint64_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        words.push_back(static_cast<uint16_t>(value >> (16 * i)));
+}
+
+static inline uint64_t GetStateCounter(const uint16_t* words)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 4; ++i)
+        value |= static_cast<uint64_t>(words[i]) << (16 * i);
+    return value;
+}
+
+// Hears the data accesses the engines make on the pages it taps (MemoryBus::TapPages), pc being the instruction that
+// makes them. The RTL model's own accesses are not heard (CPU::Tick hands its instructions over instead), the transfers
+// a device makes on its own are, whatever the engine
+class BusTap{
+    public:
+        virtual ~BusTap() = default;
+
+        virtual void OnRead(uint16_t pc, uint16_t address, uint16_t value) = 0;
+
+        // previous / value : the RAM word before and after the write
+        virtual void OnWrite(uint16_t pc, uint16_t address, uint16_t previous, uint16_t value) = 0;
+};
+
+// Plain RAM as a device : the engines' data tables point at it for the tapped pages no device maps
+class RAMPort : public BusDevice{
+    private:
+        RAM& ram;
+
+    public:
+        explicit RAMPort(RAM& ram) : ram(ram) {}
+
+        uint16_t Read(uint16_t address) override {
+            return ram.Data()[address];
+        }
+
+        void Write(uint16_t address, uint16_t data) override {
+            ram.Write(address, data);
+        }
+};
+
+// Page table in front of the RAM : each page is plain RAM or a device, separately for reads and writes (the framebuffer only
+// takes the writes). The RTL model goes through Read / Write, the functional engine and the translated code look the
+// page up in the data tables themselves and only call ReadData / WriteData for a device or a tapped page, plain memory
+// costs them a table load. Instructions are never decoded from a page with a reading device, the RTL model runs them
+class MemoryBus{
+    private:
+        RAM& ram;
+
+        // Decoded code of the owning Machine, dropped whenever the table changes
+        BlockCache& blockCache;
+
+        // nullptr : plain RAM
+        std::array<BusDevice*, BUS_PAGE_COUNT> readers{};
+        std::array<BusDevice*, BUS_PAGE_COUNT> writers{};
+
+        // Every device mapped somewhere, once
+        std::vector<BusDevice*> devices;
+
+        // What the engines go by : the page's device, ramPort on a tapped page without one, nullptr for plain RAM
+        std::array<BusDevice*, BUS_PAGE_COUNT> dataReaders{};
+        std::array<BusDevice*, BUS_PAGE_COUNT> dataWriters{};
+        RAMPort ramPort;
+
+        std::vector<BusTap*> taps;
+
+        // Taps listening to the reads / writes of each page
+        std::array<uint16_t, BUS_PAGE_COUNT> readTaps{};
+        std::array<uint16_t, BUS_PAGE_COUNT> writeTaps{};
+
+        bool dataReads = false;
+
+        // Set by a tap : the engines leave right after the instruction that made the access
+        bool stopRequested = false;
+
+        // Instruction making the current access (WriteData, CPU::Tick for the RTL model's), the devices' own transfers
+        // are heard as its accesses
+        uint16_t accessPC = 0;
+
+        // The table changed : decoded blocks and translated code were built for the old one
+        void OnTableChanged();
+
+    public:
+        MemoryBus(RAM& ram, BlockCache& blockCache) : ram(ram), blockCache(blockCache), ramPort(ram) {}
+
+        MemoryBus(const MemoryBus&) = delete;
+        MemoryBus& operator=(const MemoryBus&) = delete;
+        MemoryBus(MemoryBus&&) = delete;
+        MemoryBus& operator=(MemoryBus&&) = delete;
+
+        // Hands the addresses first to last (whole pages) to device for the BusAccess bits of access. On failure
+        // (range not page aligned, pages already mapped by another device) returns false and describes the problem in error
+        bool Map(BusDevice* device, uint16_t first, uint16_t last, int access, std::string& error);
+
+        // Every page of the device goes back to plain RAM
+        void Unmap(BusDevice* device);
+
+        // tap hears every access made on a tapped page (it keeps to the ones it asked for)
+        void AddTap(BusTap* tap);
+
+        void RemoveTap(BusTap* tap);
+
+        // Adds change (+1 / -1) to the taps listening to the BusAccess bits of access of the pages firstPage to lastPage
+        void TapPages(int firstPage, int lastPage, int access, int change);
+
+        BusDevice* GetReader(uint16_t address) const {
+            return readers[address >> BUS_PAGE_SHIFT];
+        }
+
+        BusDevice* GetWriter(uint16_t address) const {
+            return writers[address >> BUS_PAGE_SHIFT];
+        }
+
+        BusDevice* GetDataReader(uint16_t address) const {
+            return dataReaders[address >> BUS_PAGE_SHIFT];
+        }
+
+        BusDevice* GetDataWriter(uint16_t address) const {
+            return dataWriters[address >> BUS_PAGE_SHIFT];
+        }
+
+        // False while every data read is plain memory (the engines skip the table for their reads)
+        bool HasDataReaders() const {
+            return dataReads;
+        }
+
+        // Data tables, read by the translated code
+        BusDevice* const* GetDataReaders() const {
+            return dataReaders.data();
+        }
+
+        BusDevice* const* GetDataWriters() const {
+            return dataWriters.data();
+        }
+
+        uint16_t Read(uint16_t address){
+            BusDevice* device = readers[address >> BUS_PAGE_SHIFT];
+            return device ? device->Read(address) : ram.Data()[address];
+        }
+
+        void Write(uint16_t address, uint16_t data){
+            BusDevice* device = writers[address >> BUS_PAGE_SHIFT];
+            if (device)
+                device->Write(address, data);
+            else
+                ram.Write(address, data);
+        }
+
+        // The engines' data accesses, for the pages with an entry in the data tables. pc : the instruction making them
+        uint16_t ReadData(uint16_t address, uint16_t pc){
+            int page = address >> BUS_PAGE_SHIFT;
+            BusDevice* device = dataReaders[page];
+            uint16_t value = device ? device->Read(address) : ram.Data()[address];
+            if (readTaps[page] != 0) {
+                for (BusTap* tap : taps)
+                    tap->OnRead(pc, address, value);
+            }
+            return value;
+        }
+
+        void WriteData(uint16_t address, uint16_t data, uint16_t pc){
+            int page = address >> BUS_PAGE_SHIFT;
+            uint16_t previous = ram.Data()[address];
+            accessPC = pc;
+            dataWriters[page]->Write(address, data);
+            if (writeTaps[page] != 0) {
+                for (BusTap* tap : taps)
+                    tap->OnWrite(pc, address, previous, ram.Data()[address]);
+            }
+        }
+
+        // A device's own transfers (the blitter's) : through the page's device like Read / Write, heard by the taps
+        // like the engines' accesses
+        uint16_t TransferRead(uint16_t address){
+            uint16_t value = Read(address);
+            if (readTaps[address >> BUS_PAGE_SHIFT] != 0) {
+                for (BusTap* tap : taps)
+                    tap->OnRead(accessPC, address, value);
+            }
+            return value;
+        }
+
+        void TransferWrite(uint16_t address, uint16_t data){
+            uint16_t previous = ram.Data()[address];
+            Write(address, data);
+            if (writeTaps[address >> BUS_PAGE_SHIFT] != 0) {
+                for (BusTap* tap : taps)
+                    tap->OnWrite(accessPC, address, previous, ram.Data()[address]);
+            }
+        }
+
+        void SetAccessPC(uint16_t pc){
+            accessPC = pc;
+        }
+
+        // A tap wants the CPU back once the current instruction is done (the engines check after each data access)
+        void RequestStop(){
+            stopRequested = true;
+        }
+
+        bool IsStopRequested() const {
+            return stopRequested;
+        }
+
+        void ClearStopRequest(){
+            stopRequested = false;
+        }
+
+        // Clears the RAM, then resets the devices
+        void Reset();
+
+        // All ADDRESS_SPACE words (the devices keep their state, RestoreDevices() puts a saved one back)
+        void Load(const uint16_t* words);
+
+        // Every device's SaveState(), in the order they were mapped
+        std::vector<std::vector<uint16_t>> SaveDevices() const;
+
+        // Hands each device its entry of SaveDevices() back (an empty one when states is short)
+        void RestoreDevices(const std::vector<std::vector<uint16_t>>& states);
+
+        // The program's segments, zeros everywhere else
+        void Load(const ProgramImage& program);
+};
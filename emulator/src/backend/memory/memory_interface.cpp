@@ -1,47 +1,43 @@
 #include "memory_interface.hpp"
 
 #include "../control_unit/control_unit.hpp"
-#include "../registers/registers.hpp"
 #include "../temp_values/temp_values.hpp"
 
-MemoryInterface* MemoryInterface::instancePtr = nullptr;
-std::mutex MemoryInterface::mtx;
-
-MI_Data MemoryInterface::GetMI_Data(CU_Data oldCUData, RegsOut oldRegsOut, TempOut oldTempValues, bool currentClockSignal, bool memWrite, uint16_t oldRB, uint16_t oldRA, bool regWrite)
+MI_Data MemoryInterface::GetMI_Data(const CU_Data& oldCUData, const CPUState& oldState, const TempOut& oldTempValues, bool currentClockSignal, bool memWrite, uint16_t oldRB, uint16_t oldRA, bool regWrite)
 {
     MI_Data ret = {};
     
     if((!oldTempValues.isCurrJsr & oldTempValues.isCurrAddr & oldTempValues.isCurrExt & !oldCUData.loadPC) | oldTempValues.isCurrSpChange | oldTempValues.regIsCurrAddr){
         if(oldTempValues.isCurrSpChange){
-            ret.RAM_ADDRESS = oldRegsOut.SP;
+            ret.RAM_ADDRESS = oldState.SP;
         }
         else{
             if(oldTempValues.regIsCurrAddr){
                 ret.RAM_ADDRESS = oldRB;
             }
             else{
-                ret.RAM_ADDRESS = oldRegsOut.RAM_ADDRESS;
+                ret.RAM_ADDRESS = oldState.RAM_ADDRESS;
             }
         }
     }
     else{
-        ret.RAM_ADDRESS = oldRegsOut.PC;
+        ret.RAM_ADDRESS = oldState.PC;
     }
 
-    bool oldWriteToRAMFlipFlop = writeToRAMFlipFlop;
+    bool oldWriteToRAMFlipFlop = state.writeToRAM;
 
     if(!currentClockSignal){
         if(oldTempValues.isCurrExt){
-            writeToRAMFlipFlop = 0;
+            state.writeToRAM = 0;
         }
         else{
-            writeToRAMFlipFlop = !writeToRAMFlipFlop & (memWrite | oldTempValues.isCurrJsr);
+            state.writeToRAM = !state.writeToRAM & (memWrite | oldTempValues.isCurrJsr);
         }
     }
 
     ret.writeToRAM = ((memWrite | oldTempValues.isCurrJsr) & !oldWriteToRAMFlipFlop) | (oldTempValues.regIsCurrAddr & !regWrite);
     ret.RAM_Clock = oldTempValues.isCurrSpChange ? !currentClockSignal : currentClockSignal;
-    ret.RAM_DATA = oldTempValues.isCurrJsr ? oldRegsOut.PC + 2 : oldRA;
+    ret.RAM_DATA = oldTempValues.isCurrJsr ? oldState.PC + 2 : oldRA;
 
     return ret;
 }
\ No newline at end of file
@@ -1,8 +1,7 @@
 #pragma once
 
-#include <mutex>
-
-#include "ram.hpp"
+#include "memory_bus.hpp"
+#include "../cpu_state.hpp"
 
 struct MI_Data{
     uint16_t RAM_ADDRESS;
@@ -12,46 +11,42 @@ struct MI_Data{
 };
 
 struct CU_Data;
-struct RegsOut;
 struct TempOut;
 
 class MemoryInterface{
     private:
-        MemoryInterface() {}
-        static MemoryInterface* instancePtr;
-        static std::mutex mtx;
+        MemoryBus& bus;
 
-        bool writeToRAMFlipFlop = false;
-        
-        uint16_t RAM_OUT = 0;
+        // The write flip-flop lives in the Machine's CPUState
+        CPUState& state;
 
     public:
+        MemoryInterface(MemoryBus& bus, CPUState& state) : bus(bus), state(state) {}
+
         MemoryInterface(const MemoryInterface&) = delete;
         MemoryInterface& operator=(const MemoryInterface&) = delete;
         MemoryInterface(MemoryInterface&&) = delete;
         MemoryInterface& operator=(MemoryInterface&&) = delete;
 
-        // Static method to get the MemoryInterface instance
-        static MemoryInterface* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new MemoryInterface();
-                }
-            }
-            return instancePtr;
+        // Returns the RAM Out value on clock change
+        void OnClockChange(const MI_Data& data){
+            if(data.writeToRAM && data.RAM_Clock)
+                bus.Write(data.RAM_ADDRESS, data.RAM_DATA);
         }
 
-        // Returns the RAM Out value on clock change
-        void OnClockChange(MI_Data data){
-            if(data.writeToRAM)
-                RAM::GetInstance()->Write(data.RAM_ADDRESS, data.RAM_DATA, data.RAM_Clock);
+        bool GetWriteToRAMFlipFlop() const {
+            return state.writeToRAM;
+        }
+
+        void SetWriteToRAMFlipFlop(bool value){
+            state.writeToRAM = value;
         }
 
         void Reset(){
-            writeToRAMFlipFlop = false;
-            RAM::GetInstance()->Reset();
+            state.writeToRAM = false;
+            bus.Reset();
         }
         
-       MI_Data GetMI_Data(CU_Data oldCUData, RegsOut oldRegsOut, TempOut oldTempValues, bool currentClockSignal, bool memWrite, uint16_t oldRB, uint16_t oldRA, bool regWrite);
+        // oldState : registers as they were before the clock edge
+        MI_Data GetMI_Data(const CU_Data& oldCUData, const CPUState& oldState, const TempOut& oldTempValues, bool currentClockSignal, bool memWrite, uint16_t oldRB, uint16_t oldRA, bool regWrite);
 };
\ No newline at end of file
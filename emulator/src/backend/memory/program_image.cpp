@@ -0,0 +1,246 @@
+#include "program_image.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "ram.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ORGAN16_MAPPED_FILES 1
+#else
+#define ORGAN16_MAPPED_FILES 0
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static const bool HOST_LITTLE_ENDIAN = false;
+#else
+static const bool HOST_LITTLE_ENDIAN = true;
+#endif
+
+static uint32_t GetU32(const uint8_t* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static uint64_t ImageChecksum(const uint8_t* bytes, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
+
+// Whitespace as the text format knows it
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+ProgramImage::~ProgramImage()
+{
+    Clear();
+}
+
+void ProgramImage::ReleaseFile()
+{
+#if ORGAN16_MAPPED_FILES
+    if (mapping != nullptr)
+        munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    fileBytes.clear();
+    fileBytes.shrink_to_fit();
+}
+
+void ProgramImage::Clear()
+{
+    ReleaseFile();
+    segments.clear();
+    words.clear();
+    hasEntry = false;
+    entry = 0;
+}
+
+bool ProgramImage::Load(const std::string& path, std::string& error)
+{
+    Clear();
+
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+
+#if ORGAN16_MAPPED_FILES
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        error = "Could not open the program file : " + path;
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped != MAP_FAILED) {
+            mapping = mapped;
+            mappingSize = static_cast<size_t>(status.st_size);
+            bytes = static_cast<const uint8_t*>(mapped);
+            size = mappingSize;
+        }
+    }
+    close(file);
+#endif
+
+    // Not mappable (or no mmap) : read the whole file
+    if (bytes == nullptr) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            error = "Could not open the program file : " + path;
+            return false;
+        }
+        fileBytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = fileBytes.data();
+        size = fileBytes.size();
+    }
+
+    bool loaded = size >= sizeof(PROGRAM_IMAGE_MAGIC) && std::memcmp(bytes, PROGRAM_IMAGE_MAGIC, sizeof(PROGRAM_IMAGE_MAGIC)) == 0
+                ? ParseImage(bytes, size, path, error)
+                : ParseText(reinterpret_cast<const char*>(bytes), size, path, error);
+
+    // Only an image read in place still needs the file
+    if (!loaded)
+        Clear();
+    else if (!words.empty())
+        ReleaseFile();
+    return loaded;
+}
+
+bool ProgramImage::ParseImage(const uint8_t* bytes, size_t size, const std::string& path, std::string& error)
+{
+    if (size < PROGRAM_IMAGE_HEADER_SIZE) {
+        error = "Truncated program image : " + path;
+        return false;
+    }
+
+    uint32_t version = GetU32(bytes + 8);
+    if (version != PROGRAM_IMAGE_VERSION) {
+        error = "Unsupported program image version " + std::to_string(version) + " (this emulator reads version "
+              + std::to_string(PROGRAM_IMAGE_VERSION) + ") : " + path;
+        return false;
+    }
+
+    uint16_t flags = static_cast<uint16_t>(bytes[12] | (bytes[13] << 8));
+    uint16_t entryPoint = static_cast<uint16_t>(bytes[14] | (bytes[15] << 8));
+    uint32_t segmentCount = GetU32(bytes + 16);
+    uint64_t checksum = GetU32(bytes + 24) | (static_cast<uint64_t>(GetU32(bytes + 28)) << 32);
+
+    if (ImageChecksum(bytes + PROGRAM_IMAGE_HEADER_SIZE, size - PROGRAM_IMAGE_HEADER_SIZE) != checksum) {
+        error = "Corrupted program image (checksum mismatch) : " + path;
+        return false;
+    }
+
+    // Segments fit the address space, so there can not be more of them than words
+    size_t tableEnd = PROGRAM_IMAGE_HEADER_SIZE + static_cast<size_t>(segmentCount) * 8;
+    if (segmentCount > ADDRESS_SPACE || tableEnd > size) {
+        error = "Malformed program image (segment table) : " + path;
+        return false;
+    }
+
+    size_t dataWords = 0;
+    segments.reserve(segmentCount);
+    for (uint32_t i = 0; i < segmentCount; ++i) {
+        const uint8_t* entryBytes = bytes + PROGRAM_IMAGE_HEADER_SIZE + 8 * i;
+        uint32_t start = GetU32(entryBytes);
+        uint32_t length = GetU32(entryBytes + 4);
+        if (length == 0 || start >= ADDRESS_SPACE || length > ADDRESS_SPACE - start) {
+            error = "Malformed program image (segment " + std::to_string(i) + " outside the address space) : " + path;
+            return false;
+        }
+        segments.push_back({static_cast<uint16_t>(start), length, nullptr});
+        dataWords += length;
+    }
+    if (size - tableEnd != dataWords * 2) {
+        error = "Malformed program image (segment data size) : " + path;
+        return false;
+    }
+
+    // The words are used in place, unless the host reads them the other way around
+    const uint8_t* data = bytes + tableEnd;
+    if (HOST_LITTLE_ENDIAN) {
+        for (ProgramSegment& segment : segments) {
+            segment.words = reinterpret_cast<const uint16_t*>(data);
+            data += segment.length * 2;
+        }
+    }
+    else {
+        std::vector<uint16_t> decoded(dataWords);
+        for (size_t i = 0; i < dataWords; ++i)
+            decoded[i] = static_cast<uint16_t>(data[2 * i] | (data[2 * i + 1] << 8));
+        words = std::move(decoded);
+        const uint16_t* next = words.data();
+        for (ProgramSegment& segment : segments) {
+            segment.words = next;
+            next += segment.length;
+        }
+    }
+
+    hasEntry = (flags & PROGRAM_IMAGE_HAS_ENTRY) != 0;
+    entry = hasEntry ? entryPoint : 0;
+    return true;
+}
+
+bool ProgramImage::ParseText(const char* text, size_t size, const std::string& path, std::string& error)
+{
+    std::vector<uint16_t> parsed(ADDRESS_SPACE);
+    size_t count = 0;
+    size_t position = 0;
+    while (position < size) {
+        if (IsSpace(text[position])) {
+            position++;
+            continue;
+        }
+
+        size_t start = position;
+        uint32_t value = 0;
+        bool valid = true;
+        while (position < size && !IsSpace(text[position])) {
+            char c = text[position++];
+            uint32_t digit = c >= '0' && c <= '9' ? c - '0'
+                           : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                           : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                           : 16;
+            value = (value << 4) | digit;
+            if (digit > 15 || value > 0xFFFF)
+                valid = false;
+        }
+        if (!valid) {
+            error = "Invalid word in file : " + std::string(text + start, std::min<size_t>(position - start, 32));
+            return false;
+        }
+
+        // Counted past the end so the error gives the real size
+        if (count < ADDRESS_SPACE)
+            parsed[count] = static_cast<uint16_t>(value);
+        count++;
+    }
+
+    if (count != ADDRESS_SPACE) {
+        error = "Invalid file size : " + std::to_string(count) + " words instead of " + std::to_string(ADDRESS_SPACE) + " : " + path;
+        return false;
+    }
+
+    words = std::move(parsed);
+    segments.push_back({0, static_cast<uint32_t>(ADDRESS_SPACE), words.data()});
+    return true;
+}
+
+void ProgramImage::CopyTo(uint16_t* memory) const
+{
+    std::fill(memory, memory + ADDRESS_SPACE, 0);
+    for (const ProgramSegment& segment : segments)
+        std::copy_n(segment.words, segment.length, memory + segment.start);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Program image file (little endian, written by tools/compiler.py next to the text .bin) :
+//   "O16IMAGE", u32 version, u16 flags, u16 entry point, u32 segment count, u32 reserved (0),
+//   u64 checksum (FNV-1a over every byte after this 32 byte header),
+//   then per segment u32 first word, u32 length in words, then every segment's words one after the other.
+// Words outside the segments are zeros
+static const char PROGRAM_IMAGE_MAGIC[8] = {'O', '1', '6', 'I', 'M', 'A', 'G', 'E'};
+static const uint32_t PROGRAM_IMAGE_VERSION = 1;
+static const size_t PROGRAM_IMAGE_HEADER_SIZE = 32;
+static const uint16_t PROGRAM_IMAGE_HAS_ENTRY = 1;
+
+struct ProgramSegment{
+    uint16_t start;
+    uint32_t length;
+    const uint16_t* words;
+};
+
+// A compiled program : an image file (mapped, nothing is copied until the RAM loads it) or the text format
+// (ADDRESS_SPACE hexadecimal words separated by whitespace, a single segment)
+class ProgramImage{
+    private:
+        std::vector<ProgramSegment> segments;
+
+        // Words of a text program (and of an image when the file could not be mapped or the host is big endian)
+        std::vector<uint16_t> words;
+        std::vector<uint8_t> fileBytes;
+
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        bool hasEntry = false;
+        uint16_t entry = 0;
+
+        // Unmaps (or frees) the file once nothing points into it
+        void ReleaseFile();
+
+        void Clear();
+
+        bool ParseImage(const uint8_t* bytes, size_t size, const std::string& path, std::string& error);
+
+        bool ParseText(const char* text, size_t size, const std::string& path, std::string& error);
+
+    public:
+        ProgramImage() = default;
+
+        ~ProgramImage();
+
+        ProgramImage(const ProgramImage&) = delete;
+        ProgramImage& operator=(const ProgramImage&) = delete;
+        ProgramImage(ProgramImage&&) = delete;
+        ProgramImage& operator=(ProgramImage&&) = delete;
+
+        // Either format, told apart by the magic. On failure returns false and describes the problem in error
+        bool Load(const std::string& path, std::string& error);
+
+        const std::vector<ProgramSegment>& GetSegments() const {
+            return segments;
+        }
+
+        // Without one the program starts at 0
+        bool HasEntry() const {
+            return hasEntry;
+        }
+
+        uint16_t GetEntry() const {
+            return entry;
+        }
+
+        // The whole address space : the segments, zeros everywhere else
+        void CopyTo(uint16_t* memory) const;
+};
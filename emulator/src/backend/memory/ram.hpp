@@ -1,58 +1,55 @@
 #pragma once
 
-#include <mutex>
 #include <array>
+#include <cstdint>
 #include <stdexcept>
 #include <iomanip>
 #include <sstream>
-#include <utility>
+#include <vector>
+#include <algorithm>
 
-#include <QColor>
+#include "../observer.hpp"
 
-void ResetVisualRAM();
-
-std::pair<int, int> GetScreenDim();
-void SetScreenPixel(int x, int y, QColor color);
+class BlockCache;
+class ProgramImage;
 
 static const size_t ADDRESS_SPACE = 65536;
 
 class RAM{
     private:
-        static RAM* instancePtr;
-        static std::mutex mtx;
-
         std::array<uint16_t, ADDRESS_SPACE> memory{};
 
-        RAM() {
-            memory.fill(0);
-        }
+        // Decoded code of the owning Machine, told about every write
+        BlockCache& blockCache;
+
+        // Observer slot of the owning Machine
+        EmulatorObserver* const& observer;
 
     public:
+        RAM(BlockCache& blockCache, EmulatorObserver* const& observer) : blockCache(blockCache), observer(observer) {
+            memory.fill(0);
+        }
 
         RAM(const RAM&) = delete;
         RAM& operator=(const RAM&) = delete;
         RAM(RAM&&) = delete;
         RAM& operator=(RAM&&) = delete;
 
-        // Static method to get the RAM instance
-        static RAM* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new RAM();
-                }
-            }
-            return instancePtr;
-        }
-
         uint16_t Read(uint16_t address);
 
-        void Write(uint16_t address, uint16_t data, bool clockSignal);
+        // Plain store, devices are the MemoryBus' business
+        void Write(uint16_t address, uint16_t data);
 
         void Reset();
 
-        void Load(std::vector<uint16_t> vec){
-            std::copy_n(vec.begin(), ADDRESS_SPACE, memory.begin());
+        // Direct access to the words, used by the engines that bypass the memory interface
+        uint16_t* Data(){
+            return memory.data();
         }
 
+        // All ADDRESS_SPACE words
+        void Load(const uint16_t* words);
+
+        // The program's segments, zeros everywhere else
+        void Load(const ProgramImage& program);
 };
\ No newline at end of file
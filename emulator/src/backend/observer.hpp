@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// Hooks the backend calls when the memory changes.
+// Registers, flags, flip-flops and IO ports are not pushed from here : the Machine publishes them
+// as a MachineSnapshot (snapshot/snapshot_buffer.hpp) that the GUI picks up at its own pace.
+// The screen works the same way, the framebuffer device keeps a dirty row bitmap (Framebuffer::TakeDirtyRows).
+// A Machine starts without an observer (nullptr) : the components then skip the notifications.
+// Every method defaults to a no-op so an observer only overrides what it shows.
+class EmulatorObserver{
+    public:
+        virtual ~EmulatorObserver() = default;
+
+        virtual void OnRAMReset() {}
+};
+
@@ -0,0 +1,106 @@
+#include "access_heatmap.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "../functional/functional_engine.hpp"
+
+static const size_t HEATMAP_HEADER_SIZE = 8 + 4 * 4;
+
+static void PutU32(uint8_t* bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void AccessHeatmap::Enable()
+{
+    // Tapping drops the decoded blocks : their passes are folded in before the counts start
+    if (counts.empty()) {
+        bus.AddTap(this);
+        bus.TapPages(0, BUS_PAGE_COUNT - 1, BUS_READ | BUS_WRITE, 1);
+    }
+    counts.assign(HEAT_KIND_COUNT * HEATMAP_WORDS, 0);
+}
+
+void AccessHeatmap::Disable()
+{
+    if (counts.empty())
+        return;
+    bus.TapPages(0, BUS_PAGE_COUNT - 1, BUS_READ | BUS_WRITE, -1);
+    bus.RemoveTap(this);
+    counts.clear();
+    counts.shrink_to_fit();
+}
+
+void AccessHeatmap::Clear()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+}
+
+void AccessHeatmap::CountBlock(const DecodedBlock& block, size_t first, size_t last, uint64_t times)
+{
+    uint16_t pc = block.startPC;
+    for (size_t i = 0; i < last; ++i) {
+        int length = FunctionalEngine::GetLength(static_cast<uint16_t>(block.instructions[i].index << 9));
+        for (int word = 0; i >= first && word < length; ++word) {
+            uint16_t& count = counts[HEAT_FETCH * HEATMAP_WORDS + static_cast<uint16_t>(pc + word)];
+            // A saturated count stays there (it may be far above)
+            if (times == ~uint64_t(0))
+                count -= count != 0 && count != HEATMAP_MAX_COUNT;
+            else
+                count = static_cast<uint16_t>(std::min<uint64_t>(count + times, HEATMAP_MAX_COUNT));
+        }
+        pc = static_cast<uint16_t>(pc + length);
+    }
+}
+
+void AccessHeatmap::CountInstruction(uint16_t instruction, uint16_t pc, uint16_t ext, const uint16_t regs[8], uint16_t SP)
+{
+    Count(HEAT_FETCH, pc);
+    if (FunctionalEngine::GetLength(instruction) > 1)
+        Count(HEAT_FETCH, static_cast<uint16_t>(pc + 1));
+
+    uint16_t address = 0;
+    int access = FunctionalEngine::GetDataAccess(instruction, ext, regs, SP, address);
+    if (access == BUS_READ)
+        Count(HEAT_READ, address);
+    else if (access == BUS_WRITE)
+        Count(HEAT_WRITE, address);
+}
+
+void AccessHeatmap::Decay()
+{
+    for (uint16_t& count : counts)
+        count = static_cast<uint16_t>(count - ((count + (1 << HEATMAP_DECAY_SHIFT) - 1) >> HEATMAP_DECAY_SHIFT));
+}
+
+bool AccessHeatmap::Write(const std::string& path, std::string& error) const
+{
+    if (counts.empty()) {
+        error = "The heatmap is not enabled";
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(HEATMAP_HEADER_SIZE + counts.size() * 2);
+    std::memcpy(bytes.data(), HEATMAP_MAGIC, 8);
+    PutU32(bytes.data() + 8, HEATMAP_VERSION);
+    PutU32(bytes.data() + 12, HEAT_KIND_COUNT);
+    PutU32(bytes.data() + 16, static_cast<uint32_t>(HEATMAP_WORDS));
+    PutU32(bytes.data() + 20, 0);
+
+    uint8_t* out = bytes.data() + HEATMAP_HEADER_SIZE;
+    for (uint16_t count : counts) {
+        *out++ = static_cast<uint8_t>(count);
+        *out++ = static_cast<uint8_t>(count >> 8);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!file) {
+        error = "Could not write the heatmap : " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../memory/memory_bus.hpp"
+
+struct DecodedBlock;
+
+// Heatmap dump (little endian, organ16-run --heatmap) :
+//   "O16HEATM", u32 version, u32 plane count (HEAT_KIND_COUNT), u32 words per plane (65536), u32 reserved (0),
+//   then the planes one after the other in HeatKind order, one u16 count per address
+static const char HEATMAP_MAGIC[8] = {'O', '1', '6', 'H', 'E', 'A', 'T', 'M'};
+static const uint32_t HEATMAP_VERSION = 1;
+static const size_t HEATMAP_WORDS = 65536;
+
+// Counts stop there instead of wrapping around
+static const uint16_t HEATMAP_MAX_COUNT = 0xFFFF;
+
+// A display frame takes away 1 / 2^HEATMAP_DECAY_SHIFT of every count (rounded up, so a lone access fades out)
+static const int HEATMAP_DECAY_SHIFT = 3;
+
+enum HeatKind{
+    HEAT_READ,      // Data reads : LOAD, LOADR, POP, RTS (and the blitter's copy sources)
+    HEAT_WRITE,     // Data writes : STORE, STORER, PUSH, JSR (and the blitter's transfers)
+    HEAT_FETCH,     // Instruction words fetched (the extension word included)
+    HEAT_KIND_COUNT
+};
+
+// Saturating access counts of every word of the address space, kept without slowing the engines down to single steps.
+// While it is enabled it taps every bus page (the engines' data accesses come through ReadData / WriteData), the fetches
+// come with the decoded blocks' passes (BlockCache::CountBlock) and the RTL model hands over each instruction it runs.
+// Disabled it costs nothing. The GUI decays the counts once per display frame, organ16-run keeps the totals of the whole run
+class AccessHeatmap : public BusTap{
+    private:
+        MemoryBus& bus;
+
+        // HEAT_KIND_COUNT planes of HEATMAP_WORDS counts, empty while disabled
+        std::vector<uint16_t> counts;
+
+        void Count(HeatKind kind, uint16_t address){
+            uint16_t& count = counts[kind * HEATMAP_WORDS + address];
+            count += count != HEATMAP_MAX_COUNT;
+        }
+
+    public:
+        explicit AccessHeatmap(MemoryBus& bus) : bus(bus) {}
+
+        AccessHeatmap(const AccessHeatmap&) = delete;
+        AccessHeatmap& operator=(const AccessHeatmap&) = delete;
+        AccessHeatmap(AccessHeatmap&&) = delete;
+        AccessHeatmap& operator=(AccessHeatmap&&) = delete;
+
+        // Starts from zero
+        void Enable();
+
+        void Disable();
+
+        bool IsEnabled() const {
+            return !counts.empty();
+        }
+
+        void Clear();
+
+        void OnRead(uint16_t pc, uint16_t address, uint16_t value) override {
+            Count(HEAT_READ, address);
+        }
+
+        void OnWrite(uint16_t pc, uint16_t address, uint16_t previous, uint16_t value) override {
+            Count(HEAT_WRITE, address);
+        }
+
+        // Fetches of the instructions [first, last) of block, run `times` times (uint64_t(-1) takes one run back)
+        void CountBlock(const DecodedBlock& block, size_t first, size_t last, uint64_t times);
+
+        // The RTL model starts the instruction at pc (ext : the word after it, regs / SP : the registers before it runs)
+        void CountInstruction(uint16_t instruction, uint16_t pc, uint16_t ext, const uint16_t regs[8], uint16_t SP);
+
+        // One display frame went by
+        void Decay();
+
+        // HEATMAP_WORDS counts, nullptr while disabled
+        const uint16_t* GetCounts(HeatKind kind) const {
+            return counts.empty() ? nullptr : counts.data() + kind * HEATMAP_WORDS;
+        }
+
+        // Binary dump (see HEATMAP_MAGIC). On failure returns false and describes the problem in error
+        bool Write(const std::string& path, std::string& error) const;
+};
@@ -0,0 +1,157 @@
+#include "perf_counters.hpp"
+
+#include <algorithm>
+
+#include "../functional/functional_engine.hpp"
+
+#define OPCODE(op, sub) (((op) << 4) | (sub))
+
+static const int CODE_FIRST_PAGE = 0x0;
+static const int FRAMEBUFFER_FIRST_PAGE = 0x8;
+static const int DATA_FIRST_PAGE = 0xC;
+static const int STACK_FIRST_PAGE = 0xF;
+
+void PerfCounters::CountBlock(const DecodedBlock& block, size_t first, size_t last, uint64_t times)
+{
+#if ORGAN16_PERF_COUNTERS
+    uint32_t pc = block.startPC;
+    for (size_t i = 0; i < last; ++i) {
+        const DecodedInstruction& decoded = block.instructions[i];
+        if (i >= first) {
+            fetches[pc >> PERF_PAGE_SHIFT][decoded.index] += times;
+            if (decoded.index == OPCODE(0b011, 0))
+                pageReads[decoded.ext >> PERF_PAGE_SHIFT] += times;
+            else if (decoded.index == OPCODE(0b011, 1))
+                pageWrites[decoded.ext >> PERF_PAGE_SHIFT] += times;
+        }
+        pc += FunctionalEngine::GetLength(static_cast<uint16_t>(decoded.index << 9));
+    }
+#endif
+}
+
+void PerfCounters::CountInstruction(uint16_t instruction, uint16_t pc, uint16_t ext, const uint16_t regs[8], uint8_t flags)
+{
+#if ORGAN16_PERF_COUNTERS
+    uint8_t index = static_cast<uint8_t>(instruction >> 9);
+    CountFetch(index, pc);
+
+    uint16_t srcB = regs[instruction & 0b111];
+    switch (index) {
+        case OPCODE(0b011, 0): CountRead(ext); break;
+        case OPCODE(0b011, 1): CountWrite(ext); break;
+        case OPCODE(0b011, 2): CountWrite(srcB); break;
+        case OPCODE(0b011, 3): CountRead(srcB); break;
+        default:
+            if (IsConditionalJump(index))
+                CountBranch(FunctionalEngine::IsJumpTaken(index & 0b1111, flags));
+            break;
+    }
+#endif
+}
+
+uint64_t PerfCounters::SumOpcode(int index) const
+{
+    uint64_t sum = 0;
+    for (const std::array<uint64_t, 128>& page : fetches)
+        sum += page[index];
+    return sum;
+}
+
+uint64_t PerfCounters::SumPages(bool reads, int first, int last) const
+{
+    uint64_t sum = 0;
+    for (int page = first; page < last; ++page) {
+        if (!reads) {
+            sum += pageWrites[page];
+            continue;
+        }
+
+        sum += pageReads[page];
+        for (int index = 0; index < 128; ++index)
+            sum += fetches[page][index] * std::max(FunctionalEngine::GetLength(static_cast<uint16_t>(index << 9)), 1);
+    }
+    return sum;
+}
+
+uint64_t PerfCounters::Get(int counter) const
+{
+    if (counter >= PERF_OPCODE_BASE && counter < PERF_OPCODE_END)
+        return SumOpcode(counter - PERF_OPCODE_BASE);
+
+    switch (counter) {
+        case PERF_INSTRUCTIONS: {
+            uint64_t sum = 0;
+            for (int index = 0; index < 128; ++index)
+                sum += SumOpcode(index);
+            return sum;
+        }
+        case PERF_HALF_TICKS: {
+            uint64_t sum = 0;
+            for (int index = 0; index < 128; ++index)
+                sum += SumOpcode(index) * FunctionalEngine::GetHalfTicks(static_cast<uint16_t>(index << 9));
+            return sum;
+        }
+        case PERF_BRANCHES_TAKEN: return branchesTaken;
+        case PERF_BRANCHES_NOT_TAKEN: {
+            uint64_t sum = 0;
+            for (int index = OPCODE(0b100, 1); index <= OPCODE(0b100, 10); ++index)
+                sum += SumOpcode(index);
+            return sum - branchesTaken;
+        }
+        case PERF_CALLS: return SumOpcode(OPCODE(0b100, 11));
+        case PERF_RETURNS: return SumOpcode(OPCODE(0b100, 12));
+        case PERF_CALL_DEPTH: return SumOpcode(OPCODE(0b100, 11)) - SumOpcode(OPCODE(0b100, 12));
+        case PERF_IN:
+            return SumOpcode(OPCODE(0b111, 1)) + SumOpcode(OPCODE(0b111, 2)) + SumOpcode(OPCODE(0b111, 3)) + SumOpcode(PERF_COUNTER_INSTRUCTION);
+        case PERF_OUT: return SumOpcode(OPCODE(0b111, 4)) + SumOpcode(OPCODE(0b111, 5)) + SumOpcode(OPCODE(0b111, 6));
+        case PERF_CODE_READS: return SumPages(true, CODE_FIRST_PAGE, FRAMEBUFFER_FIRST_PAGE);
+        case PERF_CODE_WRITES: return SumPages(false, CODE_FIRST_PAGE, FRAMEBUFFER_FIRST_PAGE);
+        case PERF_FRAMEBUFFER_READS: return SumPages(true, FRAMEBUFFER_FIRST_PAGE, DATA_FIRST_PAGE);
+        case PERF_FRAMEBUFFER_WRITES: return SumPages(false, FRAMEBUFFER_FIRST_PAGE, DATA_FIRST_PAGE);
+        case PERF_DATA_READS: return SumPages(true, DATA_FIRST_PAGE, STACK_FIRST_PAGE);
+        case PERF_DATA_WRITES: return SumPages(false, DATA_FIRST_PAGE, STACK_FIRST_PAGE);
+        case PERF_STACK_READS:
+            return SumPages(true, STACK_FIRST_PAGE, PERF_PAGE_COUNT) + SumOpcode(OPCODE(0b100, 12)) + SumOpcode(OPCODE(0b101, 1));
+        case PERF_STACK_WRITES:
+            return SumPages(false, STACK_FIRST_PAGE, PERF_PAGE_COUNT) + SumOpcode(OPCODE(0b100, 11)) + SumOpcode(OPCODE(0b101, 0));
+        default: return 0;
+    }
+}
+
+uint16_t PerfCounters::ReadPort(uint16_t selector) const
+{
+    return static_cast<uint16_t>(Get(selector >> 2) >> ((selector & 0b11) * 16));
+}
+
+const char* PerfCounters::GetName(int counter)
+{
+    switch (counter) {
+        case PERF_INSTRUCTIONS:         return "instructions";
+        case PERF_HALF_TICKS:           return "half_ticks";
+        case PERF_BRANCHES_TAKEN:       return "branches_taken";
+        case PERF_BRANCHES_NOT_TAKEN:   return "branches_not_taken";
+        case PERF_CALLS:                return "calls";
+        case PERF_RETURNS:              return "returns";
+        case PERF_CALL_DEPTH:           return "call_depth";
+        case PERF_IN:                   return "in";
+        case PERF_OUT:                  return "out";
+        case PERF_CODE_READS:           return "code_reads";
+        case PERF_CODE_WRITES:          return "code_writes";
+        case PERF_FRAMEBUFFER_READS:    return "framebuffer_reads";
+        case PERF_FRAMEBUFFER_WRITES:   return "framebuffer_writes";
+        case PERF_DATA_READS:           return "data_reads";
+        case PERF_DATA_WRITES:          return "data_writes";
+        case PERF_STACK_READS:          return "stack_reads";
+        case PERF_STACK_WRITES:         return "stack_writes";
+        default:                        return "?";
+    }
+}
+
+void PerfCounters::Reset()
+{
+    for (std::array<uint64_t, 128>& page : fetches)
+        page.fill(0);
+    pageReads.fill(0);
+    pageWrites.fill(0);
+    branchesTaken = 0;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct DecodedBlock;
+
+// Set by the build (cmake -DORGAN16_PERF_COUNTERS=OFF turns it off), the counting hooks then compile to nothing
+#ifndef ORGAN16_PERF_COUNTERS
+#define ORGAN16_PERF_COUNTERS 1
+#endif
+
+// Accesses are counted per 4K page, the regions are sums of pages
+static const int PERF_PAGE_SHIFT = 12;
+static const int PERF_PAGE_COUNT = 16;
+
+// IN3 (OpCode 7, SubOpCode 7) reads the counters. Emulator only : the hardware control ROM keeps that encoding undocumented
+static const uint8_t PERF_COUNTER_INSTRUCTION = (0b111 << 4) | 7;
+static const int PERF_COUNTER_PORT = 3;
+
+// Counter numbers, as selected by the guest (IN3 Rd, Rs : Rd = word (Rs & 3) of counter (Rs >> 2), word 0 is the low one)
+enum PerfCounter{
+    PERF_INSTRUCTIONS,
+    PERF_HALF_TICKS,            // RTL half-ticks of the instructions started (undocumented encodings count 0)
+    PERF_BRANCHES_TAKEN,        // Jcc only
+    PERF_BRANCHES_NOT_TAKEN,
+    PERF_CALLS,
+    PERF_RETURNS,
+    PERF_CALL_DEPTH,            // JSR - RTS (two's complement when more RTS than JSR ran)
+    PERF_IN,
+    PERF_OUT,
+    PERF_CODE_READS,            // 0x0000 - 0x7FFF, instruction fetches included
+    PERF_CODE_WRITES,
+    PERF_FRAMEBUFFER_READS,     // 0x8000 - 0xBFFF
+    PERF_FRAMEBUFFER_WRITES,
+    PERF_DATA_READS,            // 0xC000 - 0xEFFF
+    PERF_DATA_WRITES,
+    PERF_STACK_READS,           // 0xF000 - 0xFFFF, plus every access through SP (JSR, RTS, PUSH, POP) wherever it points
+    PERF_STACK_WRITES,
+    PERF_COUNTER_COUNT,
+
+    // Instructions retired per OpCode / SubOpCode : PERF_OPCODE_BASE + 7 bit index
+    PERF_OPCODE_BASE = 64,
+    PERF_OPCODE_END = PERF_OPCODE_BASE + 128
+};
+
+// Event counts of one Machine, kept by every engine that runs it (RTL model, functional engine, translated code).
+// The functional engine counts decoded blocks as a whole (see BlockCache::CountPasses), only LOADR / STORER are counted
+// as they run. The rest (instructions, half-ticks, IN/OUT, calls, stack accesses...) is summed from the per-opcode counts
+// when read. Plain data : snapshots copy it
+class PerfCounters{
+    private:
+        // Instructions fetched per page and OpCode / SubOpCode : a single increment per instruction,
+        // the per-opcode counts and the fetched words are summed from it
+        std::array<std::array<uint64_t, 128>, PERF_PAGE_COUNT> fetches{};
+
+        // Data accesses per page
+        std::array<uint64_t, PERF_PAGE_COUNT> pageReads{};
+        std::array<uint64_t, PERF_PAGE_COUNT> pageWrites{};
+
+        uint64_t branchesTaken = 0;
+
+        uint64_t SumOpcode(int index) const;
+
+        // Data accesses (+ fetched words for reads) of the pages [first, last)
+        uint64_t SumPages(bool reads, int first, int last) const;
+
+    public:
+        // Jcc (OpCode 4, SubOpCode 1 - 10)
+        static bool IsConditionalJump(uint8_t index){
+            return index > (0b100 << 4) && index < ((0b100 << 4) | 11);
+        }
+
+        // Instruction with the given 7 bit index fetched at pc
+        void CountFetch(uint8_t index, uint16_t pc){
+#if ORGAN16_PERF_COUNTERS
+            fetches[pc >> PERF_PAGE_SHIFT][index]++;
+#endif
+        }
+
+        void CountRead(uint16_t address){
+#if ORGAN16_PERF_COUNTERS
+            pageReads[address >> PERF_PAGE_SHIFT]++;
+#endif
+        }
+
+        void CountWrite(uint16_t address){
+#if ORGAN16_PERF_COUNTERS
+            pageWrites[address >> PERF_PAGE_SHIFT]++;
+#endif
+        }
+
+        void CountBranch(bool taken){
+#if ORGAN16_PERF_COUNTERS
+            branchesTaken += taken;
+#endif
+        }
+
+        // Jcc taken, counted by the functional engine on the decoded blocks
+        void CountTakenBranches(uint64_t taken){
+#if ORGAN16_PERF_COUNTERS
+            branchesTaken += taken;
+#endif
+        }
+
+        // Fetches and constant address accesses (LOAD, STORE) of the instructions [first, last) of block, run `times` times.
+        // times wraps around : uint64_t(-1) takes one run back
+        void CountBlock(const DecodedBlock& block, size_t first, size_t last, uint64_t times);
+
+        // RTL model : everything about the instruction starting at pc, from the state at the instruction boundary
+        void CountInstruction(uint16_t instruction, uint16_t pc, uint16_t ext, const uint16_t regs[8], uint8_t flags);
+
+        // Value of a PerfCounter (0 for unknown numbers)
+        uint64_t Get(int counter) const;
+
+        // IN3 : 16-bit word of a counter picked by selector (see PerfCounter). Reading a counter's words is not atomic,
+        // a guest reading a fast moving counter reads the high words again to catch a carry
+        uint16_t ReadPort(uint16_t selector) const;
+
+        // Name of a counter below PERF_COUNTER_COUNT
+        static const char* GetName(int counter);
+
+        // Per page data access counters, incremented directly by the translated code
+        uint64_t* GetPageReads(){
+            return pageReads.data();
+        }
+
+        uint64_t* GetPageWrites(){
+            return pageWrites.data();
+        }
+
+        void Reset();
+};
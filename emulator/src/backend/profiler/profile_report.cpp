@@ -0,0 +1,135 @@
+#include "profile_report.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct HotSpot{
+    std::string name;
+    std::string text;
+    uint64_t samples = 0;
+};
+
+static std::string FormatAddress(uint16_t address)
+{
+    std::ostringstream text;
+    text << "0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << address;
+    return text.str();
+}
+
+static std::string Trim(const std::string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+static void WriteShare(std::ostream& out, uint64_t samples, uint64_t total)
+{
+    out << std::setw(10) << samples << std::setw(8) << std::fixed << std::setprecision(2)
+        << (total > 0 ? samples * 100.0 / total : 0.0) << "%  ";
+    out.unsetf(std::ios::floatfield);
+}
+
+static void WriteSection(std::ostream& out, const char* title, std::vector<HotSpot>& spots, uint64_t total, size_t limit)
+{
+    std::stable_sort(spots.begin(), spots.end(), [](const HotSpot& a, const HotSpot& b) { return a.samples > b.samples; });
+
+    out << "\n" << title << "\n" << "   samples   share  location\n";
+    for (size_t i = 0; i < spots.size() && i < limit; ++i) {
+        WriteShare(out, spots[i].samples, total);
+        if (spots[i].text.empty())
+            out << spots[i].name << "\n";
+        else
+            out << std::left << std::setw(24) << spots[i].name << std::right << "  " << spots[i].text << "\n";
+    }
+}
+
+void WriteHotSpots(std::ostream& out, const SamplingProfiler& profiler, const SourceMap& map, size_t limit)
+{
+    const std::vector<uint64_t>& histogram = profiler.GetHistogram();
+    uint64_t total = profiler.GetSampleCount();
+    out << "Samples : " << total << " (one every " << profiler.GetIntervalCycles() << " cycles)\n";
+    if (total == 0)
+        return;
+
+    // Keyed by label / by (file, line), or by address where the map says nothing
+    std::map<std::string, uint64_t> routines;
+    std::map<std::pair<int, int>, HotSpot> lines;
+    std::vector<HotSpot> spots;
+
+    for (size_t address = 0; address < histogram.size(); ++address) {
+        uint64_t samples = histogram[address];
+        if (samples == 0)
+            continue;
+
+        uint16_t pc = static_cast<uint16_t>(address);
+        const std::string* label = map.FindLabel(pc);
+        routines[label ? *label : "(no label)"] += samples;
+
+        SourceLocation location = map.Find(pc);
+        if (location.file < 0) {
+            spots.push_back({FormatAddress(pc), "", samples});
+            continue;
+        }
+
+        HotSpot& line = lines[{location.file, location.line}];
+        if (line.samples == 0) {
+            line.name = map.GetFileName(location.file) + ":" + std::to_string(location.line);
+            const std::vector<std::string>& source = map.GetSource(location.file);
+            if (location.line >= 1 && static_cast<size_t>(location.line) <= source.size())
+                line.text = Trim(source[location.line - 1]);
+        }
+        line.samples += samples;
+    }
+
+    if (map.IsLoaded()) {
+        std::vector<HotSpot> byRoutine;
+        for (const auto& routine : routines)
+            byRoutine.push_back({routine.first, "", routine.second});
+        WriteSection(out, "Routines", byRoutine, total, limit);
+    }
+
+    for (auto& line : lines)
+        spots.push_back(line.second);
+    WriteSection(out, map.IsLoaded() ? "Lines" : "Addresses", spots, total, limit);
+}
+
+void WriteAnnotatedSource(std::ostream& out, const SamplingProfiler& profiler, const SourceMap& map)
+{
+    const std::vector<uint64_t>& histogram = profiler.GetHistogram();
+    uint64_t total = profiler.GetSampleCount();
+    if (!map.IsLoaded()) {
+        out << "No source map : nothing to annotate\n";
+        return;
+    }
+
+    std::vector<std::vector<uint64_t>> perLine(map.GetFileCount());
+    for (size_t file = 0; file < map.GetFileCount(); ++file)
+        perLine[file].resize(map.GetSource(static_cast<int>(file)).size() + 1);
+
+    for (size_t address = 0; address < histogram.size(); ++address) {
+        SourceLocation location = map.Find(static_cast<uint16_t>(address));
+        if (histogram[address] > 0 && location.file >= 0 && static_cast<size_t>(location.line) < perLine[location.file].size())
+            perLine[location.file][location.line] += histogram[address];
+    }
+
+    for (size_t file = 0; file < map.GetFileCount(); ++file) {
+        const std::vector<std::string>& source = map.GetSource(static_cast<int>(file));
+        out << "==== " << map.GetFileName(static_cast<int>(file)) << " ====\n";
+        if (source.empty())
+            out << "(source not found)\n";
+
+        for (size_t line = 1; line <= source.size(); ++line) {
+            if (perLine[file][line] > 0)
+                WriteShare(out, perLine[file][line], total);
+            else
+                out << std::setw(21) << "";
+            out << std::setw(5) << line << " | " << source[line - 1] << "\n";
+        }
+    }
+}
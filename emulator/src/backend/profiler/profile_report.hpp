@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+#include "sampling_profiler.hpp"
+#include "source_map.hpp"
+
+// Hot spots of a profile, most sampled first : the routines (labels) then the top `limit` source lines.
+// Without a source map the lines are bare addresses
+void WriteHotSpots(std::ostream& out, const SamplingProfiler& profiler, const SourceMap& map, size_t limit = 30);
+
+// Every line of the mapped sources with its share of the samples
+void WriteAnnotatedSource(std::ostream& out, const SamplingProfiler& profiler, const SourceMap& map);
@@ -0,0 +1,22 @@
+#include "sampling_profiler.hpp"
+
+#include <algorithm>
+
+#include "../memory/ram.hpp"
+
+void SamplingProfiler::Start(uint64_t intervalCycles)
+{
+    if (histogram.empty())
+        histogram.assign(ADDRESS_SPACE, 0);
+
+    intervalHalfTicks = std::max<uint64_t>(intervalCycles, 1) * 2;
+    untilSample = intervalHalfTicks;
+    running = true;
+}
+
+void SamplingProfiler::Clear()
+{
+    std::fill(histogram.begin(), histogram.end(), 0);
+    sampleCount = 0;
+    untilSample = intervalHalfTicks;
+}
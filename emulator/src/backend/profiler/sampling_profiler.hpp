@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Default sampling period, in clock cycles
+static const uint64_t PROFILER_DEFAULT_INTERVAL = 10000;
+
+// Histogram of the guest PC, sampled every interval cycles.
+// CPU::Run splits its runs at the sampling points and records where the engine stopped, so the engines carry no hook :
+// a stopped profiler costs one test per run. The histogram is only allocated once the profiler starts
+class SamplingProfiler{
+    private:
+        // Samples per address (ADDRESS_SPACE entries once started)
+        std::vector<uint64_t> histogram;
+
+        uint64_t intervalHalfTicks = 0;
+        uint64_t untilSample = 0;
+        uint64_t sampleCount = 0;
+        bool running = false;
+
+    public:
+        // Samples every intervalCycles cycles from now on (the histogram is kept, Clear() empties it)
+        void Start(uint64_t intervalCycles = PROFILER_DEFAULT_INTERVAL);
+
+        void Stop(){
+            running = false;
+        }
+
+        bool IsRunning() const {
+            return running;
+        }
+
+        // Half-ticks left before the next sample
+        uint64_t GetHalfTicksToSample() const {
+            return untilSample;
+        }
+
+        // The Machine ran halfTicks half-ticks (at most GetHalfTicksToSample()) and stopped at pc
+        void Advance(uint64_t halfTicks, uint16_t pc){
+            untilSample -= halfTicks;
+            if (untilSample == 0) {
+                histogram[pc]++;
+                sampleCount++;
+                untilSample = intervalHalfTicks;
+            }
+        }
+
+        void Clear();
+
+        // Empty until the profiler first started
+        const std::vector<uint64_t>& GetHistogram() const {
+            return histogram;
+        }
+
+        uint64_t GetSampleCount() const {
+            return sampleCount;
+        }
+
+        uint64_t GetIntervalCycles() const {
+            return intervalHalfTicks / 2;
+        }
+};
@@ -0,0 +1,133 @@
+#include "source_map.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "../memory/ram.hpp"
+
+static bool ParseAddress(const std::string& text, uint16_t& address)
+{
+    try {
+        size_t used = 0;
+        unsigned long value = std::stoul(text, &used, 16);
+        if (used != text.size() || value >= ADDRESS_SPACE)
+            return false;
+        address = static_cast<uint16_t>(value);
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool SourceMap::Load(const std::string& path, std::string& error)
+{
+    Clear();
+
+    std::ifstream file(path);
+    if (!file) {
+        error = "Could not open the source map : " + path;
+        return false;
+    }
+
+    std::string header;
+    std::getline(file, header);
+    if (header != "organ16-map 1") {
+        error = "Not a source map (organ16-map 1) : " + path;
+        return false;
+    }
+
+    std::vector<SourceLocation> lines(ADDRESS_SPACE);
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    std::string record;
+    int number = 1;
+    while (std::getline(file, record)) {
+        ++number;
+        std::istringstream fields(record);
+        std::string kind;
+        if (!(fields >> kind))
+            continue;
+
+        bool valid = false;
+        if (kind == "file") {
+            size_t index = 0;
+            std::string name;
+            if (fields >> index && std::getline(fields >> std::ws, name) && index == fileNames.size()) {
+                fileNames.push_back(name);
+                valid = true;
+            }
+        }
+        else if (kind == "label") {
+            std::string address;
+            std::string name;
+            uint16_t value = 0;
+            if (fields >> address >> name && ParseAddress(address, value)) {
+                labels.emplace_back(value, name);
+                valid = true;
+            }
+        }
+        else if (kind == "line") {
+            std::string address;
+            unsigned words = 0;
+            int fileIndex = -1;
+            int line = 0;
+            uint16_t value = 0;
+            if (fields >> address >> words >> fileIndex >> line && ParseAddress(address, value)
+                && fileIndex >= 0 && static_cast<size_t>(fileIndex) < fileNames.size()) {
+                for (unsigned word = 0; word < words && value + word < ADDRESS_SPACE; ++word)
+                    lines[value + word] = {fileIndex, line};
+                valid = true;
+            }
+        }
+
+        if (!valid) {
+            Clear();
+            error = path + ":" + std::to_string(number) + " : invalid record '" + record + "'";
+            return false;
+        }
+    }
+
+    // A missing source only leaves its listing empty
+    for (const std::string& name : fileNames) {
+        sources.emplace_back();
+        std::ifstream source(directory / name);
+        std::string text;
+        while (std::getline(source, text))
+            sources.back().push_back(text);
+    }
+
+    std::stable_sort(labels.begin(), labels.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    locations = std::move(lines);
+    return true;
+}
+
+void SourceMap::Clear()
+{
+    fileNames.clear();
+    sources.clear();
+    locations.clear();
+    labels.clear();
+}
+
+std::string SourceMap::GetMapPath(const std::string& programPath)
+{
+    return std::filesystem::path(programPath).replace_extension(".map").string();
+}
+
+SourceLocation SourceMap::Find(uint16_t address) const
+{
+    return locations.empty() ? SourceLocation() : locations[address];
+}
+
+const std::string* SourceMap::FindLabel(uint16_t address) const
+{
+    // Last label whose address is <= address
+    auto after = std::upper_bound(labels.begin(), labels.end(), address,
+                                  [](uint16_t value, const auto& label) { return value < label.first; });
+    if (after == labels.begin())
+        return nullptr;
+    return &std::prev(after)->second;
+}
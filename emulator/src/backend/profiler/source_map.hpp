@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Source line of an instruction (file is an index into the map's files, -1 when the address has no source)
+struct SourceLocation{
+    int file = -1;
+    int line = 0;
+};
+
+// Addresses -> .org files, lines and labels, read from the .map tools/compiler.py writes next to the .bin :
+//     organ16-map 1
+//     file <index> <path relative to the map>
+//     label <address> <name>
+//     line <address> <words> <file index> <line number>
+// The sources are read along with the map (annotated listings)
+class SourceMap{
+    private:
+        std::vector<std::string> fileNames;
+        std::vector<std::vector<std::string>> sources;
+
+        // Per address (every word of an instruction points to its line)
+        std::vector<SourceLocation> locations;
+
+        // Sorted by address
+        std::vector<std::pair<uint16_t, std::string>> labels;
+
+    public:
+        // On failure returns false, describes the problem in error and leaves the map empty
+        bool Load(const std::string& path, std::string& error);
+
+        void Clear();
+
+        bool IsLoaded() const {
+            return !locations.empty();
+        }
+
+        // program.bin -> program.map
+        static std::string GetMapPath(const std::string& programPath);
+
+        SourceLocation Find(uint16_t address) const;
+
+        // Closest label at or before address (the routine it belongs to), nullptr when there is none
+        const std::string* FindLabel(uint16_t address) const;
+
+        size_t GetFileCount() const {
+            return fileNames.size();
+        }
+
+        // As written in the map (relative to it)
+        const std::string& GetFileName(int file) const {
+            return fileNames[file];
+        }
+
+        // Lines of a source file, empty when it could not be read
+        const std::vector<std::string>& GetSource(int file) const {
+            return sources[file];
+        }
+};
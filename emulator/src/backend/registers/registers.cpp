@@ -1,31 +1,23 @@
 #include "registers.hpp"
 
-#include "../alu/alu.hpp"
-
-RegisterFile* RegisterFile::instancePtr = nullptr;
-std::mutex RegisterFile::mtx;
-
-RegsOutOnChange RegisterFile::OnClockChange(RegsInOnChange in)
+void RegisterFile::OnClockChange(const RegsInOnChange& in)
 {
-    RegsOutOnChange ret = {};
-
     // --- General-purpose registers ---
     if(!in.gpClock){
         if(in.gpRegWrite){
-            RegisterName reg = static_cast<RegisterName>(in.gpRegToWrite);
-            gpRegs.at(reg).updateValue(in.gpData, false);
+            SetRegValue(static_cast<RegisterName>(in.gpRegToWrite & 0b111), in.gpData);
         }
     }
 
 
     // --- Program counter ---
     if(in.pcClock){
-        specRegs.at(PC).updateValue(in.writeToPC ? in.pcData : specRegs.at(PC).get() + 1, false);
+        SetRegValue(PC, in.writeToPC ? in.pcData : static_cast<uint16_t>(state.PC + 1));
     }
 
     // --- Stack pointer ---
     if(in.spClock){
-        specRegs.at(SP).updateValue(in.spPop ? specRegs.at(SP).get() + 1 : specRegs.at(SP).get() - 1, false);
+        SetRegValue(SP, in.spPop ? static_cast<uint16_t>(state.SP + 1) : static_cast<uint16_t>(state.SP - 1));
     }
 
     // --- Flags register ---
@@ -37,39 +29,23 @@ RegsOutOnChange RegisterFile::OnClockChange(RegsInOnChange in)
         (in.overflow << 3);
 
     if(in.flagsClock && in.flagsWrite){
-        flagReg.updateValue(flagsValue, false);
+        SetRegValue(FLAGS, flagsValue);
     }
 
     // --- Ram Address Register
 
     if(in.ramAddrClock){
-        specRegs.at(RAM_ADDRESS).updateValue(instructionsRegs.at(IR1).get(), false);
+        SetRegValue(RAM_ADDRESS, state.IR1);
     }
-
-    ret.RA = gpRegs.at(static_cast<RegisterName>(in.raRead)).get();
-    ret.RB = gpRegs.at(static_cast<RegisterName>(in.rbRead)).get();
-    ret.PC = specRegs.at(PC).get();
-    ret.SP = specRegs.at(SP).get();
-    ret.FLAGS = flagReg.get();
-    ret.RAM_ADDRESS = specRegs.at(RAM_ADDRESS).get();
-
-    return ret;
 }
 
-RegsOutOnIdle RegisterFile::OnClockIdle(RegsInOnIdle in)
+void RegisterFile::OnClockIdle(const RegsInOnIdle& in)
 {
-    RegsOutOnIdle ret = {};
-
     if(!in.ir0Clock && in.ir0Write){
-        instructionsRegs.at(IR0).updateValue(in.ir0Data, false);
+        SetRegValue(IR0, in.ir0Data);
     }
 
     if(in.ir1Clock){
-        instructionsRegs.at(IR1).updateValue(in.ir1Data, false);
+        SetRegValue(IR1, in.ir1Data);
     }
-
-    ret.IR0 = instructionsRegs.at(IR0).get();
-    ret.IR1 = instructionsRegs.at(IR1).get();
-
-    return ret;
 }
@@ -0,0 +1,82 @@
+#include "rewind_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../machine.hpp"
+
+void RewindBuffer::Take(Machine& machine)
+{
+    const uint16_t* memory = machine.ram.Data();
+    Step step;
+    step.state = machine.CaptureState();
+
+    if (steps.empty()) {
+        shadow.assign(memory, memory + ADDRESS_SPACE);
+        pageMemory += GetStepMemory(step);
+        steps.push_back(std::move(step));
+        return;
+    }
+
+    for (size_t page = 0; page < ADDRESS_SPACE / REWIND_PAGE_WORDS; ++page) {
+        size_t start = page << REWIND_PAGE_SHIFT;
+        if (std::memcmp(&shadow[start], memory + start, REWIND_PAGE_WORDS * sizeof(uint16_t)) == 0)
+            continue;
+
+        step.pages.push_back(static_cast<uint8_t>(page));
+        step.words.insert(step.words.end(), shadow.begin() + start, shadow.begin() + start + REWIND_PAGE_WORDS);
+        std::copy_n(memory + start, REWIND_PAGE_WORDS, shadow.begin() + start);
+    }
+
+    pageMemory += GetStepMemory(step);
+    steps.push_back(std::move(step));
+
+    while (steps.size() > maxSteps || (pageMemory > maxMemory && steps.size() > 1))
+        DropOldest();
+}
+
+size_t RewindBuffer::GetStepMemory(const Step& step)
+{
+    size_t words = step.words.size();
+    for (const std::vector<uint16_t>& device : step.state.devices)
+        words += device.size();
+    return words * sizeof(uint16_t);
+}
+
+void RewindBuffer::DropOldest()
+{
+    // Its pages went with the step before it, its devices' states go now
+    pageMemory -= GetStepMemory(steps.front());
+    steps.pop_front();
+
+    // Nothing goes back past the oldest step anymore
+    Step& oldest = steps.front();
+    pageMemory -= oldest.words.size() * sizeof(uint16_t);
+    oldest.pages = std::vector<uint8_t>();
+    oldest.words = std::vector<uint16_t>();
+}
+
+size_t RewindBuffer::Rewind(Machine& machine, size_t count)
+{
+    if (steps.empty())
+        return 0;
+
+    count = std::min(count, steps.size() - 1);
+    for (size_t i = 0; i < count; ++i) {
+        Step& newest = steps.back();
+        for (size_t p = 0; p < newest.pages.size(); ++p)
+            std::copy_n(&newest.words[p * REWIND_PAGE_WORDS], REWIND_PAGE_WORDS, &shadow[newest.pages[p] << REWIND_PAGE_SHIFT]);
+        pageMemory -= GetStepMemory(newest);
+        steps.pop_back();
+    }
+
+    machine.RestoreState(steps.back().state, shadow.data());
+    return count;
+}
+
+void RewindBuffer::Clear()
+{
+    steps.clear();
+    shadow.clear();
+    pageMemory = 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "../machine_state.hpp"
+
+class Machine;
+
+// Snapshots kept, and memory their pages and devices' states may take, before the oldest ones are dropped
+static const size_t REWIND_DEFAULT_STEPS = 600;
+static const size_t REWIND_DEFAULT_MEMORY = 64 << 20;
+
+static const int REWIND_PAGE_SHIFT = 8;
+static const size_t REWIND_PAGE_WORDS = size_t(1) << REWIND_PAGE_SHIFT;
+
+// Ring of incremental snapshots to step back through. Each one holds the machine state and, for the 256 word pages
+// that changed since the previous snapshot, their content at that previous snapshot : stepping back puts them back.
+// The changed pages are found by comparing the RAM with a copy of it as of the newest snapshot (128 KB compared per
+// snapshot), so the engines' stores carry no write barrier
+class RewindBuffer{
+    private:
+        struct Step{
+            MachineState state;
+            std::vector<uint8_t> pages;     // Page numbers
+            std::vector<uint16_t> words;    // Their content one step back, REWIND_PAGE_WORDS per page
+        };
+
+        std::deque<Step> steps;
+
+        // RAM at the newest snapshot
+        std::vector<uint16_t> shadow;
+
+        size_t maxSteps;
+        size_t maxMemory;
+        size_t pageMemory = 0;
+
+        void DropOldest();
+
+        // Bytes of a step counted in pageMemory
+        static size_t GetStepMemory(const Step& step);
+
+    public:
+        explicit RewindBuffer(size_t maxSteps = REWIND_DEFAULT_STEPS, size_t maxMemory = REWIND_DEFAULT_MEMORY)
+            : maxSteps(maxSteps < 1 ? 1 : maxSteps), maxMemory(maxMemory) {}
+
+        // Snapshot of the machine as it is now, becomes the newest step
+        void Take(Machine& machine);
+
+        // Puts the machine back count snapshots before the newest one (as far as the buffer goes), the newer ones are
+        // dropped. Returns the number of steps gone back
+        size_t Rewind(Machine& machine, size_t count);
+
+        void Clear();
+
+        size_t GetStepCount() const {
+            return steps.size();
+        }
+
+        // Bytes held by the page copies and the devices' states
+        size_t GetMemoryUsed() const {
+            return pageMemory;
+        }
+};
@@ -0,0 +1,80 @@
+#include "save_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "../machine.hpp"
+#include "../trace/trace_format.hpp"
+
+static const size_t SAVE_STATE_HEADER_SIZE = 8 + 4;
+
+void CaptureSaveState(Machine& machine, SaveState& saved)
+{
+    saved.state = machine.CaptureState();
+    const uint16_t* memory = machine.ram.Data();
+    saved.memory.assign(memory, memory + ADDRESS_SPACE);
+}
+
+void RestoreSaveState(Machine& machine, const SaveState& saved)
+{
+    machine.RestoreState(saved.state, saved.memory.data());
+}
+
+bool WriteSaveState(const std::string& path, const SaveState& saved, std::string& error)
+{
+    std::vector<uint8_t> bytes(SAVE_STATE_HEADER_SIZE);
+    std::memcpy(bytes.data(), SAVE_STATE_MAGIC, 8);
+    for (int i = 0; i < 4; ++i)
+        bytes[8 + i] = static_cast<uint8_t>(SAVE_STATE_VERSION >> (8 * i));
+
+    std::vector<uint16_t> zeros(ADDRESS_SPACE, 0);
+    PutMachineState(bytes, saved.state);
+    PutRAMDelta(bytes, saved.memory.data(), zeros.data());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!file) {
+        error = "Could not write the save state : " + path;
+        return false;
+    }
+    return true;
+}
+
+bool ReadSaveState(const std::string& path, SaveState& saved, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Could not open the save state : " + path;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (bytes.size() < SAVE_STATE_HEADER_SIZE || !std::equal(SAVE_STATE_MAGIC, SAVE_STATE_MAGIC + 8, bytes.begin())) {
+        error = "Not an Organ16 save state : " + path;
+        return false;
+    }
+
+    uint32_t version = 0;
+    for (int i = 0; i < 4; ++i)
+        version |= static_cast<uint32_t>(bytes[8 + i]) << (8 * i);
+    if (version != SAVE_STATE_VERSION) {
+        error = "Unsupported save state version " + std::to_string(version) + " (this emulator reads version "
+              + std::to_string(SAVE_STATE_VERSION) + ") : " + path;
+        return false;
+    }
+
+    TraceDecoder decoder(bytes.data() + SAVE_STATE_HEADER_SIZE, bytes.size() - SAVE_STATE_HEADER_SIZE);
+    MachineState state = decoder.GetMachineState();
+    std::vector<uint16_t> memory(ADDRESS_SPACE, 0);
+    decoder.ApplyRAMDelta(memory.data());
+    if (decoder.Failed() || !decoder.AtEnd()) {
+        error = "Malformed save state : " + path;
+        return false;
+    }
+
+    saved.state = state;
+    saved.memory = std::move(memory);
+    return true;
+}
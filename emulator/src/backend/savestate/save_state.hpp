@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../machine_state.hpp"
+#include "../memory/ram.hpp"
+
+class Machine;
+
+// Save state file (little endian) : "O16STATE", u32 version, then the state and the RAM encoded like a trace keyframe
+// (trace_format.hpp : varints, the RAM as a delta against zeros so the empty space costs next to nothing)
+static const char SAVE_STATE_MAGIC[8] = {'O', '1', '6', 'S', 'T', 'A', 'T', 'E'};
+static const uint32_t SAVE_STATE_VERSION = 2;
+
+// A whole Machine at one point
+struct SaveState{
+    MachineState state;
+    std::vector<uint16_t> memory = std::vector<uint16_t>(ADDRESS_SPACE);
+};
+
+void CaptureSaveState(Machine& machine, SaveState& saved);
+
+void RestoreSaveState(Machine& machine, const SaveState& saved);
+
+// On failure return false and describe the problem in error
+bool WriteSaveState(const std::string& path, const SaveState& saved, std::string& error);
+
+bool ReadSaveState(const std::string& path, SaveState& saved, std::string& error);
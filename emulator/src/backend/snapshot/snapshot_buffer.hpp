@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../cpu_state.hpp"
+#include "../io/io_ports.hpp"
+#include "../perf/perf_counters.hpp"
+#include "../perf/access_heatmap.hpp"
+
+// RAM rows of SNAPSHOT_RAM_ROW_WORDS words a snapshot carries : the ones the RAM viewer shows
+static const int SNAPSHOT_RAM_ROW_WORDS = 16;
+static const int SNAPSHOT_RAM_ROWS = 65536 / SNAPSHOT_RAM_ROW_WORDS;
+static const int SNAPSHOT_RAM_MAX_ROWS = 128;
+
+// Everything the register / debug / IO / RAM panels show, copied out of a Machine in one go
+struct MachineSnapshot{
+    CPUState cpu;
+    uint16_t ports[IO_PORT_COUNT] = {0};
+    uint16_t busAddress = 0;    // Address the RAM is being read at (highlighted in the RAM viewer)
+    uint64_t halfTicks = 0;
+    bool halted = false;
+    PerfCounters perf;
+    uint64_t sequence = 0;      // Bumped on every publish
+
+    // Rows ramFirstRow to ramFirstRow + ramRows - 1 (SnapshotBuffer::SetRAMWindow), none unless the reader asked
+    uint16_t ramFirstRow = 0;
+    uint16_t ramRows = 0;
+    uint16_t ram[SNAPSHOT_RAM_MAX_ROWS * SNAPSHOT_RAM_ROW_WORDS] = {0};
+
+    // AccessHeatmap counts of the whole address space (HEAT_KIND_COUNT planes of HEATMAP_WORDS), empty while the
+    // heatmap is disabled. The slots keep their capacity, publishing only copies
+    std::vector<uint16_t> heat;
+};
+
+// Hands the latest MachineSnapshot from the thread running the Machine to the GUI, without locks.
+// The writer fills its back slot then swaps it with the middle one, the reader swaps the middle slot with its front one
+// when a newer snapshot is there : neither side ever waits and the reader never sees a half written snapshot.
+// One writer and one reader at a time
+class SnapshotBuffer{
+    private:
+        static const uint8_t SLOT_MASK = 0b011;
+        static const uint8_t FRESH = 0b100;    // The middle slot holds a snapshot the reader has not taken yet
+
+        MachineSnapshot slots[3];
+
+        // Index of the middle slot (+ FRESH)
+        std::atomic<uint8_t> middle{1};
+
+        uint8_t back = 0;      // Writer side
+        uint8_t front = 2;     // Reader side
+
+        uint64_t sequence = 0;
+
+        // RAM rows the reader wants in the next snapshots : first row | row count << 16
+        std::atomic<uint32_t> ramWindow{0};
+
+    public:
+        SnapshotBuffer() = default;
+
+        SnapshotBuffer(const SnapshotBuffer&) = delete;
+        SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+        SnapshotBuffer(SnapshotBuffer&&) = delete;
+        SnapshotBuffer& operator=(SnapshotBuffer&&) = delete;
+
+        // Writer : the slot to fill before Publish()
+        MachineSnapshot& Back(){
+            return slots[back];
+        }
+
+        void Publish(){
+            slots[back].sequence = ++sequence;
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & SLOT_MASK;
+        }
+
+        // Writer : the RAM rows to copy into the snapshot
+        void GetRAMWindow(uint16_t& firstRow, uint16_t& rows) const {
+            uint32_t window = ramWindow.load(std::memory_order_relaxed);
+            firstRow = static_cast<uint16_t>(window);
+            rows = static_cast<uint16_t>(window >> 16);
+        }
+
+        // Reader : the RAM rows the next snapshots carry (at most SNAPSHOT_RAM_MAX_ROWS, 0 rows for none)
+        void SetRAMWindow(int firstRow, int rows){
+            firstRow = firstRow < 0 ? 0 : firstRow > SNAPSHOT_RAM_ROWS - 1 ? SNAPSHOT_RAM_ROWS - 1 : firstRow;
+            rows = rows < 0 ? 0 : rows > SNAPSHOT_RAM_MAX_ROWS ? SNAPSHOT_RAM_MAX_ROWS : rows;
+            if (firstRow + rows > SNAPSHOT_RAM_ROWS)
+                rows = SNAPSHOT_RAM_ROWS - firstRow;
+            ramWindow.store(static_cast<uint32_t>(firstRow) | (static_cast<uint32_t>(rows) << 16), std::memory_order_relaxed);
+        }
+
+        // Reader : false when nothing was published since the last call (out keeps the previous snapshot)
+        bool Consume(MachineSnapshot& out){
+            if (!(middle.load(std::memory_order_relaxed) & FRESH))
+                return false;
+
+            front = middle.exchange(front, std::memory_order_acq_rel) & SLOT_MASK;
+            out = slots[front];
+            return true;
+        }
+};
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <mutex>
-#include <unordered_map>
-#include <string>
+#include <cstdint>
+
+#include "../cpu_state.hpp"
 
 struct TempIn{
     uint8_t isNxtExt = 0;
@@ -26,69 +26,41 @@ struct TempOut{
     uint8_t regIsCurrAddr = 0;
 };
 
-void UpdateDebugValues(std::unordered_map<std::string, bool> debugValues);
-
+// The temporary values flip-flops (kept in the Machine's CPUState)
 class TemporaryValues{
     private:
-        TemporaryValues() {}
-        static TemporaryValues* instancePtr;
-        static std::mutex mtx;
-
-        
+        CPUState& state;
 
     public:
+        explicit TemporaryValues(CPUState& state) : state(state) {}
+
         TemporaryValues(const TemporaryValues&) = delete;
         TemporaryValues& operator=(const TemporaryValues&) = delete;
         TemporaryValues(TemporaryValues&&) = delete;
         TemporaryValues& operator=(TemporaryValues&&) = delete;
 
-        // Static method to get the TemporaryValues instance
-        static TemporaryValues* GetInstance() {
-            if (instancePtr == nullptr) {
-                std::lock_guard<std::mutex> lock(mtx);
-                if (instancePtr == nullptr) {
-                    instancePtr = new TemporaryValues();
-                }
-            }
-            return instancePtr;
-        }
-        
-        std::unordered_map<std::string, uint8_t> flipflops = {
-            {"CURRENT_IS_EXT", 0},
-            {"CURRENT_IS_ADDR_BASE", 0},
-            {"CURRENT_IS_ADDR_JSR", 0},
-            {"CURRENT_CHANGES_SP", 0},
-            {"CURRENTLY_JSR", 0},
-            {"CURRENTLY_RTS", 0},
-            {"REG_IS_CURR_ADDR", 0},
-        };
-
-        TempOut GetValues(){
-            TempOut ret = {};
-            ret.isCurrAddr = flipflops["CURRENT_IS_ADDR_BASE"] | flipflops["CURRENT_IS_ADDR_JSR"];
-            ret.isCurrAddrBase = flipflops["IS_CURR_ADR_BASE"];
-            ret.isCurrAddrJsr = flipflops["CURRENT_IS_ADDR_JSR"];
-            ret.isCurrExt = flipflops["CURRENT_IS_EXT"];
-            ret.isCurrJsr = flipflops["CURRENTLY_JSR"];
-            ret.isCurrRts = flipflops["CURRENTLY_RTS"];
-            ret.isCurrSpChange = flipflops["CURRENT_CHANGES_SP"];
-            ret.regIsCurrAddr = flipflops["REG_IS_CURR_ADDR"];
+        TempOut GetValues() const {
+            TempOut ret;
+            ret.isCurrAddr = state.currentIsAddrBase | state.currentIsAddrJsr;
+            ret.isCurrAddrBase = state.currentIsAddrBase;
+            ret.isCurrAddrJsr = state.currentIsAddrJsr;
+            ret.isCurrExt = state.currentIsExt;
+            ret.isCurrJsr = state.currentlyJsr;
+            ret.isCurrRts = state.currentlyRts;
+            ret.isCurrSpChange = state.currentChangesSP;
+            ret.regIsCurrAddr = state.regIsCurrAddr;
             return ret;
-        };
-
-        TempOut OnClockChange(TempIn in);
+        }
 
-        void ProcessFlipflopsAndUpdateDebug(const std::unordered_map<std::string, uint8_t> &flipflops);
+        TempOut OnClockChange(const TempIn& in);
 
         void Reset(){
-            flipflops = {
-                {"CURRENT_IS_EXT", 0},
-                {"CURRENT_IS_ADDR_BASE", 0},
-                {"CURRENT_IS_ADDR_JSR", 0},
-                {"CURRENT_CHANGES_SP", 0},
-                {"CURRENTLY_JSR", 0},
-                {"CURRENTLY_RTS", 0},
-                {"REG_IS_CURR_ADDR", 0},
-            };
-        };
-};
\ No newline at end of file
+            state.currentIsExt = 0;
+            state.currentIsAddrBase = 0;
+            state.currentIsAddrJsr = 0;
+            state.currentChangesSP = 0;
+            state.currentlyJsr = 0;
+            state.currentlyRts = 0;
+            state.regIsCurrAddr = 0;
+        }
+};
@@ -0,0 +1,92 @@
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include "../functional/functional_engine.hpp"
+
+void FlightRecorder::Enable(size_t size)
+{
+    ring.assign(std::max<size_t>(size, 1), FlightRecord());
+    Clear();
+}
+
+void FlightRecorder::Disable()
+{
+    ring.clear();
+    ring.shrink_to_fit();
+    Clear();
+}
+
+void FlightRecorder::Clear()
+{
+    next = 0;
+    recorded = 0;
+    lastHalfTicks = ~uint64_t(0);
+    haltDumped = false;
+}
+
+size_t FlightRecorder::GetCount() const
+{
+    return recorded < ring.size() ? static_cast<size_t>(recorded) : ring.size();
+}
+
+const FlightRecord& FlightRecorder::Get(size_t index) const
+{
+    size_t oldest = recorded < ring.size() ? 0 : next;
+    size_t position = oldest + index;
+    return ring[position >= ring.size() ? position - ring.size() : position];
+}
+
+void FlightRecorder::Write(std::ostream& out, const char* reason) const
+{
+    out << "Flight recorder (" << reason << ") : last " << GetCount() << " of " << recorded << " instructions\n"
+        << "      half-tick   PC    instr       R0   R1   R2   R3   R4   R5   R6   R7   SP   ZNCO\n";
+
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill();
+    for (size_t i = 0; i < GetCount(); ++i) {
+        const FlightRecord& record = Get(i);
+        out << std::dec << std::setfill(' ') << std::setw(15) << record.halfTicks << "  "
+            << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << record.PC << "  "
+            << std::setw(4) << record.instruction << " ";
+        if (FunctionalEngine::GetLength(record.instruction) == 2)
+            out << std::setw(4) << record.ext;
+        else
+            out << "    ";
+        out << "   ";
+        for (uint16_t reg : record.regs)
+            out << std::setw(4) << reg << " ";
+        out << std::setw(4) << record.SP << "  ";
+        for (int bit = 0; bit < 4; ++bit)
+            out << ((record.FLAGS >> bit) & 1);
+        out << "\n";
+    }
+    out.flags(flags);
+    out.fill(fill);
+}
+
+void FlightRecorder::DumpToFile(const char* reason)
+{
+    if (dumpPath.empty() || GetCount() == 0)
+        return;
+
+    std::ofstream out(dumpPath, std::ios::app);
+    Write(out, reason);
+    out << "\n";
+}
+
+void FlightRecorder::OnHalt()
+{
+    if (haltDumped)
+        return;
+    haltDumped = true;
+    DumpToFile("HLT");
+}
+
+void FlightRecorder::OnReset()
+{
+    DumpToFile("reset");
+    Clear();
+}
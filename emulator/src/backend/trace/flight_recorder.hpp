@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Default number of instructions kept
+static const size_t FLIGHT_RECORDER_DEFAULT_SIZE = 4096;
+
+// One instruction as it was about to execute
+struct FlightRecord{
+    uint64_t halfTicks;
+    uint16_t PC;
+    uint16_t instruction;
+    uint16_t ext;           // Word after the instruction (its extension word when it has one)
+    uint16_t regs[8];
+    uint16_t SP;
+    uint8_t FLAGS;
+};
+
+// Ring of the last instructions executed. While it is enabled CPU::Run goes one instruction at a time (whatever the engine)
+// to fill it; disabled it costs nothing. Dumped on HLT and on reset to the dump file (when one is set), or on demand
+class FlightRecorder{
+    private:
+        std::vector<FlightRecord> ring;
+        size_t next = 0;
+        uint64_t recorded = 0;
+
+        // Half-tick count of the last record, an instruction is only recorded once
+        uint64_t lastHalfTicks = ~uint64_t(0);
+
+        std::string dumpPath;
+
+        // The current halt was already dumped
+        bool haltDumped = false;
+
+        void DumpToFile(const char* reason);
+
+    public:
+        // Keeps the last size instructions (cleared)
+        void Enable(size_t size = FLIGHT_RECORDER_DEFAULT_SIZE);
+
+        void Disable();
+
+        bool IsEnabled() const {
+            return !ring.empty();
+        }
+
+        // Empty for no automatic dump
+        void SetDumpPath(const std::string& path){
+            dumpPath = path;
+        }
+
+        void Record(const FlightRecord& record){
+            if (record.halfTicks == lastHalfTicks)
+                return;
+            lastHalfTicks = record.halfTicks;
+            ring[next] = record;
+            next = next + 1 == ring.size() ? 0 : next + 1;
+            recorded++;
+            haltDumped = false;
+        }
+
+        void Clear();
+
+        // Instructions held (at most the size)
+        size_t GetCount() const;
+
+        // Oldest first
+        const FlightRecord& Get(size_t index) const;
+
+        // Text listing, oldest instruction first
+        void Write(std::ostream& out, const char* reason) const;
+
+        // The CPU halted (dumped once per halt)
+        void OnHalt();
+
+        // CPU::Reset : dumped then cleared
+        void OnReset();
+};
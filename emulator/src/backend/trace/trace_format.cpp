@@ -0,0 +1,220 @@
+#include "trace_format.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+#include "../memory/ram.hpp"
+
+// CPUState's flip-flops, packed in one number
+static uint64_t PackFlags(const CPUState& state)
+{
+    return state.FLAGS | state.currentIsExt << 4 | state.currentIsAddrBase << 5 | state.currentIsAddrJsr << 6
+         | state.currentChangesSP << 7 | state.currentlyJsr << 8 | state.currentlyRts << 9 | state.regIsCurrAddr << 10
+         | state.clockSignal << 11 | state.writeToRAM << 12;
+}
+
+static void UnpackFlags(uint64_t bits, CPUState& state)
+{
+    state.FLAGS = bits & 0b1111;
+    state.currentIsExt = (bits >> 4) & 1;
+    state.currentIsAddrBase = (bits >> 5) & 1;
+    state.currentIsAddrJsr = (bits >> 6) & 1;
+    state.currentChangesSP = (bits >> 7) & 1;
+    state.currentlyJsr = (bits >> 8) & 1;
+    state.currentlyRts = (bits >> 9) & 1;
+    state.regIsCurrAddr = (bits >> 10) & 1;
+    state.clockSignal = (bits >> 11) & 1;
+    state.writeToRAM = (bits >> 12) & 1;
+}
+
+static std::string Difference(const char* name, uint64_t expected, uint64_t actual)
+{
+    std::ostringstream text;
+    text << name << " 0x" << std::hex << std::uppercase << expected << " / 0x" << actual;
+    return text.str();
+}
+
+std::string CompareMachineState(const MachineState& expected, const MachineState& actual)
+{
+    static const char* const regNames[8] = {"R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7"};
+    for (int i = 0; i < 8; ++i) {
+        if (expected.cpu.regs[i] != actual.cpu.regs[i])
+            return Difference(regNames[i], expected.cpu.regs[i], actual.cpu.regs[i]);
+    }
+
+    const struct { const char* name; uint64_t expected; uint64_t actual; } fields[] = {
+        {"SP", expected.cpu.SP, actual.cpu.SP},
+        {"PC", expected.cpu.PC, actual.cpu.PC},
+        {"RAM_ADDRESS", expected.cpu.RAM_ADDRESS, actual.cpu.RAM_ADDRESS},
+        {"IR0", expected.cpu.IR0, actual.cpu.IR0},
+        {"IR1", expected.cpu.IR1, actual.cpu.IR1},
+        {"flags and flip-flops", PackFlags(expected.cpu), PackFlags(actual.cpu)},
+        {"half-ticks", expected.halfTicks, actual.halfTicks},
+        {"bus address", expected.busAddress, actual.busAddress},
+        {"RAM output", expected.oldRAMvalue, actual.oldRAMvalue},
+        {"port A", expected.ports[0], actual.ports[0]},
+        {"port B", expected.ports[1], actual.ports[1]},
+        {"port C", expected.ports[2], actual.ports[2]},
+    };
+    for (const auto& field : fields) {
+        if (field.expected != field.actual)
+            return Difference(field.name, field.expected, field.actual);
+    }
+
+    if (expected.devices.size() != actual.devices.size())
+        return Difference("device count", expected.devices.size(), actual.devices.size());
+    for (size_t i = 0; i < expected.devices.size(); ++i) {
+        if (expected.devices[i] != actual.devices[i])
+            return "device " + std::to_string(i) + " state";
+    }
+    return "";
+}
+
+uint64_t HashRAM(const uint16_t* memory)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < ADDRESS_SPACE; ++i) {
+        hash = (hash ^ (memory[i] & 0xFF)) * 0x100000001B3ull;
+        hash = (hash ^ (memory[i] >> 8)) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void PutMachineState(std::vector<uint8_t>& out, const MachineState& state)
+{
+    for (uint16_t reg : state.cpu.regs)
+        PutVarint(out, reg);
+    PutVarint(out, state.cpu.SP);
+    PutVarint(out, state.cpu.PC);
+    PutVarint(out, state.cpu.RAM_ADDRESS);
+    PutVarint(out, state.cpu.IR0);
+    PutVarint(out, state.cpu.IR1);
+    PutVarint(out, PackFlags(state.cpu));
+    PutVarint(out, state.halfTicks);
+    PutVarint(out, state.busAddress);
+    PutVarint(out, state.oldRAMvalue);
+    for (uint16_t port : state.ports)
+        PutVarint(out, port);
+    PutVarint(out, state.devices.size());
+    for (const std::vector<uint16_t>& device : state.devices) {
+        PutVarint(out, device.size());
+        for (uint16_t word : device)
+            PutVarint(out, word);
+    }
+}
+
+void PutRAMDelta(std::vector<uint8_t>& out, const uint16_t* memory, const uint16_t* previous)
+{
+    size_t address = 0;
+    while (address < ADDRESS_SPACE) {
+        size_t unchanged = address;
+        while (unchanged < ADDRESS_SPACE && memory[unchanged] == previous[unchanged])
+            unchanged++;
+
+        // A single unchanged word between two changed ones costs less inside the changed run
+        size_t changed = unchanged;
+        while (changed < ADDRESS_SPACE && (memory[changed] != previous[changed]
+               || (changed + 1 < ADDRESS_SPACE && memory[changed + 1] != previous[changed + 1])))
+            changed++;
+
+        PutVarint(out, unchanged - address);
+        PutVarint(out, changed - unchanged);
+        for (size_t i = unchanged; i < changed; ++i)
+            PutVarint(out, memory[i] ^ previous[i]);
+        address = changed;
+    }
+}
+
+uint8_t TraceDecoder::GetByte()
+{
+    if (position >= size) {
+        failed = true;
+        return 0;
+    }
+    return data[position++];
+}
+
+uint64_t TraceDecoder::GetVarint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = GetByte();
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    failed = true;
+    return 0;
+}
+
+// Varint holding a 16 bit word
+static uint16_t GetWord(TraceDecoder& decoder, bool& failed)
+{
+    uint64_t value = decoder.GetVarint();
+    if (value > 0xFFFF)
+        failed = true;
+    return static_cast<uint16_t>(value);
+}
+
+MachineState TraceDecoder::GetMachineState()
+{
+    MachineState state;
+    for (uint16_t& reg : state.cpu.regs)
+        reg = GetWord(*this, failed);
+    state.cpu.SP = GetWord(*this, failed);
+    state.cpu.PC = GetWord(*this, failed);
+    state.cpu.RAM_ADDRESS = GetWord(*this, failed);
+    state.cpu.IR0 = GetWord(*this, failed);
+    state.cpu.IR1 = GetWord(*this, failed);
+    UnpackFlags(GetVarint(), state.cpu);
+    state.halfTicks = GetVarint();
+    state.busAddress = GetWord(*this, failed);
+    state.oldRAMvalue = GetWord(*this, failed);
+    for (uint16_t& port : state.ports)
+        port = GetWord(*this, failed);
+
+    // Every count is checked against the bytes left (a word takes one at least) before anything is allocated
+    uint64_t devices = GetVarint();
+    if (devices > size - position) {
+        failed = true;
+        return state;
+    }
+    state.devices.resize(devices);
+    for (std::vector<uint16_t>& device : state.devices) {
+        uint64_t words = GetVarint();
+        if (failed || words > size - position) {
+            failed = true;
+            return state;
+        }
+        device.resize(words);
+        for (uint16_t& word : device)
+            word = GetWord(*this, failed);
+    }
+    return state;
+}
+
+void TraceDecoder::ApplyRAMDelta(uint16_t* memory)
+{
+    size_t address = 0;
+    while (address < ADDRESS_SPACE && !failed) {
+        uint64_t unchanged = GetVarint();
+        uint64_t changed = GetVarint();
+        if (unchanged + changed > ADDRESS_SPACE - address) {
+            failed = true;
+            return;
+        }
+
+        address += unchanged;
+        for (uint64_t i = 0; i < changed; ++i, ++address)
+            memory[address] ^= GetWord(*this, failed);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../machine_state.hpp"
+
+// Trace file (little endian) :
+//     "O16TRACE", u32 version, u64 hash of the RAM when the recording started (HashRAM)
+//     records : u8 kind, varint half-ticks since the previous record, payload
+// Numbers are LEB128 varints. A keyframe's RAM is a delta against the previous keyframe's (zeros for the first one),
+// restarts included :
+// runs of unchanged words and runs of changed words, the changed ones stored XOR the previous value.
+// A state ends with the devices' own words : their count, then for each one its word count and the words
+static const char TRACE_MAGIC[8] = {'O', '1', '6', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t TRACE_VERSION = 2;
+static const size_t TRACE_HEADER_SIZE = 8 + 4 + 8;
+
+enum TraceRecordKind : uint8_t{
+    TRACE_INPUT = 1,     // u8 port, varint value : an IN port set from outside the CPU
+    TRACE_KEYFRAME = 2,  // State and RAM delta, checked by the replay
+    TRACE_RESTART = 3,   // Same payload, loaded by the replay : the recording's start and every CPU::Init (program load, reset).
+                         // Written 0 half-ticks after the previous record, the half-ticks of its state take over
+    TRACE_END = 4        // u8 halted
+};
+
+// First difference between two states, described ("R3 0x12 / 0x13"), empty when they are the same
+std::string CompareMachineState(const MachineState& expected, const MachineState& actual);
+
+// FNV-1a over the ADDRESS_SPACE words
+uint64_t HashRAM(const uint16_t* memory);
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t value);
+
+void PutMachineState(std::vector<uint8_t>& out, const MachineState& state);
+
+void PutRAMDelta(std::vector<uint8_t>& out, const uint16_t* memory, const uint16_t* previous);
+
+// Reads the records of a trace held in memory, any read past the end or malformed field sets Failed()
+class TraceDecoder{
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        bool failed = false;
+
+    public:
+        TraceDecoder(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        bool AtEnd() const {
+            return position >= size;
+        }
+
+        bool Failed() const {
+            return failed;
+        }
+
+        size_t GetPosition() const {
+            return position;
+        }
+
+        uint8_t GetByte();
+
+        uint64_t GetVarint();
+
+        MachineState GetMachineState();
+
+        // Applies the delta to memory, which holds the previous keyframe's RAM
+        void ApplyRAMDelta(uint16_t* memory);
+};
@@ -0,0 +1,184 @@
+#include "trace_recorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../machine.hpp"
+
+TraceRecorder::~TraceRecorder()
+{
+    std::string error;
+    Stop(error);
+}
+
+bool TraceRecorder::Start(const std::string& path, uint64_t keyframeIntervalCycles, std::string& error)
+{
+    if (recording && !Stop(error))
+        return false;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = "Could not create the trace : " + path;
+        return false;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    uint64_t hash = HashRAM(machine.ram.Data());
+    std::memcpy(header, TRACE_MAGIC, 8);
+    for (int i = 0; i < 4; ++i)
+        header[8 + i] = static_cast<uint8_t>(TRACE_VERSION >> (8 * i));
+    for (int i = 0; i < 8; ++i)
+        header[12 + i] = static_cast<uint8_t>(hash >> (8 * i));
+    file.write(reinterpret_cast<const char*>(header), TRACE_HEADER_SIZE);
+
+    closing = false;
+    writeError.clear();
+    writer = std::thread(&TraceRecorder::WriteLoop, this, std::move(file));
+
+    recording = true;
+    intervalHalfTicks = std::max<uint64_t>(keyframeIntervalCycles, 1) * 2;
+    QueueKeyframe(TRACE_RESTART);
+    return true;
+}
+
+bool TraceRecorder::Stop(std::string& error)
+{
+    if (!recording)
+        return true;
+
+    QueueKeyframe(TRACE_KEYFRAME);
+    PendingRecord end;
+    end.kind = TRACE_END;
+    end.halfTicks = machine.cpu.GetHalfTicks();
+    end.halted = machine.cpu.IsHalted();
+    Queue(std::move(end));
+    recording = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    queued.notify_one();
+    writer.join();
+
+    freeImages.clear();
+    if (!writeError.empty()) {
+        error = writeError;
+        return false;
+    }
+    return true;
+}
+
+void TraceRecorder::RecordInput(int port, uint16_t value)
+{
+    PendingRecord input;
+    input.kind = TRACE_INPUT;
+    input.halfTicks = machine.cpu.GetHalfTicks();
+    input.port = static_cast<uint8_t>(port);
+    input.value = value;
+    Queue(std::move(input));
+}
+
+void TraceRecorder::OnRestart()
+{
+    QueueKeyframe(TRACE_RESTART);
+}
+
+void TraceRecorder::Queue(PendingRecord&& record)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(record));
+    }
+    queued.notify_one();
+}
+
+void TraceRecorder::QueueKeyframe(TraceRecordKind kind)
+{
+    PendingRecord keyframe;
+    keyframe.kind = kind;
+    keyframe.state = machine.CaptureState();
+    keyframe.halfTicks = keyframe.state.halfTicks;
+    nextKeyframe = keyframe.halfTicks + intervalHalfTicks;
+
+    {
+        // Back-pressure : the emulation waits rather than piling up copies of the RAM
+        std::unique_lock<std::mutex> lock(mutex);
+        written.wait(lock, [this]() { return imagesInUse < TRACE_MAX_PENDING_KEYFRAMES; });
+        imagesInUse++;
+        if (!freeImages.empty()) {
+            keyframe.memory = std::move(freeImages.back());
+            freeImages.pop_back();
+        }
+    }
+
+    const uint16_t* memory = machine.ram.Data();
+    keyframe.memory.assign(memory, memory + ADDRESS_SPACE);
+    Queue(std::move(keyframe));
+}
+
+void TraceRecorder::WriteLoop(std::ofstream file)
+{
+    // RAM of the last keyframe written, the next one is a delta against it
+    std::vector<uint16_t> previous(ADDRESS_SPACE, 0);
+    uint64_t lastHalfTicks = 0;
+    std::vector<uint8_t> bytes;
+    std::deque<PendingRecord> batch;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [this]() { return !pending.empty() || closing; });
+            if (pending.empty())
+                break;
+            batch.swap(pending);
+        }
+
+        size_t imagesDone = 0;
+        std::vector<std::vector<uint16_t>> returned;
+        bytes.clear();
+        for (PendingRecord& record : batch) {
+            bytes.push_back(record.kind);
+            if (record.kind == TRACE_RESTART) {
+                PutVarint(bytes, 0);
+            }
+            else {
+                // Never goes backwards outside a restart
+                PutVarint(bytes, record.halfTicks - std::min(lastHalfTicks, record.halfTicks));
+            }
+            lastHalfTicks = record.halfTicks;
+
+            switch (record.kind) {
+                case TRACE_INPUT:
+                    bytes.push_back(record.port);
+                    PutVarint(bytes, record.value);
+                    break;
+                case TRACE_KEYFRAME:
+                case TRACE_RESTART:
+                    PutMachineState(bytes, record.state);
+                    PutRAMDelta(bytes, record.memory.data(), previous.data());
+                    previous.swap(record.memory);
+                    returned.push_back(std::move(record.memory));
+                    imagesDone++;
+                    break;
+                case TRACE_END:
+                    bytes.push_back(record.halted);
+                    break;
+            }
+        }
+        batch.clear();
+
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        file.flush();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!file && writeError.empty())
+                writeError = "Could not write the trace";
+            imagesInUse -= imagesDone;
+            for (std::vector<uint16_t>& image : returned)
+                freeImages.push_back(std::move(image));
+        }
+        written.notify_all();
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace_format.hpp"
+
+class Machine;
+
+// Default distance between two keyframes, in clock cycles
+static const uint64_t TRACE_DEFAULT_KEYFRAME_INTERVAL = 10000000;
+
+// Keyframes the writer thread may have on hand before the emulation waits for it
+static const size_t TRACE_MAX_PENDING_KEYFRAMES = 4;
+
+// Records a run (see trace_format.hpp) : the IN port values set from outside the CPU (Machine::SetInput), a restart
+// on every CPU::Init and a keyframe every interval. CPU::Run stops at the keyframes, like at the profiler's samples.
+// The emulation thread only queues the raw records (a keyframe is a copy of the RAM), a background thread
+// delta-encodes them and streams the file
+class TraceRecorder{
+    private:
+        Machine& machine;
+
+        bool recording = false;
+        uint64_t intervalHalfTicks = 0;
+        uint64_t nextKeyframe = 0;
+
+        // Record as queued by the emulation thread
+        struct PendingRecord{
+            TraceRecordKind kind = TRACE_INPUT;
+            uint64_t halfTicks = 0;
+            uint8_t port = 0;               // TRACE_INPUT
+            uint16_t value = 0;
+            bool halted = false;            // TRACE_END
+            MachineState state;             // Keyframes and restarts
+            std::vector<uint16_t> memory;
+        };
+
+        std::mutex mutex;
+        std::condition_variable queued;
+        std::condition_variable written;
+        std::deque<PendingRecord> pending;
+
+        // RAM copies given back by the writer thread, and the ones queued or being encoded
+        std::vector<std::vector<uint16_t>> freeImages;
+        size_t imagesInUse = 0;
+
+        bool closing = false;
+        std::string writeError;
+        std::thread writer;
+
+        void Queue(PendingRecord&& record);
+
+        void QueueKeyframe(TraceRecordKind kind);
+
+        // Writer thread
+        void WriteLoop(std::ofstream file);
+
+    public:
+        explicit TraceRecorder(Machine& machine) : machine(machine) {}
+
+        ~TraceRecorder();
+
+        TraceRecorder(const TraceRecorder&) = delete;
+        TraceRecorder& operator=(const TraceRecorder&) = delete;
+        TraceRecorder(TraceRecorder&&) = delete;
+        TraceRecorder& operator=(TraceRecorder&&) = delete;
+
+        // Starts from the Machine's current state, false (with error set) when the file can't be created
+        bool Start(const std::string& path, uint64_t keyframeIntervalCycles, std::string& error);
+
+        // Ends with a keyframe, then waits for the writer thread. False (with error set) when the file could not be written
+        bool Stop(std::string& error);
+
+        bool IsRecording() const {
+            return recording;
+        }
+
+        void RecordInput(int port, uint16_t value);
+
+        // CPU::Init or a state put back (Machine::RestoreState) : the replay loads the state as it is now
+        void OnRestart();
+
+        // Half-ticks CPU::Run can go before the next keyframe (at least 1)
+        uint64_t GetHalfTicksToKeyframe(uint64_t halfTicks) const {
+            return nextKeyframe > halfTicks ? nextKeyframe - halfTicks : 1;
+        }
+
+        // CPU::Run stopped with the CPU at halfTicks
+        void OnRun(uint64_t halfTicks){
+            if (halfTicks >= nextKeyframe)
+                QueueKeyframe(TRACE_KEYFRAME);
+        }
+};
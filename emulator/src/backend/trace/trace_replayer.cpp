@@ -0,0 +1,146 @@
+#include "trace_replayer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "../machine.hpp"
+
+bool TraceReplayer::Load(const std::string& path, std::string& error)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Could not open the trace : " + path;
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (data.size() < TRACE_HEADER_SIZE || !std::equal(TRACE_MAGIC, TRACE_MAGIC + 8, data.begin())) {
+        error = "Not an Organ16 trace : " + path;
+        return false;
+    }
+
+    uint32_t version = 0;
+    for (int i = 0; i < 4; ++i)
+        version |= static_cast<uint32_t>(data[8 + i]) << (8 * i);
+    if (version != TRACE_VERSION) {
+        error = "Unsupported trace version " + std::to_string(version) + " : " + path;
+        return false;
+    }
+
+    ramHash = 0;
+    for (int i = 0; i < 8; ++i)
+        ramHash |= static_cast<uint64_t>(data[12 + i]) << (8 * i);
+    return true;
+}
+
+// Runs the CPU up to target, false when it halts before
+static bool RunTo(Machine& machine, uint64_t target)
+{
+    CPU& cpu = machine.cpu;
+    while (cpu.GetHalfTicks() < target) {
+        if (cpu.IsHalted())
+            return false;
+        cpu.Run(target - cpu.GetHalfTicks());
+    }
+    return true;
+}
+
+static std::string DescribeDivergence(uint64_t halfTicks, const std::string& what)
+{
+    std::ostringstream text;
+    text << "Diverged at half-tick " << halfTicks << " : " << what;
+    return text.str();
+}
+
+TraceReplayResult TraceReplayer::Replay(Machine& machine) const
+{
+    TraceReplayResult result;
+    if (data.size() < TRACE_HEADER_SIZE) {
+        result.message = "No trace loaded";
+        return result;
+    }
+
+    TraceDecoder decoder(data.data() + TRACE_HEADER_SIZE, data.size() - TRACE_HEADER_SIZE);
+    std::vector<uint16_t> memory(ADDRESS_SPACE, 0);
+    uint64_t halfTicks = 0;
+    uint64_t startHalfTicks = 0;
+    bool started = false;
+
+    while (!decoder.AtEnd()) {
+        TraceRecordKind kind = static_cast<TraceRecordKind>(decoder.GetByte());
+        halfTicks += decoder.GetVarint();
+
+        if (kind == TRACE_RESTART || kind == TRACE_KEYFRAME) {
+            MachineState state = decoder.GetMachineState();
+            decoder.ApplyRAMDelta(memory.data());
+            if (decoder.Failed())
+                break;
+
+            if (kind == TRACE_RESTART) {
+                if (started)
+                    result.halfTicks += machine.cpu.GetHalfTicks() - startHalfTicks;
+                machine.RestoreState(state, memory.data());
+                halfTicks = startHalfTicks = state.halfTicks;
+                started = true;
+                continue;
+            }
+
+            if (!started || !RunTo(machine, halfTicks)) {
+                result.message = DescribeDivergence(halfTicks, "the CPU halted before the keyframe");
+                return result;
+            }
+
+            std::string difference = CompareMachineState(state, machine.CaptureState());
+            const uint16_t* replayed = machine.ram.Data();
+            for (size_t address = 0; address < ADDRESS_SPACE && difference.empty(); ++address) {
+                if (replayed[address] != memory[address]) {
+                    std::ostringstream text;
+                    text << "RAM[0x" << std::hex << std::uppercase << address << "] 0x" << memory[address] << " / 0x" << replayed[address];
+                    difference = text.str();
+                }
+            }
+            if (!difference.empty()) {
+                result.message = DescribeDivergence(halfTicks, difference + " (recorded / replayed)");
+                return result;
+            }
+            result.keyframes++;
+        }
+        else if (kind == TRACE_INPUT) {
+            uint8_t port = decoder.GetByte();
+            uint64_t value = decoder.GetVarint();
+            if (decoder.Failed() || port >= IO_PORT_COUNT || value > 0xFFFF)
+                break;
+
+            if (!started || !RunTo(machine, halfTicks)) {
+                result.message = DescribeDivergence(halfTicks, "the CPU halted before an input");
+                return result;
+            }
+            machine.ioPorts.SetPortValue(port, static_cast<uint16_t>(value));
+            result.inputs++;
+        }
+        else if (kind == TRACE_END) {
+            bool halted = decoder.GetByte() != 0;
+            if (decoder.Failed() || !decoder.AtEnd())
+                break;
+
+            result.halfTicks += machine.cpu.GetHalfTicks() - startHalfTicks;
+            if (machine.cpu.IsHalted() != halted) {
+                result.message = DescribeDivergence(halfTicks, halted ? "the recorded run halted" : "the replayed run halted");
+                return result;
+            }
+            result.matched = true;
+            result.message = "Reproduced";
+            return result;
+        }
+        else {
+            break;
+        }
+    }
+
+    std::ostringstream text;
+    text << "Malformed or truncated trace (at byte " << TRACE_HEADER_SIZE + decoder.GetPosition() << ")";
+    result.message = text.str();
+    return result;
+}
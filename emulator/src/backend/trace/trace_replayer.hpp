@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "trace_format.hpp"
+
+class Machine;
+
+struct TraceReplayResult{
+    bool matched = false;       // Every keyframe and the end of the run were reproduced
+    uint64_t inputs = 0;
+    uint64_t keyframes = 0;     // Checked (restarts not included)
+    uint64_t halfTicks = 0;     // Emulated
+    std::string message;        // What went wrong (first divergence, malformed trace)
+};
+
+// Plays a trace back on a Machine : loads its first state, runs the CPU (at full speed, whatever the engine) up to each
+// record, sets the inputs at their half-tick and checks the keyframes against the Machine
+class TraceReplayer{
+    private:
+        std::vector<uint8_t> data;
+        uint64_t ramHash = 0;
+
+    public:
+        // On failure returns false and describes the problem in error
+        bool Load(const std::string& path, std::string& error);
+
+        // Of the RAM when the recording started (HashRAM)
+        uint64_t GetRAMHash() const {
+            return ramHash;
+        }
+
+        TraceReplayResult Replay(Machine& machine) const;
+};
@@ -0,0 +1,86 @@
+/*
+This is "organ16_batch.cpp", the batch runner for the Organ16 emulator.
+It runs every job of a manifest on all the host's cores and writes one JSON line per job,
+then fails if a job's results differ from the ones its manifest line expects.
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "backend/batch/batch_runner.hpp"
+
+static void PrintUsage(const char* exe){
+    std::cerr << "Usage: " << exe << " <manifest> [options]\n"
+              << "  --threads N   Worker threads (default: one per hardware thread)\n"
+              << "  --out FILE    Write the JSON lines to FILE instead of the standard output\n"
+              << "Manifest : one job per line, '<program.bin> [--engine NAME] [--cycles N] [--in0/--in1/--in2 V]', '#' starts a comment\n"
+              << "           --expect-cycles N, --expect-ram-hash H, --expect-fb-hash H, --expect-lcd-hash H : the job fails\n"
+              << "           (and the run returns 1) when its result differs\n";
+}
+
+int main(int argc, char* argv[]){
+    std::string manifestPath;
+    std::string outputPath;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--threads" && hasValue) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 0));
+        }
+        else if (arg == "--out" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (!arg.empty() && arg[0] != '-' && manifestPath.empty()) {
+            manifestPath = arg;
+        }
+        else {
+            std::cerr << "Invalid argument : " << arg << "\n";
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (manifestPath.empty()) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    std::vector<BatchJob> jobs;
+    std::string error;
+    if (!LoadBatchManifest(manifestPath, jobs, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            std::cerr << "Could not write the results : " << outputPath << "\n";
+            return 1;
+        }
+    }
+
+    BatchSummary summary = RunBatch(jobs, threads, outputPath.empty() ? std::cout : file);
+
+    std::cerr << "Jobs        : " << summary.jobs << "\n"
+              << "Threads     : " << summary.workers << "\n"
+              << "Cycles      : " << summary.cycles << "\n"
+              << "Host time   : " << std::fixed << std::setprecision(3) << summary.seconds * 1000.0 << " ms\n"
+              << "Throughput  : " << std::setprecision(3) << (summary.seconds > 0 ? summary.cycles / summary.seconds / 1e6 : 0.0) << " MHz\n";
+
+    if (!summary.failures.empty()) {
+        std::cerr << "Failures    : " << summary.failures.size() << "\n";
+        for (const std::string& failure : summary.failures)
+            std::cerr << "  " << failure << "\n";
+        return 1;
+    }
+    return 0;
+}
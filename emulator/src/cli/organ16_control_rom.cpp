@@ -0,0 +1,73 @@
+/*
+This is "organ16_control_rom.cpp", the control ROM exporter for the Organ16 emulator.
+It writes the emulator's decode table as ROM images for the Logisim circuit and the breadboard build.
+The ROM address is (OpCode << 8) | (SubOpCode << 4) | FLAGS, see ControlRomAddress.
+*/
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "backend/control_unit/control_unit.hpp"
+
+static void PrintUsage(const char* exe){
+    std::cerr << "Usage: " << exe << " <output prefix>\n"
+              << "  Writes <prefix>.hex     Logisim \"v2.0 raw\" image, 2048 x 22 bit words\n"
+              << "         <prefix>_0.bin   Bits 0-7 of every word, for a 2K x 8 EEPROM (28C16)\n"
+              << "         <prefix>_1.bin   Bits 8-15\n"
+              << "         <prefix>_2.bin   Bits 16-21\n";
+}
+
+static bool WriteLogisimImage(const std::string& path, const std::array<uint32_t, CONTROL_ROM_SIZE>& image){
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    file << "v2.0 raw\n";
+    for (size_t address = 0; address < CONTROL_ROM_SIZE; ++address) {
+        file << std::hex << image[address] << ((address % 8 == 7) ? "\n" : " ");
+    }
+    return static_cast<bool>(file);
+}
+
+static bool WriteEepromSlice(const std::string& path, const std::array<uint32_t, CONTROL_ROM_SIZE>& image, int slice){
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    for (size_t address = 0; address < CONTROL_ROM_SIZE; ++address) {
+        char byte = static_cast<char>((image[address] >> (slice * 8)) & 0xFF);
+        file.put(byte);
+    }
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char* argv[]){
+    if (argc != 2) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    std::string prefix = argv[1];
+    std::array<uint32_t, CONTROL_ROM_SIZE> image = ControlUnit::GetControlRomImage();
+
+    if (!WriteLogisimImage(prefix + ".hex", image)) {
+        std::cerr << "Could not write " << prefix << ".hex\n";
+        return 1;
+    }
+
+    const int sliceCount = (CONTROL_ROM_WORD_BITS + 7) / 8;
+    for (int slice = 0; slice < sliceCount; ++slice) {
+        std::string path = prefix + "_" + std::to_string(slice) + ".bin";
+        if (!WriteEepromSlice(path, image, slice)) {
+            std::cerr << "Could not write " << path << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Control ROM : " << CONTROL_ROM_SIZE << " words of " << CONTROL_ROM_WORD_BITS << " bits, "
+              << sliceCount << " EEPROM slices\n";
+    return 0;
+}
@@ -0,0 +1,758 @@
+/*
+This is "organ16_run.cpp", the headless runner for the Organ16 emulator.
+It loads a compiled program, runs it without any GUI and dumps the machine state.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "backend/machine.hpp"
+#include "backend/clock_pacer.hpp"
+#include "backend/lockstep/lockstep_engine.hpp"
+#include "backend/memory/program_image.hpp"
+#include "backend/profiler/profile_report.hpp"
+#include "backend/trace/trace_replayer.hpp"
+#include "backend/savestate/save_state.hpp"
+#include "backend/debug/gdb_stub.hpp"
+
+// Every heap allocation of the process goes through here, the report shows how many happened during the run
+// (none for the RTL model : its half-tick only works on the Machine's CPUState)
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(std::size_t size){
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+// Host frame of a paced run
+static const std::chrono::milliseconds PACED_FRAME_LENGTH(16);
+
+struct RunOptions{
+    std::string programPath;
+    uint64_t maxCycles = std::numeric_limits<uint64_t>::max() / 2;
+    uint16_t inputs[IO_PORT_COUNT] = {0, 0, 0};
+    std::string ramDumpPath;
+    std::string framebufferDumpPath;
+    std::string countersPath;
+    std::string heatmapPath;
+
+    // --lcd-spi : the ST7735S also listens to its pins on this port, --dump-lcd writes what its panel shows
+    int lcdSpiPort = -1;
+    std::string lcdDumpPath;
+
+    // --profile / --annotate : sample the PC every profileInterval cycles, report against the source map
+    std::string profilePath;
+    std::string annotatePath;
+    std::string sourceMapPath;     // Default : the program's .map, when there is one
+    uint64_t profileInterval = PROFILER_DEFAULT_INTERVAL;
+
+    // --record / --replay : trace of the run (inputs and keyframes)
+    std::string recordPath;
+    std::string replayPath;
+    uint64_t keyframeInterval = TRACE_DEFAULT_KEYFRAME_INTERVAL;
+
+    // --flight-recorder : last instructions executed, written to flightDumpPath (standard output by default)
+    size_t flightRecorderSize = 0;
+    std::string flightDumpPath;
+
+    // --load-state starts from a save state (instead of the program's first instruction), --save-state writes the final one
+    std::string loadStatePath;
+    std::string saveStatePath;
+
+    // --break / --watch : Debugger::Add() commands, the run stops on the first one set off
+    std::vector<std::string> debugCommands;
+
+    // --gdb : serve a gdb / lldb client (PORT or unix:PATH) before the run
+    std::string gdbAddress;
+
+    bool quiet = false;
+    ExecutionEngine engine = ENGINE_FUNCTIONAL;
+
+    // --mhz : run in real time at this frequency (ClockPacer) instead of flat out
+    double targetMHz = 0;
+
+    // --engine lockstep : that many machines run the program side by side (LockstepEngine)
+    bool lockstep = false;
+    size_t lanes = 64;
+    LockstepIsa isa = LockstepEngine::GetBestIsa();
+    int sweepPort = -1;     // Lane i sees its input + i on this port
+};
+
+static void PrintUsage(const char* exe){
+    std::cerr << "Usage: " << exe << " <program.bin|program.o16> [options]\n"
+              << "       " << exe << " --load-state FILE [options]\n"
+              << "  --cycles N          Stop after N clock cycles (default: run until HLT)\n"
+              << "  --engine NAME       functional (default), jit (native code, x86-64 Linux), rtl (half-tick circuit model)\n"
+              << "                      or lockstep (many machines at once, one per SIMD lane)\n"
+              << "  --lanes N           Machines run by the lockstep engine (default: 64), the dumps show the first one\n"
+              << "  --isa NAME          Lockstep instruction set : scalar, sse2 or avx2 (default: the widest available)\n"
+              << "  --sweep P           Lockstep lane i sees its --inP value + i on port P\n"
+              << "  --mhz F             Pace the clock at F MHz in real time (e.g. 0.5) and report the frequency achieved\n"
+              << "  --in0/--in1/--in2 V Value presented on IO port A/B/C (hex with 0x, or decimal)\n"
+              << "  --dump-ram FILE     Write the final RAM content (same text format as .bin)\n"
+              << "  --dump-fb FILE      Write the final framebuffer as a binary PPM image\n"
+              << "  --counters FILE     Write the performance counters as CSV (name,value ; - for the standard output)\n"
+              << "  --lcd-spi P         Wire the ST7735S display controller's pins to OUT port P (bit level SPI : SDA bit 0,\n"
+              << "                      SCL bit 1, D/CX bit 2, CSX bit 3, RESX bit 4), on top of its memory mapped registers\n"
+              << "  --dump-lcd FILE     Write what the ST7735S panel shows at the end as a binary PPM image (128x160)\n"
+              << "  --heatmap FILE      Count the reads, writes and fetches of every address and write them as a binary dump\n"
+              << "  --profile FILE      Sample the PC and write the hot spots (routines, source lines ; - for the standard output)\n"
+              << "  --annotate FILE     Sample the PC and write the sources annotated with their share of the samples\n"
+              << "  --profile-interval N  Cycles between two samples (default: " << PROFILER_DEFAULT_INTERVAL << ")\n"
+              << "  --source-map FILE   Source map written by tools/compiler.py (default: the program's .map)\n"
+              << "  --record FILE       Record a trace of the run (inputs and state keyframes) for --replay\n"
+              << "  --keyframe-interval N  Cycles between two keyframes of the trace (default: " << TRACE_DEFAULT_KEYFRAME_INTERVAL << ")\n"
+              << "  --replay FILE       Replay a trace recorded from this program and check it runs the same\n"
+              << "  --flight-recorder N Keep the last N instructions executed (runs one instruction at a time)\n"
+              << "  --flight-dump FILE  Where they are written, on HLT or at the end of the run (default: the standard output)\n"
+              << "  --load-state FILE   Start from a save state (the program, if given, is loaded first then replaced)\n"
+              << "  --save-state FILE   Write the final state, --load-state starts from it\n"
+              << "  --break SPEC        Stop before the instruction at ADDRESS [if CONDITION], e.g. \"0x40 if R3 == 0x7F && [0xC000] > 100\"\n"
+              << "  --watch SPEC        Stop after a data access : [read|write|access|change] FIRST[-LAST] [if CONDITION]\n"
+              << "                      (write by default, the word is 'value'), or after a register changes : REGISTER [if CONDITION]\n"
+              << "  --gdb ADDRESS       Wait for gdb / lldb on PORT (localhost) or unix:PATH and let it drive the machine,\n"
+              << "                      the run goes on once it detaches (target remote localhost:PORT)\n"
+              << "  --quiet             Do not print the register dump\n";
+}
+
+static bool ParseNumber(const char* text, uint64_t& out){
+    char* end = nullptr;
+    out = std::strtoull(text, &end, 0);
+    return end != text && *end == '\0';
+}
+
+static bool ParseDecimal(const char* text, double& out){
+    char* end = nullptr;
+    out = std::strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool ParseArgs(int argc, char* argv[], RunOptions& options){
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        uint64_t value = 0;
+
+        if (arg == "--cycles" && hasValue && ParseNumber(argv[i + 1], value)) {
+            options.maxCycles = value;
+            ++i;
+        }
+        else if ((arg == "--in0" || arg == "--in1" || arg == "--in2") && hasValue && ParseNumber(argv[i + 1], value)) {
+            options.inputs[arg[4] - '0'] = static_cast<uint16_t>(value);
+            ++i;
+        }
+        else if (arg == "--engine" && hasValue && std::strcmp(argv[i + 1], "rtl") == 0) {
+            options.engine = ENGINE_RTL;
+            ++i;
+        }
+        else if (arg == "--engine" && hasValue && std::strcmp(argv[i + 1], "functional") == 0) {
+            options.engine = ENGINE_FUNCTIONAL;
+            ++i;
+        }
+        else if (arg == "--engine" && hasValue && std::strcmp(argv[i + 1], "jit") == 0) {
+            options.engine = ENGINE_JIT;
+            ++i;
+        }
+        else if (arg == "--engine" && hasValue && std::strcmp(argv[i + 1], "lockstep") == 0) {
+            options.lockstep = true;
+            ++i;
+        }
+        else if (arg == "--lanes" && hasValue && ParseNumber(argv[i + 1], value) && value > 0) {
+            options.lanes = static_cast<size_t>(value);
+            ++i;
+        }
+        else if (arg == "--isa" && hasValue && std::strcmp(argv[i + 1], "scalar") == 0) {
+            options.isa = LOCKSTEP_SCALAR;
+            ++i;
+        }
+        else if (arg == "--isa" && hasValue && std::strcmp(argv[i + 1], "sse2") == 0) {
+            options.isa = LOCKSTEP_SSE2;
+            ++i;
+        }
+        else if (arg == "--isa" && hasValue && std::strcmp(argv[i + 1], "avx2") == 0) {
+            options.isa = LOCKSTEP_AVX2;
+            ++i;
+        }
+        else if (arg == "--sweep" && hasValue && ParseNumber(argv[i + 1], value) && value < IO_PORT_COUNT) {
+            options.sweepPort = static_cast<int>(value);
+            ++i;
+        }
+        else if (arg == "--mhz" && hasValue && ParseDecimal(argv[i + 1], options.targetMHz) && options.targetMHz > 0) {
+            ++i;
+        }
+        else if (arg == "--dump-ram" && hasValue) {
+            options.ramDumpPath = argv[++i];
+        }
+        else if (arg == "--dump-fb" && hasValue) {
+            options.framebufferDumpPath = argv[++i];
+        }
+        else if (arg == "--counters" && hasValue) {
+            options.countersPath = argv[++i];
+        }
+        else if (arg == "--lcd-spi" && hasValue && ParseNumber(argv[i + 1], value) && value < IO_PORT_COUNT) {
+            options.lcdSpiPort = static_cast<int>(value);
+            ++i;
+        }
+        else if (arg == "--dump-lcd" && hasValue) {
+            options.lcdDumpPath = argv[++i];
+        }
+        else if (arg == "--heatmap" && hasValue) {
+            options.heatmapPath = argv[++i];
+        }
+        else if (arg == "--profile" && hasValue) {
+            options.profilePath = argv[++i];
+        }
+        else if (arg == "--annotate" && hasValue) {
+            options.annotatePath = argv[++i];
+        }
+        else if (arg == "--profile-interval" && hasValue && ParseNumber(argv[i + 1], value) && value > 0) {
+            options.profileInterval = value;
+            ++i;
+        }
+        else if (arg == "--source-map" && hasValue) {
+            options.sourceMapPath = argv[++i];
+        }
+        else if (arg == "--record" && hasValue) {
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--keyframe-interval" && hasValue && ParseNumber(argv[i + 1], value) && value > 0) {
+            options.keyframeInterval = value;
+            ++i;
+        }
+        else if (arg == "--replay" && hasValue) {
+            options.replayPath = argv[++i];
+        }
+        else if (arg == "--flight-recorder" && hasValue && ParseNumber(argv[i + 1], value) && value > 0) {
+            options.flightRecorderSize = static_cast<size_t>(value);
+            ++i;
+        }
+        else if (arg == "--flight-dump" && hasValue) {
+            options.flightDumpPath = argv[++i];
+        }
+        else if (arg == "--load-state" && hasValue) {
+            options.loadStatePath = argv[++i];
+        }
+        else if (arg == "--save-state" && hasValue) {
+            options.saveStatePath = argv[++i];
+        }
+        else if (arg == "--break" && hasValue) {
+            options.debugCommands.push_back(std::string("break ") + argv[++i]);
+        }
+        else if (arg == "--watch" && hasValue) {
+            options.debugCommands.push_back(std::string("watch ") + argv[++i]);
+        }
+        else if (arg == "--gdb" && hasValue) {
+            options.gdbAddress = argv[++i];
+        }
+        else if (arg == "--quiet") {
+            options.quiet = true;
+        }
+        else if (!arg.empty() && arg[0] != '-' && options.programPath.empty()) {
+            options.programPath = arg;
+        }
+        else {
+            std::cerr << "Invalid argument : " << arg << "\n";
+            return false;
+        }
+    }
+
+    // The lockstep lanes have no devices
+    if (options.lockstep && (options.lcdSpiPort >= 0 || !options.lcdDumpPath.empty())) {
+        std::cerr << "--lcd-spi and --dump-lcd need a machine with the ST7735S, not --engine lockstep\n";
+        return false;
+    }
+    return !options.programPath.empty() || (!options.loadStatePath.empty() && !options.lockstep);
+}
+
+static void DumpRegisters(Machine& machine){
+    static const RegisterName names[] = {R0, R1, R2, R3, R4, R5, R6, R7, SP, PC, FLAGS, IR0, IR1, RAM_ADDRESS};
+    static const char* labels[] = {"R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "SP", "PC", "FLAGS", "IR0", "IR1", "RAM_ADDRESS"};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        std::cout << std::setw(12) << std::left << labels[i] << "0x"
+                  << std::uppercase << std::setfill('0') << std::setw(4) << std::right << std::hex
+                  << machine.registers.GetRegValue(names[i])
+                  << std::dec << std::setfill(' ') << "\n";
+    }
+    for (int p = 0; p < IO_PORT_COUNT; ++p) {
+        std::cout << "PORT" << static_cast<char>('A' + p) << "       0x"
+                  << std::uppercase << std::setfill('0') << std::setw(4) << std::hex
+                  << machine.ioPorts.GetIN(p)
+                  << std::dec << std::setfill(' ') << "\n";
+    }
+}
+
+static void DumpLaneRegisters(const LockstepEngine& engine, size_t lane){
+    ArchState state = engine.GetLaneState(lane);
+    const uint16_t values[] = {state.regs[0], state.regs[1], state.regs[2], state.regs[3], state.regs[4], state.regs[5],
+                               state.regs[6], state.regs[7], state.SP, state.PC, state.FLAGS, state.IR1};
+    static const char* labels[] = {"R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7", "SP", "PC", "FLAGS", "IR1"};
+
+    for (size_t i = 0; i < sizeof(labels) / sizeof(labels[0]); ++i) {
+        std::cout << std::setw(12) << std::left << labels[i] << "0x"
+                  << std::uppercase << std::setfill('0') << std::setw(4) << std::right << std::hex
+                  << values[i]
+                  << std::dec << std::setfill(' ') << "\n";
+    }
+    for (int p = 0; p < IO_PORT_COUNT; ++p) {
+        std::cout << "PORT" << static_cast<char>('A' + p) << "       0x"
+                  << std::uppercase << std::setfill('0') << std::setw(4) << std::hex
+                  << engine.GetLanePort(lane, p)
+                  << std::dec << std::setfill(' ') << "\n";
+    }
+}
+
+static bool DumpRAM(const uint16_t* memory, const std::string& path){
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    out << std::hex << std::setfill('0');
+    for (size_t address = 0; address < ADDRESS_SPACE; ++address) {
+        out << std::setw(4) << memory[address];
+        out << (((address + 1) % 16 == 0) ? '\n' : ' ');
+    }
+    return static_cast<bool>(out);
+}
+
+static bool DumpFramebuffer(const uint16_t* memory, const std::string& path){
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+
+    out << "P6\n" << SCREEN_WIDTH << " " << SCREEN_HEIGHT << "\n255\n";
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; ++i) {
+        uint16_t color = memory[FRAMEBUFFER_START + i];
+
+        // Extracting 5-6-5 RGB components
+        char rgb[3] = {
+            static_cast<char>((((color >> 11) & 0x1F) * 255) / 31),
+            static_cast<char>((((color >> 5) & 0x3F) * 255) / 63),
+            static_cast<char>(((color & 0x1F) * 255) / 31)
+        };
+        out.write(rgb, 3);
+    }
+    return static_cast<bool>(out);
+}
+
+static bool DumpLcd(const St7735s& lcd, const std::string& path){
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+
+    out << "P6\n" << LCD_WIDTH << " " << LCD_HEIGHT << "\n255\n";
+    uint32_t row[LCD_WIDTH];
+    for (int y = 0; y < LCD_HEIGHT; ++y) {
+        lcd.CopyRow(y, row);
+        for (uint32_t color : row) {
+            char rgb[3] = {static_cast<char>(color >> 16), static_cast<char>(color >> 8), static_cast<char>(color)};
+            out.write(rgb, 3);
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+static bool WriteDumps(const uint16_t* memory, const RunOptions& options){
+    if (!options.ramDumpPath.empty() && !DumpRAM(memory, options.ramDumpPath)) {
+        std::cerr << "Could not write the RAM dump : " << options.ramDumpPath << "\n";
+        return false;
+    }
+    if (!options.framebufferDumpPath.empty() && !DumpFramebuffer(memory, options.framebufferDumpPath)) {
+        std::cerr << "Could not write the framebuffer dump : " << options.framebufferDumpPath << "\n";
+        return false;
+    }
+    return true;
+}
+
+// One "name,value" line per counter, then one per OpCode / SubOpCode that ran ("op_<OpCode>_<SubOpCode>")
+static void WriteCounters(const PerfCounters& counters, std::ostream& out){
+    out << "counter,value\n";
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; ++counter)
+        out << PerfCounters::GetName(counter) << "," << counters.Get(counter) << "\n";
+    for (int index = 0; index < 128; ++index) {
+        uint64_t count = counters.Get(PERF_OPCODE_BASE + index);
+        if (count > 0)
+            out << "op_" << (index >> 4) << "_" << (index & 0b1111) << "," << count << "\n";
+    }
+}
+
+static bool DumpCounters(const PerfCounters& counters, const std::string& path){
+    if (path == "-") {
+        WriteCounters(counters, std::cout);
+        return true;
+    }
+
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    WriteCounters(counters, out);
+    return static_cast<bool>(out);
+}
+
+// path "-" is the standard output
+template <typename Writer>
+static bool WriteReport(const std::string& path, Writer writer){
+    if (path == "-") {
+        writer(std::cout);
+        return true;
+    }
+
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    writer(out);
+    return static_cast<bool>(out);
+}
+
+// The program's own map is optional, one given with --source-map is not
+static bool LoadSourceMap(const RunOptions& options, SourceMap& map){
+    std::string path = options.sourceMapPath.empty() ? SourceMap::GetMapPath(options.programPath) : options.sourceMapPath;
+    std::string error;
+    if (map.Load(path, error))
+        return true;
+
+    if (!options.sourceMapPath.empty()) {
+        std::cerr << error << "\n";
+        return false;
+    }
+    std::cerr << "No source map (" << error << "), the profile shows addresses\n";
+    return true;
+}
+
+static bool WriteProfile(const SamplingProfiler& profiler, const RunOptions& options){
+    SourceMap map;
+    if (!LoadSourceMap(options, map))
+        return false;
+
+    if (!options.profilePath.empty()
+        && !WriteReport(options.profilePath, [&](std::ostream& out) { WriteHotSpots(out, profiler, map); })) {
+        std::cerr << "Could not write the profile : " << options.profilePath << "\n";
+        return false;
+    }
+    if (!options.annotatePath.empty()
+        && !WriteReport(options.annotatePath, [&](std::ostream& out) { WriteAnnotatedSource(out, profiler, map); })) {
+        std::cerr << "Could not write the annotated sources : " << options.annotatePath << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Throughput is given in guest instructions across every lane, comparable with the single machine engines
+static int RunLockstep(const RunOptions& options, const ProgramImage& program){
+    std::unique_ptr<LockstepEngine> engine = std::make_unique<LockstepEngine>(options.lanes);
+    engine->SetIsa(options.isa);
+    engine->LoadProgram(program);
+
+    for (size_t lane = 0; lane < options.lanes; ++lane) {
+        for (int p = 0; p < IO_PORT_COUNT; ++p) {
+            uint16_t value = options.inputs[p];
+            if (p == options.sweepPort)
+                value = static_cast<uint16_t>(value + lane);
+            engine->SetLaneInput(lane, p, value);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t instructions = engine->Run(options.maxCycles * 2);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    size_t halted = 0;
+    size_t unsupported = 0;
+    uint64_t cycles = 0;
+    for (size_t lane = 0; lane < options.lanes; ++lane) {
+        halted += engine->GetLaneStopReason(lane) == STOP_HALT;
+        unsupported += engine->GetLaneStopReason(lane) == STOP_UNSUPPORTED;
+        cycles += engine->GetLaneHalfTicks(lane) / 2;
+    }
+
+    // A lane stopped on something the engine does not run did not finish the program : the run failed
+    std::string haltReason = unsupported > 0 ? "unsupported" : halted == options.lanes ? "HLT" : "cycle limit";
+
+    std::cout << "Engine      : lockstep, " << options.lanes << " lanes, " << LockstepEngine::GetIsaName(engine->GetIsa()) << "\n"
+              << "Halt reason : " << haltReason << " (" << halted << "/" << options.lanes << " lanes halted, "
+              << unsupported << " unsupported)\n"
+              << "Cycles      : " << cycles << " (all lanes)\n"
+              << "Instructions: " << instructions << " (all lanes)\n"
+              << "Host time   : " << std::fixed << std::setprecision(3) << seconds * 1000.0 << " ms\n"
+              << "Speed       : " << std::setprecision(3) << (seconds > 0 ? cycles / seconds / 1e6 : 0.0) << " MHz\n"
+              << "Throughput  : " << std::setprecision(3) << (seconds > 0 ? instructions / seconds / 1e6 : 0.0) << " MIPS\n";
+    std::cout.unsetf(std::ios::floatfield);
+
+    for (size_t lane = 0; lane < options.lanes; ++lane) {
+        FunctionalStopReason reason = engine->GetLaneStopReason(lane);
+        if (reason == STOP_UNSUPPORTED) {
+            std::cerr << "Lane " << lane << " stopped on an instruction the lockstep engine does not run (or a device store), at PC 0x"
+                      << std::hex << engine->GetLaneState(lane).PC << std::dec << "\n";
+            break;
+        }
+    }
+
+    if (!options.quiet)
+        DumpLaneRegisters(*engine, 0);
+
+    if (!WriteDumps(engine->GetLaneMemory(0), options))
+        return 1;
+    return unsupported > 0 ? 1 : 0;
+}
+
+// The trace starts from its own copy of the RAM, the program only tells whether it is the one it was recorded from
+static int RunReplay(Machine& machine, const RunOptions& options){
+    TraceReplayer replayer;
+    std::string error;
+    if (!replayer.Load(options.replayPath, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    if (replayer.GetRAMHash() != HashRAM(machine.ram.Data()))
+        std::cerr << "The trace was not recorded from this program's initial RAM (started mid-run, or another program)\n";
+
+    auto start = std::chrono::steady_clock::now();
+    TraceReplayResult result = replayer.Replay(machine);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t cycles = result.halfTicks / 2;
+
+    std::cout << "Replay      : " << result.message << "\n"
+              << "Inputs      : " << result.inputs << "\n"
+              << "Keyframes   : " << result.keyframes << " checked\n"
+              << "Cycles      : " << cycles << "\n"
+              << "Host time   : " << std::fixed << std::setprecision(3) << seconds * 1000.0 << " ms\n"
+              << "Speed       : " << std::setprecision(3) << (seconds > 0 ? cycles / seconds / 1e6 : 0.0) << " MHz\n";
+    std::cout.unsetf(std::ios::floatfield);
+
+    if (!options.quiet)
+        DumpRegisters(machine);
+
+    if (!WriteDumps(machine.ram.Data(), options))
+        return 1;
+    return result.matched ? 0 : 1;
+}
+
+// Runs maxHalfTicks half-ticks (or until HLT / a debugger stop) in real time, one pacer frame every PACED_FRAME_LENGTH
+static uint64_t RunPaced(ClockPacer& pacer, Machine& machine, uint64_t maxHalfTicks){
+    uint64_t executed = 0;
+    auto nextFrame = std::chrono::steady_clock::now();
+    pacer.RunFrame(0);
+
+    while (executed < maxHalfTicks && !machine.cpu.IsHalted() && !machine.debugger.HasStopped()) {
+        nextFrame += PACED_FRAME_LENGTH;
+        std::this_thread::sleep_until(nextFrame);
+        executed += pacer.RunFrame(maxHalfTicks - executed);
+    }
+    return executed;
+}
+
+int main(int argc, char* argv[]){
+    RunOptions options;
+    if (!ParseArgs(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    // Without a program (--load-state alone) the RAM starts empty
+    ProgramImage program;
+    std::string error;
+    if (!options.programPath.empty() && !program.Load(options.programPath, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (options.lockstep)
+        return RunLockstep(options, program);
+
+    std::unique_ptr<Machine> machine = std::make_unique<Machine>();
+    CPU* cpu = &machine->cpu;
+    cpu->SetExecutionEngine(options.engine);
+    machine->LoadProgram(program);
+
+    for (int p = 0; p < IO_PORT_COUNT; ++p)
+        machine->SetInput(p, options.inputs[p]);
+
+    // Ports included : the state's values win over --in0-2
+    if (!options.loadStatePath.empty()) {
+        SaveState saved;
+        if (!ReadSaveState(options.loadStatePath, saved, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        RestoreSaveState(*machine, saved);
+    }
+
+    if (options.flightRecorderSize > 0) {
+        machine->flightRecorder.Enable(options.flightRecorderSize);
+        if (!options.flightDumpPath.empty()) {
+            std::ofstream(options.flightDumpPath, std::ios::trunc);
+            machine->flightRecorder.SetDumpPath(options.flightDumpPath);
+        }
+    }
+
+    if (!options.heatmapPath.empty())
+        machine->heatmap.Enable();
+
+    if (options.lcdSpiPort >= 0)
+        machine->lcd.SetSpiPort(options.lcdSpiPort);
+
+    for (const std::string& command : options.debugCommands) {
+        if (machine->debugger.Add(command, error) < 0) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
+    if (!options.replayPath.empty())
+        return RunReplay(*machine, options);
+
+    if (!options.recordPath.empty() && !machine->traceRecorder.Start(options.recordPath, options.keyframeInterval, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (!options.gdbAddress.empty()) {
+        GdbStub stub(*machine);
+        if (!stub.Listen(options.gdbAddress, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        std::cerr << "Waiting for gdb on " << stub.GetAddress() << "\n";
+        if (!stub.Serve(error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        if (stub.WasKilled())
+            return 0;
+    }
+
+    ClockPacer pacer(*machine);
+    machine->clock.SetFrequency(options.targetMHz * 1e6);
+
+    bool profiling = !options.profilePath.empty() || !options.annotatePath.empty();
+    if (profiling)
+        machine->profiler.Start(options.profileInterval);
+
+    uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    uint64_t halfTicks = options.targetMHz > 0 ? RunPaced(pacer, *machine, options.maxCycles * 2) : cpu->Run(options.maxCycles * 2);
+    auto end = std::chrono::steady_clock::now();
+    uint64_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+    if (machine->traceRecorder.IsRecording() && !machine->traceRecorder.Stop(error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t cycles = halfTicks / 2;
+
+    std::string haltReason = cpu->IsHalted() ? "HLT" : machine->debugger.HasStopped() ? machine->debugger.DescribeStop() : "cycle limit";
+    std::cout << "Halt reason : " << haltReason << "\n"
+              << "Cycles      : " << cycles << "\n"
+              << "Host time   : " << std::fixed << std::setprecision(3) << seconds * 1000.0 << " ms\n"
+              << "Speed       : " << std::setprecision(3) << (seconds > 0 ? cycles / seconds / 1e6 : 0.0) << " MHz\n"
+              << "Allocations : " << allocations << "\n";
+    if (options.targetMHz > 0) {
+        std::cout << "Target      : " << std::setprecision(3) << options.targetMHz << " MHz\n"
+                  << "Achieved    : " << std::setprecision(3) << (seconds > 0 ? cycles / seconds / 1e6 : 0.0) << " MHz ("
+                  << std::setprecision(1) << (seconds > 0 ? cycles / seconds / 1e4 / options.targetMHz : 0.0) << " %)\n"
+                  << "Dropped     : " << pacer.GetDroppedHalfTicks() << " half-ticks, " << pacer.GetLateFrames() << " late frames\n";
+    }
+    if (options.engine != ENGINE_RTL) {
+        // Only what the functional engine ran, the instructions left to the RTL model are not counted
+        uint64_t instructions = machine->functionalEngine.GetInstructionCount();
+        std::cout << "Instructions: " << instructions << "\n"
+                  << "Throughput  : " << std::setprecision(3) << (seconds > 0 ? instructions / seconds / 1e6 : 0.0) << " MIPS\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    St7735s* lcd = &machine->lcd;
+    if (lcd->GetBytes() > 0) {
+        std::cout << "LCD         : " << lcd->GetBytes() << " bytes (" << lcd->GetBytes() * 8 << " SCL cycles), "
+                  << lcd->GetPixels() << " pixels, " << lcd->GetFrames() << " frames\n";
+        if (lcd->GetFrames() > 0) {
+            uint64_t frameCycles = cycles / lcd->GetFrames();
+            std::cout << "LCD frame   : " << frameCycles << " cycles";
+            if (options.targetMHz > 0)
+                std::cout << " (" << std::fixed << std::setprecision(1) << options.targetMHz * 1e6 / frameCycles << " fps at "
+                          << std::setprecision(3) << options.targetMHz << " MHz)";
+            std::cout << "\n";
+            std::cout.unsetf(std::ios::floatfield);
+        }
+    }
+    if (machine->blitter.GetTransfers() > 0)
+        std::cout << "Blitter     : " << machine->blitter.GetTransfers() << " transfers, " << machine->blitter.GetCycles() << " cycles\n";
+    if (options.engine == ENGINE_JIT)
+        std::cout << "JIT blocks  : " << machine->jitCompiler.GetCompiledBlockCount() << "\n";
+    if (options.engine != ENGINE_RTL) {
+        FunctionalEngine* engine = &machine->functionalEngine;
+        for (int kind = 0; kind < FUSION_COUNT; ++kind)
+            std::cout << "Fused       : " << std::left << std::setw(13) << FunctionalEngine::GetFusionName(static_cast<FusionKind>(kind))
+                      << std::right << engine->GetFusionCount(static_cast<FusionKind>(kind)) << "\n";
+    }
+
+    if (!options.quiet)
+        DumpRegisters(*machine);
+
+    // On HLT the flight recorder already wrote to its dump file
+    if (options.flightRecorderSize > 0) {
+        if (options.flightDumpPath.empty())
+            machine->flightRecorder.Write(std::cout, cpu->IsHalted() ? "HLT" : "end of run");
+        else if (!cpu->IsHalted()) {
+            std::ofstream out(options.flightDumpPath, std::ios::app);
+            machine->flightRecorder.Write(out, "end of run");
+        }
+    }
+
+    if (!options.countersPath.empty()) {
+        if (!ORGAN16_PERF_COUNTERS)
+            std::cerr << "Performance counters are compiled out (ORGAN16_PERF_COUNTERS=OFF), every counter reads 0\n";
+        if (!DumpCounters(machine->ReadPerfCounters(), options.countersPath)) {
+            std::cerr << "Could not write the counters : " << options.countersPath << "\n";
+            return 1;
+        }
+    }
+
+    if (!options.heatmapPath.empty() && !machine->heatmap.Write(options.heatmapPath, error)) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+
+    if (!options.lcdDumpPath.empty() && !DumpLcd(machine->lcd, options.lcdDumpPath)) {
+        std::cerr << "Could not write the LCD dump : " << options.lcdDumpPath << "\n";
+        return 1;
+    }
+
+    if (profiling && !WriteProfile(machine->profiler, options))
+        return 1;
+
+    if (!options.saveStatePath.empty()) {
+        SaveState saved;
+        CaptureSaveState(*machine, saved);
+        if (!WriteSaveState(options.saveStatePath, saved, error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
+    return WriteDumps(machine->ram.Data(), options) ? 0 : 1;
+}
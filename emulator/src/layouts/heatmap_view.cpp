@@ -0,0 +1,69 @@
+#include "heatmap_view.hpp"
+
+#include <algorithm>
+
+static const int HEATMAP_IMAGE_SIZE = 256;
+
+// 0 for no access, 1 - 16 : bits of the count
+static int HeatLevel(uint16_t count)
+{
+    int bits = 0;
+    while (count >> bits)
+        bits++;
+    return bits;
+}
+
+static int HeatChannel(uint16_t count, int base)
+{
+    return base + (255 - base) * HeatLevel(count) / 16;
+}
+
+QRgb HeatColor(uint16_t reads, uint16_t writes, uint16_t fetches, int base)
+{
+    return qRgb(HeatChannel(writes, base), HeatChannel(reads, base), HeatChannel(fetches, base));
+}
+
+HeatmapView::HeatmapView(QWidget *parent) : QWidget(parent), image(HEATMAP_IMAGE_SIZE, HEATMAP_IMAGE_SIZE, QImage::Format_RGB32)
+{
+    image.fill(Qt::black);
+    setMinimumSize(HEATMAP_IMAGE_SIZE, HEATMAP_IMAGE_SIZE);
+    targetRect = QRect(0, 0, image.width(), image.height());
+}
+
+void HeatmapView::present(const MachineSnapshot& snapshot)
+{
+    if (snapshot.heat.empty())
+        return;
+    const uint16_t* reads = snapshot.heat.data() + HEAT_READ * HEATMAP_WORDS;
+    const uint16_t* writes = snapshot.heat.data() + HEAT_WRITE * HEATMAP_WORDS;
+    const uint16_t* fetches = snapshot.heat.data() + HEAT_FETCH * HEATMAP_WORDS;
+
+    for (int y = 0; y < HEATMAP_IMAGE_SIZE; ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        int address = y * HEATMAP_IMAGE_SIZE;
+        for (int x = 0; x < HEATMAP_IMAGE_SIZE; ++x, ++address)
+            line[x] = HeatColor(reads[address], writes[address], fetches[address]);
+    }
+    update(targetRect);
+}
+
+void HeatmapView::resizeEvent(QResizeEvent *)
+{
+    QSize imgSize = image.size();
+    QSize widgetSize = size();
+
+    int scale = std::max(1, std::min(widgetSize.width() / imgSize.width(), widgetSize.height() / imgSize.height()));
+    QSize scaledSize = imgSize * scale;
+
+    QPoint center((widgetSize.width() - scaledSize.width())/2,
+                    (widgetSize.height() - scaledSize.height())/2);
+
+    targetRect = QRect(center, scaledSize);
+}
+
+void HeatmapView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawImage(targetRect, image);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QWidget>
+#include <QPainter>
+#include <QImage>
+#include <QColor>
+
+#include <cstdint>
+
+#include "../backend/snapshot/snapshot_buffer.hpp"
+
+// Red : writes, green : reads, blue : fetches, on a log scale (a single access already shows). A channel without any
+// access stays at base, the RAM viewer tints its own background that way
+QRgb HeatColor(uint16_t reads, uint16_t writes, uint16_t fetches, int base = 0);
+
+// The whole address space as a 256x256 density image : one pixel per word, 256 words per line (address 0 top left,
+// two framebuffer rows per line from 0x8000 down, the stack at the bottom)
+class HeatmapView : public QWidget {
+public:
+    HeatmapView(QWidget *parent = nullptr);
+
+    // Redraws the image from the snapshot's counts (nothing when it carries none)
+    void present(const MachineSnapshot& snapshot);
+
+    QSize sizeHint() const override {
+        return QSize(512, 512);
+    }
+
+    bool hasHeightForWidth() const override {
+        return true;
+    }
+
+    int heightForWidth(int w) const override {
+        return w;
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override;
+
+    void resizeEvent(QResizeEvent *) override;
+
+private:
+    QImage image;
+
+    // Where the image is drawn : the largest whole multiple of its size that fits, centered
+    QRect targetRect;
+};
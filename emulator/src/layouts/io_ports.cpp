@@ -4,8 +4,10 @@
 #include <QGroupBox>
 #include <QLabel>
 
-IOPortsPanel::IOPortsPanel(QWidget* parent)
-    : QWidget(parent)
+#include "../backend/machine.hpp"
+
+IOPortsPanel::IOPortsPanel(Machine& machine, QWidget* parent)
+    : QWidget(parent), m_machine(machine)
 {
     QVBoxLayout* mainLayout = new QVBoxLayout(this);
 
@@ -77,6 +79,8 @@ void IOPortsPanel::createPort(int portIndex, char portName)
                     else
                         m_portValues[p] &= ~(1u << i);
 
+                    m_machine.SetInput(p, m_portValues[p]);
+
                     emit squareClicked(portName, i);
                 });
     }
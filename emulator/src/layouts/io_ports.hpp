@@ -3,12 +3,14 @@
 #include <QPushButton>
 #include <vector>
 
+class Machine;
+
 class IOPortsPanel : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit IOPortsPanel(QWidget* parent = nullptr);
+    explicit IOPortsPanel(Machine& machine, QWidget* parent = nullptr);
 
     // Set or get full 16-bit port values (A, B, C)
     void setPortValue(char portName, uint16_t value);
@@ -25,6 +27,7 @@ private:
     int portIndexFromName(char portName) const;
     void createPort(int portIndex, char portName);
 
+    Machine& m_machine;
     std::vector<std::vector<QPushButton*>> m_ports;  // ports A,B,C → 3 × 16 LEDs
     uint16_t m_portValues[3] = {0, 0, 0};
 };
\ No newline at end of file
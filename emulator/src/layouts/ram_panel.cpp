@@ -1,59 +1,125 @@
 #include "ram_panel.hpp"
+#include "heatmap_view.hpp"
 
 #include <QString>
+#include <QBrush>
 
-#include "../backend/cpu.hpp"
+#include <algorithm>
 
-RamPanel::RamPanel(QObject *parent)
-    : QAbstractTableModel(parent), ram(RAM::GetInstance()) {}
+static const QColor BUS_COLOR("#4477ff");
+static const QColor VISITED_COLOR("#5e5e5e");
+
+// Heat tints the cells' own grey
+static const int HEAT_BASE = 0x5e;
+
+RamPanel::RamPanel(Machine& machine, QObject *parent)
+    : QAbstractTableModel(parent), machine(machine), words(ADDRESS_SPACE, 0), attributes(ADDRESS_SPACE, 0), heat(ADDRESS_SPACE, 0) {}
 
 int RamPanel::rowCount(const QModelIndex &) const {
-    return 4096; // 65536 / 16
+    return RAM_PANEL_ROWS;
 }
 
 int RamPanel::columnCount(const QModelIndex &) const {
-    return 16;
+    return RAM_PANEL_COLUMNS;
 }
 
 void RamPanel::updateRAM() {
     beginResetModel();
+    std::fill(words.begin(), words.end(), 0);
+    std::fill(attributes.begin(), attributes.end(), 0);
+    std::fill(heat.begin(), heat.end(), 0);
+    dirtyRows.fill(0);
+    busAddress = 0;
     endResetModel();
 }
 
+void RamPanel::refresh(const MachineSnapshot& snapshot) {
+    for (int i = 0; i < snapshot.ramRows; ++i) {
+        int row = snapshot.ramFirstRow + i;
+        const uint16_t* received = snapshot.ram + i * RAM_PANEL_COLUMNS;
+        uint16_t* shown = words.data() + row * RAM_PANEL_COLUMNS;
+        if (!std::equal(received, received + RAM_PANEL_COLUMNS, shown)) {
+            std::copy_n(received, RAM_PANEL_COLUMNS, shown);
+            markRowDirty(row);
+        }
+
+        QRgb* shownHeat = heat.data() + row * RAM_PANEL_COLUMNS;
+        for (int column = 0; column < RAM_PANEL_COLUMNS; ++column) {
+            QRgb color = 0;
+            if (!snapshot.heat.empty()) {
+                size_t word = row * RAM_PANEL_COLUMNS + column;
+                uint16_t reads = snapshot.heat[HEAT_READ * HEATMAP_WORDS + word];
+                uint16_t writes = snapshot.heat[HEAT_WRITE * HEATMAP_WORDS + word];
+                uint16_t fetches = snapshot.heat[HEAT_FETCH * HEATMAP_WORDS + word];
+                if (reads | writes | fetches)
+                    color = HeatColor(reads, writes, fetches, HEAT_BASE);
+            }
+            if (color != shownHeat[column]) {
+                shownHeat[column] = color;
+                markRowDirty(row);
+            }
+        }
+    }
+
+    if (snapshot.busAddress != busAddress) {
+        attributes[busAddress] = static_cast<uint8_t>((attributes[busAddress] & ~RAM_CELL_BUS) | RAM_CELL_VISITED);
+        markRowDirty(busAddress / RAM_PANEL_COLUMNS);
+        busAddress = snapshot.busAddress;
+        markRowDirty(busAddress / RAM_PANEL_COLUMNS);
+    }
+    attributes[busAddress] |= RAM_CELL_BUS;
+
+    // Rows out of view are read again by the view when they scroll in, only the visible ones need a signal
+    int first = -1;
+    int last = -1;
+    for (int row = firstVisibleRow; row < firstVisibleRow + visibleRows; ++row) {
+        if (dirtyRows[row >> 6] & (uint64_t(1) << (row & 63))) {
+            if (first < 0)
+                first = row;
+            last = row;
+        }
+    }
+    dirtyRows.fill(0);
+
+    if (first >= 0)
+        emit dataChanged(index(first, 0), index(last, RAM_PANEL_COLUMNS - 1), {Qt::DisplayRole, Qt::BackgroundRole});
+}
+
+bool RamPanel::setVisibleRows(int first, int count) {
+    first = std::clamp(first, 0, RAM_PANEL_ROWS - 1);
+    count = std::clamp(count, 0, std::min(SNAPSHOT_RAM_MAX_ROWS, RAM_PANEL_ROWS - first));
+    if (first == firstVisibleRow && count == visibleRows)
+        return false;
+
+    firstVisibleRow = first;
+    visibleRows = count;
+    machine.snapshots.SetRAMWindow(first, count);
+    return true;
+}
+
 QVariant RamPanel::data(const QModelIndex &index, int role) const {
     if (!index.isValid())
         return QVariant();
 
-    int address = index.row() * 16 + index.column();
-    if (address >= 65536)
+    int address = index.row() * RAM_PANEL_COLUMNS + index.column();
+    if (address >= static_cast<int>(ADDRESS_SPACE))
         return QVariant();
 
-    if (role == Qt::DisplayRole) {
-        try {
-            uint16_t word = ram->Read(static_cast<uint16_t>(address));
-            return QString("%1").arg(word, 4, 16, QChar('0')).toUpper();
-        } catch (...) {
-            return "ERR";
-        }
-    }
+    if (role == Qt::DisplayRole)
+        return QString("%1").arg(words[address], 4, 16, QChar('0')).toUpper();
+
     if (role == Qt::BackgroundRole) {
-        QPair<int, int> cell(index.row(), index.column());
-        if (bgColors.contains(cell)) {
-            return QBrush(bgColors[cell]);
-        }
+        if (attributes[address] & RAM_CELL_BUS)
+            return QBrush(BUS_COLOR);
+        if (heat[address] != 0)
+            return QBrush(QColor(heat[address]));
+        if (attributes[address] & RAM_CELL_VISITED)
+            return QBrush(VISITED_COLOR);
     }
 
     return QVariant();
 }
 
-void RamPanel::setCellBackground(int row, int col, const QColor &color) {
-    QPair<int, int> cell(row, col);
-    bgColors[cell] = color;
-
-    QModelIndex idx = index(row, col);
-    emit dataChanged(idx, idx, {Qt::BackgroundRole});
-}
-
 QVariant RamPanel::headerData(int section, Qt::Orientation orientation, int role) const {
     if (role != Qt::DisplayRole)
         return QVariant();
@@ -79,19 +145,17 @@ bool RamPanel::setData(const QModelIndex &index, const QVariant &value, int role
     if (role != Qt::EditRole || !index.isValid())
         return false;
 
-    int address = index.row() * 16 + index.column();
+    int address = index.row() * RAM_PANEL_COLUMNS + index.column();
     bool ok;
     uint16_t newVal = value.toString().toUShort(&ok, 16);
 
-    if (!ok || address >= 65536)
+    if (!ok || address >= static_cast<int>(ADDRESS_SPACE))
         return false;
 
-    try {
-        ram->Write(static_cast<uint16_t>(address), newVal, true);
-        CPU::GetInstance()->Init();
-        emit dataChanged(index, index);
-        return true;
-    } catch (...) {
-        return false;
-    }
-}
\ No newline at end of file
+    // Edits happen between runs : the GUI thread is the one running the Machine (both clocks, see main.cpp)
+    machine.bus.Write(static_cast<uint16_t>(address), newVal);
+    machine.cpu.Init();
+    words[address] = newVal;
+    emit dataChanged(index, index);
+    return true;
+}
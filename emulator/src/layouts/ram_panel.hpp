@@ -3,22 +3,63 @@
 #include <QAbstractTableModel>
 #include <QTableView>
 #include <QHeaderView>
+#include <QColor>
 
-#include "../backend/memory/ram.hpp"
+#include <array>
+#include <vector>
 
+#include "../backend/machine.hpp"
+
+static const int RAM_PANEL_COLUMNS = SNAPSHOT_RAM_ROW_WORDS;
+static const int RAM_PANEL_ROWS = SNAPSHOT_RAM_ROWS;
+
+// What a RAM word is highlighted with, one byte per address
+enum RamCellAttribute : uint8_t {
+    RAM_CELL_VISITED = 1,   // The bus went through it since the last reset
+    RAM_CELL_BUS = 2        // Address the RAM is being read at
+};
+
+// RAM viewer model. The words come from the Machine's snapshots (the rows in view only, see setVisibleRows), never from
+// the RAM itself, so a refresh copies and compares only the rows on screen, as they were when the clock last published.
+// Changed rows are marked in a dirty bitmap and repainted with a single dataChanged per refresh. While the Machine's heatmap is enabled the cells are tinted with their access counts
 class RamPanel : public QAbstractTableModel {
     public:
-        explicit RamPanel(QObject *parent = nullptr);
+        explicit RamPanel(Machine& machine, QObject *parent = nullptr);
         int rowCount(const QModelIndex &) const override;
         int columnCount(const QModelIndex &) const override;
+
+        // The RAM was reset : every word is zero again
         void updateRAM();
+
+        // Takes the rows and the bus address of a snapshot, repaints the visible rows that changed
+        void refresh(const MachineSnapshot& snapshot);
+
+        // Rows the view shows, asked for in the Machine's next snapshots. True when they changed
+        bool setVisibleRows(int first, int count);
+
         QVariant data(const QModelIndex &index, int role) const override;
-        void setCellBackground(int row, int col, const QColor &color);
         QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
         Qt::ItemFlags flags(const QModelIndex &index) const override;
         bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 
     private:
-        RAM* ram;
-        QMap<QPair<int, int>, QColor> bgColors;
-};
\ No newline at end of file
+        Machine& machine;
+
+        // Words as the last snapshots had them
+        std::vector<uint16_t> words;
+        std::vector<uint8_t> attributes;
+
+        // HeatColor of each word, 0 for none
+        std::vector<QRgb> heat;
+
+        // Rows to repaint (bit row % 64 of dirtyRows[row / 64])
+        std::array<uint64_t, RAM_PANEL_ROWS / 64> dirtyRows{};
+
+        uint16_t busAddress = 0;
+        int firstVisibleRow = 0;
+        int visibleRows = 0;
+
+        void markRowDirty(int row){
+            dirtyRows[row >> 6] |= uint64_t(1) << (row & 63);
+        }
+};
@@ -1,18 +1,33 @@
 #include "canvas.hpp"
 
-CanvasWidget::CanvasWidget(QWidget *parent) : QWidget(parent), canvas(320, 240, QImage::Format_RGB32)
+#include <algorithm>
+#include <cstring>
+
+CanvasWidget::CanvasWidget(QWidget *parent) : QWidget(parent), canvas(128, 128, QImage::Format_RGB16)
 {
-    canvas = QImage(128, 128, QImage::Format_RGB32);
     canvas.fill(Qt::yellow);
     setMinimumSize(128, 128);
+    targetRect = QRect(0, 0, canvas.width(), canvas.height());
 }
 
-void CanvasWidget::setPixel(int x, int y, QColor color)
+void CanvasWidget::presentRows(const uint16_t* framebuffer, const uint64_t* dirtyRows)
 {
-    if (x >= 0 && x < canvas.width() && y >= 0 && y < canvas.height()) {
-        canvas.setPixelColor(x, y, color);
-        update();
+    int firstRow = -1;
+    int lastRow = -1;
+    for (int y = 0; y < canvas.height(); ++y) {
+        if (!(dirtyRows[y / 64] & (uint64_t(1) << (y % 64))))
+            continue;
+
+        std::memcpy(canvas.scanLine(y), framebuffer + y * canvas.width(), canvas.width() * sizeof(uint16_t));
+        if (firstRow < 0)
+            firstRow = y;
+        lastRow = y;
     }
+
+    if (firstRow < 0)
+        return;
+
+    update(QRect(targetRect.x(), targetRect.y() + firstRow * scale, targetRect.width(), (lastRow - firstRow + 1) * scale));
 }
 
 void CanvasWidget::clear()
@@ -23,23 +38,30 @@ void CanvasWidget::clear()
 
 void CanvasWidget::updateFrame(const QImage &newImage)
 {
-    if (newImage.size() == canvas.size() && newImage.format() == canvas.format()) {
-        canvas = newImage.copy();
+    if (newImage.size() == canvas.size()) {
+        canvas = newImage.convertToFormat(QImage::Format_RGB16);
         update();
     }
 }
 
-void CanvasWidget::paintEvent(QPaintEvent *)
+void CanvasWidget::resizeEvent(QResizeEvent *)
 {
-    QPainter painter(this);
     QSize imgSize = canvas.size();
     QSize widgetSize = size();
 
-    QSize scaledSize = imgSize.scaled(widgetSize, Qt::KeepAspectRatio);
+    scale = std::max(1, std::min(widgetSize.width() / imgSize.width(), widgetSize.height() / imgSize.height()));
+    QSize scaledSize = imgSize * scale;
 
     QPoint center((widgetSize.width() - scaledSize.width())/2,
                     (widgetSize.height() - scaledSize.height())/2);
 
-    QRect targetRect(center, scaledSize);
+    targetRect = QRect(center, scaledSize);
+}
+
+void CanvasWidget::paintEvent(QPaintEvent *)
+{
+    // Whole multiples, nearest pixel : no filtering
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
     painter.drawImage(targetRect, canvas);
 }
@@ -5,11 +5,15 @@
 #include <QColor>
 #include <QMouseEvent>
 
+#include <cstdint>
+
 class CanvasWidget : public QWidget {
 public:
     CanvasWidget(QWidget *parent = nullptr);
 
-    void setPixel(int x, int y, QColor color);
+    // Copies the rows flagged in dirtyRows (bit y of dirtyRows[y / 64]) out of the guest framebuffer (RGB565, 128 words per row)
+    // and repaints only them
+    void presentRows(const uint16_t* framebuffer, const uint64_t* dirtyRows);
 
     void clear();
 
@@ -30,6 +34,13 @@ public:
 protected:
     void paintEvent(QPaintEvent *) override;
 
+    void resizeEvent(QResizeEvent *) override;
+
 private:
+    // Same layout as the guest framebuffer (Format_RGB16), rows are copied as they are
     QImage canvas;
-};
\ No newline at end of file
+
+    // Where the canvas is drawn : the largest whole multiple of its size that fits, centered
+    QRect targetRect;
+    int scale = 1;
+};
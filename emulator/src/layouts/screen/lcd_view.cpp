@@ -0,0 +1,51 @@
+#include "lcd_view.hpp"
+
+#include <algorithm>
+
+LcdView::LcdView(QWidget *parent) : QWidget(parent), image(LCD_WIDTH, LCD_HEIGHT, QImage::Format_RGB32)
+{
+    image.fill(Qt::black);
+    setMinimumSize(LCD_WIDTH, LCD_HEIGHT);
+    targetRect = QRect(0, 0, image.width(), image.height());
+}
+
+void LcdView::presentRows(const St7735s& lcd, const uint64_t* dirtyRows)
+{
+    int firstRow = -1;
+    int lastRow = -1;
+    for (int y = 0; y < LCD_HEIGHT; ++y) {
+        if (!(dirtyRows[y / 64] & (uint64_t(1) << (y % 64))))
+            continue;
+
+        lcd.CopyRow(y, reinterpret_cast<uint32_t*>(image.scanLine(y)));
+        if (firstRow < 0)
+            firstRow = y;
+        lastRow = y;
+    }
+
+    if (firstRow < 0)
+        return;
+
+    update(QRect(targetRect.x(), targetRect.y() + firstRow * scale, targetRect.width(), (lastRow - firstRow + 1) * scale));
+}
+
+void LcdView::resizeEvent(QResizeEvent *)
+{
+    QSize imgSize = image.size();
+    QSize widgetSize = size();
+
+    scale = std::max(1, std::min(widgetSize.width() / imgSize.width(), widgetSize.height() / imgSize.height()));
+    QSize scaledSize = imgSize * scale;
+
+    QPoint center((widgetSize.width() - scaledSize.width())/2,
+                    (widgetSize.height() - scaledSize.height())/2);
+
+    targetRect = QRect(center, scaledSize);
+}
+
+void LcdView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawImage(targetRect, image);
+}
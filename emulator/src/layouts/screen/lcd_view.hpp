@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QWidget>
+#include <QPainter>
+#include <QImage>
+
+#include <cstdint>
+
+#include "../../backend/io/st7735s.hpp"
+
+// What the ST7735S panel shows, 128x160 (portrait, like the ER-TFT018A3-2 on the breadboard)
+class LcdView : public QWidget {
+public:
+    LcdView(QWidget *parent = nullptr);
+
+    // Copies the panel rows flagged in dirtyRows (bit y of dirtyRows[y / 64]) and repaints only them
+    void presentRows(const St7735s& lcd, const uint64_t* dirtyRows);
+
+    QSize sizeHint() const override {
+        return QSize(2 * LCD_WIDTH, 2 * LCD_HEIGHT);
+    }
+
+    bool hasHeightForWidth() const override {
+        return true;
+    }
+
+    int heightForWidth(int w) const override {
+        return w * LCD_HEIGHT / LCD_WIDTH;
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override;
+
+    void resizeEvent(QResizeEvent *) override;
+
+private:
+    QImage image;
+
+    // Where the image is drawn : the largest whole multiple of its size that fits, centered
+    QRect targetRect;
+    int scale = 1;
+};
@@ -6,137 +6,365 @@ Expect garbage code, bugs and crashes 😅.
 
 #include "qt_includes.hpp"
 
-#include <bitset>
+#include <algorithm>
 #include <iostream>
-#include <iomanip>
-#include <sstream>
 #include <cstdint>
+#include <sstream>
 
-#include "gui/display/qtdisplay.hpp"
-#include "gui/regs/clck_btn.hpp"
-#include "gui/regs/flow_layout.hpp"
-#include "gui/memory/ram_panel.hpp"
-#include "gui/io/io_ports.hpp"
-
-#include "backend/cpu.hpp"
+#include "layouts/screen/canvas.hpp"
+#include "layouts/screen/lcd_view.hpp"
+#include "layouts/regs/clck_btn.hpp"
+#include "layouts/regs/flow_layout.hpp"
+#include "layouts/ram_panel.hpp"
+#include "layouts/heatmap_view.hpp"
+#include "layouts/io_ports.hpp"
+
+#include "backend/machine.hpp"
+#include "backend/clock_pacer.hpp"
+#include "backend/profiler/profile_report.hpp"
+#include "backend/trace/trace_replayer.hpp"
+#include "backend/savestate/save_state.hpp"
+#include "backend/savestate/rewind_buffer.hpp"
 
 #include "splitter.hpp"
 
+// The emulated computer shown by this window
+Machine machine;
+
+// Keeps the automatic clock at the configured frequency
+ClockPacer pacer(machine);
+
+// Source map of the imported program (profiler reports)
+SourceMap sourceMap;
+
+// A snapshot after every display frame of the automatic clock and every manual clock click
+RewindBuffer rewindBuffer;
+
 QMainWindow* window;
 std::unordered_map<RegisterName, QLineEdit*> registersLineEdits;
 std::unordered_map<std::string, QWidget*> debugValuesLEDs;
 QLabel* clockLabel;
 QLabel* clockTicks;
+QLabel* hudLabel;
 CanvasWidget* canvas;
-QtDisplay* screen;
 IOPortsPanel* ioPanel;
 RamPanel* ramPanel;
 QTableView* ramView;
+
+// Window of the memory heatmap, built the first time it is shown
+QDialog* heatmapWindow = nullptr;
+HeatmapView* heatmapView = nullptr;
+
+// Window of the ST7735S panel, built the first time it is shown
+QDialog* lcdWindow = nullptr;
+LcdView* lcdView = nullptr;
 FullSplitter* HSplitterBottom;
 QAction *toggleAutomatic;
 QAction *toggleManual;
 QTimer timer;
 
+// Polls the Machine's snapshot buffer and the screen's dirty rows once per display refresh
+QTimer refreshTimer;
+
+// Length of a display frame (set from the screen's refresh rate)
+int displayFrameMs = 16;
+
+// What the panels currently show
+MachineSnapshot shownSnapshot;
+bool snapshotShown = false;
+
+// Performance HUD, measured over windows of PACER_MEASURE_SECONDS
+struct HudSample{
+    ClockPacer::HostClock::time_point time;
+    uint64_t instructions = 0;
+    uint64_t halfTicks = 0;
+    double emulationSeconds = 0;
+    uint64_t frames = 0;
+};
+HudSample hudSample;
+bool hudSampled = false;
+uint64_t displayFrames = 0;
+
 bool debugPanelShown = false;
 
-int savedClockFrequency;
+int savedClockFrequency;     // MHz
 bool automaticClock = false;
 uint32_t halfTicksOnClockClick = 1;
 
-uint16_t GetIN(int portIndex){
-    return ioPanel->portValue(ioPanel->portNameFromIndex(portIndex));
-}
-
-void SetOUT(int portIndex, uint16_t data){
-    ioPanel->setPortValue(ioPanel->portNameFromIndex(portIndex), data);
-}
+// Why the debugger last stopped the CPU, shown in the status bar until the clock runs again
+QString debugStopMessage;
 
-void ResetIOPortsVisual(){
-    ioPanel->reset();
+// The debugger stopped the CPU : the clock goes manual so the state can be looked at
+void ShowDebugStop(){
+    if (automaticClock)
+        toggleManual->setChecked(true);
+    debugStopMessage = "Stopped : " + QString::fromStdString(machine.debugger.DescribeStop());
+    window->statusBar()->showMessage(debugStopMessage);
 }
 
 void ToggleManualClock(bool checked){
     automaticClock = false;
-    Clock::GetInstance()->SetFrequency(0);
+    machine.clock.SetFrequency(0);
     timer.stop();
 }
 
 void ToggleAutomaticClock(bool checked){
     automaticClock = true;
+    debugStopMessage.clear();
     timer.stop();
     QObject::disconnect(&timer, nullptr, nullptr, nullptr);
 
-    Clock::GetInstance()->SetFrequency(savedClockFrequency);
+    machine.clock.SetFrequency(savedClockFrequency * 1e6);
+    pacer.Restart();
 
-    if (Clock::GetInstance()->GetFrequency() > 0) {
+    // The pacer works out how many half-ticks each display frame is worth
+    if (machine.clock.GetFrequency() > 0) {
         QObject::connect(&timer, &QTimer::timeout, []() {
-            CPU::GetInstance()->RunFrame();
-
-            QMetaObject::invokeMethod(canvas, []() {
-                screen->Present(RAM::GetInstance()->framebuffer);
-            }, Qt::QueuedConnection);
-            CPU::GetInstance()->RunFrame(-1);
+            if (pacer.RunFrame() > 0)
+                rewindBuffer.Take(machine);
+            if (machine.debugger.HasStopped())
+                ShowDebugStop();
         });
-        timer.start(1000 / Clock::GetInstance()->GetFrequency());
+        timer.start(displayFrameMs);
     }
 }
 
-void UpdateDebugValues(std::unordered_map<std::string, bool> debugValues){
-    for(auto& pair : debugValues){
-        if(debugValuesLEDs.find(pair.first) != debugValuesLEDs.end()){
-            QWidget* led = debugValuesLEDs.at(pair.first);
+// Flip-flops shown in the debug panel, in the LED order
+static const int DEBUG_VALUE_COUNT = 8;
+static const char* const debugValueNames[DEBUG_VALUE_COUNT] = {
+    "IsCurrExt", "IsCurrAddrBase", "IsCurrAddr", "IsCurrAddrJsr",
+    "IsCurrSpChange", "IsCurrJsr", "IsCurrRts", "RegIsCurrAddr"
+};
+
+void GetDebugValues(const CPUState& state, bool values[DEBUG_VALUE_COUNT]){
+    values[0] = state.currentIsExt;
+    values[1] = state.currentIsAddrBase;
+    values[2] = state.currentIsAddrBase || state.currentIsAddrJsr;
+    values[3] = state.currentIsAddrJsr;
+    values[4] = state.currentChangesSP;
+    values[5] = state.currentlyJsr;
+    values[6] = state.currentlyRts;
+    values[7] = state.regIsCurrAddr;
+}
 
-            QMetaObject::invokeMethod(led, [led, pair]() {
-                led->setStyleSheet(
-                    pair.second
-                        ? "background-color: rgba(40, 197, 26, 1);"
-                        : "background-color: rgba(143, 143, 143, 1);"
-                );
-            }, Qt::QueuedConnection);
-        }
+// Only the LEDs that changed get a new stylesheet (all of them when force is set)
+void UpdateDebugValues(const CPUState& state, const CPUState& shownState, bool force){
+    bool values[DEBUG_VALUE_COUNT];
+    bool shownValues[DEBUG_VALUE_COUNT];
+    GetDebugValues(state, values);
+    GetDebugValues(shownState, shownValues);
+
+    for(int i = 0; i < DEBUG_VALUE_COUNT; ++i){
+        auto led = debugValuesLEDs.find(debugValueNames[i]);
+        if(led == debugValuesLEDs.end() || (!force && values[i] == shownValues[i]))
+            continue;
+
+        led->second->setStyleSheet(
+            values[i]
+                ? "background-color: rgba(40, 197, 26, 1);"
+                : "background-color: rgba(143, 143, 143, 1);"
+        );
     }
 }
 
+// The machine starts over (program load, reset, state load) : nothing to step back to before it
+void RestartRewind(){
+    rewindBuffer.Clear();
+    rewindBuffer.Take(machine);
+}
+
 void ImportRAM() {
-    CPU::GetInstance()->Reset();
+    machine.cpu.Reset();
 
     QString fileName = QFileDialog::getOpenFileName(
         window,
         "Open Program File",
         "",
-        "Program Files (*.bin)"
+        "Program Files (*.bin *.o16)"
     );
 
     if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QIODevice::ReadOnly)) {
-            QString fileContent = QString::fromUtf8(file.readAll());
-            file.close();
-            QStringList wordList = fileContent.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
-            std::vector<uint16_t> wordValues;
-            for (const QString& wordStr : wordList) {
-                bool ok;
-                uint16_t value = wordStr.toUShort(&ok, 16);  // Base 16 (hex)
-                if (ok) {
-                    wordValues.push_back(value);
-                } 
-                else {
-                    QMessageBox::warning(window, "File Error", "Invalid word in file : " + wordStr);
-                }
-            }
-            if(wordValues.size() == ADDRESS_SPACE){
-                RAM::GetInstance()->Load(wordValues);
-            }
-            else{
-                QMessageBox::warning(window, "File Error", "Invalid file size : " + QString::number(wordValues.size()));
-            }
+        ProgramImage program;
+        std::string error;
+        if (program.Load(fileName.toStdString(), error)) {
+            machine.LoadProgram(program);
+
+            // The compiler writes program.map next to program.bin, the profile shows addresses without it
+            sourceMap.Load(SourceMap::GetMapPath(fileName.toStdString()), error);
         }
         else {
-            QMessageBox::warning(window, "File Error", "Could not open the selected file.");
+            QMessageBox::warning(window, "File Error", QString::fromStdString(error));
         }
     }
-    
-    CPU::GetInstance()->Init();
+
+    RestartRewind();
+}
+
+void ToggleProfiler(bool checked){
+    if (checked)
+        machine.profiler.Start(PROFILER_DEFAULT_INTERVAL);
+    else
+        machine.profiler.Stop();
+}
+
+// Report in a monospace text window
+void ShowTextWindow(const QString& title, const std::string& report){
+    QDialog* dialog = new QDialog(window);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle(title);
+    dialog->resize(900, 600);
+
+    QPlainTextEdit* text = new QPlainTextEdit(dialog);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    text->setPlainText(QString::fromStdString(report));
+
+    QVBoxLayout* layout = new QVBoxLayout(dialog);
+    layout->addWidget(text);
+    dialog->show();
+}
+
+// Hot spots then the annotated sources
+void ShowProfile(){
+    std::ostringstream report;
+    WriteHotSpots(report, machine.profiler, sourceMap);
+    report << "\n";
+    WriteAnnotatedSource(report, machine.profiler, sourceMap);
+    ShowTextWindow("Profile", report.str());
+}
+
+// Checked : records from now on (the inputs set with the IO ports panel, resets and program loads included)
+void ToggleTraceRecording(QAction* action, bool checked){
+    std::string error;
+    if (!checked) {
+        if (!machine.traceRecorder.Stop(error))
+            QMessageBox::warning(window, "Trace", QString::fromStdString(error));
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(window, "Record Trace", "", "Organ16 traces (*.o16trace)");
+    if (fileName.isEmpty() || !machine.traceRecorder.Start(fileName.toStdString(), TRACE_DEFAULT_KEYFRAME_INTERVAL, error)) {
+        if (!fileName.isEmpty())
+            QMessageBox::warning(window, "Trace", QString::fromStdString(error));
+        QSignalBlocker blocker(action);
+        action->setChecked(false);
+    }
+}
+
+// Runs the whole trace at full speed, the machine is left in its final state
+void ReplayTrace(){
+    QString fileName = QFileDialog::getOpenFileName(window, "Replay Trace", "", "Organ16 traces (*.o16trace)");
+    if (fileName.isEmpty())
+        return;
+
+    TraceReplayer replayer;
+    std::string error;
+    if (!replayer.Load(fileName.toStdString(), error)) {
+        QMessageBox::warning(window, "Trace", QString::fromStdString(error));
+        return;
+    }
+
+    if (automaticClock)
+        toggleManual->setChecked(true);
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    TraceReplayResult result = replayer.Replay(machine);
+    QApplication::restoreOverrideCursor();
+
+    QString summary = QString::fromStdString(result.message) + "\n"
+                    + QString::number(result.inputs) + " inputs, " + QString::number(result.keyframes) + " keyframes checked, "
+                    + QString::number(result.halfTicks / 2) + " cycles";
+    if (result.matched)
+        QMessageBox::information(window, "Trace", summary);
+    else
+        QMessageBox::warning(window, "Trace", summary);
+}
+
+// Checked : keeps the last instructions, dumped on HLT and reset to the file chosen (if any)
+void ToggleFlightRecorder(bool checked){
+    if (!checked) {
+        machine.flightRecorder.Disable();
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(window, "Flight Recorder Dump File (cancel for none)", "", "Text files (*.txt)");
+    machine.flightRecorder.Enable(FLIGHT_RECORDER_DEFAULT_SIZE);
+    machine.flightRecorder.SetDumpPath(fileName.toStdString());
+}
+
+// Checked : counts every access, tints the RAM viewer and shows the density image (both drawn from the snapshots)
+void ToggleHeatmap(QAction* action, bool checked){
+    if (!checked) {
+        machine.heatmap.Disable();
+        if (heatmapWindow)
+            heatmapWindow->hide();
+    }
+    else {
+        machine.heatmap.Enable();
+        if (!heatmapWindow) {
+            heatmapWindow = new QDialog(window);
+            heatmapWindow->setWindowTitle("Memory heatmap (red : writes, green : reads, blue : fetches)");
+            heatmapView = new HeatmapView(heatmapWindow);
+            QVBoxLayout* layout = new QVBoxLayout(heatmapWindow);
+            layout->addWidget(heatmapView);
+
+            // Closing the window stops the counting
+            QObject::connect(heatmapWindow, &QDialog::finished, [action]() { action->setChecked(false); });
+        }
+        heatmapWindow->show();
+    }
+
+    // The RAM viewer and the heatmap window take the heat (or its end) from the next snapshot
+    if (!automaticClock)
+        machine.PublishSnapshot();
+}
+
+void ShowFlightRecorder(){
+    std::ostringstream report;
+    machine.flightRecorder.Write(report, "on demand");
+    ShowTextWindow("Flight recorder", report.str());
+}
+
+// Breakpoints and watches, one Debugger::Add() command per line (they all start over on OK)
+void EditBreakpoints(){
+    QDialog* dialog = new QDialog(window);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle("Breakpoints");
+    dialog->resize(700, 400);
+
+    QLabel* help = new QLabel("break ADDRESS [if CONDITION]\n"
+                              "watch [read|write|access|change] FIRST[-LAST] [if CONDITION]\n"
+                              "watch REGISTER [if CONDITION]\n"
+                              "Conditions such as R3 == 0x7F && [0xC000] > 100, 'value' is the word a watch caught", dialog);
+
+    std::ostringstream list;
+    machine.debugger.List(list);
+    QPlainTextEdit* text = new QPlainTextEdit(dialog);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    text->setPlainText(QString::fromStdString(list.str()));
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, dialog);
+    QObject::connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::reject);
+    QObject::connect(buttons, &QDialogButtonBox::accepted, [dialog, text]() {
+        machine.debugger.Clear();
+        QStringList errors;
+        for (const QString& line : text->toPlainText().split('\n')) {
+            std::string command = line.trimmed().toStdString();
+            std::string error;
+            if (!command.empty() && command[0] != '#' && machine.debugger.Add(command, error) < 0)
+                errors << QString::fromStdString(error);
+        }
+        if (!errors.isEmpty())
+            QMessageBox::warning(window, "Breakpoints", errors.join("\n"));
+        dialog->accept();
+    });
+
+    QVBoxLayout* layout = new QVBoxLayout(dialog);
+    layout->addWidget(help);
+    layout->addWidget(text);
+    layout->addWidget(buttons);
+    dialog->show();
 }
 
 QWidget* MakeDebugWidget(const std::string& tempValueName) {
@@ -188,27 +416,27 @@ void ShowDebug(){
     // ---------- Temporary Values Flip flops ----------
     QGridLayout* gridLayout = new QGridLayout;
     gridLayout->setAlignment(Qt::AlignLeft | Qt::AlignTop);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrExt"), 0, 0);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrAddrBase"), 0, 1);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrAddr"), 0, 2);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrAddrJsr"), 0, 3);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrSpChange"), 1, 0);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrJsr"), 1, 1);
-    gridLayout->addWidget(MakeDebugWidget("IsCurrRts"), 1, 2);
-    gridLayout->addWidget(MakeDebugWidget("RegIsCurrAddr"), 1, 3);
+    for(int i = 0; i < DEBUG_VALUE_COUNT; ++i)
+        gridLayout->addWidget(MakeDebugWidget(debugValueNames[i]), i / 4, i % 4);
     
     debugLayout->addLayout(gridLayout);
     HSplitterBottom->addWidget(debugPanel);
     debugPanel->show();
+
+    // The new LEDs start off, show the current values right away
+    UpdateDebugValues(shownSnapshot.cpu, shownSnapshot.cpu, true);
 }
 
-void UpdateVisualRAMCurrentAddress(uint16_t oldAddress, uint16_t newAddress){
-    int oldRow = oldAddress / 16;
-    int oldColumn = oldAddress % 16;
-    ramPanel->setCellBackground(oldRow, oldColumn, QColor("#5e5e5e"));
-    int row = newAddress / 16;
-    int column = newAddress % 16;
-    ramPanel->setCellBackground(row, column, QColor("#4477ff"));
+// Asks the Machine for the RAM rows in view. True when they changed
+bool UpdateVisibleRAMRows()
+{
+    int first = ramView->rowAt(0);
+    int last = ramView->rowAt(ramView->viewport()->height() - 1);
+    if (first < 0)
+        return ramPanel->setVisibleRows(0, 0);
+    if (last < 0)
+        last = ramPanel->rowCount(QModelIndex()) - 1;
+    return ramPanel->setVisibleRows(first, last - first + 1);
 }
 
 void ResetVisualRAM()
@@ -216,25 +444,57 @@ void ResetVisualRAM()
     ramPanel->updateRAM();
 }
 
-std::pair<int, int> GetScreenDim()
+// Copies the framebuffer rows written since the last display frame into the canvas
+void PresentScreen()
 {
-    return std::pair<int, int>(128, 128);
+    uint64_t dirtyRows[SCREEN_DIRTY_WORDS];
+    machine.framebuffer.TakeDirtyRows(dirtyRows);
+    canvas->presentRows(machine.framebuffer.GetPixels(), dirtyRows);
 }
 
-void SetScreenPixel(int x, int y, QColor color)
+// Same for the ST7735S panel, while its window is open
+void PresentLcd()
 {
-    canvas->setPixel(x, y, color);
+    if (!lcdWindow || !lcdWindow->isVisible())
+        return;
+
+    uint64_t dirtyRows[LCD_DIRTY_WORDS];
+    machine.lcd.TakeDirtyRows(dirtyRows);
+    lcdView->presentRows(machine.lcd, dirtyRows);
 }
 
-void OnClockClick() {
-    QtConcurrent::run([]() {
-        CPU::GetInstance()->RunFrame();
+// Checked : shows the ST7735S panel (the controller runs either way)
+void ToggleLcdWindow(QAction* action, bool checked){
+    if (!checked) {
+        if (lcdWindow)
+            lcdWindow->hide();
+        return;
+    }
 
-        QMetaObject::invokeMethod(canvas, []() {
-            screen->Present(RAM::GetInstance()->framebuffer);
-        }, Qt::QueuedConnection);
-        CPU::GetInstance()->RunFrame(halfTicksOnClockClick);
-    });
+    if (!lcdWindow) {
+        lcdWindow = new QDialog(window);
+        lcdWindow->setWindowTitle("ST7735S panel");
+        lcdView = new LcdView(lcdWindow);
+        QVBoxLayout* layout = new QVBoxLayout(lcdWindow);
+        layout->addWidget(lcdView);
+        QObject::connect(lcdWindow, &QDialog::finished, [action]() { action->setChecked(false); });
+    }
+
+    // Everything again : the rows changed while the window was closed were not taken
+    uint64_t allRows[LCD_DIRTY_WORDS];
+    std::fill(allRows, allRows + LCD_DIRTY_WORDS, ~uint64_t(0));
+    lcdView->presentRows(machine.lcd, allRows);
+    lcdWindow->show();
+}
+
+// Runs on the GUI thread like the automatic clock : the Machine has a single owner, which alone publishes its
+// snapshots and lets the panels edit it between runs
+void OnClockClick() {
+    debugStopMessage.clear();
+    machine.cpu.Run(halfTicksOnClockClick);
+    rewindBuffer.Take(machine);
+    if (machine.debugger.HasStopped())
+        ShowDebugStop();
 }
 
 void OnClockUp(){
@@ -250,45 +510,194 @@ void OnClockDown(){
 }
 
 void OnResetClick(){
-    CPU::GetInstance()->Reset();
+    debugStopMessage.clear();
+    machine.cpu.Reset();
     canvas->clear();
+    RestartRewind();
+}
+
+void SaveStateFile(){
+    QString fileName = QFileDialog::getSaveFileName(window, "Save State", "", "Organ16 save states (*.o16state)");
+    if (fileName.isEmpty())
+        return;
+
+    SaveState saved;
+    std::string error;
+    CaptureSaveState(machine, saved);
+    if (!WriteSaveState(fileName.toStdString(), saved, error))
+        QMessageBox::warning(window, "Save State", QString::fromStdString(error));
+}
+
+void LoadStateFile(const QString& fileName){
+    SaveState saved;
+    std::string error;
+    if (!ReadSaveState(fileName.toStdString(), saved, error)) {
+        QMessageBox::warning(window, "Load State", QString::fromStdString(error));
+        return;
+    }
+    RestoreSaveState(machine, saved);
+    RestartRewind();
+}
+
+// Back count snapshots (display frames of the automatic clock, manual clock clicks)
+void StepBack(size_t count){
+    if (automaticClock)
+        toggleManual->setChecked(true);
+    rewindBuffer.Rewind(machine, count);
 }
 
 void UpdateRegValue(RegisterName name, uint16_t value)
 {
-    if(name == FLAGS){
-        std::bitset<4> bits(value & 0xF); 
-        QString binaryString = "0b" + QString::fromStdString(bits.to_string());
-        registersLineEdits[FLAGS]->setText(binaryString);
+    QString text;
+    if(name == FLAGS)
+        text = "0b" + QString("%1").arg(value & 0xF, 4, 2, QChar('0'));
+    else
+        text = "0x" + QString("%1").arg(value, 4, 16, QChar('0')).toUpper();
+
+    // Showing a value must not write it back into the Machine (textChanged)
+    QLineEdit* lineEdit = registersLineEdits.at(name);
+    QSignalBlocker blocker(lineEdit);
+    lineEdit->setText(text);
+}
+
+void UpdateClockLabel(bool newValue) {
+    static const QString baseStyle = R"(
+        QLabel {
+            border: none;
+            background: transparent;
+            font-weight: 600;
+            font-size: 14px;
+            padding: 2px 4px;
+            color: rgba(%1);
+        }
+    )";
+    static const QString highStyle = baseStyle.arg("9, 202, 25, 255");
+    static const QString lowStyle = baseStyle.arg("167, 167, 167, 255");
+
+    clockLabel->setText(newValue ? "HIGH" : "LOW");
+    clockLabel->setStyleSheet(newValue ? highStyle : lowStyle);
+}
+
+// Shows the latest snapshot the Machine published (GUI thread, once per display refresh).
+// Only the widgets whose value changed since the last refresh are touched
+void RefreshFromSnapshot(){
+    // Kept between frames : the heat planes are copied into the capacity they already have
+    static MachineSnapshot snapshot;
+    if(!machine.snapshots.Consume(snapshot))
+        return;
+
+    const CPUState& state = snapshot.cpu;
+    const CPUState& shownState = shownSnapshot.cpu;
+    bool force = !snapshotShown;
+
+    for(int i = R0; i <= RAM_ADDRESS; ++i){
+        RegisterName name = static_cast<RegisterName>(i);
+        uint16_t value = GetRegisterValue(state, name);
+        if(force || value != GetRegisterValue(shownState, name))
+            UpdateRegValue(name, value);
     }
-    else{
-        std::stringstream ss;
-        ss << "0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << value;
-        QString hexString = QString::fromStdString(ss.str());
 
-        registersLineEdits.at(name)->setText(hexString);
+    UpdateDebugValues(state, shownState, force);
+
+    if(force || state.clockSignal != shownState.clockSignal)
+        UpdateClockLabel(state.clockSignal);
+
+    for(int p = 0; p < IO_PORT_COUNT; ++p){
+        if(force || snapshot.ports[p] != shownSnapshot.ports[p])
+            ioPanel->setPortValue(ioPanel->portNameFromIndex(p), snapshot.ports[p]);
     }
+
+    ramPanel->refresh(snapshot);
+
+    shownSnapshot = snapshot;
+    snapshotShown = true;
 }
 
-void UpdateClockLabel(bool newValue) {
-    QMetaObject::invokeMethod(clockLabel, [newValue]() {
-        clockLabel->setText(newValue ? "HIGH" : "LOW");
-
-        QString color = newValue ? "9, 202, 25, 255" : "167, 167, 167, 255";
-        QString baseStyle = R"(
-            QLabel {
-                border: none;
-                background: transparent;
-                font-weight: 600;
-                font-size: 14px;
-                padding: 2px 4px;
-                color: rgba(%1);
-            }
-        )";
-        clockLabel->setStyleSheet(baseStyle.arg(color));
-    });
+// Achieved against configured frequency, while the automatic clock runs
+void ShowClockSpeed(){
+    if(!automaticClock || pacer.GetTargetFrequency() <= 0){
+        if(debugStopMessage.isEmpty())
+            window->statusBar()->clearMessage();
+        else
+            window->statusBar()->showMessage(debugStopMessage);
+        return;
+    }
+
+    window->statusBar()->showMessage(QString("Clock : %1 MHz (target %2 MHz), %3 half-ticks dropped")
+        .arg(pacer.GetAchievedFrequency() / 1e6, 0, 'f', 3)
+        .arg(pacer.GetTargetFrequency() / 1e6, 0, 'f', 3)
+        .arg(pacer.GetDroppedHalfTicks()));
+}
+
+// Effective clock, instructions per cycle, host time per instruction and display frame time.
+// Counters compiled out (ORGAN16_PERF_COUNTERS) leave IPC and ns / instruction at 0
+void ShowPerformanceHud(){
+    HudSample now;
+    now.time = ClockPacer::HostClock::now();
+    now.instructions = shownSnapshot.perf.Get(PERF_INSTRUCTIONS);
+    now.halfTicks = shownSnapshot.halfTicks;
+    now.emulationSeconds = pacer.GetEmulationSeconds();
+    now.frames = displayFrames;
+
+    if(!hudSampled){
+        hudSample = now;
+        hudSampled = true;
+        return;
+    }
+
+    double seconds = std::chrono::duration<double>(now.time - hudSample.time).count();
+    if(seconds < PACER_MEASURE_SECONDS)
+        return;
+
+    // A reset sends the counters back to 0
+    uint64_t instructions = now.instructions >= hudSample.instructions ? now.instructions - hudSample.instructions : 0;
+    uint64_t halfTicks = now.halfTicks >= hudSample.halfTicks ? now.halfTicks - hudSample.halfTicks : 0;
+    double cycles = halfTicks / 2.0;
+    double emulationSeconds = now.emulationSeconds - hudSample.emulationSeconds;
+    uint64_t frames = now.frames - hudSample.frames;
+    hudSample = now;
+
+    QString text = QString("%1 MHz | IPC %2 | %3 ns/instr | frame %4 ms")
+        .arg(cycles / seconds / 1e6, 0, 'f', 3)
+        .arg(cycles > 0 ? instructions / cycles : 0.0, 0, 'f', 3)
+        .arg(instructions > 0 ? emulationSeconds * 1e9 / instructions : 0.0, 0, 'f', 1)
+        .arg(frames > 0 ? seconds * 1000.0 / frames : 0.0, 0, 'f', 1);
+    if(text != hudLabel->text())
+        hudLabel->setText(text);
 }
 
+// Once per display frame : the panels and the screen catch up with the Machine
+void RefreshDisplay(){
+    displayFrames++;
+
+    // The Machine runs on this thread (automatic clock and clock clicks) : when it is idle it publishes the rows
+    // scrolled into view right away
+    if(UpdateVisibleRAMRows() && !automaticClock)
+        machine.PublishSnapshot();
+    RefreshFromSnapshot();
+    PresentScreen();
+    PresentLcd();
+
+    if(heatmapView && heatmapWindow->isVisible())
+        heatmapView->present(shownSnapshot);
+
+    // The automatic clock runs the Machine on this thread : the counts fade while the program runs, not while it waits
+    if(machine.heatmap.IsEnabled() && automaticClock)
+        machine.heatmap.Decay();
+    ShowClockSpeed();
+    ShowPerformanceHud();
+}
+
+// Routes the backend notifications to the widgets
+class GuiObserver : public EmulatorObserver{
+    public:
+        void OnRAMReset() override {
+            ResetVisualRAM();
+        }
+};
+
+GuiObserver guiObserver;
+
 QWidget* MakeRegisterWidget(const QString& regName) {
     QWidget* w = new QWidget;
     QVBoxLayout* layout = new QVBoxLayout(w);
@@ -309,7 +718,7 @@ QWidget* MakeRegisterWidget(const QString& regName) {
         uint16_t result = static_cast<uint16_t>(value.toUShort(&ok, 16));
 
         if (ok) {
-            RegisterFile::GetInstance()->SetRegValue(RegisterFromString(regName.toStdString()), result);
+            machine.registers.SetRegValue(RegisterFromString(regName.toStdString()), result);
         }
     });
 
@@ -440,6 +849,18 @@ void SetupGUI(){
     importAction->setToolTip("Load a compiled program file to RAM");
     QObject::connect(importAction, &QAction::triggered, &ImportRAM);
     file_menu->addAction(importAction);
+    QAction* saveStateAction = new QAction("Save state...", file_menu);
+    saveStateAction->setToolTip("Write the whole machine (registers, flip-flops, IO ports, RAM) to a file");
+    QObject::connect(saveStateAction, &QAction::triggered, &SaveStateFile);
+    file_menu->addAction(saveStateAction);
+    QAction* loadStateAction = new QAction("Load state...", file_menu);
+    loadStateAction->setToolTip("Put the machine back in a saved state (also: organ16 <file.o16state>)");
+    QObject::connect(loadStateAction, &QAction::triggered, []() {
+        QString fileName = QFileDialog::getOpenFileName(window, "Load State", "", "Organ16 save states (*.o16state)");
+        if (!fileName.isEmpty())
+            LoadStateFile(fileName);
+    });
+    file_menu->addAction(loadStateAction);
 
     QMenu *debug_menu = new QMenu("Debug", menubar);
     QAction* showSignals = new QAction();
@@ -447,6 +868,53 @@ void SetupGUI(){
     showSignals->setToolTip("Show all intermediate/temporary values");
     QObject::connect(showSignals, &QAction::triggered, &ShowDebug);
     debug_menu->addAction(showSignals);
+
+    QAction* breakpointsAction = new QAction("Breakpoints...", debug_menu);
+    breakpointsAction->setToolTip("Stop on an address, a RAM access or a register change, with an optional condition");
+    QObject::connect(breakpointsAction, &QAction::triggered, &EditBreakpoints);
+    debug_menu->addAction(breakpointsAction);
+
+    QAction* heatmapAction = new QAction("Memory heatmap", debug_menu);
+    heatmapAction->setCheckable(true);
+    heatmapAction->setToolTip("Count the reads, writes and fetches of every address");
+    QObject::connect(heatmapAction, &QAction::toggled, [heatmapAction](bool checked) { ToggleHeatmap(heatmapAction, checked); });
+    debug_menu->addAction(heatmapAction);
+
+    QMenu* profilerMenu = new QMenu("Profiler...", debug_menu);
+    QAction* profileAction = new QAction("Sample the program counter", profilerMenu);
+    profileAction->setCheckable(true);
+    profileAction->setToolTip("Sample the PC every " + QString::number(PROFILER_DEFAULT_INTERVAL) + " cycles while the program runs");
+    QObject::connect(profileAction, &QAction::toggled, &ToggleProfiler);
+    QAction* clearProfileAction = new QAction("Clear samples", profilerMenu);
+    QObject::connect(clearProfileAction, &QAction::triggered, []() { machine.profiler.Clear(); });
+    QAction* showProfileAction = new QAction("Show profile...", profilerMenu);
+    showProfileAction->setToolTip("Hot routines and source lines (uses the .map next to the imported program)");
+    QObject::connect(showProfileAction, &QAction::triggered, &ShowProfile);
+    profilerMenu->addAction(profileAction);
+    profilerMenu->addAction(clearProfileAction);
+    profilerMenu->addAction(showProfileAction);
+    debug_menu->addMenu(profilerMenu);
+
+    QMenu* traceMenu = new QMenu("Trace...", debug_menu);
+    QAction* recordTraceAction = new QAction("Record trace...", traceMenu);
+    recordTraceAction->setCheckable(true);
+    recordTraceAction->setToolTip("Record the inputs and state keyframes of the run, to replay it exactly");
+    QObject::connect(recordTraceAction, &QAction::toggled, [recordTraceAction](bool checked) { ToggleTraceRecording(recordTraceAction, checked); });
+    QAction* replayTraceAction = new QAction("Replay trace...", traceMenu);
+    replayTraceAction->setToolTip("Replay a recorded run at full speed and check it goes the same way");
+    QObject::connect(replayTraceAction, &QAction::triggered, &ReplayTrace);
+    QAction* flightRecorderAction = new QAction("Flight recorder", traceMenu);
+    flightRecorderAction->setCheckable(true);
+    flightRecorderAction->setToolTip("Keep the last " + QString::number(FLIGHT_RECORDER_DEFAULT_SIZE) + " instructions executed (runs one instruction at a time)");
+    QObject::connect(flightRecorderAction, &QAction::toggled, &ToggleFlightRecorder);
+    QAction* showFlightRecorderAction = new QAction("Show flight recorder...", traceMenu);
+    QObject::connect(showFlightRecorderAction, &QAction::triggered, &ShowFlightRecorder);
+    traceMenu->addAction(recordTraceAction);
+    traceMenu->addAction(replayTraceAction);
+    traceMenu->addSeparator();
+    traceMenu->addAction(flightRecorderAction);
+    traceMenu->addAction(showFlightRecorderAction);
+    debug_menu->addMenu(traceMenu);
     
     QMenu *simulation_menu = new QMenu("Simulation", menubar);
     QMenu* modClockFreq = new QMenu("Clock frequency...", simulation_menu);
@@ -458,14 +926,14 @@ void SetupGUI(){
     QVBoxLayout* frequencyVLayout = new QVBoxLayout(mainFrequencyWidget);
 
     QLabel* frequencyTitle = new QLabel(
-        QString("Frequency: %1 Hz").arg(savedClockFrequency)
+        QString("Frequency: %1 MHz").arg(savedClockFrequency)
     );
     frequencyTitle->setAlignment(Qt::AlignHCenter);
 
     QSlider* slider = new QSlider(Qt::Horizontal);
     slider->setMinimumSize(200, 50);
     slider->setRange(0, 100);
-    slider->setValue(Clock::GetInstance()->GetFrequency());
+    slider->setValue(static_cast<int>(machine.clock.GetFrequency() / 1e6));
     QObject::connect(slider, &QSlider::valueChanged, [frequencyTitle](int value){
         savedClockFrequency = value;
         if(automaticClock)
@@ -518,8 +986,55 @@ void SetupGUI(){
     });
     modClockType->addAction(toggleManual);
 
+    QMenu* modEngine = new QMenu("Execution engine...", simulation_menu);
+    modEngine->setToolTip("Half-tick circuit model or fast instruction-level engine");
+    QActionGroup* engineGroup = new QActionGroup(modEngine);
+    QAction* rtlEngine = new QAction("RTL (half-tick)", engineGroup);
+    rtlEngine->setCheckable(true);
+    rtlEngine->setChecked(true);
+    QObject::connect(rtlEngine, &QAction::triggered, [](){
+        machine.cpu.SetExecutionEngine(ENGINE_RTL);
+    });
+    QAction* functionalEngine = new QAction("Functional (fast)", engineGroup);
+    functionalEngine->setCheckable(true);
+    QObject::connect(functionalEngine, &QAction::triggered, [](){
+        machine.cpu.SetExecutionEngine(ENGINE_FUNCTIONAL);
+    });
+    QAction* jitEngine = new QAction("JIT (native code)", engineGroup);
+    jitEngine->setCheckable(true);
+    jitEngine->setEnabled(JitCompiler::IsSupported());
+    QObject::connect(jitEngine, &QAction::triggered, [](){
+        machine.cpu.SetExecutionEngine(ENGINE_JIT);
+    });
+    modEngine->addAction(rtlEngine);
+    modEngine->addAction(functionalEngine);
+    modEngine->addAction(jitEngine);
+
     simulation_menu->addMenu(modClockType);
     simulation_menu->addMenu(modClockFreq);
+    simulation_menu->addMenu(modEngine);
+
+    QAction* stepBackAction = new QAction("Step back", simulation_menu);
+    stepBackAction->setShortcut(QKeySequence("Ctrl+Z"));
+    stepBackAction->setToolTip("Back one display frame (automatic clock) or one clock click (manual clock)");
+    QObject::connect(stepBackAction, &QAction::triggered, []() { StepBack(1); });
+    QAction* stepBackSecondAction = new QAction("Step back 60 steps", simulation_menu);
+    stepBackSecondAction->setShortcut(QKeySequence("Ctrl+Shift+Z"));
+    QObject::connect(stepBackSecondAction, &QAction::triggered, []() { StepBack(60); });
+    simulation_menu->addAction(stepBackAction);
+    simulation_menu->addAction(stepBackSecondAction);
+
+    QAction* lcdAction = new QAction("ST7735S panel", simulation_menu);
+    lcdAction->setCheckable(true);
+    lcdAction->setToolTip("Show the display controller's panel (registers at 0xEE00)");
+    QObject::connect(lcdAction, &QAction::toggled, [lcdAction](bool checked) { ToggleLcdWindow(lcdAction, checked); });
+    QAction* lcdSpiAction = new QAction("ST7735S pins on port C", simulation_menu);
+    lcdSpiAction->setCheckable(true);
+    lcdSpiAction->setToolTip("Drive the display controller bit by bit with OUT2 (SDA bit 0, SCL bit 1, D/CX bit 2, CSX bit 3, RESX bit 4)");
+    QObject::connect(lcdSpiAction, &QAction::toggled, [](bool checked) { machine.lcd.SetSpiPort(checked ? 2 : -1); });
+    simulation_menu->addSeparator();
+    simulation_menu->addAction(lcdAction);
+    simulation_menu->addAction(lcdSpiAction);
 
     menubar->addMenu(file_menu);
     menubar->addMenu(debug_menu);
@@ -549,8 +1064,6 @@ void SetupGUI(){
     canvas = new CanvasWidget;
     canvas->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
     rightLayout->addWidget(canvas);
-
-    screen = new QtDisplay(canvas);
     
     /* ============ Left panel ============== */
     QWidget* leftPanel = new QWidget;
@@ -558,7 +1071,7 @@ void SetupGUI(){
     leftPanel->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
     QVBoxLayout* leftLayout = new QVBoxLayout(leftPanel);
 
-    ramPanel = new RamPanel();
+    ramPanel = new RamPanel(machine);
     ramView = new QTableView;
     ramView->setModel(ramPanel);
     ramView->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Minimum);
@@ -644,7 +1157,7 @@ void SetupGUI(){
 
     // ---------- Bottom panel : IO Ports --------------
 
-    ioPanel = new IOPortsPanel();
+    ioPanel = new IOPortsPanel(machine);
 
     HSplitterBottom->addWidget(bottomPanel);
     HSplitterBottom->addWidget(ioPanel);
@@ -655,6 +1168,9 @@ void SetupGUI(){
     VSplitter->addWidget(HSplitterBottom);
 
     window->setCentralWidget(VSplitter);
+
+    hudLabel = new QLabel;
+    window->statusBar()->addPermanentWidget(hudLabel);
     window->setWindowTitle("Organ 16 Emulator");
     window->show();
 }
@@ -664,9 +1180,25 @@ int main(int argc, char *argv[]) {
 
     SetupGUI();
 
-    CPU* cpu = CPU::GetInstance();
+    machine.SetObserver(&guiObserver);
+
+    CPU* cpu = &machine.cpu;
 
     cpu->Init();
 
+    // organ16 <file.o16state> : starts where the state was saved (a program's long initialisation already done)
+    QStringList arguments = app.arguments();
+    if (arguments.size() > 1 && arguments[1].endsWith(".o16state"))
+        LoadStateFile(arguments[1]);
+    else
+        RestartRewind();
+
+    // Registers, flags, flip-flops, IO ports and the screen follow the display, whatever the clock does
+    QScreen* screen = QGuiApplication::primaryScreen();
+    qreal refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60.0;
+    displayFrameMs = std::max(1, static_cast<int>(1000.0 / refreshRate));
+    QObject::connect(&refreshTimer, &QTimer::timeout, &RefreshDisplay);
+    refreshTimer.start(displayFrameMs);
+
     return app.exec();
 }
\ No newline at end of file
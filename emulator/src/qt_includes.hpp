@@ -1,5 +1,6 @@
 #include <QApplication>
 #include <QMainWindow>
+#include <QStatusBar>
 #include <QSplitter>
 #include <QMenuBar>
 #include <QVBoxLayout>
@@ -8,6 +9,8 @@
 #include <QLineEdit>
 #include <QFile>
 #include <QTimer>
+#include <QScreen>
+#include <QSignalBlocker>
 #include <QString>
 #include <QStringLiteral>
 #include <QtConcurrent>
@@ -16,4 +19,9 @@
 #include <QFileDialog>
 #include <QFile>
 #include <QMessageBox>
-#include <QWidgetAction>
\ No newline at end of file
+#include <QWidgetAction>
+#include <QActionGroup>
+#include <QDialog>
+#include <QPlainTextEdit>
+#include <QFontDatabase>
+#include <QDialogButtonBox>
\ No newline at end of file
@@ -2,6 +2,7 @@ import os
 import re
 import sys
 import json
+import struct
 from typing import Tuple, List, Optional
 
 STACK_START = 0xF000
@@ -57,6 +58,7 @@ INSTR_FORMAT = {
     "IN0":  {"regs": 1, "imm": False},
     "IN1":  {"regs": 1, "imm": False},
     "IN2":  {"regs": 1, "imm": False},
+    "IN3":  {"regs": 2, "imm": False},  # Emulator performance counters : IN3 Rd, Rs
     "OUT0": {"regs": 1, "imm": False},
     "OUT1": {"regs": 1, "imm": False},
     "OUT2": {"regs": 1, "imm": False},
@@ -75,20 +77,26 @@ def replace_names_with_values(expr: str, mapping: dict) -> str:
         expr = new_expr
     return expr
 
-def ReadFileLines(filename: str):
+def ReadFileLinesNumbered(filename: str) -> List[Tuple[str, int]]:
+    """
+    Same as ReadFileLines, each line paired with its 1-based line number in the file (for the source map).
+    """
     try:
         with open(filename, 'r') as file:
             lines = []
-            for line in file:
+            for number, line in enumerate(file, start=1):
                 # Strip comments starting with ; or #
                 line = line.split(';')[0].split('#')[0].strip()
                 if line:
-                    lines.append(line)
+                    lines.append((line, number))
             return lines
     except FileNotFoundError:
         print(f"File '{filename}' not found.", file=sys.stderr)
         sys.exit(1)
 
+def ReadFileLines(filename: str):
+    return [line for line, _ in ReadFileLinesNumbered(filename)]
+
 def ImmediateToBin(immediate: str, label_map: dict = None, constants_map: dict = None) -> str:
     try:
 
@@ -133,6 +141,7 @@ def OpCodeToBinOpCode(instruction: str) -> str:
         "POP":  ("101", "0001"), "STORER": ("011", "0010"), "LOADR": ("011", "0011"),
         "IN0":  ("111", "0001"), "IN1":  ("111", "0010"), "IN2":  ("111", "0011"),
         "OUT0":  ("111", "0100"), "OUT1":  ("111", "0101"), "OUT2":  ("111", "0110"),
+        "IN3":  ("111", "0111"),
     }
     if instruction in opcode_map:
         op, sub = opcode_map[instruction]
@@ -309,9 +318,62 @@ def ReplaceLabelsAndConstants(line: str, label_map: dict, constants_map: dict) -
             line = line.replace(imm, str(constants_map[imm_upper]))
     return line
 
-def CompileMultiple(segments: List[Tuple[str, int]], output_file: str):
+def WriteSourceMap(map_file: str, source_files: List[str], labels: List[Tuple[int, str]], locations: List[Tuple[int, int, int, int]]):
+    """
+    Write the source map read by the emulator's profiler, next to the .bin :
+        organ16-map 1
+        file <index> <path relative to the map>
+        label <address> <name>
+        line <address> <words> <file index> <line number>
+    Addresses are 4 hexadecimal digits, one 'line' record per instruction.
+    """
+    map_dir = os.path.dirname(os.path.abspath(map_file))
+    with open(map_file, "w") as out:
+        out.write("organ16-map 1\n")
+        for index, path in enumerate(source_files):
+            out.write(f"file {index} {os.path.relpath(path, map_dir)}\n")
+        for address, name in labels:
+            out.write(f"label {address:04x} {name}\n")
+        for address, words, file_index, number in locations:
+            out.write(f"line {address:04x} {words} {file_index} {number}\n")
+
+def WriteProgramImage(image_file: str, memory: List[str], ranges: List[Tuple[int, int]], entry: Optional[int]):
+    """
+    Write the program image the emulator maps instead of parsing the text .bin (little endian) :
+        "O16IMAGE", u32 version (1), u16 flags (1 : entry point set), u16 entry point,
+        u32 segment count, u32 reserved (0), u64 checksum (FNV-1a over every byte after this 32 byte header)
+        per segment : u32 first word, u32 length in words
+        then every segment's words, one segment after the other
+    Only the linker segments' words are stored, the emulator fills the rest of the RAM with zeros.
+    """
+    merged = []
+    for start, end in sorted(r for r in ranges if r[1] > r[0]):
+        if merged and start <= merged[-1][1]:
+            merged[-1][1] = max(merged[-1][1], end)
+        else:
+            merged.append([start, end])
+
+    table = b"".join(struct.pack("<II", start, end - start) for start, end in merged)
+    data = b"".join(struct.pack("<H", int(memory[address], 16)) for start, end in merged for address in range(start, end))
+
+    checksum = 0xCBF29CE484222325
+    for byte in table + data:
+        checksum = ((checksum ^ byte) * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+
+    flags = 1 if entry is not None else 0
+    header = b"O16IMAGE" + struct.pack("<IHHIIQ", 1, flags, entry or 0, len(merged), 0, checksum)
+    with open(image_file, "wb") as out:
+        out.write(header + table + data)
+
+def CompileMultiple(segments: List[Tuple[str, int]], output_file: str, map_file: Optional[str] = None,
+                    image_file: Optional[str] = None, entry: Optional[str] = None):
     memory = ["0000"] * 65536  # 64K words initialized to zero
 
+    # Source map : files, labels and (address, words, file, line) of every instruction
+    source_files = []
+    map_labels = []
+    map_locations = []
+
     global_labels = {}
     file_lines = []
     all_constants = {}
@@ -328,18 +390,22 @@ def CompileMultiple(segments: List[Tuple[str, int]], output_file: str):
                 words = words[:max_instr]
 
             # store into memory later
-            file_lines.append((words, base_addr, "BINARY"))
+            file_lines.append((words, base_addr, "BINARY", None, -1))
             continue
         # ----------------------------------------------------------------------
 
-        lines = ReadFileLines(filepath)
+        numbered = ReadFileLinesNumbered(filepath)
+        lines = [line for line, _ in numbered]
+        numbers = [number for _, number in numbered]
 
         # Extract constants first
         constants = ParseConstants(lines)
         all_constants.update(constants)
 
         # Remove @define lines before further processing
-        lines = [line for line in lines if not line.strip().startswith("@define")]
+        kept = [i for i, line in enumerate(lines) if not line.strip().startswith("@define")]
+        lines = [lines[i] for i in kept]
+        numbers = [numbers[i] for i in kept]
 
         instr_count = sum(InstructionWordCount(line) for line in lines if not IsLabel(line))
         max_instr = STACK_START - base_addr
@@ -362,12 +428,17 @@ def CompileMultiple(segments: List[Tuple[str, int]], output_file: str):
                 new_lines.append(line)
                 words_used += word_count
             lines = new_lines
+            numbers = numbers[:len(lines)]
 
         label_map = FirstPass(lines, base_addr)
         global_labels.update(label_map)
-        file_lines.append((lines, base_addr, constants))  # pass constants too
+        source_files.append(filepath)
+        file_lines.append((lines, base_addr, constants, numbers, len(source_files) - 1))  # pass constants too
 
-    for segment, base_addr, segtype in file_lines:
+    # Words written by each segment, the program image only stores those
+    ranges = []
+
+    for segment, base_addr, segtype, numbers, file_index in file_lines:
         addr = base_addr
 
         # --- Direct binary copy ---------------------------------------
@@ -375,14 +446,17 @@ def CompileMultiple(segments: List[Tuple[str, int]], output_file: str):
             for w in segment:
                 memory[addr] = w
                 addr += 1
+            ranges.append((base_addr, addr))
             continue
         # --------------------------------------------------------------------
 
         lines = segment
-        for line in lines:
+        for line, number in zip(lines, numbers):
             if IsLabel(line):
+                map_labels.append((addr, line[:-1]))
                 continue
             # Replace labels and constants
+            start = addr
             line = ReplaceLabelsAndConstants(line, global_labels, constants)
             binaries = LineToBinary(line, global_labels, constants)
             if isinstance(binaries, (tuple, list)):
@@ -392,11 +466,24 @@ def CompileMultiple(segments: List[Tuple[str, int]], output_file: str):
             elif binaries:
                 memory[addr] = BinToHex(binaries)
                 addr += 1
+            if addr > start:
+                map_locations.append((start, addr - start, file_index, number))
+        ranges.append((base_addr, addr))
 
     with open(output_file, "w") as out:
         for i in range(0, len(memory), 16):
             out.write(" ".join(memory[i:i+16]) + "\n")
 
+    if map_file:
+        WriteSourceMap(map_file, source_files, map_labels, map_locations)
+
+    if image_file:
+        # Entry point : a label or a hexadecimal address, the program starts at 0 without one
+        entry_address = None
+        if entry is not None:
+            entry_address = global_labels[entry] if entry in global_labels else int(entry, 16)
+        WriteProgramImage(image_file, memory, ranges, entry_address)
+
 def find_first_list(data):
     if isinstance(data, list):
         return data
@@ -455,9 +542,12 @@ def main():
         print("No valid segments to compile.", file=sys.stderr)
         sys.exit(1)
 
-    CompileMultiple(segments, filename[:-1] + "bin")
+    # Optional "entry": "LABEL" or "0x0040" next to the segments
+    entry = data.get("entry") if isinstance(data, dict) else None
+
+    CompileMultiple(segments, filename[:-1] + "bin", filename[:-1] + "map", filename[:-1] + "o16", entry)
 
-    print(f"Successfully compiled {filename[:-1]}bin")
+    print(f"Successfully compiled {filename[:-1]}bin (source map {filename[:-1]}map, program image {filename[:-1]}o16)")
 
 if __name__ == '__main__':
     main()
\ No newline at end of file